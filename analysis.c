@@ -0,0 +1,358 @@
+/**
+ * @file analysis.c
+ * @brief Statistics computed from trajectory files across all cores.
+ * @author Justin Thoreson
+ */
+
+#include "analysis.h"
+#include "threadpool.h"
+#include "trajectory.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief The fewest particles of a step worth totalling on a thread of their own.
+ */
+#define CHUNK_PARTICLES 16384
+
+/**
+ * @brief Accumulators owned by a single worker thread.
+ */
+typedef struct {
+	uint64_t* visits;    // Visits of each cell, row by row
+	uint64_t* last_seen; // One past the last step each particle was alive in
+} accumulator_t;
+
+/**
+ * @brief A range of the particles of a step whose displacement is totalled on
+ * the pool.
+ */
+typedef struct {
+	const particle_store_t* particles;
+	int32_t* displacement;   // Net x and y moves of each particle so far
+	uint32_t particle_count; // Particles of the trajectory
+	uint32_t first, end;     // The particles of the range
+	bool moved;              // Whether the particles moved into the step
+	double sum;              // Sum of squared displacements of the range
+	randomwalk_result_t result;
+} chunk_t;
+
+/**
+ * @brief The state of an analysis shared by its jobs.
+ */
+typedef struct {
+	const trajectory_t* trajectory;
+	trajectory_info_t info;
+	analysis_args_t args;
+	threadpool_t* pool;
+	uint16_t workers;
+	accumulator_t* accumulators; // One per worker thread
+	chunk_t* chunks;             // One per worker thread
+	int32_t* displacement;       // Net x and y moves of each particle so far
+	double* msd;                 // Sum of squared displacements of each step
+	uint32_t* alive;             // Particles alive in each step
+} analysis_t;
+
+/**
+ * @brief The decoding of a single block scheduled on the pool.
+ */
+typedef struct {
+	analysis_t* analysis;
+	uint64_t block;
+	randomwalk_result_t result;
+} job_t;
+
+/**
+ * @brief Decode the block of a job; a threadpool_task_fn.
+ * @param[in,out] arg The job_t to run.
+ */
+static void run_job(void* arg);
+
+/**
+ * @brief Accumulate the visits or exits of a decoded step; a trajectory_visit_t.
+ * @param[in,out] context The job_t decoding the step.
+ * @param[in] step The decoded step.
+ * @param[in] particles The particles alive after the step.
+ * @return The result of accumulating the step.
+ */
+static randomwalk_result_t visit_step(
+	void* context,
+	const uint64_t step,
+	const particle_store_t* const particles
+);
+
+/**
+ * @brief Carry the displacement of each particle through a decoded step and
+ * record its mean square, splitting the particles across the pool; a
+ * trajectory_visit_t.
+ * @param[in,out] context The analysis_t decoding the step.
+ * @param[in] step The decoded step.
+ * @param[in] particles The particles alive after the step.
+ * @return The result of accumulating the step.
+ */
+static randomwalk_result_t visit_displacement(
+	void* context,
+	const uint64_t step,
+	const particle_store_t* const particles
+);
+
+/**
+ * @brief Total the displacement of a range of particles; a threadpool_task_fn.
+ * @param[in,out] arg The chunk_t to total.
+ */
+static void run_chunk(void* arg);
+
+/**
+ * @brief Decode every block holding an analyzed step on the pool.
+ * @param[in,out] analysis The analysis to run.
+ * @param[in] first_block The block holding the first analyzed step.
+ * @param[in] end_block One past the block holding the last analyzed step.
+ * @return The result of decoding the blocks.
+ */
+static randomwalk_result_t decode_blocks(
+	analysis_t* const analysis,
+	const uint64_t first_block,
+	const uint64_t end_block
+);
+
+/**
+ * @brief Write the merged statistic to standard output.
+ * @param[in] analysis The finished analysis.
+ * @param[in] workers The number of worker threads.
+ */
+static void write_statistic(const analysis_t* const analysis, const uint16_t workers);
+
+randomwalk_result_t analysis(const analysis_args_t args) {
+	analysis_t state = { .args = args };
+	trajectory_t* trajectory = NULL;
+	randomwalk_result_t result = trajectory_open(&trajectory, args.path);
+	if (result != RANDOMWALK_OK)
+		return result;
+	state.trajectory = trajectory;
+	trajectory_info(trajectory, &state.info);
+	const trajectory_info_t* const info = &state.info;
+	if (!state.args.last || state.args.last > info->last_step)
+		state.args.last = info->last_step;
+	if (state.args.first < info->first_step)
+		state.args.first = info->first_step;
+	uint64_t first_block = 0, last_block = 0;
+	if (state.args.first > state.args.last ||
+		trajectory_find_block(trajectory, state.args.first, &first_block) != RANDOMWALK_OK ||
+		trajectory_find_block(trajectory, state.args.last, &last_block) != RANDOMWALK_OK) {
+		trajectory_close(&trajectory);
+		return RANDOMWALK_FAIL;
+	}
+	result = threadpool_create(&state.pool, args.threads);
+	const uint16_t workers = state.pool ? threadpool_size(state.pool) : 0;
+	state.workers = workers;
+	const uint64_t steps = state.args.last - state.args.first + 1;
+	const size_t cells = (size_t)info->width * info->height;
+	if (result == RANDOMWALK_OK && args.stat == ANALYSIS_MSD) {
+		// Displacement carries over from block to block, so blocks are decoded
+		// in order and only the particles of each step are split across threads
+		state.chunks = (chunk_t*)calloc(workers, sizeof(chunk_t));
+		state.displacement = (int32_t*)calloc((size_t)info->particle_count * 2, sizeof(int32_t));
+		state.msd = (double*)calloc(steps, sizeof(double));
+		state.alive = (uint32_t*)calloc(steps, sizeof(uint32_t));
+		if (!state.chunks || !state.msd || !state.alive || (info->particle_count && !state.displacement))
+			result = RANDOMWALK_FAIL;
+		// Moves before the first analyzed step still add up to the displacement
+		if (result == RANDOMWALK_OK)
+			result = trajectory_read(trajectory, info->first_step, state.args.last, visit_displacement, &state);
+	} else if (result == RANDOMWALK_OK) {
+		state.accumulators = (accumulator_t*)calloc(workers, sizeof(accumulator_t));
+		result = state.accumulators ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+		for (uint16_t i = 0; result == RANDOMWALK_OK && i < workers; i++) {
+			accumulator_t* const accumulator = &state.accumulators[i];
+			if (args.stat == ANALYSIS_VISITS)
+				accumulator->visits = (uint64_t*)calloc(cells, sizeof(uint64_t));
+			if (args.stat == ANALYSIS_EXITS)
+				accumulator->last_seen = (uint64_t*)calloc(info->particle_count, sizeof(uint64_t));
+			if ((args.stat == ANALYSIS_VISITS && !accumulator->visits) ||
+				(args.stat == ANALYSIS_EXITS && info->particle_count && !accumulator->last_seen))
+				result = RANDOMWALK_FAIL;
+		}
+		if (result == RANDOMWALK_OK)
+			result = decode_blocks(&state, first_block, last_block + 1);
+	}
+	if (result == RANDOMWALK_OK)
+		write_statistic(&state, workers);
+	if (state.pool)
+		threadpool_destroy(&state.pool);
+	for (uint16_t i = 0; state.accumulators && i < workers; i++) {
+		free(state.accumulators[i].visits);
+		free(state.accumulators[i].last_seen);
+	}
+	free(state.accumulators);
+	free(state.chunks);
+	free(state.displacement);
+	free(state.msd);
+	free(state.alive);
+	trajectory_close(&trajectory);
+	return result == RANDOMWALK_OK ? RANDOMWALK_DONE : result;
+}
+
+static randomwalk_result_t decode_blocks(
+	analysis_t* const analysis,
+	const uint64_t first_block,
+	const uint64_t end_block
+) {
+	const uint64_t blocks = end_block - first_block;
+	job_t* const jobs = (job_t*)calloc(blocks, sizeof(job_t));
+	if (!jobs)
+		return RANDOMWALK_FAIL;
+	randomwalk_result_t result = RANDOMWALK_OK;
+	for (uint64_t i = 0; result == RANDOMWALK_OK && i < blocks; i++) {
+		jobs[i] = (job_t){ .analysis = analysis, .block = first_block + i };
+		result = threadpool_submit(analysis->pool, run_job, &jobs[i]);
+	}
+	if (result == RANDOMWALK_OK)
+		result = threadpool_wait(analysis->pool);
+	for (uint64_t i = 0; result == RANDOMWALK_OK && i < blocks; i++)
+		result = jobs[i].result;
+	free(jobs);
+	return result;
+}
+
+static void run_job(void* arg) {
+	job_t* const job = (job_t*)arg;
+	const analysis_t* const analysis = job->analysis;
+	job->result = trajectory_decode_block(
+		analysis->trajectory,
+		job->block,
+		analysis->args.first,
+		analysis->args.last,
+		visit_step,
+		job
+	);
+}
+
+static randomwalk_result_t visit_step(
+	void* context,
+	const uint64_t step,
+	const particle_store_t* const particles
+) {
+	job_t* const job = (job_t*)context;
+	const analysis_t* const analysis = job->analysis;
+	const trajectory_info_t* const info = &analysis->info;
+	const int32_t worker = threadpool_worker_index();
+	if (worker < 0)
+		return RANDOMWALK_FAIL;
+	const accumulator_t* const accumulator = &analysis->accumulators[worker];
+	if (analysis->args.stat == ANALYSIS_VISITS) {
+		for (uint32_t i = 0; i < particles->count; i++)
+			accumulator->visits[particles->y[i] * info->width + particles->x[i]]++;
+	} else {
+		for (uint32_t i = 0; i < particles->count; i++) {
+			const uint32_t id = particles->id[i];
+			if (id >= info->particle_count)
+				return RANDOMWALK_FAIL;
+			if (accumulator->last_seen[id] < step + 1)
+				accumulator->last_seen[id] = step + 1;
+		}
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t visit_displacement(
+	void* context,
+	const uint64_t step,
+	const particle_store_t* const particles
+) {
+	analysis_t* const analysis = (analysis_t*)context;
+	const uint32_t count = particles->count;
+	uint32_t chunk_count = (count + CHUNK_PARTICLES - 1) / CHUNK_PARTICLES;
+	if (chunk_count > analysis->workers)
+		chunk_count = analysis->workers;
+	if (!chunk_count)
+		chunk_count = 1;
+	// Particles are stored once each, so chunks move disjoint displacements
+	for (uint32_t i = 0; i < chunk_count; i++)
+		analysis->chunks[i] = (chunk_t){
+			.particles = particles,
+			.displacement = analysis->displacement,
+			.particle_count = analysis->info.particle_count,
+			.first = (uint32_t)((uint64_t)count * i / chunk_count),
+			.end = (uint32_t)((uint64_t)count * (i + 1) / chunk_count),
+			// The direction after every step but the first is that of its move
+			.moved = step > analysis->info.first_step
+		};
+	randomwalk_result_t result = RANDOMWALK_OK;
+	if (chunk_count == 1)
+		run_chunk(&analysis->chunks[0]);
+	else {
+		for (uint32_t i = 0; result == RANDOMWALK_OK && i < chunk_count; i++)
+			result = threadpool_submit(analysis->pool, run_chunk, &analysis->chunks[i]);
+		if (result == RANDOMWALK_OK)
+			result = threadpool_wait(analysis->pool);
+	}
+	double sum = 0;
+	for (uint32_t i = 0; result == RANDOMWALK_OK && i < chunk_count; i++) {
+		result = analysis->chunks[i].result;
+		sum += analysis->chunks[i].sum;
+	}
+	if (result == RANDOMWALK_OK && step >= analysis->args.first) {
+		analysis->msd[step - analysis->args.first] = sum;
+		analysis->alive[step - analysis->args.first] = count;
+	}
+	return result;
+}
+
+static void run_chunk(void* arg) {
+	// Shift coordinate by current direction:  N  NE  E SE  S  SW   W  NW
+	static const int8_t delta_x[DIRECTION_COUNT] = {  0,  1, 1, 1, 0, -1, -1, -1 };
+	static const int8_t delta_y[DIRECTION_COUNT] = { -1, -1, 0, 1, 1,  1,  0, -1 };
+	chunk_t* const chunk = (chunk_t*)arg;
+	const particle_store_t* const particles = chunk->particles;
+	int32_t* const moves = chunk->displacement;
+	double sum = 0;
+	for (uint32_t i = chunk->first; i < chunk->end; i++) {
+		const uint32_t id = particles->id[i];
+		const uint8_t direction = particles->direction[i];
+		if (id >= chunk->particle_count || direction >= DIRECTION_COUNT) {
+			chunk->result = RANDOMWALK_FAIL;
+			return;
+		}
+		if (chunk->moved) {
+			moves[id * 2] += delta_x[direction];
+			moves[id * 2 + 1] += delta_y[direction];
+		}
+		sum += (double)moves[id * 2] * moves[id * 2] + (double)moves[id * 2 + 1] * moves[id * 2 + 1];
+	}
+	chunk->sum = sum;
+	chunk->result = RANDOMWALK_OK;
+}
+
+static void write_statistic(const analysis_t* const analysis, const uint16_t workers) {
+	const trajectory_info_t* const info = &analysis->info;
+	const analysis_args_t* const args = &analysis->args;
+	if (args->stat == ANALYSIS_MSD) {
+		puts("step,particles,msd");
+		for (uint64_t i = 0; i <= args->last - args->first; i++) {
+			const uint32_t alive = analysis->alive[i];
+			printf("%lu,%u,%.6f\n", args->first + i, alive, alive ? analysis->msd[i] / alive : 0.0);
+		}
+	} else if (args->stat == ANALYSIS_VISITS) {
+		for (uint8_t y = 0; y < info->height; y++) {
+			for (uint8_t x = 0; x < info->width; x++) {
+				uint64_t visits = 0;
+				for (uint16_t i = 0; i < workers; i++)
+					visits += analysis->accumulators[i].visits[y * info->width + x];
+				printf(x ? ",%lu" : "%lu", visits);
+			}
+			putchar('\n');
+		}
+	} else {
+		puts("id,exit_step");
+		for (uint32_t id = 0; id < info->particle_count; id++) {
+			uint64_t last_seen = 0;
+			for (uint16_t i = 0; i < workers; i++)
+				if (analysis->accumulators[i].last_seen[id] > last_seen)
+					last_seen = analysis->accumulators[i].last_seen[id];
+			// Particles seen in the last step analyzed have not left the plane
+			if (last_seen && last_seen <= args->last)
+				printf("%u,%lu\n", id, last_seen);
+		}
+	}
+}
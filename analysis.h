@@ -0,0 +1,55 @@
+/**
+ * @file analysis.h
+ * @brief Statistics computed from trajectory files across all cores.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief Statistics an analysis may compute.
+ */
+typedef enum {
+	ANALYSIS_VISITS = 0, // Particles seen on each cell summed over the steps
+	ANALYSIS_MSD,        // Mean squared displacement from the first step
+	ANALYSIS_EXITS       // Step in which each particle left the plane
+} analysis_stat_t;
+
+/**
+ * @brief Arguments to be given to an analysis.
+ */
+typedef struct {
+	const char* path; // Trajectory file to analyze
+	analysis_stat_t stat;
+	uint16_t threads; // 0 uses every online CPU
+	uint64_t first;   // First step to analyze
+	uint64_t last;    // Last step to analyze; 0 analyzes through the end
+} analysis_args_t;
+
+/**
+ * @brief Compute a statistic from a trajectory file and write it to standard output.
+ *
+ * Blocks of the file are decoded in parallel into per-thread accumulators
+ * merged at the end. The mean squared displacement instead decodes blocks in
+ * order, carrying the displacement of each particle from block to block, and
+ * splits the particles of each step across threads, so its memory grows with
+ * the particles rather than the blocks. The file is memory-mapped and read a block at a time, so
+ * files larger than memory may be analyzed.
+ *
+ * Visits are written as one comma-separated row of counts per row of the plane.
+ * The mean squared displacement is written as rows of step, particles and mean
+ * squared displacement, where displacement accumulates the moves of a particle
+ * and so is unbroken by wrapping. Exits are written as rows of particle id and
+ * the step in which it left the plane, for each particle that left it.
+ *
+ * @param[in] args A structure of arguments to configure the analysis with.
+ * @return An enum denoting the random walk result code.
+ */
+randomwalk_result_t analysis(const analysis_args_t args);
+
+#endif // ANALYSIS_H
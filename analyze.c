@@ -0,0 +1,107 @@
+/**
+ * @file analyze.c
+ * @brief Compute statistics from random walk trajectory files.
+ * @author Justin Thoreson
+ */
+
+#include "analysis.h"
+#include "args.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * @brief Information on how to run the analysis program.
+ */
+static const char* USAGE =
+	"Usage: ./randomwalk-analyze <trajectory> [arguments]\n"
+	"Parameters (R = required | O = optional):\n"
+	"[R] --stat={visits,msd,exits} statistic to compute\n"
+	"[O] --threads=<uint16>        worker threads (default: all CPUs)\n"
+	"[O] --from=<uint64>           first step to analyze\n"
+	"[O] --to=<uint64>             last step to analyze";
+
+/**
+ * @brief Parse a single command line argument.
+ * @param[out] args The parsed analysis argument.
+ * @param[in] arg The argument to parse.
+ * @param[out] has_stat Whether the statistic was parsed.
+ * @return True if parsing succeeded, false otherwise.
+ */
+static bool parse_arg(analysis_args_t* const args, char* arg, bool* const has_stat);
+
+/**
+ * @brief Parse command line arguments.
+ * @param[out] args The parsed analysis arguments.
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments to parse.
+ * @return True if the arguments are parsed successfully, false otherwise.
+ */
+static bool parse_args(
+	analysis_args_t* const args,
+	const int argc,
+	char** const argv
+);
+
+int main(int argc, char** argv) {
+	analysis_args_t args = { 0 };
+	if (!parse_args(&args, argc, argv)) {
+		puts(USAGE);
+		return 1;
+	}
+	// Standard output carries the statistic
+	const randomwalk_result_t result = analysis(args);
+	if (result != RANDOMWALK_DONE) {
+		fprintf(stderr, "Failed to analyze: %s\n", args.path);
+		return 1;
+	}
+	return 0;
+}
+
+static bool parse_arg(analysis_args_t* const args, char* arg, bool* const has_stat) {
+	if (!*has_stat && args_skip_prefix(&arg, "--stat=")) {
+		*has_stat = true;
+		if (!strcmp(arg, "visits"))
+			args->stat = ANALYSIS_VISITS;
+		else if (!strcmp(arg, "msd"))
+			args->stat = ANALYSIS_MSD;
+		else if (!strcmp(arg, "exits"))
+			args->stat = ANALYSIS_EXITS;
+		else
+			return false;
+		return true;
+	}
+	if (!args->threads && args_skip_prefix(&arg, "--threads="))
+		return args_parse_uint16(arg, &args->threads);
+	if (!args->first && args_skip_prefix(&arg, "--from="))
+		return args_parse_uint64(arg, &args->first);
+	if (!args->last && args_skip_prefix(&arg, "--to="))
+		return args_parse_uint64(arg, &args->last);
+	return false;
+}
+
+static bool parse_args(
+	analysis_args_t* const args,
+	const int argc,
+	char** const argv
+) {
+	if (argc < 3 || !strncmp(argv[1], "--", 2)) {
+		puts("Insufficient number of arguments");
+		return false;
+	}
+	args->path = argv[1];
+	bool has_stat = false;
+	for (int i = 2; i < argc; i++) {
+		char* const arg = argv[i];
+		if (!parse_arg(args, arg, &has_stat)) {
+			printf("Failed to parse: %s\n", arg);
+			return false;
+		}
+	}
+	if (!has_stat) {
+		puts("Analysis requires --stat");
+		return false;
+	}
+	return true;
+}
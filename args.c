@@ -0,0 +1,64 @@
+/**
+ * @file args.c
+ * @brief Helpers parsing the command-line arguments of each program.
+ * @author Justin Thoreson
+ */
+
+#include "args.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Parse a signed integer within an upper bound.
+ * @param[in] arg The string argument to parse.
+ * @param[out] value The parsed integer.
+ * @param[in] max The largest value accepted.
+ * @return True if the integer is parsed successfully, false otherwise.
+ */
+static bool parse_bounded(const char* const arg, int64_t* const value, const int64_t max);
+
+bool args_skip_prefix(char** string, const char* const prefix) {
+	const size_t prefix_size = strlen(prefix);
+	if (strncmp(*string, prefix, prefix_size))
+		return false;
+	*string += prefix_size;
+	return true;
+}
+
+bool args_parse_uint8(const char* const arg, uint8_t* const value) {
+	int64_t temp;
+	if (!value || !parse_bounded(arg, &temp, UINT8_MAX))
+		return false;
+	*value = (uint8_t)temp;
+	return true;
+}
+
+bool args_parse_uint16(const char* const arg, uint16_t* const value) {
+	int64_t temp;
+	if (!value || !parse_bounded(arg, &temp, UINT16_MAX))
+		return false;
+	*value = (uint16_t)temp;
+	return true;
+}
+
+bool args_parse_uint32(const char* const arg, uint32_t* const value) {
+	int64_t temp;
+	if (!value || !parse_bounded(arg, &temp, UINT32_MAX))
+		return false;
+	*value = (uint32_t)temp;
+	return true;
+}
+
+bool args_parse_uint64(const char* const arg, uint64_t* const value) {
+	if (!arg || !value || *arg == '-')
+		return false;
+	return sscanf(arg, "%lu", value) == 1;
+}
+
+static bool parse_bounded(const char* const arg, int64_t* const value, const int64_t max) {
+	if (!arg)
+		return false;
+	if (sscanf(arg, "%ld", value) != 1)
+		return false;
+	return *value >= 0 && *value <= max;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file args.h
+ * @brief Helpers parsing the command-line arguments of each program.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef ARGS_H
+#define ARGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Move a string pointer forward passed a specified prefix.
+ * @param[in,out] string The string in which the prefix is skipped.
+ * @param[in] prefix The prefix to skip.
+ * @return True if skipping succeeded, false otherwise.
+ */
+bool args_skip_prefix(char** string, const char* const prefix);
+
+/**
+ * @brief Parse an 8-bit unsigned integer.
+ * @param[in] arg The string argument to parse.
+ * @param[out] value The parsed integer.
+ * @return True if the integer is parsed successfully, false otherwise.
+ */
+bool args_parse_uint8(const char* const arg, uint8_t* const value);
+
+/**
+ * @brief Parse an 16-bit unsigned integer.
+ * @param[in] arg The string argument to parse.
+ * @param[out] value The parsed integer.
+ * @return True if the integer is parsed successfully, false otherwise.
+ */
+bool args_parse_uint16(const char* const arg, uint16_t* const value);
+
+/**
+ * @brief Parse a 32-bit unsigned integer.
+ * @param[in] arg The string argument to parse.
+ * @param[out] value The parsed integer.
+ * @return True if the integer is parsed successfully, false otherwise.
+ */
+bool args_parse_uint32(const char* const arg, uint32_t* const value);
+
+/**
+ * @brief Parse a 64-bit unsigned integer.
+ * @param[in] arg The string argument to parse.
+ * @param[out] value The parsed integer.
+ * @return True if the integer is parsed successfully, false otherwise.
+ */
+bool args_parse_uint64(const char* const arg, uint64_t* const value);
+
+#endif // ARGS_H
@@ -0,0 +1,483 @@
+/**
+ * @file bench.c
+ * @brief Benchmark the step kernel over a large particle store with and
+ * without huge page backing, the wrapping walk kernels with and without
+ * power of two sides, and the step kernel with and without a flight recorder.
+ * @author Justin Thoreson
+ */
+
+#define _GNU_SOURCE
+#include "args.h"
+#include "framebuffer.h"
+#include "hugealloc.h"
+#include "kernel.h"
+#include "kernelset.h"
+#include "particles.h"
+#include "recorder.h"
+#include "rng.h"
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Information on how to run the benchmark program.
+ */
+static const char* USAGE =
+	"Usage: ./randomwalk-bench [arguments]\n"
+	"Parameters (R = required | O = optional):\n"
+	"[R] --pcount=<uint32>  particles stepped\n"
+	"[O] --steps=<uint32>   steps per run (default: 100)\n"
+	"[O] --runs=<uint32>    runs with and without huge pages each (default: 3)\n"
+	"[O] --seed=<uint64>    seed of the random number generator (default: 1)\n"
+	"[O] --wrap-paths       instead, time the walk kernels of each instruction\n"
+	"                       set wrapping a plane of general and power of two sides\n"
+	"[O] --record=<uint32>  instead, time steps with and without a flight recorder\n"
+	"                       keeping this many steps, with and without wrap";
+
+/**
+ * @brief The side length of the plane stepped on.
+ */
+#define BENCH_PLANE_SIZE 255
+
+/**
+ * @brief The side lengths of the planes the wrapping walk kernels are timed
+ * on: the last to wrap by comparison, and the first to wrap by mask.
+ */
+#define BENCH_GENERAL_SIZE 127
+#define BENCH_POW2_SIZE 128
+
+/**
+ * @brief Arguments of the benchmark.
+ */
+typedef struct {
+	uint32_t particle_count;
+	uint32_t steps;
+	uint32_t runs;
+	uint64_t seed;
+	bool wrap_paths;
+	uint32_t record; // Steps kept by the flight recorder timed; 0 times none
+} bench_args_t;
+
+/**
+ * @brief Measurements of a single run.
+ */
+typedef struct {
+	double seconds;
+	int64_t load_misses, store_misses; // -1 if the counter is unavailable
+	uint64_t huge_kib;                 // Anonymous memory backed by huge pages
+} bench_result_t;
+
+/**
+ * @brief Parse command line arguments.
+ * @param[out] args The parsed benchmark arguments.
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments to parse.
+ * @return True if the arguments are parsed successfully, false otherwise.
+ */
+static bool parse_args(bench_args_t* const args, const int argc, char** const argv);
+
+/**
+ * @brief Open a counter of data TLB misses of the calling thread.
+ * @param[in] op The kind of access counted, PERF_COUNT_HW_CACHE_OP_READ or
+ * PERF_COUNT_HW_CACHE_OP_WRITE.
+ * @return The file descriptor of the counter, or -1 if it is unavailable.
+ */
+static int open_tlb_counter(const uint64_t op);
+
+/**
+ * @brief Read and close a counter.
+ * @param[in] counter The file descriptor of the counter; may be -1.
+ * @return The count, or -1 if the counter is unavailable.
+ */
+static int64_t close_counter(const int counter);
+
+/**
+ * @brief Determine the anonymous memory of the process backed by huge pages.
+ * @return The memory in KiB, or 0 if it is unknown.
+ */
+static uint64_t huge_kib(void);
+
+/**
+ * @brief Step a freshly allocated store, painting it each step, and measure
+ * the data TLB misses taken.
+ * @param[in] args The benchmark arguments.
+ * @param[in] huge Whether the store is advised to be backed by huge pages.
+ * @param[out] result The measurements of the run.
+ * @return The result of the run.
+ */
+static randomwalk_result_t run(
+	const bench_args_t args,
+	const bool huge,
+	bench_result_t* const result
+);
+
+/**
+ * @brief Time the walk kernels of each instruction set the CPU supports on a
+ * wrapping plane of general sides and one of power of two sides.
+ * @param[in] args The benchmark arguments.
+ * @return The result of the runs.
+ */
+static randomwalk_result_t run_wrap_paths(const bench_args_t args);
+
+/**
+ * @brief Walk particles in fixed directions on a wrapping plane with the
+ * selected walk kernel and measure the time taken.
+ * @param[in] args The benchmark arguments.
+ * @param[in] side The side length of the plane.
+ * @param[in,out] x The x coordinates of the particles.
+ * @param[in,out] y The y coordinates of the particles.
+ * @param[in] direction The directions of the particles.
+ * @return The seconds taken.
+ */
+static double time_walk(
+	const bench_args_t args,
+	const uint8_t side,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction
+);
+
+/**
+ * @brief Step a store, observing each step with a flight recorder or not, and
+ * measure the time taken by the steps and by the final dump.
+ * @param[in] args The benchmark arguments.
+ * @param[in] wrap Whether particles wrap around the plane or leave it.
+ * @param[in] record Whether the steps are recorded.
+ * @param[out] seconds The time taken by the steps.
+ * @param[out] dump_seconds The time taken by the dump; 0 if not recorded.
+ * @return The result of the run.
+ */
+static randomwalk_result_t run_record(
+	const bench_args_t args,
+	const bool wrap,
+	const bool record,
+	double* const seconds,
+	double* const dump_seconds
+);
+
+/**
+ * @brief Measure the seconds elapsed since a time.
+ * @param[in] start The time to measure from.
+ * @return The seconds elapsed.
+ */
+static double elapsed(const struct timespec start);
+
+int main(int argc, char** argv) {
+	bench_args_t args = { .steps = 100, .runs = 3, .seed = 1 };
+	if (!parse_args(&args, argc, argv)) {
+		puts(USAGE);
+		return 1;
+	}
+	if (args.record) {
+		puts("recording,wrap,particles,steps,seconds,dump_seconds");
+		for (uint8_t wrap = 1; wrap < 2; wrap--) {
+			// Alternated so drift in the host affects both alike
+			for (uint32_t i = 0; i < 2 * args.runs; i++) {
+				const bool record = i % 2;
+				double seconds, dump_seconds;
+				if (run_record(args, wrap, record, &seconds, &dump_seconds) != RANDOMWALK_OK) {
+					fputs("Failed to record the particles\n", stderr);
+					return 1;
+				}
+				printf("%d,%d,%u,%u,%.6f,%.6f\n", record, wrap, args.particle_count,
+					args.steps, seconds, dump_seconds);
+			}
+		}
+		return 0;
+	}
+	if (args.wrap_paths) {
+		if (run_wrap_paths(args) != RANDOMWALK_OK) {
+			fputs("Failed to allocate the particles\n", stderr);
+			return 1;
+		}
+		return 0;
+	}
+	puts("huge_pages,particles,steps,seconds,dtlb_load_misses,dtlb_store_misses,anon_huge_kib");
+	// Alternated so drift in the host affects both alike
+	for (uint32_t i = 0; i < 2 * args.runs; i++) {
+		const bool huge = i % 2;
+		bench_result_t result;
+		if (run(args, huge, &result) != RANDOMWALK_OK) {
+			fputs("Failed to allocate the particles\n", stderr);
+			return 1;
+		}
+		printf(
+			"%d,%u,%u,%.6f,%ld,%ld,%lu\n",
+			huge,
+			args.particle_count,
+			args.steps,
+			result.seconds,
+			result.load_misses,
+			result.store_misses,
+			result.huge_kib
+		);
+	}
+	return 0;
+}
+
+static bool parse_args(bench_args_t* const args, const int argc, char** const argv) {
+	for (int i = 1; i < argc; i++) {
+		char* arg = argv[i];
+		bool parsed = false;
+		if (args_skip_prefix(&arg, "--pcount="))
+			parsed = args_parse_uint32(arg, &args->particle_count);
+		else if (args_skip_prefix(&arg, "--steps="))
+			parsed = args_parse_uint32(arg, &args->steps);
+		else if (args_skip_prefix(&arg, "--runs="))
+			parsed = args_parse_uint32(arg, &args->runs);
+		else if (args_skip_prefix(&arg, "--seed="))
+			parsed = args_parse_uint64(arg, &args->seed);
+		else if (args_skip_prefix(&arg, "--record="))
+			parsed = args_parse_uint32(arg, &args->record) && args->record;
+		else if (!strcmp(arg, "--wrap-paths"))
+			parsed = args->wrap_paths = true;
+		if (!parsed) {
+			printf("Failed to parse: %s\n", argv[i]);
+			return false;
+		}
+	}
+	if (!args->particle_count) {
+		puts("Benchmark requires --pcount");
+		return false;
+	}
+	return true;
+}
+
+static int open_tlb_counter(const uint64_t op) {
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HW_CACHE,
+		.size = sizeof(attr),
+		.config = PERF_COUNT_HW_CACHE_DTLB | op << 8 |
+			(uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+		.disabled = 1,
+		.exclude_kernel = 1,
+		.exclude_hv = 1
+	};
+	const int counter = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	if (counter >= 0)
+		ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+	return counter;
+}
+
+static int64_t close_counter(const int counter) {
+	if (counter < 0)
+		return -1;
+	ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+	uint64_t count;
+	const bool read_count = read(counter, &count, sizeof(count)) == sizeof(count);
+	close(counter);
+	return read_count ? (int64_t)count : -1;
+}
+
+static uint64_t huge_kib(void) {
+	FILE* const file = fopen("/proc/self/smaps_rollup", "r");
+	if (!file)
+		return 0;
+	char line[128];
+	uint64_t kib = 0;
+	while (fgets(line, sizeof(line), file))
+		if (sscanf(line, "AnonHugePages: %lu kB", &kib) == 1)
+			break;
+	fclose(file);
+	return kib;
+}
+
+static randomwalk_result_t run(
+	const bench_args_t args,
+	const bool huge,
+	bench_result_t* const result
+) {
+	hugealloc_set_enabled(huge);
+	particle_store_t particles;
+	framebuffer_t framebuffer;
+	if (particle_store_create(&particles, args.particle_count) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	if (framebuffer_create(&framebuffer, BENCH_PLANE_SIZE, BENCH_PLANE_SIZE) != RANDOMWALK_OK) {
+		particle_store_destroy(&particles);
+		return RANDOMWALK_FAIL;
+	}
+	rng_t rng;
+	rng_seed(&rng, args.seed);
+	for (uint32_t i = 0; i < args.particle_count; i++) {
+		const coordinate_t coord = {
+			rng_uint8(&rng, 0, BENCH_PLANE_SIZE - 1),
+			rng_uint8(&rng, 0, BENCH_PLANE_SIZE - 1)
+		};
+		const color_t color = { (uint8_t)i, (uint8_t)(i >> 8), (uint8_t)(i >> 16) };
+		particle_store_push(&particles, i, coord, rng_uint8(&rng, 0, DIRECTION_COUNT - 1), color);
+	}
+	// Wrapping keeps every particle alive, so each step touches the whole store
+	const kernel_plane_t plane = {
+		.width = BENCH_PLANE_SIZE,
+		.height = BENCH_PLANE_SIZE,
+		.prob_dir_change = 50,
+		.wrap = true
+	};
+	const int load_counter = open_tlb_counter(PERF_COUNT_HW_CACHE_OP_READ);
+	const int store_counter = open_tlb_counter(PERF_COUNT_HW_CACHE_OP_WRITE);
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t step = 0; step < args.steps; step++) {
+		kernel_step(&particles, NULL, plane, false, &rng);
+		framebuffer_paint(&framebuffer, &particles);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	*result = (bench_result_t){
+		.seconds = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9,
+		.load_misses = close_counter(load_counter),
+		.store_misses = close_counter(store_counter),
+		.huge_kib = huge_kib()
+	};
+	framebuffer_destroy(&framebuffer);
+	particle_store_destroy(&particles);
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t run_wrap_paths(const bench_args_t args) {
+	uint8_t* const memory = (uint8_t*)malloc((size_t)args.particle_count * 3);
+	if (!memory)
+		return RANDOMWALK_FAIL;
+	uint8_t* const x = memory;
+	uint8_t* const y = memory + args.particle_count;
+	uint8_t* const direction = memory + args.particle_count * 2;
+	rng_t rng;
+	rng_seed(&rng, args.seed);
+	for (uint32_t i = 0; i < args.particle_count; i++) {
+		x[i] = rng_uint8(&rng, 0, BENCH_GENERAL_SIZE - 1);
+		y[i] = rng_uint8(&rng, 0, BENCH_GENERAL_SIZE - 1);
+		direction[i] = rng_uint8(&rng, 0, DIRECTION_COUNT - 1);
+	}
+	puts("path,isa,side,particles,steps,seconds");
+	const char* const names[] = { "scalar", "sse4", "avx2", "avx512" };
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (kernelset_select(names[i]) != RANDOMWALK_OK)
+			continue;
+		// Alternated so drift in the host affects both alike
+		for (uint32_t run = 0; run < 2 * args.runs; run++) {
+			const bool pow2 = run % 2;
+			const uint8_t side = pow2 ? BENCH_POW2_SIZE : BENCH_GENERAL_SIZE;
+			printf(
+				"%s,%s,%u,%u,%u,%.6f\n",
+				pow2 ? "mask" : "general",
+				names[i],
+				side,
+				args.particle_count,
+				args.steps,
+				time_walk(args, side, x, y, direction)
+			);
+		}
+	}
+	free(memory);
+	return RANDOMWALK_OK;
+}
+
+static double time_walk(
+	const bench_args_t args,
+	const uint8_t side,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction
+) {
+	const kernelset_t* const kernels = kernelset_active();
+	const kernel_plane_t plane = {
+		.width = side,
+		.height = side,
+		.prob_dir_change = 50,
+		.wrap = true
+	};
+	uint8_t alive[KERNELSET_CHUNK_PARTICLES];
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t step = 0; step < args.steps; step++) {
+		for (uint32_t first = 0; first < args.particle_count; first += KERNELSET_CHUNK_PARTICLES) {
+			const uint32_t count = args.particle_count - first < KERNELSET_CHUNK_PARTICLES ?
+				args.particle_count - first : KERNELSET_CHUNK_PARTICLES;
+			kernels->walk(plane, x + first, y + first, direction + first, alive, count);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static randomwalk_result_t run_record(
+	const bench_args_t args,
+	const bool wrap,
+	const bool record,
+	double* const seconds,
+	double* const dump_seconds
+) {
+	const char* const path = "randomwalk-bench.rec";
+	const randomwalk_args_t run_args = {
+		.width = BENCH_PLANE_SIZE,
+		.height = BENCH_PLANE_SIZE,
+		.particle_count = args.particle_count,
+		.wrap = wrap
+	};
+	particle_store_t particles, deaths;
+	recorder_t* recorder = NULL;
+	if (particle_store_create(&particles, args.particle_count) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	if (particle_store_create(&deaths, args.particle_count) != RANDOMWALK_OK ||
+		(record && recorder_create(&recorder, args.record, path, run_args) != RANDOMWALK_OK)) {
+		particle_store_destroy(&deaths);
+		particle_store_destroy(&particles);
+		return RANDOMWALK_FAIL;
+	}
+	rng_t rng;
+	rng_seed(&rng, args.seed);
+	for (uint32_t i = 0; i < args.particle_count; i++) {
+		const coordinate_t coord = {
+			rng_uint8(&rng, 0, BENCH_PLANE_SIZE - 1),
+			rng_uint8(&rng, 0, BENCH_PLANE_SIZE - 1)
+		};
+		const color_t color = { (uint8_t)i, (uint8_t)(i >> 8), (uint8_t)(i >> 16) };
+		particle_store_push(&particles, i, coord, rng_uint8(&rng, 0, DIRECTION_COUNT - 1), color);
+	}
+	const kernel_plane_t plane = {
+		.width = BENCH_PLANE_SIZE,
+		.height = BENCH_PLANE_SIZE,
+		.prob_dir_change = 50,
+		.wrap = wrap
+	};
+	frame_t frame = {
+		.width = BENCH_PLANE_SIZE,
+		.height = BENCH_PLANE_SIZE,
+		.wrap = wrap,
+		.particles = &particles,
+		.deaths = &deaths
+	};
+	randomwalk_result_t result = recorder ? recorder_observe(recorder, &frame) : RANDOMWALK_OK;
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t step = 1; result == RANDOMWALK_OK && step <= args.steps; step++) {
+		result = kernel_step(&particles, &deaths, plane, false, &rng);
+		if (result == RANDOMWALK_DONE)
+			result = RANDOMWALK_OK;
+		frame.step = step;
+		if (result == RANDOMWALK_OK && recorder)
+			result = recorder_observe(recorder, &frame);
+	}
+	*seconds = elapsed(start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (recorder && recorder_destroy(&recorder) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	*dump_seconds = record ? elapsed(start) : 0;
+	if (record)
+		remove(path);
+	particle_store_destroy(&deaths);
+	particle_store_destroy(&particles);
+	return result;
+}
+
+static double elapsed(const struct timespec start) {
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file checkpoint.c
+ * @brief Periodic checkpoints of a counter-based run, from which any later
+ * step is recomputed.
+ * @author Justin Thoreson
+ */
+
+#include "checkpoint.h"
+#include "spawn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct checkpoint_writer_t {
+	FILE* file;
+	uint32_t interval;
+	bool failed;
+};
+
+/**
+ * @brief The magic bytes opening a checkpoint file.
+ */
+static const char CHECKPOINT_MAGIC[8] = { 'R', 'W', 'C', 'H', 'K', 'P', '0', '1' };
+
+/**
+ * @brief The size of the file header.
+ */
+static const size_t HEADER_SIZE = 40;
+
+/**
+ * @brief The size of the header fields describing the run, which a loaded
+ * file must match.
+ */
+static const size_t RUN_FIELDS_SIZE = 36;
+
+/**
+ * @brief The size of the header of a checkpoint.
+ */
+static const size_t RECORD_HEADER_SIZE = 12;
+
+/**
+ * @brief The size of a serialized particle.
+ */
+static const size_t PARTICLE_SIZE = 10;
+
+/**
+ * @brief Store an unsigned integer in little-endian byte order.
+ * @param[out] bytes The bytes to store into.
+ * @param[in] value The value to store.
+ * @param[in] size The number of bytes to store.
+ * @return The bytes following those stored.
+ */
+static uint8_t* store_le(uint8_t* bytes, uint64_t value, const size_t size);
+
+/**
+ * @brief Load an unsigned integer in little-endian byte order.
+ * @param[in] bytes The bytes to load from.
+ * @param[in] size The number of bytes to load.
+ * @return The loaded value.
+ */
+static uint64_t load_le(const uint8_t* const bytes, const size_t size);
+
+/**
+ * @brief Serialize the header of a checkpoint file.
+ * @param[out] header The header to serialize into.
+ * @param[in] args The random walk arguments.
+ * @param[in] interval The steps between checkpoints.
+ * @return The result of serializing the header.
+ */
+static randomwalk_result_t store_header(
+	uint8_t* const header,
+	const randomwalk_args_t args,
+	const uint32_t interval
+);
+
+randomwalk_result_t checkpoint_writer_create(
+	checkpoint_writer_t** writer,
+	const char* const path,
+	const uint32_t interval,
+	const randomwalk_args_t args
+) {
+	if (!writer || *writer || !path || !interval)
+		return RANDOMWALK_FAIL;
+	uint8_t header[HEADER_SIZE];
+	if (store_header(header, args, interval) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	checkpoint_writer_t* const created =
+		(checkpoint_writer_t*)calloc(1, sizeof(checkpoint_writer_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	*writer = created;
+	created->interval = interval;
+	created->file = fopen(path, "wb");
+	created->failed = !created->file || fwrite(header, sizeof(header), 1, created->file) != 1;
+	if (created->failed) {
+		checkpoint_writer_destroy(writer);
+		return RANDOMWALK_FAIL;
+	}
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t checkpoint_writer_observe(void* context, const frame_t* const frame) {
+	checkpoint_writer_t* const writer = (checkpoint_writer_t*)context;
+	if (!writer || !frame || !frame->particles)
+		return RANDOMWALK_FAIL;
+	// The initial particles are recomputed as cheaply as they are loaded
+	if (writer->failed || !frame->step || frame->step % writer->interval)
+		return writer->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+	const particle_store_t* const particles = frame->particles;
+	uint8_t bytes[RECORD_HEADER_SIZE]; // Holds a particle too
+	store_le(store_le(bytes, frame->step, 8), particles->count, 4);
+	writer->failed = fwrite(bytes, RECORD_HEADER_SIZE, 1, writer->file) != 1;
+	for (uint32_t i = 0; !writer->failed && i < particles->count; i++) {
+		uint8_t* field = store_le(bytes, particles->id[i], 4);
+		*field++ = particles->x[i];
+		*field++ = particles->y[i];
+		*field++ = particles->direction[i];
+		*field++ = particles->color[i].r;
+		*field++ = particles->color[i].g;
+		*field++ = particles->color[i].b;
+		writer->failed = fwrite(bytes, PARTICLE_SIZE, 1, writer->file) != 1;
+	}
+	return writer->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
+
+randomwalk_result_t checkpoint_writer_destroy(checkpoint_writer_t** writer) {
+	if (!writer || !*writer)
+		return RANDOMWALK_FAIL;
+	checkpoint_writer_t* const destroyed = *writer;
+	if (destroyed->file && fclose(destroyed->file))
+		destroyed->failed = true;
+	const randomwalk_result_t result = destroyed->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+	free(destroyed);
+	*writer = NULL;
+	return result;
+}
+
+randomwalk_result_t checkpoint_load(
+	const char* const path,
+	const randomwalk_args_t args,
+	const uint64_t step,
+	particle_store_t* const particles,
+	uint64_t* const loaded_step,
+	bool* const loaded
+) {
+	if (!path || !particles || particles->count || !loaded_step || !loaded)
+		return RANDOMWALK_FAIL;
+	uint8_t expected[HEADER_SIZE], header[HEADER_SIZE];
+	if (store_header(expected, args, 0) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	FILE* const file = fopen(path, "rb");
+	if (!file)
+		return RANDOMWALK_FAIL;
+	randomwalk_result_t result =
+		fread(header, sizeof(header), 1, file) == 1 &&
+		!memcmp(header, expected, RUN_FIELDS_SIZE) ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+	*loaded = false;
+	long best_offset = 0;
+	uint32_t best_count = 0;
+	// Checkpoints are in order of step, so the scan stops at the first past it
+	uint8_t bytes[RECORD_HEADER_SIZE]; // Holds a particle too
+	while (result == RANDOMWALK_OK && fread(bytes, RECORD_HEADER_SIZE, 1, file) == 1) {
+		const uint64_t record_step = load_le(bytes, 8);
+		const uint32_t count = (uint32_t)load_le(bytes + 8, 4);
+		if (record_step > step)
+			break;
+		const long offset = ftell(file);
+		if (count > particles->capacity || offset < 0 ||
+			fseek(file, (long)count * PARTICLE_SIZE, SEEK_CUR)) {
+			result = RANDOMWALK_FAIL;
+			break;
+		}
+		*loaded = true;
+		*loaded_step = record_step;
+		best_offset = offset;
+		best_count = count;
+	}
+	if (result == RANDOMWALK_OK && *loaded && fseek(file, best_offset, SEEK_SET))
+		result = RANDOMWALK_FAIL;
+	for (uint32_t i = 0; result == RANDOMWALK_OK && *loaded && i < best_count; i++) {
+		if (fread(bytes, PARTICLE_SIZE, 1, file) != 1) {
+			result = RANDOMWALK_FAIL;
+			break;
+		}
+		particle_store_push(
+			particles,
+			(uint32_t)load_le(bytes, 4),
+			(coordinate_t){ bytes[4], bytes[5] },
+			(direction_t)bytes[6],
+			(color_t){ bytes[7], bytes[8], bytes[9] }
+		);
+	}
+	fclose(file);
+	if (result != RANDOMWALK_OK)
+		particles->count = 0;
+	return result;
+}
+
+static uint8_t* store_le(uint8_t* bytes, uint64_t value, const size_t size) {
+	for (size_t i = 0; i < size; i++, value >>= 8)
+		*bytes++ = (uint8_t)value;
+	return bytes;
+}
+
+static uint64_t load_le(const uint8_t* const bytes, const size_t size) {
+	uint64_t value = 0;
+	for (size_t i = size; i > 0; i--)
+		value = value << 8 | bytes[i - 1];
+	return value;
+}
+
+static randomwalk_result_t store_header(
+	uint8_t* const header,
+	const randomwalk_args_t args,
+	const uint32_t interval
+) {
+	spawn_distribution_t distribution;
+	if (spawn_parse(args.init, args.width, args.height, &distribution) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	uint64_t sigma;
+	memcpy(&sigma, &distribution.sigma, sizeof(sigma));
+	memcpy(header, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	uint8_t* field = header + sizeof(CHECKPOINT_MAGIC);
+	field = store_le(field, args.seed, 8);
+	field = store_le(field, args.particle_count, 4);
+	field = store_le(field, args.width, 1);
+	field = store_le(field, args.height, 1);
+	field = store_le(field, args.prob_dir_change, 1);
+	field = store_le(field, args.wrap, 1);
+	field = store_le(field, distribution.kind, 1);
+	field = store_le(field, distribution.x, 1);
+	field = store_le(field, distribution.y, 1);
+	field = store_le(field, distribution.edge, 1);
+	field = store_le(field, sigma, 8);
+	store_le(field, interval, 4);
+	return RANDOMWALK_OK;
+}
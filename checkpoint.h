@@ -0,0 +1,106 @@
+/**
+ * @file checkpoint.h
+ * @brief Periodic checkpoints of a counter-based run, from which any later
+ * step is recomputed.
+ * @author Justin Thoreson
+ *
+ * A checkpoint file holds the particles alive at every multiple of an
+ * interval of steps. Since a counter-based run draws each step of each
+ * particle from the seed, the particle and the step alone, the particles at
+ * any step are recomputed from the last checkpoint before it, costing at most
+ * one interval of steps.
+ *
+ * All integers are little-endian. The file begins with a header:
+ *
+ * | Bytes | Field                                        |
+ * |-------|----------------------------------------------|
+ * | 8     | magic "RWCHKP01"                             |
+ * | 8     | seed                                         |
+ * | 4     | initial particle count                       |
+ * | 1     | width                                        |
+ * | 1     | height                                       |
+ * | 1     | probability of direction change              |
+ * | 1     | wrap                                         |
+ * | 1     | kind of initial distribution                 |
+ * | 1     | x of the initial distribution                |
+ * | 1     | y of the initial distribution                |
+ * | 1     | edge of the initial distribution             |
+ * | 8     | sigma of the initial distribution, IEEE 754  |
+ * | 4     | steps between checkpoints                    |
+ *
+ * Each checkpoint, in order of step, holds uint64 step, uint32 particle count
+ * and that many particles (uint32 id, uint8 x, uint8 y, uint8 direction,
+ * uint8 red, uint8 green, uint8 blue).
+ */
+
+#pragma once
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "observer.h"
+#include "particles.h"
+#include "randomwalk.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief A writer of a checkpoint file.
+ */
+typedef struct checkpoint_writer_t checkpoint_writer_t;
+
+/**
+ * @brief Create a checkpoint file and write its header.
+ * @param[out] writer The created writer.
+ * @param[in] path The file to write to.
+ * @param[in] interval The steps between checkpoints.
+ * @param[in] args The random walk arguments, with the probability of direction
+ * change resolved.
+ * @return The result of creating the writer.
+ */
+randomwalk_result_t checkpoint_writer_create(
+	checkpoint_writer_t** writer,
+	const char* const path,
+	const uint32_t interval,
+	const randomwalk_args_t args
+);
+
+/**
+ * @brief Write the particles of a frame whose step is a multiple of the
+ * interval; an observer function.
+ * @param[in,out] context The writer to write with.
+ * @param[in] frame The frame to checkpoint.
+ * @return The result of writing the checkpoint.
+ */
+randomwalk_result_t checkpoint_writer_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Close a checkpoint file and free its writer.
+ * @param[in,out] writer The writer to destroy.
+ * @return The result of closing the file.
+ */
+randomwalk_result_t checkpoint_writer_destroy(checkpoint_writer_t** writer);
+
+/**
+ * @brief Load the last checkpoint at or before a step.
+ *
+ * The file must have been written by a run of the same arguments.
+ *
+ * @param[in] path The file to read from.
+ * @param[in] args The random walk arguments, with the probability of direction
+ * change resolved.
+ * @param[in] step The step to load the last checkpoint before.
+ * @param[out] particles The empty store to load the particles into.
+ * @param[out] loaded_step The step of the loaded checkpoint.
+ * @param[out] loaded Whether any checkpoint was at or before the step.
+ * @return The result of reading the file.
+ */
+randomwalk_result_t checkpoint_load(
+	const char* const path,
+	const randomwalk_args_t args,
+	const uint64_t step,
+	particle_store_t* const particles,
+	uint64_t* const loaded_step,
+	bool* const loaded
+);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,235 @@
+/**
+ * @file deathlog.c
+ * @brief A log of when and where each particle left the plane.
+ * @author Justin Thoreson
+ */
+
+#include "deathlog.h"
+#include "rng.h"
+#include "spawn.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct deathlog_t {
+	int fd;
+	bool failed;
+	uint8_t height;
+	uint32_t particle_count;
+	coordinate_t* origins;       // Initial coordinate of each particle by id
+	uint64_t exits[DEATHLOG_EDGE_COUNT];
+	uint64_t* curve_steps;       // Steps of the survival curve
+	uint32_t* curve_survivors;   // Particles alive after each step of the curve
+	uint32_t curve_length;
+	char* summary_path;
+	char* buffer;                // Rows gathered before writing
+	size_t size;
+};
+
+/**
+ * @brief The size of the buffer rows are gathered in before writing.
+ */
+static const size_t DEATHLOG_BUFFER_SIZE = 1 << 20;
+
+/**
+ * @brief The most bytes a single row may take.
+ */
+static const size_t DEATHLOG_ROW_SIZE = 96;
+
+/**
+ * @brief The names of the edges of the plane.
+ */
+static const char* const EDGE_NAMES[DEATHLOG_EDGE_COUNT] = { "north", "south", "west", "east" };
+
+/**
+ * @brief Write out every buffered byte.
+ * @param[in,out] log The log to flush.
+ */
+static void flush(deathlog_t* const log);
+
+/**
+ * @brief Determine the edge a particle left the plane through.
+ * @param[in] coord The last coordinate of the particle.
+ * @param[in] direction The direction the particle left the plane in.
+ * @param[in] height The height of the plane.
+ * @return The edge crossed.
+ */
+static deathlog_edge_t exit_edge(
+	const coordinate_t coord,
+	const direction_t direction,
+	const uint8_t height
+);
+
+/**
+ * @brief Place the particles of a counter-based run as its strips place them,
+ * to know the origins of a run sought past its first step.
+ * @param[in,out] log The log to record the origins in.
+ * @param[in] args The random walk arguments.
+ * @return The result of placing the particles.
+ */
+static randomwalk_result_t seed_origins(deathlog_t* const log, const randomwalk_args_t args);
+
+/**
+ * @brief Write the exit histogram and survival curve.
+ * @param[in] log The finished log.
+ * @return The result of writing the summary.
+ */
+static randomwalk_result_t write_summary(const deathlog_t* const log);
+
+randomwalk_result_t deathlog_create(
+	deathlog_t** log,
+	const char* const path,
+	const randomwalk_args_t args
+) {
+	if (!log || *log || !path)
+		return RANDOMWALK_FAIL;
+	deathlog_t* const created = (deathlog_t*)calloc(1, sizeof(deathlog_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	*log = created;
+	created->height = args.height;
+	created->particle_count = args.particle_count;
+	// Every particle dies at most once, so the curve never outgrows this
+	created->origins = (coordinate_t*)calloc(args.particle_count, sizeof(coordinate_t));
+	created->curve_steps = (uint64_t*)malloc((args.particle_count + 1) * sizeof(uint64_t));
+	created->curve_survivors = (uint32_t*)malloc((args.particle_count + 1) * sizeof(uint32_t));
+	created->buffer = (char*)malloc(DEATHLOG_BUFFER_SIZE);
+	const size_t summary_size = strlen(path) + sizeof(".summary");
+	created->summary_path = (char*)malloc(summary_size);
+	created->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (!created->origins || !created->curve_steps || !created->curve_survivors ||
+		!created->buffer || !created->summary_path || created->fd < 0 ||
+		(args.counter_rng && args.seek_step && seed_origins(created, args) != RANDOMWALK_OK)) {
+		created->failed = true;
+		deathlog_destroy(log);
+		return RANDOMWALK_FAIL;
+	}
+	snprintf(created->summary_path, summary_size, "%s.summary", path);
+	created->size = (size_t)sprintf(created->buffer, "id,step,edge,x,y,initial_x,initial_y\n");
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t deathlog_observe(void* context, const frame_t* const frame) {
+	deathlog_t* const log = (deathlog_t*)context;
+	if (!log || !frame || !frame->particles || !frame->deaths)
+		return RANDOMWALK_FAIL;
+	if (!frame->step) {
+		const particle_store_t* const particles = frame->particles;
+		for (uint32_t i = 0; i < particles->count; i++)
+			if (particles->id[i] < log->particle_count)
+				log->origins[particles->id[i]] = (coordinate_t){ particles->x[i], particles->y[i] };
+	}
+	// The curve starts from the first frame, which a sought run takes past step 0
+	const particle_store_t* const deaths = frame->deaths;
+	if (!log->curve_length || deaths->count) {
+		log->curve_steps[log->curve_length] = frame->step;
+		log->curve_survivors[log->curve_length] = frame->particles->count;
+		log->curve_length++;
+	}
+	for (uint32_t i = 0; i < deaths->count; i++) {
+		const uint32_t id = deaths->id[i];
+		const coordinate_t coord = { deaths->x[i], deaths->y[i] };
+		if (id >= log->particle_count || deaths->direction[i] >= DIRECTION_COUNT)
+			return RANDOMWALK_FAIL;
+		const deathlog_edge_t edge =
+			exit_edge(coord, (direction_t)deaths->direction[i], log->height);
+		log->exits[edge]++;
+		if (log->size + DEATHLOG_ROW_SIZE > DEATHLOG_BUFFER_SIZE)
+			flush(log);
+		log->size += (size_t)sprintf(
+			log->buffer + log->size,
+			"%u,%lu,%s,%u,%u,%u,%u\n",
+			id,
+			frame->step,
+			EDGE_NAMES[edge],
+			coord.x,
+			coord.y,
+			log->origins[id].x,
+			log->origins[id].y
+		);
+	}
+	return log->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
+
+randomwalk_result_t deathlog_destroy(deathlog_t** log) {
+	if (!log || !*log)
+		return RANDOMWALK_FAIL;
+	deathlog_t* const destroyed = *log;
+	if (destroyed->fd >= 0) {
+		flush(destroyed);
+		if (close(destroyed->fd))
+			destroyed->failed = true;
+	}
+	if (!destroyed->failed && write_summary(destroyed) != RANDOMWALK_OK)
+		destroyed->failed = true;
+	const randomwalk_result_t result = destroyed->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+	free(destroyed->origins);
+	free(destroyed->curve_steps);
+	free(destroyed->curve_survivors);
+	free(destroyed->buffer);
+	free(destroyed->summary_path);
+	free(destroyed);
+	*log = NULL;
+	return result;
+}
+
+static void flush(deathlog_t* const log) {
+	size_t written = 0;
+	while (!log->failed && written < log->size) {
+		const ssize_t result = write(log->fd, log->buffer + written, log->size - written);
+		if (result < 0 && errno != EINTR)
+			log->failed = true;
+		else if (result > 0)
+			written += (size_t)result;
+	}
+	log->size = 0;
+}
+
+static deathlog_edge_t exit_edge(
+	const coordinate_t coord,
+	const direction_t direction,
+	const uint8_t height
+) {
+	// Shift coordinate by current direction:  N  NE  E SE  S  SW   W  NW
+	const int8_t delta_x[DIRECTION_COUNT] = {  0,  1, 1, 1, 0, -1, -1, -1 };
+	const int8_t delta_y[DIRECTION_COUNT] = { -1, -1, 0, 1, 1,  1,  0, -1 };
+	const int16_t new_x = coord.x + delta_x[direction];
+	const int16_t new_y = coord.y + delta_y[direction];
+	if (new_y < 0)
+		return DEATHLOG_EDGE_NORTH;
+	if (new_y == height)
+		return DEATHLOG_EDGE_SOUTH;
+	return new_x < 0 ? DEATHLOG_EDGE_WEST : DEATHLOG_EDGE_EAST;
+}
+
+static randomwalk_result_t seed_origins(deathlog_t* const log, const randomwalk_args_t args) {
+	spawn_distribution_t distribution;
+	if (spawn_parse(args.init, args.width, args.height, &distribution) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	for (uint32_t id = 0; id < log->particle_count; id++) {
+		rng_t rng;
+		rng_seed(&rng, rng_derive(args.seed, id));
+		color_t color;
+		direction_t direction;
+		spawn_particle(&distribution, args.width, args.height, &rng,
+			&log->origins[id], &color, &direction);
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t write_summary(const deathlog_t* const log) {
+	FILE* const file = fopen(log->summary_path, "w");
+	if (!file)
+		return RANDOMWALK_FAIL;
+	fputs("edge,exits\n", file);
+	for (uint8_t edge = 0; edge < DEATHLOG_EDGE_COUNT; edge++)
+		fprintf(file, "%s,%lu\n", EDGE_NAMES[edge], log->exits[edge]);
+	fputs("\nstep,survivors\n", file);
+	for (uint32_t i = 0; i < log->curve_length; i++)
+		fprintf(file, "%lu,%u\n", log->curve_steps[i], log->curve_survivors[i]);
+	return fclose(file) ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
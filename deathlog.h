@@ -0,0 +1,72 @@
+/**
+ * @file deathlog.h
+ * @brief A log of when and where each particle left the plane.
+ * @author Justin Thoreson
+ *
+ * The log is a CSV file with one row per death, in the order they happened:
+ *
+ *     id,step,edge,x,y,initial_x,initial_y
+ *
+ * where step is the step in which the particle left the plane, edge is the edge
+ * it crossed, x and y are the last coordinate it held and initial_x and
+ * initial_y the coordinate it started from. A particle leaving through a corner
+ * is counted against the north or south edge.
+ *
+ * Once the run ends, a summary is written to the log path suffixed with
+ * ".summary": the number of exits through each edge, then the survival curve as
+ * the particles alive after the first step and after each step with deaths.
+ */
+
+#pragma once
+#ifndef DEATHLOG_H
+#define DEATHLOG_H
+
+#include "observer.h"
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief The edges of the plane particles may leave through.
+ */
+typedef enum {
+	DEATHLOG_EDGE_NORTH = 0,
+	DEATHLOG_EDGE_SOUTH,
+	DEATHLOG_EDGE_WEST,
+	DEATHLOG_EDGE_EAST,
+	DEATHLOG_EDGE_COUNT // special enumeration to track the number of enumerators
+} deathlog_edge_t;
+
+/**
+ * @brief A writer of a death log.
+ */
+typedef struct deathlog_t deathlog_t;
+
+/**
+ * @brief Create a death log.
+ * @param[out] log The created log.
+ * @param[in] path The file to write the log to.
+ * @param[in] args The random walk arguments.
+ * @return The result of creating the log.
+ */
+randomwalk_result_t deathlog_create(
+	deathlog_t** log,
+	const char* const path,
+	const randomwalk_args_t args
+);
+
+/**
+ * @brief Log the deaths of a frame; an observer_t callback.
+ * @param[in,out] context The deathlog_t to log to.
+ * @param[in] frame The frame to log.
+ * @return The result of logging the frame.
+ */
+randomwalk_result_t deathlog_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Flush the log, write the summary and free the log.
+ * @param[in,out] log The log to destroy.
+ * @return The result of finishing the log.
+ */
+randomwalk_result_t deathlog_destroy(deathlog_t** log);
+
+#endif // DEATHLOG_H
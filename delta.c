@@ -0,0 +1,214 @@
+/**
+ * @file delta.c
+ * @brief Compact encoding of the change in particles from one step to the next.
+ * @author Justin Thoreson
+ */
+
+#include "delta.h"
+#include <string.h>
+
+/**
+ * @brief The direction of movement indexed by the zigzag-encoded change in x
+ * and y, or DIRECTION_COUNT for combinations that are not a move.
+ */
+static const uint8_t MOVE_DIRECTIONS[3][3] = {
+	//   dy: 0              -1                   +1
+	{ DIRECTION_COUNT, DIRECTION_NORTH,     DIRECTION_SOUTH     }, // dx:  0
+	{ DIRECTION_WEST,  DIRECTION_NORTHWEST, DIRECTION_SOUTHWEST }, // dx: -1
+	{ DIRECTION_EAST,  DIRECTION_NORTHEAST, DIRECTION_SOUTHEAST }  // dx: +1
+};
+
+/**
+ * @brief The change in x of a move in each direction:  N  NE  E SE  S  SW   W  NW
+ */
+static const int8_t DELTA_X[DIRECTION_COUNT] =        {  0,  1, 1, 1, 0, -1, -1, -1 };
+
+/**
+ * @brief The change in y of a move in each direction.
+ */
+static const int8_t DELTA_Y[DIRECTION_COUNT] =        { -1, -1, 0, 1, 1,  1,  0, -1 };
+
+/**
+ * @brief The nibble of a move in each direction, direction d in bits 4d to
+ * 4d + 3, so that a nibble is found by a shift rather than a load.
+ */
+static const uint32_t MOVE_CODES = 0x5198A264;
+
+/**
+ * @brief Find the nibble of a move.
+ * @param[in] direction The direction of the move; only its low three bits are
+ * used.
+ * @return The nibble.
+ */
+static inline uint8_t move_code(const uint8_t direction) {
+	return (uint8_t)(MOVE_CODES >> (direction & 7) * 4 & 0xF);
+}
+
+/**
+ * @brief Find the first of a range of ascending identifiers not below one.
+ * @param[in] ids The identifiers.
+ * @param[in] first The first index of the range.
+ * @param[in] end The index past the range.
+ * @param[in] id The identifier sought.
+ * @return The index of the first identifier not below id, or end if none is.
+ */
+static uint32_t lower_bound(
+	const uint32_t* const ids,
+	uint32_t first,
+	uint32_t end,
+	const uint32_t id
+);
+
+/**
+ * @brief Zigzag-encode the change along one axis.
+ * @param[in] change The change along the axis, -1, 0 or 1.
+ * @return 0 for no change, 1 for a decrease and 2 for an increase.
+ */
+static uint8_t encode_axis(const int8_t change);
+
+/**
+ * @brief Apply a zigzag-encoded change along one axis.
+ * @param[in] coordinate The coordinate before the step.
+ * @param[in] code The zigzag-encoded change.
+ * @param[in] size The size of the plane along the axis.
+ * @param[in] wrap Whether the coordinate wraps around the plane.
+ * @return The coordinate after the step.
+ */
+static uint8_t decode_axis(
+	const uint8_t coordinate,
+	const uint8_t code,
+	const uint8_t size,
+	const bool wrap
+);
+
+randomwalk_result_t delta_encode(
+	uint8_t* const delta,
+	const particle_store_t* const before,
+	const particle_store_t* const after
+) {
+	if (!delta || !before || !after)
+		return RANDOMWALK_FAIL;
+	memset(delta, 0, delta_size(before->count));
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < before->count; i++) {
+		if (j == after->count || after->id[j] != before->id[i])
+			continue; // Died, encoded as DELTA_DEATH
+		// Particles are captured after moving, so their direction is that of the move
+		const direction_t direction = (direction_t)after->direction[j];
+		if (direction >= DIRECTION_COUNT)
+			return RANDOMWALK_FAIL;
+		const uint8_t code = encode_axis(DELTA_X[direction]) |
+			encode_axis(DELTA_Y[direction]) << 2;
+		delta[i / 2] |= (uint8_t)(code << (i % 2 * 4));
+		j++;
+	}
+	return j == after->count ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+}
+
+randomwalk_result_t delta_encode_step(
+	uint8_t* const delta,
+	const particle_store_t* const after,
+	const particle_store_t* const deaths
+) {
+	if (!delta || !after || !deaths)
+		return RANDOMWALK_FAIL;
+	// Bytes are written whole as nibbles are reached, high nibbles as 0 until
+	// filled, so the delta needs no clearing beforehand
+	uint32_t i = 0, j = 0;
+	uint8_t directions = 0;
+	for (uint32_t k = 0; k <= deaths->count; k++) {
+		// The survivors up to the next death keep their places in order
+		uint32_t end = after->count;
+		if (k < deaths->count) {
+			if (k && deaths->id[k] <= deaths->id[k - 1])
+				return RANDOMWALK_FAIL;
+			end = lower_bound(after->id, j, after->count, deaths->id[k]);
+			if (end < after->count && after->id[end] == deaths->id[k])
+				return RANDOMWALK_FAIL;
+		}
+		const uint8_t* const direction = after->direction;
+		if (j < end && i % 2) {
+			directions |= direction[j];
+			delta[i++ / 2] |= (uint8_t)(move_code(direction[j++]) << 4);
+		}
+		for (; j + 1 < end; i += 2, j += 2) {
+			directions |= direction[j] | direction[j + 1];
+			delta[i / 2] = (uint8_t)(move_code(direction[j]) | move_code(direction[j + 1]) << 4);
+		}
+		if (j < end) {
+			directions |= direction[j];
+			delta[i++ / 2] = move_code(direction[j++]);
+		}
+		if (k < deaths->count) {
+			if (!(i % 2))
+				delta[i / 2] = DELTA_DEATH;
+			i++;
+		}
+	}
+	return directions < DIRECTION_COUNT ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+}
+
+randomwalk_result_t delta_apply(
+	particle_store_t* const particles,
+	const uint8_t* const delta,
+	const uint8_t width,
+	const uint8_t height,
+	const bool wrap
+) {
+	if (!particles || !delta)
+		return RANDOMWALK_FAIL;
+	uint32_t survivors = 0;
+	for (uint32_t i = 0; i < particles->count; i++) {
+		const uint8_t code = delta[i / 2] >> (i % 2 * 4) & 0xF;
+		if (code == DELTA_DEATH)
+			continue;
+		const uint8_t dx = code & 3, dy = code >> 2;
+		const uint8_t x = decode_axis(particles->x[i], dx, width, wrap);
+		const uint8_t y = decode_axis(particles->y[i], dy, height, wrap);
+		// A survivor never leaves the plane, so a delta moving one off it is damaged
+		if (x >= width || y >= height)
+			return RANDOMWALK_FAIL;
+		particles->id[survivors] = particles->id[i];
+		particles->x[survivors] = x;
+		particles->y[survivors] = y;
+		particles->direction[survivors] = dx < 3 && dy < 3 && MOVE_DIRECTIONS[dx][dy] != DIRECTION_COUNT ?
+			MOVE_DIRECTIONS[dx][dy] : particles->direction[i];
+		particles->color[survivors] = particles->color[i];
+		survivors++;
+	}
+	particles->count = survivors;
+	return RANDOMWALK_OK;
+}
+
+static uint32_t lower_bound(
+	const uint32_t* const ids,
+	uint32_t first,
+	uint32_t end,
+	const uint32_t id
+) {
+	while (first < end) {
+		const uint32_t middle = first + (end - first) / 2;
+		if (ids[middle] < id)
+			first = middle + 1;
+		else
+			end = middle;
+	}
+	return first;
+}
+
+static uint8_t encode_axis(const int8_t change) {
+	return change < 0 ? 1 : change > 0 ? 2 : 0;
+}
+
+static uint8_t decode_axis(
+	const uint8_t coordinate,
+	const uint8_t code,
+	const uint8_t size,
+	const bool wrap
+) {
+	const int16_t moved = coordinate + (code == 2) - (code == 1);
+	if (!wrap)
+		return (uint8_t)moved;
+	// Mirrors the wrap around of walking, under which reaching 0 also wraps
+	return (uint8_t)(moved > 0 ? moved == size ? 0 : moved : size - 1);
+}
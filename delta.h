@@ -0,0 +1,99 @@
+/**
+ * @file delta.h
+ * @brief Compact encoding of the change in particles from one step to the next.
+ * @author Justin Thoreson
+ *
+ * A particle moves by at most one cell along each axis per step, so its move
+ * is encoded in a nibble: the zigzag-encoded change in x in the low two bits
+ * and the zigzag-encoded change in y in the high two bits. As every live
+ * particle moves, the nibble 0 marks a particle that died. The delta of a step
+ * holds one nibble per particle alive before the step, in order, two to a byte.
+ */
+
+#pragma once
+#ifndef DELTA_H
+#define DELTA_H
+
+#include "particles.h"
+#include "randomwalk.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The nibble marking a particle that died during the step.
+ */
+#define DELTA_DEATH 0
+
+/**
+ * @brief Compute the number of bytes of a delta.
+ * @param[in] count The number of particles alive before the step.
+ * @return The number of bytes of the delta.
+ */
+static inline size_t delta_size(const uint32_t count) {
+	return ((size_t)count + 1) / 2;
+}
+
+/**
+ * @brief Encode the change from the particles before a step to those after.
+ *
+ * The particles after the step must be those before it that survived, in the
+ * same order, each with the direction it moved in.
+ *
+ * @param[out] delta The encoded delta, of delta_size(before->count) bytes.
+ * @param[in] before The particles alive before the step.
+ * @param[in] after The particles alive after the step.
+ * @return The result of encoding the delta.
+ */
+randomwalk_result_t delta_encode(
+	uint8_t* const delta,
+	const particle_store_t* const before,
+	const particle_store_t* const after
+);
+
+/**
+ * @brief Encode the change of a step from the particles after it and those
+ * that died during it, without the particles before it.
+ *
+ * The particles before the step are the survivors and the deaths merged in
+ * order of identifier, as every store of a run keeps its particles, so each
+ * death is placed among the survivors by a binary search and every other
+ * nibble follows from the direction of a survivor alone.
+ *
+ * @param[out] delta The encoded delta, of delta_size(after->count +
+ * deaths->count) bytes.
+ * @param[in] after The particles alive after the step, each with the direction
+ * it moved in, in ascending order of identifier.
+ * @param[in] deaths The particles that died during the step, in ascending order
+ * of identifier.
+ * @return The result of encoding the delta.
+ */
+randomwalk_result_t delta_encode_step(
+	uint8_t* const delta,
+	const particle_store_t* const after,
+	const particle_store_t* const deaths
+);
+
+/**
+ * @brief Apply a delta to the particles before a step, in place.
+ *
+ * The direction of each surviving particle becomes the direction it moved in.
+ * A delta moving a surviving particle off the plane is rejected, leaving the
+ * particles partly applied.
+ *
+ * @param[in,out] particles The particles before the step; after it on return.
+ * @param[in] delta The delta of the step.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @param[in] wrap Whether particles return to the opposite edge of egress.
+ * @return The result of applying the delta.
+ */
+randomwalk_result_t delta_apply(
+	particle_store_t* const particles,
+	const uint8_t* const delta,
+	const uint8_t width,
+	const uint8_t height,
+	const bool wrap
+);
+
+#endif // DELTA_H
@@ -0,0 +1,712 @@
+/**
+ * @file domain.c
+ * @brief A spatially decomposed engine running each strip of the plane on a
+ * thread of its own.
+ * @author Justin Thoreson
+ */
+
+#define _GNU_SOURCE
+#include "domain.h"
+#include "hugealloc.h"
+#include "kernel.h"
+#include "kernelset.h"
+#include "mailbox.h"
+#include "placement.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The strips a domain engine cuts the plane into unless told otherwise.
+ */
+#define DOMAIN_ENGINE_STRIPS 4
+
+typedef struct domain_engine_t domain_engine_t;
+
+/**
+ * @brief The connection of a strip thread to the others.
+ */
+typedef struct {
+	mailbox_link_t link; // First, so the link functions accept the context
+	domain_engine_t* engine;
+	uint32_t index;
+	uint64_t step;
+} thread_link_t;
+
+/**
+ * @brief A strip run on a thread of its own.
+ */
+typedef struct {
+	pthread_t thread;
+	domain_strip_t strip;
+	thread_link_t link;
+	mailbox_t* from_north; // Migrants moving south into the strip
+	mailbox_t* from_south; // Migrants moving north into the strip
+} strip_thread_t;
+
+/**
+ * @brief The state shared by every strip thread of a run.
+ */
+struct domain_engine_t {
+	strip_thread_t* threads;
+	uint32_t strip_count;
+	uint32_t started;            // Strip threads started
+	uint32_t* alive;             // Particles per strip, by step parity
+	uint32_t total;              // Particles in every strip after the last step
+	atomic_uint_fast64_t walked;
+	pthread_barrier_t barrier;
+	bool barrier_ready;
+	randomwalk_stats_t stats;
+	// A lockstep run waits between steps for its controller to observe the
+	// step and release the next, and ends once the controller stops it
+	bool lockstep, stopping;
+	pthread_barrier_t stepped, released;
+};
+
+/**
+ * @brief The state of a domain engine: a lockstep run of strip threads.
+ */
+typedef struct {
+	domain_engine_t strips;
+	uint64_t* visits; // Visits of each cell, counted by the strips though unused
+	size_t cell_count;
+	bool* present;    // Whether each particle was observed in a strip
+	uint32_t particle_count;
+	uint64_t step;    // The step the strips last took
+} lockstep_t;
+
+/**
+ * @brief Place the particles initially within a strip.
+ *
+ * Every strip derives the initial coordinate of every particle and keeps the
+ * ones landing within it, which costs two draws per particle and strip.
+ *
+ * @param[in,out] strip The strip to place particles in.
+ */
+static void place_particles(domain_strip_t* const strip);
+
+/**
+ * @brief Move every migrant waiting for a strip into it.
+ * @param[in,out] strip The strip to receive migrants into.
+ * @return True if any migrant was received, false otherwise.
+ */
+static bool receive_migrants(domain_strip_t* const strip);
+
+/**
+ * @brief Hand a particle leaving a strip off to a neighboring strip.
+ *
+ * While the neighbor cannot take it, the migrants waiting for the strip itself
+ * are received, so that two strips handing off to each other cannot deadlock.
+ *
+ * @param[in,out] strip The strip the particle leaves.
+ * @param[in] side The neighbor the particle enters.
+ * @param[in] migrant The particle leaving.
+ */
+static void send_migrant(
+	domain_strip_t* const strip,
+	const transport_side_t side,
+	const migrant_t* const migrant
+);
+
+/**
+ * @brief Advance the particles of a strip by one step and exchange migrants.
+ * @param[in,out] strip The strip to advance.
+ * @param[in] plane The plane to advance the particles on.
+ * @param[in] step The step taken, counted from 1, which a counter-based run
+ * draws from.
+ */
+static void step_strip(domain_strip_t* const strip, const kernel_plane_t plane, const uint64_t step);
+
+/**
+ * @brief Count a visit to the cell of every particle of a strip.
+ * @param[in,out] strip The strip to count visits in.
+ */
+static void count_visits(domain_strip_t* const strip);
+
+/**
+ * @brief Count the resident pages of the particles of a strip on each node.
+ * @param[in,out] strip The strip to count pages of.
+ */
+static void count_pages(domain_strip_t* const strip);
+
+/**
+ * @brief Total the particles alive in every strip thread; a transport total
+ * function.
+ * @param[in,out] context The link of the calling strip thread.
+ * @param[in] alive The particles alive in the calling strip.
+ * @return The particles alive in every strip.
+ */
+static uint32_t total_threads(void* context, const uint32_t alive);
+
+/**
+ * @brief Allocate the strips of a run and connect them through mailboxes.
+ * @param[out] engine The run to allocate the strips of.
+ * @param[in] args The random walk arguments, with the seed and the
+ * probability of direction change resolved.
+ * @param[in] strip_count The number of strips.
+ * @param[in,out] visits The visits of each cell of the plane.
+ * @return The result of allocating the strips.
+ */
+static randomwalk_result_t create_strips(
+	domain_engine_t* const engine,
+	const randomwalk_args_t args,
+	const uint32_t strip_count,
+	uint64_t* const visits
+);
+
+/**
+ * @brief Start a thread for every strip of a run, aborting if only some
+ * start, as those could never finish.
+ * @param[in,out] engine The run to start.
+ * @return The result of starting the threads.
+ */
+static randomwalk_result_t start_strips(domain_engine_t* const engine);
+
+/**
+ * @brief Free the strips of a run whose threads have been joined.
+ * @param[in,out] engine The run to free.
+ */
+static void destroy_strips(domain_engine_t* const engine);
+
+/**
+ * @brief Place the particles of a counter-based run over strip threads run in
+ * lockstep; an engine init function.
+ * @param[out] engine The state of the created engine.
+ * @param[in] args The random walk arguments.
+ * @return The result of placing the particles.
+ */
+static randomwalk_result_t init_lockstep(void** engine, const randomwalk_args_t args);
+
+/**
+ * @brief Release the strip threads for one step and wait for them to take it;
+ * an engine step function.
+ * @param[in,out] engine The engine to advance.
+ * @param[in] step The step taken.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+static randomwalk_result_t step_lockstep(void* engine, const uint64_t step);
+
+/**
+ * @brief Gather the particles of every strip in order of identifier; an
+ * engine observe function.
+ * @param[in] engine The engine to observe.
+ * @param[out] particles The store to gather into.
+ * @return The result of gathering the particles.
+ */
+static randomwalk_result_t observe_lockstep(void* engine, particle_store_t* const particles);
+
+/**
+ * @brief Stop and join the strip threads and free the engine; an engine
+ * destroy function.
+ * @param[in,out] engine The state of the engine to destroy.
+ * @return The result of destroying the engine.
+ */
+static randomwalk_result_t destroy_lockstep(void** engine);
+
+/**
+ * @brief Run a strip thread.
+ * @param[in,out] arg The strip thread to run.
+ * @return NULL.
+ */
+static void* run_thread(void* arg);
+
+/**
+ * @brief The operations of the domain engine.
+ */
+static const engine_t DOMAIN_ENGINE = {
+	.name = "domain",
+	.init = init_lockstep,
+	.step = step_lockstep,
+	.observe = observe_lockstep,
+	.destroy = destroy_lockstep
+};
+
+uint32_t domain_strip_count(const uint32_t requested, const uint8_t height) {
+	const uint32_t most = height / 2 ? height / 2 : 1;
+	if (!requested)
+		return 1;
+	return requested < most ? requested : most;
+}
+
+randomwalk_result_t domain_strip_create(
+	domain_strip_t* const strip,
+	const randomwalk_args_t args,
+	const uint32_t index,
+	const uint32_t strip_count,
+	uint64_t* const visits,
+	const transport_t transport
+) {
+	if (!strip || !visits || index >= strip_count)
+		return RANDOMWALK_FAIL;
+	const uint32_t north = (index + strip_count - 1) % strip_count;
+	*strip = (domain_strip_t){
+		.args = args,
+		.first_row = (uint8_t)(index * args.height / strip_count),
+		.end_row = (uint8_t)((index + 1) * args.height / strip_count),
+		.north_first_row = (uint8_t)(north * args.height / strip_count),
+		.north_end_row = (uint8_t)((north + 1) * args.height / strip_count),
+		.visits = visits,
+		.transport = transport,
+		.cpu = -1
+	};
+	randomwalk_result_t result = spawn_parse(args.init, args.width, args.height, &strip->spawn);
+	if (result != RANDOMWALK_OK)
+		return result;
+	// Every particle may crowd into one strip
+	result = particle_store_create(&strip->particles, args.particle_count);
+	strip->rngs = (rng_t*)hugealloc_alloc((size_t)args.particle_count * sizeof(rng_t));
+	if (result != RANDOMWALK_OK || !strip->rngs) {
+		domain_strip_destroy(strip);
+		return RANDOMWALK_FAIL;
+	}
+	return RANDOMWALK_OK;
+}
+
+void domain_strip_run(domain_strip_t* const strip, randomwalk_stats_t* const stats) {
+	const randomwalk_args_t args = strip->args;
+	const kernel_plane_t plane = {
+		.width = args.width,
+		.height = args.height,
+		.prob_dir_change = args.prob_dir_change,
+		.wrap = args.wrap
+	};
+	const transport_t transport = strip->transport;
+	// Pinned before the first touch, so the particles land on the local node
+	int32_t pinned = -1;
+	if (strip->cpu >= 0 && placement_pin((uint16_t)strip->cpu) == RANDOMWALK_OK)
+		pinned = strip->cpu;
+	else if (strip->cpu >= 0)
+		fprintf(stderr, "Failed to pin strip rows %u-%u to CPU %d\n",
+			strip->first_row, strip->end_row - 1, strip->cpu);
+	if (strip->pinned)
+		*strip->pinned = pinned;
+	place_particles(strip);
+	count_visits(strip);
+	for (uint64_t step = 0;; step++) {
+		const uint32_t survivors = transport.total(transport.context, strip->particles.count);
+		if (!survivors || (args.max_steps && step == args.max_steps)) {
+			if (stats)
+				*stats = (randomwalk_stats_t){ .steps = step, .survivors = survivors };
+			break;
+		}
+		step_strip(strip, plane, step + 1);
+		count_visits(strip);
+	}
+	if (strip->ran_on)
+		*strip->ran_on = sched_getcpu();
+	if (strip->pages)
+		count_pages(strip);
+}
+
+randomwalk_result_t domain_strip_destroy(domain_strip_t* const strip) {
+	if (!strip)
+		return RANDOMWALK_FAIL;
+	particle_store_destroy(&strip->particles);
+	hugealloc_free(strip->rngs, (size_t)strip->args.particle_count * sizeof(rng_t));
+	strip->rngs = NULL;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t domain_write_visits(
+	const char* const path,
+	const uint64_t* const visits,
+	const uint8_t width,
+	const uint8_t height
+) {
+	FILE* const file = fopen(path, "w");
+	if (!file)
+		return RANDOMWALK_FAIL;
+	for (uint8_t y = 0; y < height; y++)
+		for (uint8_t x = 0; x < width; x++)
+			fprintf(file, "%lu%c", visits[y * width + x], x + 1 < width ? ',' : '\n');
+	return fclose(file) ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
+
+randomwalk_result_t domain_run(
+	const randomwalk_args_t args,
+	randomwalk_stats_t* const stats
+) {
+	const uint32_t strip_count = domain_strip_count(args.domains, args.height);
+	domain_engine_t engine = { 0 };
+	const uint32_t node_count = placement_node_count();
+	const size_t cell_count = (size_t)args.width * args.height;
+	uint64_t* const visits = (uint64_t*)hugealloc_calloc(cell_count, sizeof(uint64_t));
+	int32_t* const ran_on = (int32_t*)calloc(2 * strip_count, sizeof(int32_t));
+	int32_t* const pinned = ran_on ? ran_on + strip_count : NULL;
+	uint64_t* const pages = (uint64_t*)calloc(strip_count * node_count, sizeof(uint64_t));
+	placement_cpus_t cpus = { 0 };
+	randomwalk_result_t result = visits && ran_on && pages ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+	if (result == RANDOMWALK_OK && args.cpus)
+		result = placement_parse_cpus(args.cpus, &cpus);
+	if (result == RANDOMWALK_OK)
+		result = create_strips(&engine, args, strip_count, visits);
+	for (uint32_t i = 0; result == RANDOMWALK_OK && i < strip_count; i++) {
+		domain_strip_t* const strip = &engine.threads[i].strip;
+		if (cpus.count)
+			strip->cpu = cpus.cpus[i % cpus.count];
+		if (args.numa_report) {
+			strip->pinned = &pinned[i];
+			strip->ran_on = &ran_on[i];
+			strip->pages = &pages[i * node_count];
+			strip->node_count = node_count;
+		}
+	}
+	if (result == RANDOMWALK_OK)
+		result = start_strips(&engine);
+	for (uint32_t i = 0; i < engine.started; i++)
+		pthread_join(engine.threads[i].thread, NULL);
+	if (result == RANDOMWALK_OK) {
+		if (args.visits_path)
+			result = domain_write_visits(args.visits_path, visits, args.width, args.height);
+		if (args.numa_report) {
+			placement_print_header(stdout, node_count);
+			for (uint32_t i = 0; i < strip_count; i++)
+				placement_print_strip(stdout, i, pinned[i], ran_on[i], &pages[i * node_count], node_count);
+		}
+	}
+	// Freeing the strips clears the engine, so its statistics are kept first
+	const randomwalk_stats_t run_stats = engine.stats;
+	if (result == RANDOMWALK_OK && stats)
+		*stats = run_stats;
+	destroy_strips(&engine);
+	hugealloc_free(visits, cell_count * sizeof(uint64_t));
+	free(ran_on);
+	free(pages);
+	placement_free_cpus(&cpus);
+	if (result != RANDOMWALK_OK)
+		return result;
+	return run_stats.survivors ? RANDOMWALK_OK : RANDOMWALK_DONE;
+}
+
+const engine_t* domain_engine_get(void) {
+	return &DOMAIN_ENGINE;
+}
+
+static randomwalk_result_t create_strips(
+	domain_engine_t* const engine,
+	const randomwalk_args_t args,
+	const uint32_t strip_count,
+	uint64_t* const visits
+) {
+	const size_t mailbox_bytes = mailbox_size(MAILBOX_CAPACITY);
+	engine->strip_count = strip_count;
+	engine->threads = (strip_thread_t*)calloc(strip_count, sizeof(strip_thread_t));
+	engine->alive = (uint32_t*)calloc(2 * strip_count, sizeof(uint32_t));
+	if (!engine->threads || !engine->alive)
+		return RANDOMWALK_FAIL;
+	for (uint32_t i = 0; i < strip_count; i++) {
+		strip_thread_t* const thread = &engine->threads[i];
+		thread->from_north = (mailbox_t*)malloc(mailbox_bytes);
+		thread->from_south = (mailbox_t*)malloc(mailbox_bytes);
+		if (!thread->from_north || !thread->from_south)
+			return RANDOMWALK_FAIL;
+		mailbox_init(thread->from_north, MAILBOX_CAPACITY);
+		mailbox_init(thread->from_south, MAILBOX_CAPACITY);
+	}
+	for (uint32_t i = 0; i < strip_count; i++) {
+		strip_thread_t* const thread = &engine->threads[i];
+		strip_thread_t* const north = &engine->threads[(i + strip_count - 1) % strip_count];
+		strip_thread_t* const south = &engine->threads[(i + 1) % strip_count];
+		thread->link = (thread_link_t){
+			.link = {
+				.inbox = { thread->from_north, thread->from_south },
+				.outbox = { north->from_south, south->from_north },
+				.walked = &engine->walked,
+				.strip_count = strip_count
+			},
+			.engine = engine,
+			.index = i
+		};
+		const transport_t transport = {
+			.send = mailbox_link_send,
+			.receive = mailbox_link_receive,
+			.finish_walk = mailbox_link_finish_walk,
+			.all_walked = mailbox_link_all_walked,
+			.total = total_threads,
+			.context = &thread->link
+		};
+		const randomwalk_result_t result =
+			domain_strip_create(&thread->strip, args, i, strip_count, visits, transport);
+		if (result != RANDOMWALK_OK)
+			return result;
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t start_strips(domain_engine_t* const engine) {
+	if (pthread_barrier_init(&engine->barrier, NULL, engine->strip_count))
+		return RANDOMWALK_FAIL;
+	engine->barrier_ready = true;
+	while (engine->started < engine->strip_count) {
+		strip_thread_t* const thread = &engine->threads[engine->started];
+		if (pthread_create(&thread->thread, NULL, run_thread, thread))
+			break;
+		engine->started++;
+	}
+	if (engine->started == engine->strip_count)
+		return RANDOMWALK_OK;
+	// Strips wait on each other, so a partial start can never finish
+	if (engine->started) {
+		fputs("Failed to start every domain thread\n", stderr);
+		abort();
+	}
+	return RANDOMWALK_FAIL;
+}
+
+static void destroy_strips(domain_engine_t* const engine) {
+	if (engine->barrier_ready)
+		pthread_barrier_destroy(&engine->barrier);
+	for (uint32_t i = 0; engine->threads && i < engine->strip_count; i++) {
+		domain_strip_destroy(&engine->threads[i].strip);
+		free(engine->threads[i].from_north);
+		free(engine->threads[i].from_south);
+	}
+	free(engine->threads);
+	free(engine->alive);
+	*engine = (domain_engine_t){ 0 };
+}
+
+static randomwalk_result_t init_lockstep(void** engine, const randomwalk_args_t args) {
+	if (!engine || *engine)
+		return RANDOMWALK_FAIL;
+	lockstep_t* const created = (lockstep_t*)calloc(1, sizeof(lockstep_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	*engine = created;
+	// The engine stops the strips itself, so they run without a step limit
+	randomwalk_args_t run = args;
+	run.max_steps = 0;
+	created->cell_count = (size_t)args.width * args.height;
+	created->particle_count = args.particle_count;
+	created->visits = (uint64_t*)hugealloc_calloc(created->cell_count, sizeof(uint64_t));
+	created->present = (bool*)calloc(args.particle_count, sizeof(bool));
+	randomwalk_result_t result = created->visits && created->present ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+	const uint32_t strip_count = domain_strip_count(args.domains ? args.domains : DOMAIN_ENGINE_STRIPS, args.height);
+	domain_engine_t* const strips = &created->strips;
+	if (result == RANDOMWALK_OK)
+		result = create_strips(strips, run, strip_count, created->visits);
+	if (result == RANDOMWALK_OK) {
+		strips->lockstep = true;
+		if (pthread_barrier_init(&strips->stepped, NULL, strip_count + 1))
+			result = RANDOMWALK_FAIL;
+		else if (pthread_barrier_init(&strips->released, NULL, strip_count + 1)) {
+			pthread_barrier_destroy(&strips->stepped);
+			result = RANDOMWALK_FAIL;
+		}
+		if (result != RANDOMWALK_OK)
+			strips->lockstep = false;
+	}
+	if (result == RANDOMWALK_OK)
+		result = start_strips(strips);
+	// The strips have placed their particles once they total them
+	if (result == RANDOMWALK_OK)
+		pthread_barrier_wait(&strips->stepped);
+	if (result != RANDOMWALK_OK)
+		destroy_lockstep(engine);
+	return result;
+}
+
+static randomwalk_result_t step_lockstep(void* engine, const uint64_t step) {
+	lockstep_t* const state = (lockstep_t*)engine;
+	if (!state || step != state->step + 1)
+		return RANDOMWALK_FAIL;
+	if (!state->strips.total)
+		return RANDOMWALK_DONE;
+	pthread_barrier_wait(&state->strips.released);
+	pthread_barrier_wait(&state->strips.stepped);
+	state->step = step;
+	return state->strips.total ? RANDOMWALK_OK : RANDOMWALK_DONE;
+}
+
+static randomwalk_result_t observe_lockstep(void* engine, particle_store_t* const particles) {
+	lockstep_t* const state = (lockstep_t*)engine;
+	if (!state || !particles || particles->capacity < state->particle_count)
+		return RANDOMWALK_FAIL;
+	// Each particle is placed at its identifier, then the gaps are closed
+	memset(state->present, 0, state->particle_count * sizeof(bool));
+	for (uint32_t i = 0; i < state->strips.strip_count; i++) {
+		const particle_store_t* const strip = &state->strips.threads[i].strip.particles;
+		for (uint32_t j = 0; j < strip->count; j++) {
+			const uint32_t id = strip->id[j];
+			if (id >= state->particle_count || state->present[id])
+				return RANDOMWALK_FAIL;
+			state->present[id] = true;
+			particles->x[id] = strip->x[j];
+			particles->y[id] = strip->y[j];
+			particles->direction[id] = strip->direction[j];
+			particles->color[id] = strip->color[j];
+		}
+	}
+	uint32_t count = 0;
+	for (uint32_t id = 0; id < state->particle_count; id++) {
+		if (!state->present[id])
+			continue;
+		particles->id[count] = id;
+		particles->x[count] = particles->x[id];
+		particles->y[count] = particles->y[id];
+		particles->direction[count] = particles->direction[id];
+		particles->color[count] = particles->color[id];
+		count++;
+	}
+	particles->count = count;
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t destroy_lockstep(void** engine) {
+	if (!engine || !*engine)
+		return RANDOMWALK_FAIL;
+	lockstep_t* const state = (lockstep_t*)*engine;
+	domain_engine_t* const strips = &state->strips;
+	// Strips waiting for the next step are let go with no particles to total
+	if (strips->started) {
+		strips->stopping = true;
+		pthread_barrier_wait(&strips->released);
+	}
+	for (uint32_t i = 0; i < strips->started; i++)
+		pthread_join(strips->threads[i].thread, NULL);
+	if (strips->lockstep) {
+		pthread_barrier_destroy(&strips->stepped);
+		pthread_barrier_destroy(&strips->released);
+	}
+	destroy_strips(strips);
+	hugealloc_free(state->visits, state->cell_count * sizeof(uint64_t));
+	free(state->present);
+	free(state);
+	*engine = NULL;
+	return RANDOMWALK_OK;
+}
+
+static void place_particles(domain_strip_t* const strip) {
+	const randomwalk_args_t args = strip->args;
+	for (uint32_t id = 0; id < args.particle_count; id++) {
+		rng_t rng;
+		rng_seed(&rng, rng_derive(args.seed, id));
+		coordinate_t coord;
+		color_t color;
+		direction_t direction;
+		spawn_particle(&strip->spawn, args.width, args.height, &rng, &coord, &color, &direction);
+		if (coord.y < strip->first_row || coord.y >= strip->end_row)
+			continue;
+		// The store holds every particle, so this cannot fail
+		strip->rngs[strip->particles.count] = rng;
+		particle_store_push(&strip->particles, id, coord, direction, color);
+	}
+}
+
+static bool receive_migrants(domain_strip_t* const strip) {
+	particle_store_t* const particles = &strip->particles;
+	const transport_t transport = strip->transport;
+	bool received = false;
+	migrant_t migrant;
+	while (transport.receive(transport.context, &migrant)) {
+		const uint32_t i = particles->count++;
+		particles->id[i] = migrant.id;
+		particles->x[i] = migrant.x;
+		particles->y[i] = migrant.y;
+		particles->direction[i] = migrant.direction;
+		particles->color[i] = migrant.color;
+		strip->rngs[i] = migrant.rng;
+		received = true;
+	}
+	return received;
+}
+
+static void send_migrant(
+	domain_strip_t* const strip,
+	const transport_side_t side,
+	const migrant_t* const migrant
+) {
+	while (!strip->transport.send(strip->transport.context, side, migrant))
+		if (!receive_migrants(strip))
+			sched_yield();
+}
+
+static void step_strip(domain_strip_t* const strip, const kernel_plane_t plane, const uint64_t step) {
+	particle_store_t* const particles = &strip->particles;
+	const transport_t transport = strip->transport;
+	// Migrants arriving meanwhile are appended past the particles being walked
+	const uint32_t count = particles->count;
+	uint32_t survivors = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		uint8_t x = particles->x[i], y = particles->y[i], direction = particles->direction[i];
+		rng_t rng = strip->rngs[i];
+		if (strip->args.counter_rng)
+			rng_seed_counter(&rng, strip->args.seed, particles->id[i], step);
+		if (!kernel_move(plane, &x, &y, &direction, &rng))
+			continue;
+		if (y >= strip->first_row && y < strip->end_row) {
+			particles->id[survivors] = particles->id[i];
+			particles->x[survivors] = x;
+			particles->y[survivors] = y;
+			particles->direction[survivors] = direction;
+			particles->color[survivors] = particles->color[i];
+			strip->rngs[survivors] = rng;
+			survivors++;
+			continue;
+		}
+		// Wrapping from row 0 lands on the last row whichever way a particle moves
+		const bool northward = y >= strip->north_first_row && y < strip->north_end_row;
+		const migrant_t migrant = { particles->id[i], x, y, direction, particles->color[i], rng };
+		send_migrant(strip, northward ? TRANSPORT_NORTH : TRANSPORT_SOUTH, &migrant);
+	}
+	// Once every strip has walked, nothing more is sent this step
+	transport.finish_walk(transport.context);
+	while (!transport.all_walked(transport.context))
+		if (!receive_migrants(strip))
+			sched_yield();
+	receive_migrants(strip);
+	const uint32_t arrivals = particles->count - count;
+	memmove(particles->id + survivors, particles->id + count, arrivals * sizeof(uint32_t));
+	memmove(particles->x + survivors, particles->x + count, arrivals);
+	memmove(particles->y + survivors, particles->y + count, arrivals);
+	memmove(particles->direction + survivors, particles->direction + count, arrivals);
+	memmove(particles->color + survivors, particles->color + count, arrivals * sizeof(color_t));
+	memmove(strip->rngs + survivors, strip->rngs + count, arrivals * sizeof(rng_t));
+	particles->count = survivors + arrivals;
+}
+
+static void count_visits(domain_strip_t* const strip) {
+	kernelset_active()->accumulate(strip->visits, &strip->particles, strip->args.width);
+}
+
+static void count_pages(domain_strip_t* const strip) {
+	const particle_store_t* const particles = &strip->particles;
+	const uint32_t capacity = particles->capacity;
+	placement_count_pages(particles->id, capacity * sizeof(uint32_t), strip->pages, strip->node_count);
+	placement_count_pages(particles->x, capacity, strip->pages, strip->node_count);
+	placement_count_pages(particles->y, capacity, strip->pages, strip->node_count);
+	placement_count_pages(particles->direction, capacity, strip->pages, strip->node_count);
+	placement_count_pages(particles->color, capacity * sizeof(color_t), strip->pages, strip->node_count);
+	placement_count_pages(strip->rngs, capacity * sizeof(rng_t), strip->pages, strip->node_count);
+}
+
+static uint32_t total_threads(void* context, const uint32_t alive) {
+	thread_link_t* const link = (thread_link_t*)context;
+	domain_engine_t* const engine = link->engine;
+	// Counts alternate between two rows, as one may still be read while the other is written
+	uint32_t* const counts = engine->alive + (link->step++ & 1) * engine->strip_count;
+	counts[link->index] = alive;
+	pthread_barrier_wait(&engine->barrier);
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < engine->strip_count; i++)
+		total += counts[i];
+	if (!engine->lockstep)
+		return total;
+	if (!link->index)
+		engine->total = total;
+	pthread_barrier_wait(&engine->stepped);
+	pthread_barrier_wait(&engine->released);
+	return engine->stopping ? 0 : total;
+}
+
+static void* run_thread(void* arg) {
+	strip_thread_t* const thread = (strip_thread_t*)arg;
+	randomwalk_stats_t stats;
+	domain_strip_run(&thread->strip, &stats);
+	if (!thread->link.index)
+		thread->link.engine->stats = stats;
+	return NULL;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file domain.h
+ * @brief A spatially decomposed engine running each strip of the plane on a
+ * thread of its own.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef DOMAIN_H
+#define DOMAIN_H
+
+#include "engine.h"
+#include "particles.h"
+#include "randomwalk.h"
+#include "rng.h"
+#include "spawn.h"
+#include "transport.h"
+#include <stdint.h>
+
+/**
+ * @brief A strip of rows of the plane and the particles within it.
+ *
+ * A strip reaches the others only through its transport, so the same strip
+ * may run on a thread or in a process of its own.
+ */
+typedef struct {
+	randomwalk_args_t args;
+	uint8_t first_row, end_row; // Rows [first_row, end_row) are owned
+	uint8_t north_first_row, north_end_row; // Rows of the northern neighbor
+	spawn_distribution_t spawn; // Distribution the particles are placed by
+	particle_store_t particles;
+	rng_t* rngs;       // Generator of each particle of the store
+	uint64_t* visits;  // Visits of each cell of the plane, of which only the
+	                   // rows of the strip are touched
+	transport_t transport;
+	int32_t cpu;       // CPU to pin the strip to; -1 leaves it unpinned
+	int32_t* pinned;   // CPU the strip was pinned to, once run, or -1 if it
+	                   // was left unpinned or could not be pinned; may be NULL
+	int32_t* ran_on;   // CPU the strip last ran on, once run; may be NULL
+	uint64_t* pages;   // Resident pages of the particles of the strip on each
+	                   // node, once run; may be NULL
+	uint32_t node_count;
+} domain_strip_t;
+
+/**
+ * @brief Determine the number of strips a plane is cut into.
+ *
+ * Wrapping from rows 0 and 1 lands on the last row, so every strip is at
+ * least two rows tall to keep such moves between neighbors.
+ *
+ * @param[in] requested The number of strips requested.
+ * @param[in] height The height of the plane.
+ * @return The number of strips, at least 1.
+ */
+uint32_t domain_strip_count(const uint32_t requested, const uint8_t height);
+
+/**
+ * @brief Allocate a strip of the plane.
+ *
+ * The particles are allocated but left untouched, so that their pages are
+ * placed on the node of whichever CPU the strip runs on, which first writes
+ * them. The strip is left unpinned and unreported.
+ *
+ * @param[out] strip The strip to allocate.
+ * @param[in] args The random walk arguments, with the seed and the
+ * probability of direction change resolved.
+ * @param[in] index The index of the strip from the north.
+ * @param[in] strip_count The number of strips.
+ * @param[in,out] visits The visits of each cell of the plane.
+ * @param[in] transport The transport connecting the strip to the others.
+ * @return The result of allocating the strip.
+ */
+randomwalk_result_t domain_strip_create(
+	domain_strip_t* const strip,
+	const randomwalk_args_t args,
+	const uint32_t index,
+	const uint32_t strip_count,
+	uint64_t* const visits,
+	const transport_t transport
+);
+
+/**
+ * @brief Run a strip until every particle dies or the step limit is hit.
+ *
+ * Every strip of a run must be run at once, as they wait on each other.
+ * The strip pins the calling thread to its CPU, if any, before placing its
+ * particles, and records its placement, if asked to, once done. A strip that
+ * cannot be pinned warns and runs unpinned, as the other strips wait on it,
+ * and is recorded as unpinned.
+ * Every particle draws from a generator of its own derived from the seed, or
+ * under args.counter_rng from the seed, its identifier and the step, so the
+ * outcome does not depend on the number of strips.
+ *
+ * @param[in,out] strip The strip to run.
+ * @param[out] stats Statistics gathered from the run; may be NULL.
+ */
+void domain_strip_run(domain_strip_t* const strip, randomwalk_stats_t* const stats);
+
+/**
+ * @brief Free a strip of the plane.
+ * @param[in,out] strip The strip to free.
+ * @return The result of freeing the strip.
+ */
+randomwalk_result_t domain_strip_destroy(domain_strip_t* const strip);
+
+/**
+ * @brief Write the visits to each cell as one line of comma-separated counts
+ * per row.
+ * @param[in] path The file to write to.
+ * @param[in] visits The visits of each cell of the plane.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @return The result of writing the visit counts.
+ */
+randomwalk_result_t domain_write_visits(
+	const char* const path,
+	const uint64_t* const visits,
+	const uint8_t width,
+	const uint8_t height
+);
+
+/**
+ * @brief Run the random walk headlessly over strips of the plane in parallel.
+ *
+ * The plane is cut into args.domains horizontal strips, each run on a thread
+ * of its own. Particles crossing into a neighboring strip, across the plane
+ * edges too when wrapping, are handed off through lock-free single-producer
+ * single-consumer mailboxes, so no cell is ever touched by two threads.
+ *
+ * If args.visits_path is set, the number of steps a particle spent in each
+ * cell, the initial placement included, is written there. If args.cpus is
+ * set, strip threads are pinned to its CPUs in turn, and if args.numa_report
+ * is set, the node each strip ran on and the nodes its particles were placed
+ * on are printed.
+ *
+ * @param[in] args The validated random walk arguments, with the seed and the
+ * probability of direction change resolved.
+ * @param[out] stats Statistics gathered from the run; may be NULL.
+ * @return The result of the run.
+ */
+randomwalk_result_t domain_run(
+	const randomwalk_args_t args,
+	randomwalk_stats_t* const stats
+);
+
+/**
+ * @brief Get the domain engine.
+ *
+ * The plane is cut into args.domains strips, or four if unset, each run on a
+ * thread of its own exactly as domain_run runs them, except that the threads
+ * wait for the engine between steps so that every step may be observed. Under
+ * --counter-rng every particle draws each step from the seed, its identifier
+ * and the step.
+ *
+ * @return The engine.
+ */
+const engine_t* domain_engine_get(void);
+
+#endif // DOMAIN_H
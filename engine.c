@@ -0,0 +1,427 @@
+/**
+ * @file engine.c
+ * @brief Interchangeable engines advancing a counter-based random walk, and a
+ * differential check of one engine against another.
+ * @author Justin Thoreson
+ */
+
+#include "engine.h"
+#include "domain.h"
+#include "kernel.h"
+#include "refengine.h"
+#include "regen.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The state of a store engine.
+ */
+typedef struct {
+	particle_store_t particles;
+	kernel_plane_t plane;
+	uint64_t seed;
+} store_engine_t;
+
+/**
+ * @brief The steps each tile advances at once unless told otherwise.
+ */
+#define ENGINE_TILE_STEPS 8
+
+/**
+ * @brief The state of a tile engine.
+ *
+ * Tiles of the store are advanced a block of steps at a time, one after
+ * another, as a tiled run advances them. The particles after each step of the
+ * block are kept, as a tile runs ahead of the tiles after it.
+ */
+typedef struct {
+	store_engine_t store;
+	particle_store_t* tiles;  // Windows onto the store, each compacted in place
+	uint32_t tile_count;
+	particle_store_t* steps;  // The particles after each step of the block
+	uint32_t block_steps;     // Steps of a block
+	uint64_t block_first;     // The first step of the block last advanced
+	uint64_t step;            // The step observed
+} tile_engine_t;
+
+/**
+ * @brief Place the particles of a run in a store; an engine init function.
+ * @param[out] engine The state of the created engine.
+ * @param[in] args The random walk arguments.
+ * @return The result of placing the particles.
+ */
+static randomwalk_result_t init_store(void** engine, const randomwalk_args_t args);
+
+/**
+ * @brief Advance the store with the step kernel; an engine step function.
+ * @param[in,out] engine The engine to advance.
+ * @param[in] step The step taken.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+static randomwalk_result_t step_store(void* engine, const uint64_t step);
+
+/**
+ * @brief Copy the particles of the store; an engine observe function.
+ * @param[in] engine The engine to observe.
+ * @param[out] particles The store to copy into.
+ * @return The result of copying the particles.
+ */
+static randomwalk_result_t observe_store(void* engine, particle_store_t* const particles);
+
+/**
+ * @brief Free the store and the engine; an engine destroy function.
+ * @param[in,out] engine The state of the engine to destroy.
+ * @return The result of destroying the engine.
+ */
+static randomwalk_result_t destroy_store(void** engine);
+
+/**
+ * @brief Place the particles of a run in a store cut into tiles; an engine
+ * init function.
+ * @param[out] engine The state of the created engine.
+ * @param[in] args The random walk arguments.
+ * @return The result of placing the particles.
+ */
+static randomwalk_result_t init_tiles(void** engine, const randomwalk_args_t args);
+
+/**
+ * @brief Advance the tiles through the block of steps holding a step, once
+ * the step passes the block last advanced; an engine step function.
+ * @param[in,out] engine The engine to advance.
+ * @param[in] step The step taken.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+static randomwalk_result_t step_tiles(void* engine, const uint64_t step);
+
+/**
+ * @brief Copy the particles of the step taken last; an engine observe function.
+ * @param[in] engine The engine to observe.
+ * @param[out] particles The store to copy into.
+ * @return The result of copying the particles.
+ */
+static randomwalk_result_t observe_tiles(void* engine, particle_store_t* const particles);
+
+/**
+ * @brief Free the tiles and the engine; an engine destroy function.
+ * @param[in,out] engine The state of the engine to destroy.
+ * @return The result of destroying the engine.
+ */
+static randomwalk_result_t destroy_tiles(void** engine);
+
+/**
+ * @brief Append the particles of one store to another with room for them.
+ * @param[in,out] particles The store to append to.
+ * @param[in] tile The particles to append.
+ */
+static void append_particles(particle_store_t* const particles, const particle_store_t* const tile);
+
+/**
+ * @brief Find the first particle at which two stores differ.
+ * @param[in] expected The first store.
+ * @param[in] actual The second store.
+ * @param[out] index The first differing particle, or the shorter count if
+ * one store holds every particle of the other and more.
+ * @return True if the stores differ, false otherwise.
+ */
+static bool find_divergence(
+	const particle_store_t* const expected,
+	const particle_store_t* const actual,
+	uint32_t* const index
+);
+
+/**
+ * @brief Report a particle of an engine at a divergence.
+ * @param[out] report The stream to report to.
+ * @param[in] engine The engine the particle belongs to.
+ * @param[in] particles The particles of the engine.
+ * @param[in] index The particle to report.
+ */
+static void report_particle(
+	FILE* const report,
+	const engine_t* const engine,
+	const particle_store_t* const particles,
+	const uint32_t index
+);
+
+/**
+ * @brief The operations of the store engine.
+ */
+static const engine_t STORE_ENGINE = {
+	.name = "store",
+	.init = init_store,
+	.step = step_store,
+	.observe = observe_store,
+	.destroy = destroy_store
+};
+
+/**
+ * @brief The operations of the tile engine.
+ */
+static const engine_t TILE_ENGINE = {
+	.name = "tile",
+	.init = init_tiles,
+	.step = step_tiles,
+	.observe = observe_tiles,
+	.destroy = destroy_tiles
+};
+
+const engine_t* engine_find(const char* const name) {
+	if (!name)
+		return NULL;
+	const engine_t* const engines[] = { refengine_get(), &STORE_ENGINE, &TILE_ENGINE, domain_engine_get() };
+	for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++)
+		if (!strcmp(name, engines[i]->name))
+			return engines[i];
+	return NULL;
+}
+
+randomwalk_result_t engine_diff(
+	const engine_t* const reference,
+	const engine_t* const candidate,
+	randomwalk_args_t args,
+	FILE* const report,
+	bool* const diverged
+) {
+	if (!reference || !candidate || !report || !diverged)
+		return RANDOMWALK_FAIL;
+	// Both engines start from the seed alone
+	args.checkpoint_path = NULL;
+	const engine_t* const engines[2] = { reference, candidate };
+	void* states[2] = { NULL, NULL };
+	particle_store_t observed[2] = { 0 };
+	randomwalk_result_t result = RANDOMWALK_OK;
+	for (uint8_t i = 0; result == RANDOMWALK_OK && i < 2; i++) {
+		result = particle_store_create(&observed[i], args.particle_count);
+		if (result == RANDOMWALK_OK)
+			result = engines[i]->init(&states[i], args);
+	}
+	*diverged = false;
+	uint64_t step = 0;
+	while (result == RANDOMWALK_OK) {
+		for (uint8_t i = 0; result == RANDOMWALK_OK && i < 2; i++) {
+			if (step) {
+				const randomwalk_result_t stepped = engines[i]->step(states[i], step);
+				result = stepped == RANDOMWALK_DONE ? RANDOMWALK_OK : stepped;
+			}
+			if (result == RANDOMWALK_OK)
+				result = engines[i]->observe(states[i], &observed[i]);
+		}
+		uint32_t index;
+		if (result != RANDOMWALK_OK)
+			break;
+		if (find_divergence(&observed[0], &observed[1], &index)) {
+			*diverged = true;
+			fprintf(report, "Engines %s and %s diverge at step %lu, particle %u of %u and %u\n",
+				reference->name, candidate->name, step, index, observed[0].count, observed[1].count);
+			report_particle(report, reference, &observed[0], index);
+			report_particle(report, candidate, &observed[1], index);
+			break;
+		}
+		if (!observed[0].count || (args.max_steps && step == args.max_steps)) {
+			fprintf(report, "Engines %s and %s agree through step %lu, %u particles alive\n",
+				reference->name, candidate->name, step, observed[0].count);
+			break;
+		}
+		step++;
+	}
+	for (uint8_t i = 0; i < 2; i++) {
+		if (states[i])
+			engines[i]->destroy(&states[i]);
+		particle_store_destroy(&observed[i]);
+	}
+	return result;
+}
+
+static randomwalk_result_t init_store(void** engine, const randomwalk_args_t args) {
+	if (!engine || *engine)
+		return RANDOMWALK_FAIL;
+	store_engine_t* const created = (store_engine_t*)calloc(1, sizeof(store_engine_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	created->plane = (kernel_plane_t){
+		.width = args.width,
+		.height = args.height,
+		.prob_dir_change = args.prob_dir_change,
+		.wrap = args.wrap
+	};
+	created->seed = args.seed;
+	*engine = created;
+	if (particle_store_create(&created->particles, args.particle_count) != RANDOMWALK_OK ||
+		regen_particles(&created->particles, args, 0) != RANDOMWALK_OK) {
+		destroy_store(engine);
+		return RANDOMWALK_FAIL;
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t step_store(void* engine, const uint64_t step) {
+	store_engine_t* const state = (store_engine_t*)engine;
+	if (!state)
+		return RANDOMWALK_FAIL;
+	if (!state->particles.count)
+		return RANDOMWALK_DONE;
+	return kernel_step_counter(&state->particles, NULL, state->plane, false, state->seed, step);
+}
+
+static randomwalk_result_t observe_store(void* engine, particle_store_t* const particles) {
+	const store_engine_t* const state = (const store_engine_t*)engine;
+	if (!state)
+		return RANDOMWALK_FAIL;
+	return particle_store_copy(particles, &state->particles);
+}
+
+static randomwalk_result_t destroy_store(void** engine) {
+	if (!engine || !*engine)
+		return RANDOMWALK_FAIL;
+	store_engine_t* const state = (store_engine_t*)*engine;
+	const randomwalk_result_t result = particle_store_destroy(&state->particles);
+	free(state);
+	*engine = NULL;
+	return result;
+}
+
+static randomwalk_result_t init_tiles(void** engine, const randomwalk_args_t args) {
+	if (!engine || *engine)
+		return RANDOMWALK_FAIL;
+	tile_engine_t* const created = (tile_engine_t*)calloc(1, sizeof(tile_engine_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	*engine = created;
+	void* store = NULL;
+	randomwalk_result_t result = init_store(&store, args);
+	if (result != RANDOMWALK_OK) {
+		destroy_tiles(engine);
+		return result;
+	}
+	created->store = *(store_engine_t*)store;
+	free(store);
+	particle_store_t* const particles = &created->store.particles;
+	created->tile_count = (particles->count + KERNEL_TILE_PARTICLES - 1) / KERNEL_TILE_PARTICLES;
+	created->block_steps = args.tile_steps ? args.tile_steps : ENGINE_TILE_STEPS;
+	created->tiles = (particle_store_t*)calloc(created->tile_count, sizeof(particle_store_t));
+	created->steps = (particle_store_t*)calloc(created->block_steps, sizeof(particle_store_t));
+	if (!created->tiles || !created->steps) {
+		destroy_tiles(engine);
+		return RANDOMWALK_FAIL;
+	}
+	for (uint32_t k = 0; result == RANDOMWALK_OK && k < created->block_steps; k++)
+		result = particle_store_create(&created->steps[k], args.particle_count);
+	if (result != RANDOMWALK_OK) {
+		destroy_tiles(engine);
+		return result;
+	}
+	for (uint32_t t = 0; t < created->tile_count; t++) {
+		const uint32_t first = t * KERNEL_TILE_PARTICLES;
+		const uint32_t count = particles->count - first < KERNEL_TILE_PARTICLES ?
+			particles->count - first : KERNEL_TILE_PARTICLES;
+		created->tiles[t] = (particle_store_t){
+			.count = count,
+			.capacity = count,
+			.id = particles->id + first,
+			.x = particles->x + first,
+			.y = particles->y + first,
+			.direction = particles->direction + first,
+			.color = particles->color + first
+		};
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t step_tiles(void* engine, const uint64_t step) {
+	tile_engine_t* const state = (tile_engine_t*)engine;
+	if (!state || !step)
+		return RANDOMWALK_FAIL;
+	state->step = step;
+	if (state->block_first && step >= state->block_first && step - state->block_first < state->block_steps)
+		return state->steps[step - state->block_first].count ? RANDOMWALK_OK : RANDOMWALK_DONE;
+	// Counter-based draws leave every tile free to run ahead of the others
+	state->block_first = step;
+	for (uint32_t k = 0; k < state->block_steps; k++)
+		state->steps[k].count = 0;
+	const store_engine_t* const store = &state->store;
+	for (uint32_t t = 0; t < state->tile_count; t++) {
+		particle_store_t* const tile = &state->tiles[t];
+		for (uint32_t k = 0; k < state->block_steps && tile->count; k++) {
+			const randomwalk_result_t stepped =
+				kernel_step_counter(tile, NULL, store->plane, false, store->seed, step + k);
+			if (stepped != RANDOMWALK_OK && stepped != RANDOMWALK_DONE)
+				return stepped;
+			append_particles(&state->steps[k], tile);
+		}
+	}
+	return state->steps[0].count ? RANDOMWALK_OK : RANDOMWALK_DONE;
+}
+
+static randomwalk_result_t observe_tiles(void* engine, particle_store_t* const particles) {
+	const tile_engine_t* const state = (const tile_engine_t*)engine;
+	if (!state)
+		return RANDOMWALK_FAIL;
+	if (!state->step)
+		return particle_store_copy(particles, &state->store.particles);
+	return particle_store_copy(particles, &state->steps[state->step - state->block_first]);
+}
+
+static randomwalk_result_t destroy_tiles(void** engine) {
+	if (!engine || !*engine)
+		return RANDOMWALK_FAIL;
+	tile_engine_t* const state = (tile_engine_t*)*engine;
+	for (uint32_t k = 0; state->steps && k < state->block_steps; k++)
+		particle_store_destroy(&state->steps[k]);
+	free(state->steps);
+	free(state->tiles);
+	const randomwalk_result_t result = particle_store_destroy(&state->store.particles);
+	free(state);
+	*engine = NULL;
+	return result;
+}
+
+static void append_particles(particle_store_t* const particles, const particle_store_t* const tile) {
+	const uint32_t count = particles->count;
+	memcpy(particles->id + count, tile->id, tile->count * sizeof(uint32_t));
+	memcpy(particles->x + count, tile->x, tile->count);
+	memcpy(particles->y + count, tile->y, tile->count);
+	memcpy(particles->direction + count, tile->direction, tile->count);
+	memcpy(particles->color + count, tile->color, tile->count * sizeof(color_t));
+	particles->count = count + tile->count;
+}
+
+static bool find_divergence(
+	const particle_store_t* const expected,
+	const particle_store_t* const actual,
+	uint32_t* const index
+) {
+	const uint32_t count = expected->count < actual->count ? expected->count : actual->count;
+	for (*index = 0; *index < count; (*index)++) {
+		const uint32_t i = *index;
+		if (expected->id[i] != actual->id[i] ||
+			expected->x[i] != actual->x[i] ||
+			expected->y[i] != actual->y[i] ||
+			expected->direction[i] != actual->direction[i] ||
+			memcmp(&expected->color[i], &actual->color[i], sizeof(color_t)))
+			return true;
+	}
+	return expected->count != actual->count;
+}
+
+static void report_particle(
+	FILE* const report,
+	const engine_t* const engine,
+	const particle_store_t* const particles,
+	const uint32_t index
+) {
+	if (index >= particles->count) {
+		fprintf(report, "  %-9s none\n", engine->name);
+		return;
+	}
+	const color_t color = particles->color[index];
+	fprintf(report, "  %-9s id %u at (%u, %u) heading %u, color #%02x%02x%02x\n",
+		engine->name,
+		particles->id[index],
+		particles->x[index],
+		particles->y[index],
+		particles->direction[index],
+		color.r,
+		color.g,
+		color.b
+	);
+}
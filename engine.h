@@ -0,0 +1,91 @@
+/**
+ * @file engine.h
+ * @brief Interchangeable engines advancing a counter-based random walk, and a
+ * differential check of one engine against another.
+ * @author Justin Thoreson
+ *
+ * Every engine of a counter-based run draws each step of each particle from
+ * the seed, the particle and the step alone, so engines differing only in how
+ * they store and advance particles must agree on every particle at every step.
+ */
+
+#pragma once
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "particles.h"
+#include "randomwalk.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief The operations of an engine.
+ */
+typedef struct {
+	const char* name;
+
+	/**
+	 * @brief Place the initial particles of a run.
+	 * @param[out] engine The state of the created engine.
+	 * @param[in] args The random walk arguments, with the probability of
+	 * direction change resolved.
+	 * @return The result of creating the engine.
+	 */
+	randomwalk_result_t (*init)(void** engine, const randomwalk_args_t args);
+
+	/**
+	 * @brief Advance every particle by one step.
+	 * @param[in,out] engine The engine to advance.
+	 * @param[in] step The step taken, counted from 1.
+	 * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+	 */
+	randomwalk_result_t (*step)(void* engine, const uint64_t step);
+
+	/**
+	 * @brief Copy the particles alive, in order of identifier.
+	 * @param[in] engine The engine to observe.
+	 * @param[out] particles The store to copy into, of the initial count.
+	 * @return The result of copying the particles.
+	 */
+	randomwalk_result_t (*observe)(void* engine, particle_store_t* const particles);
+
+	/**
+	 * @brief Free an engine.
+	 * @param[in,out] engine The state of the engine to destroy.
+	 * @return The result of destroying the engine.
+	 */
+	randomwalk_result_t (*destroy)(void** engine);
+} engine_t;
+
+/**
+ * @brief Find an engine by name.
+ * @param[in] name The name: reference, the linked list the walk was first
+ * written with; store, the fused kernel over a particle store that runs with
+ * the kernels selected by --isa; tile, the same kernel advancing tiles of the
+ * store several steps at a time; or domain, strip threads handing particles
+ * off to each other.
+ * @return The engine, or NULL if none has the name.
+ */
+const engine_t* engine_find(const char* const name);
+
+/**
+ * @brief Run two engines side by side, comparing their particles after every
+ * step, and report the first step and particle at which they diverge.
+ * @param[in] reference The engine trusted to be correct.
+ * @param[in] candidate The engine to check.
+ * @param[in] args The random walk arguments of a counter-based run; the run
+ * stops at args.max_steps, if set, or once both engines run out of particles.
+ * @param[out] report The stream to report to.
+ * @param[out] diverged Whether the engines diverged.
+ * @return The result of running the engines.
+ */
+randomwalk_result_t engine_diff(
+	const engine_t* const reference,
+	const engine_t* const candidate,
+	randomwalk_args_t args,
+	FILE* const report,
+	bool* const diverged
+);
+
+#endif // ENGINE_H
@@ -0,0 +1,266 @@
+/**
+ * @file ensemble.c
+ * @brief Ensembles of independent replicates of one small configuration,
+ * interleaved so that each lane of a vector carries a different replicate.
+ * @author Justin Thoreson
+ */
+
+#include "ensemble.h"
+#include "kernel.h"
+#include "kernelset.h"
+#include "rng.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The replicates steered together by one vector of the widest kernels.
+ */
+static const uint32_t VECTOR_LANES = 8;
+
+/**
+ * @brief The particles of an ensemble, row by row of lanes, and the state of
+ * the replicate in each lane.
+ */
+typedef struct {
+	uint8_t* x;
+	uint8_t* y;
+	uint8_t* direction;
+	uint8_t* alive;  // Nonzero for each slot still on the plane
+	uint32_t rows;   // Rows holding a particle of at least one replicate
+	uint32_t lanes;  // Slots in a row
+	rng_t rngs[ENSEMBLE_MAX_LANES];
+	uint32_t counts[ENSEMBLE_MAX_LANES];    // Particles alive in each lane
+	uint32_t replicate[ENSEMBLE_MAX_LANES]; // The replicate each lane carries
+} ensemble_t;
+
+/**
+ * @brief Place the particles of a replicate in its lane, drawing exactly what
+ * its own run draws to place them.
+ * @param[in,out] ensemble The ensemble to place into.
+ * @param[in] lane The lane of the replicate.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ */
+static void place_replicate(
+	ensemble_t* const ensemble,
+	const uint32_t lane,
+	const uint8_t width,
+	const uint8_t height
+);
+
+/**
+ * @brief Clear the slots of the particles that left the plane, and record the
+ * step at which each replicate runs out of particles.
+ * @param[in,out] ensemble The ensemble.
+ * @param[in] walked Nonzero for each slot of the rows remaining on the plane.
+ * @param[in] first The first row walked.
+ * @param[in] rows The number of rows walked.
+ * @param[in] step The step taken.
+ * @param[out] stats The statistics of each replicate, set as it finishes.
+ * @param[in,out] deaths The particles that left the plane so far this step.
+ * @return The number of replicates that ran out of particles.
+ */
+static uint32_t retire_deaths(
+	ensemble_t* const ensemble,
+	const uint8_t* const walked,
+	const uint32_t first,
+	const uint32_t rows,
+	const uint64_t step,
+	randomwalk_stats_t* const stats,
+	uint32_t* const deaths
+);
+
+/**
+ * @brief Narrow the rows to the lanes of the replicates still running, padded
+ * with finished lanes to a whole number of vectors.
+ * @param[in,out] ensemble The ensemble to compact.
+ * @param[in] running The replicates with particles left.
+ */
+static void compact_lanes(ensemble_t* const ensemble, const uint32_t running);
+
+/**
+ * @brief Move the particles left of each replicate to the first rows of its
+ * lane, in order so that the replicate still steers in order of particle, and
+ * drop the rows no replicate has a particle left in.
+ * @param[in,out] ensemble The ensemble to compact.
+ */
+static void compact_rows(ensemble_t* const ensemble);
+
+randomwalk_result_t ensemble_simulate(
+	const randomwalk_args_t args,
+	const uint64_t* const seeds,
+	const uint32_t replicates,
+	randomwalk_stats_t* const stats
+) {
+	if (!seeds || !stats || !replicates || replicates > ENSEMBLE_MAX_LANES ||
+		!args.width || !args.height || !args.particle_count)
+		return RANDOMWALK_FAIL;
+	const size_t slots = (size_t)args.particle_count * replicates;
+	uint8_t* const memory = (uint8_t*)malloc(slots * 4);
+	if (!memory)
+		return RANDOMWALK_FAIL;
+	ensemble_t ensemble = {
+		.x = memory,
+		.y = memory + slots,
+		.direction = memory + slots * 2,
+		.alive = memory + slots * 3,
+		.rows = args.particle_count,
+		.lanes = replicates
+	};
+	memset(ensemble.alive, 0xFF, slots);
+	for (uint32_t lane = 0; lane < replicates; lane++) {
+		rng_seed(&ensemble.rngs[lane], seeds[lane]);
+		place_replicate(&ensemble, lane, args.width, args.height);
+		ensemble.counts[lane] = args.particle_count;
+		ensemble.replicate[lane] = lane;
+	}
+	const kernel_plane_t plane = {
+		.width = args.width,
+		.height = args.height,
+		.prob_dir_change = args.prob_dir_change ? args.prob_dir_change : DEFAULT_PROB_DIR_CHANGE,
+		.wrap = args.wrap
+	};
+	const kernelset_t* const kernels = kernelset_active();
+	uint8_t walked[KERNELSET_CHUNK_PARTICLES];
+	uint32_t running = replicates;
+	uint64_t step = 0;
+	while (running && (!args.max_steps || step < args.max_steps)) {
+		kernels->steer_lanes(ensemble.direction, ensemble.alive, ensemble.rows, ensemble.lanes,
+			plane.prob_dir_change, ensemble.rngs);
+		step++;
+		// Whole rows are walked at once so that deaths are charged to their lanes
+		const uint32_t chunk_rows = KERNELSET_CHUNK_PARTICLES / ensemble.lanes;
+		uint32_t deaths = 0, finished = 0;
+		for (uint32_t first = 0; first < ensemble.rows; first += chunk_rows) {
+			const uint32_t rows = ensemble.rows - first < chunk_rows ?
+				ensemble.rows - first : chunk_rows;
+			const size_t offset = (size_t)first * ensemble.lanes;
+			kernels->walk(plane, ensemble.x + offset, ensemble.y + offset,
+				ensemble.direction + offset, walked, rows * ensemble.lanes);
+			finished += retire_deaths(&ensemble, walked, first, rows, step, stats, &deaths);
+		}
+		running -= finished;
+		if (finished)
+			compact_lanes(&ensemble, running);
+		if (deaths)
+			compact_rows(&ensemble);
+	}
+	for (uint32_t lane = 0; lane < ensemble.lanes; lane++)
+		if (ensemble.counts[lane])
+			stats[ensemble.replicate[lane]] = (randomwalk_stats_t){
+				.steps = step,
+				.survivors = ensemble.counts[lane]
+			};
+	free(memory);
+	return RANDOMWALK_OK;
+}
+
+static void place_replicate(
+	ensemble_t* const ensemble,
+	const uint32_t lane,
+	const uint8_t width,
+	const uint8_t height
+) {
+	rng_t* const rng = &ensemble->rngs[lane];
+	for (uint32_t row = 0; row < ensemble->rows; row++) {
+		const size_t slot = (size_t)row * ensemble->lanes + lane;
+		ensemble->x[slot] = rng_uint8(rng, 0, width - 1);
+		ensemble->y[slot] = rng_uint8(rng, 0, height - 1);
+		// Colors are drawn only to keep the generator in step with a lone run
+		for (uint8_t channel = 0; channel < 3; channel++)
+			rng_uint8(rng, 0, UINT8_MAX);
+		ensemble->direction[slot] = rng_uint8(rng, 0, DIRECTION_COUNT - 1);
+	}
+}
+
+static uint32_t retire_deaths(
+	ensemble_t* const ensemble,
+	const uint8_t* const walked,
+	const uint32_t first,
+	const uint32_t rows,
+	const uint64_t step,
+	randomwalk_stats_t* const stats,
+	uint32_t* const deaths
+) {
+	const uint32_t lanes = ensemble->lanes;
+	const size_t count = (size_t)rows * lanes;
+	uint8_t* const alive = ensemble->alive + (size_t)first * lanes;
+	// Most steps of most rows lose nothing, which one branchless pass finds
+	uint8_t lost = 0;
+	for (size_t slot = 0; slot < count; slot++)
+		lost |= alive[slot] & ~walked[slot];
+	if (!lost)
+		return 0;
+	uint32_t finished = 0;
+	for (uint32_t row = 0; row < rows; row++) {
+		for (uint32_t lane = 0; lane < lanes; lane++) {
+			const size_t slot = (size_t)row * lanes + lane;
+			if (!alive[slot] || walked[slot])
+				continue;
+			alive[slot] = 0;
+			(*deaths)++;
+			if (!--ensemble->counts[lane]) {
+				stats[ensemble->replicate[lane]] = (randomwalk_stats_t){ .steps = step };
+				finished++;
+			}
+		}
+	}
+	return finished;
+}
+
+static void compact_lanes(ensemble_t* const ensemble, const uint32_t running) {
+	const uint32_t lanes = ensemble->lanes;
+	const uint32_t padded = (running + VECTOR_LANES - 1) / VECTOR_LANES * VECTOR_LANES;
+	if (padded >= lanes)
+		return;
+	// Kept lanes stay in order, so each moves to a slot at or before its own
+	uint32_t kept[ENSEMBLE_MAX_LANES], count = 0, spare = padded - running;
+	for (uint32_t lane = 0; lane < lanes; lane++) {
+		if (ensemble->counts[lane])
+			kept[count++] = lane;
+		else if (spare) {
+			kept[count++] = lane;
+			spare--;
+		}
+	}
+	for (uint32_t row = 0; row < ensemble->rows; row++) {
+		for (uint32_t lane = 0; lane < padded; lane++) {
+			const size_t to = (size_t)row * padded + lane;
+			const size_t from = (size_t)row * lanes + kept[lane];
+			ensemble->x[to] = ensemble->x[from];
+			ensemble->y[to] = ensemble->y[from];
+			ensemble->direction[to] = ensemble->direction[from];
+			ensemble->alive[to] = ensemble->alive[from];
+		}
+	}
+	for (uint32_t lane = 0; lane < padded; lane++) {
+		ensemble->rngs[lane] = ensemble->rngs[kept[lane]];
+		ensemble->counts[lane] = ensemble->counts[kept[lane]];
+		ensemble->replicate[lane] = ensemble->replicate[kept[lane]];
+	}
+	ensemble->lanes = padded;
+}
+
+static void compact_rows(ensemble_t* const ensemble) {
+	const uint32_t lanes = ensemble->lanes;
+	uint32_t rows = 0;
+	for (uint32_t lane = 0; lane < lanes; lane++) {
+		uint32_t kept = 0;
+		for (uint32_t row = 0; row < ensemble->rows; row++) {
+			const size_t from = (size_t)row * lanes + lane, to = (size_t)kept * lanes + lane;
+			if (!ensemble->alive[from])
+				continue;
+			ensemble->x[to] = ensemble->x[from];
+			ensemble->y[to] = ensemble->y[from];
+			ensemble->direction[to] = ensemble->direction[from];
+			ensemble->alive[to] = ensemble->alive[from];
+			kept++;
+		}
+		// The slots vacated below the particles left hold no particle
+		for (uint32_t row = kept; row < ensemble->rows; row++)
+			ensemble->alive[(size_t)row * lanes + lane] = 0;
+		if (kept > rows)
+			rows = kept;
+	}
+	ensemble->rows = rows;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file ensemble.h
+ * @brief Ensembles of independent replicates of one small configuration,
+ * interleaved so that each lane of a vector carries a different replicate.
+ * @author Justin Thoreson
+ *
+ * Particle p of replicate r occupies slot p * replicates + r, so a row of slots
+ * holds the same particle of every replicate. Each replicate draws from its own
+ * generator in the order its own run would, so an ensemble reproduces the
+ * steps and survivors of running every replicate alone.
+ */
+
+#pragma once
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief The most replicates run in the lanes of one ensemble.
+ */
+#define ENSEMBLE_MAX_LANES 64
+
+/**
+ * @brief Run replicates of a configuration side by side until each runs out
+ * of particles or the step limit is reached.
+ * @param[in] args The random walk arguments shared by every replicate; only
+ * the plane, the particle count, the probability of direction change, wrap
+ * and the step limit are used.
+ * @param[in] seeds The nonzero seed of each replicate.
+ * @param[in] replicates The number of replicates, at most ENSEMBLE_MAX_LANES.
+ * @param[out] stats The steps taken and the survivors of each replicate, as
+ * randomwalk_simulate reports them.
+ * @return The result of running the ensemble.
+ */
+randomwalk_result_t ensemble_simulate(
+	const randomwalk_args_t args,
+	const uint64_t* const seeds,
+	const uint32_t replicates,
+	randomwalk_stats_t* const stats
+);
+
+#endif // ENSEMBLE_H
@@ -0,0 +1,178 @@
+/**
+ * @file eventstream.c
+ * @brief A length-prefixed binary event stream of a random walk.
+ * @author Justin Thoreson
+ */
+
+#include "eventstream.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct eventstream_t {
+	int fd;
+	uint32_t positions_interval;
+	uint64_t step;
+	uint32_t alive;
+	bool failed;
+	size_t size;
+	uint8_t* buffer;
+};
+
+/**
+ * @brief The size of the buffer records are gathered in before writing.
+ */
+const size_t EVENTSTREAM_BUFFER_SIZE = 1 << 20;
+
+/**
+ * @brief The size of a single serialized particle.
+ */
+const uint32_t PARTICLE_RECORD_SIZE = 7;
+
+/**
+ * @brief Write out every buffered byte.
+ * @param[in,out] stream The writer to flush.
+ */
+static void flush(eventstream_t* const stream);
+
+/**
+ * @brief Append an unsigned integer in little-endian byte order.
+ * @param[in,out] stream The writer to append to.
+ * @param[in] value The value to append.
+ * @param[in] size The number of bytes to append.
+ */
+static void put(eventstream_t* const stream, uint64_t value, const size_t size);
+
+/**
+ * @brief Append the length prefix and type of a record.
+ * @param[in,out] stream The writer to append to.
+ * @param[in] type The type of the record.
+ * @param[in] fields_size The size of the fields following the type.
+ */
+static void put_header(
+	eventstream_t* const stream,
+	const eventstream_record_t type,
+	const uint64_t fields_size
+);
+
+/**
+ * @brief Append a record listing particles.
+ * @param[in,out] stream The writer to append to.
+ * @param[in] type The type of the record.
+ * @param[in] step The step the particles belong to.
+ * @param[in] particles The particles to list.
+ */
+static void put_particles(
+	eventstream_t* const stream,
+	const eventstream_record_t type,
+	const uint64_t step,
+	const particle_store_t* const particles
+);
+
+randomwalk_result_t eventstream_create(
+	eventstream_t** stream,
+	const int fd,
+	const randomwalk_args_t args,
+	const uint32_t positions_interval
+) {
+	if (!stream || *stream || fd < 0)
+		return RANDOMWALK_FAIL;
+	// A record of every particle must fit the payload length
+	if (13 + (uint64_t)args.particle_count * PARTICLE_RECORD_SIZE > UINT32_MAX)
+		return RANDOMWALK_BADCOUNT;
+	eventstream_t* const created = (eventstream_t*)calloc(1, sizeof(eventstream_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	created->buffer = (uint8_t*)malloc(EVENTSTREAM_BUFFER_SIZE);
+	if (!created->buffer) {
+		free(created);
+		return RANDOMWALK_FAIL;
+	}
+	created->fd = fd;
+	created->positions_interval = positions_interval;
+	put_header(created, EVENTSTREAM_START, 7);
+	put(created, args.width, 1);
+	put(created, args.height, 1);
+	put(created, args.wrap, 1);
+	put(created, args.particle_count, 4);
+	*stream = created;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t eventstream_observe(void* context, const frame_t* const frame) {
+	eventstream_t* const stream = (eventstream_t*)context;
+	if (!stream || !frame || !frame->particles || !frame->deaths)
+		return RANDOMWALK_FAIL;
+	put_header(stream, EVENTSTREAM_STEP, 16);
+	put(stream, frame->step, 8);
+	put(stream, frame->particles->count, 4);
+	put(stream, frame->deaths->count, 4);
+	if (frame->deaths->count)
+		put_particles(stream, EVENTSTREAM_DEATHS, frame->step, frame->deaths);
+	if (stream->positions_interval && !(frame->step % stream->positions_interval))
+		put_particles(stream, EVENTSTREAM_POSITIONS, frame->step, frame->particles);
+	stream->step = frame->step;
+	stream->alive = frame->particles->count;
+	return stream->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
+
+randomwalk_result_t eventstream_destroy(eventstream_t** stream) {
+	if (!stream || !*stream)
+		return RANDOMWALK_FAIL;
+	eventstream_t* const destroyed = *stream;
+	put_header(destroyed, EVENTSTREAM_END, 12);
+	put(destroyed, destroyed->step, 8);
+	put(destroyed, destroyed->alive, 4);
+	flush(destroyed);
+	const randomwalk_result_t result = destroyed->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+	free(destroyed->buffer);
+	free(destroyed);
+	*stream = NULL;
+	return result;
+}
+
+static void flush(eventstream_t* const stream) {
+	size_t written = 0;
+	while (!stream->failed && written < stream->size) {
+		const ssize_t result = write(stream->fd, stream->buffer + written, stream->size - written);
+		if (result < 0 && errno != EINTR)
+			stream->failed = true;
+		else if (result > 0)
+			written += (size_t)result;
+	}
+	stream->size = 0;
+}
+
+static void put(eventstream_t* const stream, uint64_t value, const size_t size) {
+	if (stream->size + size > EVENTSTREAM_BUFFER_SIZE)
+		flush(stream);
+	for (size_t i = 0; i < size; i++, value >>= 8)
+		stream->buffer[stream->size++] = (uint8_t)value;
+}
+
+static void put_header(
+	eventstream_t* const stream,
+	const eventstream_record_t type,
+	const uint64_t fields_size
+) {
+	put(stream, fields_size + 1, 4);
+	put(stream, type, 1);
+}
+
+static void put_particles(
+	eventstream_t* const stream,
+	const eventstream_record_t type,
+	const uint64_t step,
+	const particle_store_t* const particles
+) {
+	put_header(stream, type, 12 + (uint64_t)particles->count * PARTICLE_RECORD_SIZE);
+	put(stream, step, 8);
+	put(stream, particles->count, 4);
+	for (uint32_t i = 0; i < particles->count; i++) {
+		put(stream, particles->id[i], 4);
+		put(stream, particles->x[i], 1);
+		put(stream, particles->y[i], 1);
+		put(stream, particles->direction[i], 1);
+	}
+}
@@ -0,0 +1,78 @@
+/**
+ * @file eventstream.h
+ * @brief A length-prefixed binary event stream of a random walk.
+ * @author Justin Thoreson
+ *
+ * Every record is a little-endian uint32 payload length, followed by the
+ * payload: a uint8 record type and the fields of that type, all little-endian.
+ *
+ * | Type            | Fields                                                   |
+ * |-----------------|----------------------------------------------------------|
+ * | START (0)       | uint8 width, uint8 height, uint8 wrap, uint32 pcount     |
+ * | STEP (1)        | uint64 step, uint32 alive, uint32 deaths                 |
+ * | DEATHS (2)      | uint64 step, uint32 count, count particles               |
+ * | POSITIONS (3)   | uint64 step, uint32 count, count particles               |
+ * | END (4)         | uint64 steps, uint32 survivors                           |
+ *
+ * Each particle is a uint32 id, uint8 x, uint8 y and uint8 direction. A DEATHS
+ * record follows the STEP record of any step with deaths, holding each dead
+ * particle at its last coordinate and the direction it left the plane in.
+ */
+
+#pragma once
+#ifndef EVENTSTREAM_H
+#define EVENTSTREAM_H
+
+#include "observer.h"
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief Types of records within an event stream.
+ */
+typedef enum {
+	EVENTSTREAM_START = 0,
+	EVENTSTREAM_STEP,
+	EVENTSTREAM_DEATHS,
+	EVENTSTREAM_POSITIONS,
+	EVENTSTREAM_END
+} eventstream_record_t;
+
+/**
+ * @brief A writer of an event stream to a file descriptor.
+ */
+typedef struct eventstream_t eventstream_t;
+
+/**
+ * @brief Create an event stream writer and write its START record.
+ * @param[out] stream The created writer.
+ * @param[in] fd The file descriptor to write to.
+ * @param[in] args The random walk arguments.
+ * @param[in] positions_interval Steps between POSITIONS records; 0 for none.
+ * @return The result of creating the writer; RANDOMWALK_BADCOUNT if a record
+ * of every particle, beyond 613566754 particles, would overflow its payload
+ * length.
+ */
+randomwalk_result_t eventstream_create(
+	eventstream_t** stream,
+	const int fd,
+	const randomwalk_args_t args,
+	const uint32_t positions_interval
+);
+
+/**
+ * @brief Write the records of a frame; an observer_t callback.
+ * @param[in,out] context The eventstream_t to write with.
+ * @param[in] frame The frame to write.
+ * @return The result of writing the records.
+ */
+randomwalk_result_t eventstream_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Write the END record, flush and free an event stream writer.
+ * @param[in,out] stream The writer to destroy.
+ * @return The result of destroying the writer.
+ */
+randomwalk_result_t eventstream_destroy(eventstream_t** stream);
+
+#endif // EVENTSTREAM_H
@@ -0,0 +1,45 @@
+/**
+ * @file framebuffer.c
+ * @brief An image of the plane as painted by the particles' trails.
+ * @author Justin Thoreson
+ */
+
+#include "framebuffer.h"
+#include "hugealloc.h"
+
+randomwalk_result_t framebuffer_create(
+	framebuffer_t* const framebuffer,
+	const uint8_t width,
+	const uint8_t height
+) {
+	if (!framebuffer || !width || !height)
+		return RANDOMWALK_FAIL;
+	*framebuffer = (framebuffer_t){
+		.width = width,
+		.height = height,
+		.cells = (color_t*)hugealloc_calloc((size_t)width * height, sizeof(color_t))
+	};
+	return framebuffer->cells ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+}
+
+randomwalk_result_t framebuffer_paint(
+	framebuffer_t* const framebuffer,
+	const particle_store_t* const particles
+) {
+	if (!framebuffer || !framebuffer->cells || !particles)
+		return RANDOMWALK_FAIL;
+	for (uint32_t i = 0; i < particles->count; i++) {
+		const size_t cell = (size_t)particles->y[i] * framebuffer->width + particles->x[i];
+		framebuffer->cells[cell] = particles->color[i];
+	}
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t framebuffer_destroy(framebuffer_t* const framebuffer) {
+	if (!framebuffer)
+		return RANDOMWALK_FAIL;
+	hugealloc_free(framebuffer->cells,
+		(size_t)framebuffer->width * framebuffer->height * sizeof(color_t));
+	*framebuffer = (framebuffer_t){ 0 };
+	return RANDOMWALK_OK;
+}
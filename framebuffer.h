@@ -0,0 +1,57 @@
+/**
+ * @file framebuffer.h
+ * @brief An image of the plane as painted by the particles' trails.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "particles.h"
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief The color of every cell of the plane, stored row by row.
+ *
+ * Particles paint the cell they occupy and the paint is never cleared, exactly
+ * as the terminal accumulates trails.
+ */
+typedef struct {
+	uint8_t width, height;
+	color_t* cells;
+} framebuffer_t;
+
+/**
+ * @brief Allocate a framebuffer with every cell unpainted (black).
+ * @param[out] framebuffer The framebuffer to allocate.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @return The result of allocating the framebuffer.
+ */
+randomwalk_result_t framebuffer_create(
+	framebuffer_t* const framebuffer,
+	const uint8_t width,
+	const uint8_t height
+);
+
+/**
+ * @brief Paint the cells occupied by particles with their colors.
+ * @param[in,out] framebuffer The framebuffer to paint.
+ * @param[in] particles The particles to paint.
+ * @return The result of painting the framebuffer.
+ */
+randomwalk_result_t framebuffer_paint(
+	framebuffer_t* const framebuffer,
+	const particle_store_t* const particles
+);
+
+/**
+ * @brief Free a framebuffer.
+ * @param[in,out] framebuffer The framebuffer to free.
+ * @return The result of freeing the framebuffer.
+ */
+randomwalk_result_t framebuffer_destroy(framebuffer_t* const framebuffer);
+
+#endif // FRAMEBUFFER_H
@@ -0,0 +1,246 @@
+/**
+ * @file frameexport.c
+ * @brief Export of random walk frames as images or video.
+ * @author Justin Thoreson
+ */
+
+#include "frameexport.h"
+#include "kernelset.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct frameexport_t {
+	randomwalk_export_t format;
+	char* path;
+	uint8_t width, height, scale;
+	size_t pixel_width, pixel_height;
+	uint8_t* pixels; // One scaled image, interleaved RGB or planar YUV
+	uint8_t* cells;  // One converted pixel per cell, interleaved
+};
+
+/**
+ * @brief The size of the buffer behind the Y4M output stream.
+ */
+#define STREAM_BUFFER_SIZE (1 << 20)
+
+/**
+ * @brief The buffer behind the Y4M output stream.
+ *
+ * Standard output keeps referring to its buffer until the program exits.
+ */
+static char stream_buffer[STREAM_BUFFER_SIZE];
+
+/**
+ * @brief The default delay between frames in milliseconds.
+ */
+const uint16_t DEFAULT_FRAME_DELAY_MILLIS = 25;
+
+/**
+ * @brief Scale a row of interleaved cells into one plane row of pixels.
+ * @param[out] row The pixel row to fill.
+ * @param[in] cells The converted cells of the row.
+ * @param[in] width The number of cells in the row.
+ * @param[in] scale The side length in pixels of each cell.
+ * @param[in] stride The number of components per cell.
+ * @param[in] component The component to extract.
+ */
+static void scale_row(
+	uint8_t* row,
+	const uint8_t* const cells,
+	const uint8_t width,
+	const uint8_t scale,
+	const uint8_t stride,
+	const uint8_t component
+);
+
+/**
+ * @brief Scale a plane of cells into pixels, replicating each scaled row.
+ * @param[out] plane The pixel plane to fill.
+ * @param[in] exporter The exporter holding the converted cells.
+ * @param[in] stride The number of components per cell.
+ * @param[in] component The component to extract.
+ */
+static void scale_plane(
+	uint8_t* const plane,
+	const frameexport_t* const exporter,
+	const uint8_t stride,
+	const uint8_t component
+);
+
+/**
+ * @brief Write a frame as a PPM image.
+ * @param[in,out] exporter The exporter.
+ * @param[in] frame The frame to write.
+ * @return The result of writing the image.
+ */
+static randomwalk_result_t write_ppm(
+	frameexport_t* const exporter,
+	const frame_t* const frame
+);
+
+/**
+ * @brief Write a frame to the Y4M stream.
+ * @param[in,out] exporter The exporter.
+ * @param[in] frame The frame to write.
+ * @return The result of writing the frame.
+ */
+static randomwalk_result_t write_y4m(
+	frameexport_t* const exporter,
+	const frame_t* const frame
+);
+
+randomwalk_result_t frameexport_create(
+	frameexport_t** exporter,
+	const randomwalk_export_t format,
+	const char* const path,
+	const uint8_t width,
+	const uint8_t height,
+	const uint8_t scale,
+	const uint16_t delay_ms
+) {
+	if (!exporter || *exporter || format == RANDOMWALK_EXPORT_NONE ||
+		(format == RANDOMWALK_EXPORT_PPM && !path))
+		return RANDOMWALK_FAIL;
+	frameexport_t* const created = (frameexport_t*)calloc(1, sizeof(frameexport_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	*exporter = created;
+	created->format = format;
+	created->width = width;
+	created->height = height;
+	created->scale = scale ? scale : 1;
+	created->pixel_width = (size_t)width * created->scale;
+	created->pixel_height = (size_t)height * created->scale;
+	created->path = path ? strdup(path) : NULL;
+	created->pixels = (uint8_t*)malloc(created->pixel_width * created->pixel_height * 3);
+	created->cells = (uint8_t*)malloc((size_t)width * height * 3);
+	if ((path && !created->path) || !created->pixels || !created->cells) {
+		frameexport_destroy(exporter);
+		return RANDOMWALK_FAIL;
+	}
+	if (format == RANDOMWALK_EXPORT_Y4M) {
+		setvbuf(stdout, stream_buffer, _IOFBF, STREAM_BUFFER_SIZE);
+		const int written = printf(
+			"YUV4MPEG2 W%zu H%zu F1000:%u Ip A1:1 C444 XCOLORRANGE=FULL\n",
+			created->pixel_width,
+			created->pixel_height,
+			delay_ms ? delay_ms : DEFAULT_FRAME_DELAY_MILLIS
+		);
+		if (written < 0) {
+			frameexport_destroy(exporter);
+			return RANDOMWALK_FAIL;
+		}
+	}
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t frameexport_observe(void* context, const frame_t* const frame) {
+	frameexport_t* const exporter = (frameexport_t*)context;
+	if (!exporter || !frame || !frame->framebuffer)
+		return RANDOMWALK_FAIL;
+	return exporter->format == RANDOMWALK_EXPORT_PPM ?
+		write_ppm(exporter, frame) : write_y4m(exporter, frame);
+}
+
+randomwalk_result_t frameexport_destroy(frameexport_t** exporter) {
+	if (!exporter || !*exporter)
+		return RANDOMWALK_FAIL;
+	frameexport_t* const destroyed = *exporter;
+	randomwalk_result_t result = RANDOMWALK_OK;
+	if (destroyed->format == RANDOMWALK_EXPORT_Y4M && fflush(stdout))
+		result = RANDOMWALK_FAIL;
+	free(destroyed->cells);
+	free(destroyed->pixels);
+	free(destroyed->path);
+	free(destroyed);
+	*exporter = NULL;
+	return result;
+}
+
+static void scale_row(
+	uint8_t* row,
+	const uint8_t* const cells,
+	const uint8_t width,
+	const uint8_t scale,
+	const uint8_t stride,
+	const uint8_t component
+) {
+	for (uint8_t x = 0; x < width; x++) {
+		const uint8_t value = cells[(size_t)x * stride + component];
+		for (uint8_t i = 0; i < scale; i++)
+			*row++ = value;
+	}
+}
+
+static void scale_plane(
+	uint8_t* const plane,
+	const frameexport_t* const exporter,
+	const uint8_t stride,
+	const uint8_t component
+) {
+	const size_t row_size = exporter->pixel_width;
+	for (uint8_t y = 0; y < exporter->height; y++) {
+		uint8_t* const row = plane + (size_t)y * exporter->scale * row_size;
+		scale_row(
+			row,
+			exporter->cells + (size_t)y * exporter->width * stride,
+			exporter->width,
+			exporter->scale,
+			stride,
+			component
+		);
+		for (uint8_t i = 1; i < exporter->scale; i++)
+			memcpy(row + i * row_size, row, row_size);
+	}
+}
+
+static randomwalk_result_t write_ppm(
+	frameexport_t* const exporter,
+	const frame_t* const frame
+) {
+	const size_t row_size = exporter->pixel_width * 3;
+	const color_t* const cells = frame->framebuffer->cells;
+	for (uint8_t y = 0; y < exporter->height; y++) {
+		uint8_t* const row = exporter->pixels + (size_t)y * exporter->scale * row_size;
+		uint8_t* pixel = row;
+		for (uint8_t x = 0; x < exporter->width; x++) {
+			const color_t color = cells[(size_t)y * exporter->width + x];
+			for (uint8_t i = 0; i < exporter->scale; i++) {
+				*pixel++ = color.r;
+				*pixel++ = color.g;
+				*pixel++ = color.b;
+			}
+		}
+		for (uint8_t i = 1; i < exporter->scale; i++)
+			memcpy(row + i * row_size, row, row_size);
+	}
+	char filename[PATH_MAX];
+	if (snprintf(filename, sizeof(filename), "%s/frame_%08lu.ppm",
+		exporter->path, frame->step) >= (int)sizeof(filename))
+		return RANDOMWALK_FAIL;
+	FILE* const file = fopen(filename, "wb");
+	if (!file)
+		return RANDOMWALK_FAIL;
+	const bool written = fprintf(file, "P6\n%zu %zu\n255\n",
+		exporter->pixel_width, exporter->pixel_height) > 0 &&
+		fwrite(exporter->pixels, row_size, exporter->pixel_height, file) ==
+		exporter->pixel_height;
+	return fclose(file) || !written ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
+
+static randomwalk_result_t write_y4m(
+	frameexport_t* const exporter,
+	const frame_t* const frame
+) {
+	const size_t cell_count = (size_t)exporter->width * exporter->height;
+	kernelset_active()->encode(frame->framebuffer->cells, exporter->cells, cell_count);
+	const size_t plane_size = exporter->pixel_width * exporter->pixel_height;
+	for (uint8_t component = 0; component < 3; component++)
+		scale_plane(exporter->pixels + component * plane_size, exporter, 3, component);
+	if (fputs("FRAME\n", stdout) < 0 ||
+		fwrite(exporter->pixels, plane_size, 3, stdout) != 3)
+		return RANDOMWALK_FAIL;
+	return RANDOMWALK_OK;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file frameexport.h
+ * @brief Export of random walk frames as images or video.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef FRAMEEXPORT_H
+#define FRAMEEXPORT_H
+
+#include "observer.h"
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief An exporter rendering frames as raw pixels.
+ */
+typedef struct frameexport_t frameexport_t;
+
+/**
+ * @brief Create an exporter.
+ *
+ * PPM exports write one image per frame into a directory; Y4M exports write a
+ * single 4:4:4 video stream to standard output.
+ *
+ * @param[out] exporter The created exporter.
+ * @param[in] format The format to export frames in.
+ * @param[in] path The directory to write images into; unused for Y4M.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @param[in] scale The side length in pixels of each cell; 0 means 1.
+ * @param[in] delay_ms The delay between frames, determining the frame rate.
+ * @return The result of creating the exporter.
+ */
+randomwalk_result_t frameexport_create(
+	frameexport_t** exporter,
+	const randomwalk_export_t format,
+	const char* const path,
+	const uint8_t width,
+	const uint8_t height,
+	const uint8_t scale,
+	const uint16_t delay_ms
+);
+
+/**
+ * @brief Render and write a frame; an observer_t callback.
+ * @param[in,out] context The frameexport_t to write with.
+ * @param[in] frame The frame to export.
+ * @return The result of exporting the frame.
+ */
+randomwalk_result_t frameexport_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Flush and free an exporter.
+ * @param[in,out] exporter The exporter to destroy.
+ * @return The result of destroying the exporter.
+ */
+randomwalk_result_t frameexport_destroy(frameexport_t** exporter);
+
+#endif // FRAMEEXPORT_H
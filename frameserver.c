@@ -0,0 +1,476 @@
+/**
+ * @file frameserver.c
+ * @brief Streaming of random walk frames to viewers over a Unix domain socket.
+ * @author Justin Thoreson
+ */
+
+#define _GNU_SOURCE
+#include "frameserver.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * @brief Encoded bytes shared by every viewer they are queued to.
+ */
+typedef struct {
+	size_t references;
+	size_t size;
+	char data[];
+} message_t;
+
+/**
+ * @brief A message waiting to be sent to a viewer.
+ *
+ * Queued messages are structured in a singly-linked-list-like fashion.
+ */
+typedef struct queued_t {
+	struct queued_t* next;
+	message_t* message;
+} queued_t;
+
+/**
+ * @brief A connected viewer and its backlog of messages.
+ *
+ * Viewers are structured in a singly-linked-list-like fashion.
+ */
+typedef struct client_t {
+	struct client_t* next;
+	int fd;
+	queued_t* head;
+	queued_t** tail;
+	size_t offset;  // Bytes of the head message already sent
+	size_t backlog; // Bytes queued but not yet sent
+	bool needs_keyframe;
+	bool awaiting_writable;
+} client_t;
+
+struct frameserver_t {
+	int listener, epoll;
+	char* path;
+	uint8_t width, height;
+	color_t* shown; // Cells as of the most recently encoded frame
+	size_t backlog_limit;
+	client_t* clients;
+};
+
+/**
+ * @brief The largest number of bytes needed to encode a single cell.
+ */
+const size_t CELL_ENCODING_SIZE = 32;
+
+/**
+ * @brief The smallest backlog beyond which a viewer is resynchronized.
+ */
+const size_t MIN_BACKLOG_LIMIT = 256 * 1024;
+
+/**
+ * @brief The number of readiness events serviced per epoll wait.
+ */
+#define EVENT_BATCH_SIZE 64
+
+/**
+ * @brief The number of milliseconds to spend draining backlogs on shutdown.
+ */
+const int DRAIN_MILLIS = 1000;
+
+/**
+ * @brief Allocate a message able to hold a number of bytes.
+ * @param[in] capacity The number of bytes the message may hold.
+ * @return The allocated message, holding a single reference, or NULL.
+ */
+static message_t* message_create(const size_t capacity);
+
+/**
+ * @brief Drop a reference to a message, freeing it with the last one.
+ * @param[in,out] message The message to release.
+ */
+static void message_release(message_t* const message);
+
+/**
+ * @brief Append an escape sequence painting a cell to a message.
+ * @param[in,out] message The message to append to.
+ * @param[in] x The column of the cell.
+ * @param[in] y The row of the cell.
+ * @param[in] color The color to paint the cell.
+ */
+static void encode_cell(
+	message_t* const message,
+	const uint8_t x,
+	const uint8_t y,
+	const color_t color
+);
+
+/**
+ * @brief Encode the cells changed since the previous frame.
+ * @param[in,out] server The server holding the previously encoded cells.
+ * @param[in] frame The frame to encode.
+ * @return The encoded message, or NULL.
+ */
+static message_t* encode_delta(frameserver_t* const server, const frame_t* const frame);
+
+/**
+ * @brief Encode every painted cell after clearing the screen.
+ * @param[in] server The server holding the encoded cells.
+ * @return The encoded message, or NULL.
+ */
+static message_t* encode_keyframe(const frameserver_t* const server);
+
+/**
+ * @brief Queue a message to a viewer.
+ * @param[in,out] client The viewer to queue to.
+ * @param[in,out] message The message to queue.
+ * @return The result of queueing the message.
+ */
+static randomwalk_result_t enqueue(client_t* const client, message_t* const message);
+
+/**
+ * @brief Discard the backlog of a viewer, except a partially sent message.
+ * @param[in,out] client The viewer whose backlog to discard.
+ */
+static void discard_backlog(client_t* const client);
+
+/**
+ * @brief Send as much of a viewer's backlog as it accepts without blocking.
+ * @param[in] server The server the viewer is connected to.
+ * @param[in,out] client The viewer to send to.
+ * @return The result of sending; failure means the viewer must be dropped.
+ */
+static randomwalk_result_t flush_client(
+	const frameserver_t* const server,
+	client_t* const client
+);
+
+/**
+ * @brief Accept every pending connection.
+ * @param[in,out] server The server to accept connections on.
+ */
+static void accept_clients(frameserver_t* const server);
+
+/**
+ * @brief Disconnect a viewer and free it.
+ * @param[in,out] server The server the viewer is connected to.
+ * @param[in,out] client The viewer to disconnect.
+ */
+static void drop_client(frameserver_t* const server, client_t* const client);
+
+/**
+ * @brief Service every readiness event, waiting at most a timeout.
+ * @param[in,out] server The server to service.
+ * @param[in] timeout The number of milliseconds to wait for events.
+ */
+static void service_events(frameserver_t* const server, const int timeout);
+
+randomwalk_result_t frameserver_create(
+	frameserver_t** server,
+	const char* const path,
+	const uint8_t width,
+	const uint8_t height
+) {
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	if (!server || *server || !path || !*path || strlen(path) >= sizeof(address.sun_path))
+		return RANDOMWALK_FAIL;
+	strcpy(address.sun_path, path);
+	frameserver_t* const created = (frameserver_t*)calloc(1, sizeof(frameserver_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	created->listener = created->epoll = -1;
+	created->width = width;
+	created->height = height;
+	created->backlog_limit = 2 * (size_t)width * height * CELL_ENCODING_SIZE;
+	if (created->backlog_limit < MIN_BACKLOG_LIMIT)
+		created->backlog_limit = MIN_BACKLOG_LIMIT;
+	*server = created;
+	created->path = strdup(path);
+	created->shown = (color_t*)calloc((size_t)width * height, sizeof(color_t));
+	if (!created->path || !created->shown) {
+		frameserver_destroy(server);
+		return RANDOMWALK_FAIL;
+	}
+	unlink(path);
+	created->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	created->epoll = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+	if (created->listener < 0 || created->epoll < 0 ||
+		bind(created->listener, (struct sockaddr*)&address, sizeof(address)) ||
+		listen(created->listener, SOMAXCONN) ||
+		epoll_ctl(created->epoll, EPOLL_CTL_ADD, created->listener, &event)) {
+		frameserver_destroy(server);
+		return RANDOMWALK_FAIL;
+	}
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t frameserver_observe(void* context, const frame_t* const frame) {
+	frameserver_t* const server = (frameserver_t*)context;
+	if (!server || !frame || !frame->particles || !frame->framebuffer)
+		return RANDOMWALK_FAIL;
+	service_events(server, 0);
+	message_t* const delta = encode_delta(server, frame);
+	if (!delta)
+		return RANDOMWALK_FAIL;
+	message_t* keyframe = NULL;
+	client_t* next = NULL;
+	for (client_t* client = server->clients; client; client = next) {
+		next = client->next;
+		if (!client->needs_keyframe && client->backlog + delta->size > server->backlog_limit) {
+			discard_backlog(client);
+			client->needs_keyframe = true;
+		}
+		message_t* message = delta;
+		if (client->needs_keyframe) {
+			if (!keyframe)
+				keyframe = encode_keyframe(server);
+			message = keyframe;
+		}
+		if (!message || enqueue(client, message) != RANDOMWALK_OK ||
+			flush_client(server, client) != RANDOMWALK_OK) {
+			drop_client(server, client);
+			continue;
+		}
+		client->needs_keyframe = false;
+	}
+	if (keyframe)
+		message_release(keyframe);
+	message_release(delta);
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t frameserver_destroy(frameserver_t** server) {
+	if (!server || !*server)
+		return RANDOMWALK_FAIL;
+	frameserver_t* const destroyed = *server;
+	for (int waited = 0; waited < DRAIN_MILLIS; waited += 50) {
+		bool drained = true;
+		for (client_t* client = destroyed->clients; client; client = client->next)
+			drained = drained && !client->head;
+		if (drained)
+			break;
+		service_events(destroyed, 50);
+	}
+	while (destroyed->clients)
+		drop_client(destroyed, destroyed->clients);
+	if (destroyed->epoll >= 0)
+		close(destroyed->epoll);
+	if (destroyed->listener >= 0) {
+		close(destroyed->listener);
+		unlink(destroyed->path);
+	}
+	free(destroyed->shown);
+	free(destroyed->path);
+	free(destroyed);
+	*server = NULL;
+	return RANDOMWALK_OK;
+}
+
+static message_t* message_create(const size_t capacity) {
+	message_t* const message = (message_t*)malloc(sizeof(message_t) + capacity);
+	if (message)
+		*message = (message_t){ .references = 1, .size = 0 };
+	return message;
+}
+
+static void message_release(message_t* const message) {
+	if (message && !--message->references)
+		free(message);
+}
+
+static void encode_cell(
+	message_t* const message,
+	const uint8_t x,
+	const uint8_t y,
+	const color_t color
+) {
+	message->size += (size_t)sprintf(
+		message->data + message->size,
+		"\x1b[%d;%dH\x1b[48;2;%d;%d;%dm ",
+		y + 1, x + 1, color.r, color.g, color.b
+	);
+}
+
+static message_t* encode_delta(frameserver_t* const server, const frame_t* const frame) {
+	const particle_store_t* const particles = frame->particles;
+	message_t* const message = message_create(
+		(size_t)particles->count * CELL_ENCODING_SIZE + 1
+	);
+	if (!message)
+		return NULL;
+	// Only cells occupied by a particle can have changed since the last frame
+	for (uint32_t i = 0; i < particles->count; i++) {
+		const uint8_t x = particles->x[i], y = particles->y[i];
+		const size_t cell = (size_t)y * server->width + x;
+		const color_t color = frame->framebuffer->cells[cell];
+		if (!memcmp(&server->shown[cell], &color, sizeof(color_t)))
+			continue;
+		server->shown[cell] = color;
+		encode_cell(message, x, y, color);
+	}
+	return message;
+}
+
+static message_t* encode_keyframe(const frameserver_t* const server) {
+	const size_t cell_count = (size_t)server->width * server->height;
+	message_t* const message = message_create(cell_count * CELL_ENCODING_SIZE + 16);
+	if (!message)
+		return NULL;
+	message->size = (size_t)sprintf(message->data, "\x1b[0m\x1b[2J");
+	const color_t unpainted = { 0 };
+	for (size_t cell = 0; cell < cell_count; cell++)
+		if (memcmp(&server->shown[cell], &unpainted, sizeof(color_t)))
+			encode_cell(
+				message,
+				(uint8_t)(cell % server->width),
+				(uint8_t)(cell / server->width),
+				server->shown[cell]
+			);
+	return message;
+}
+
+static randomwalk_result_t enqueue(client_t* const client, message_t* const message) {
+	if (!message->size)
+		return RANDOMWALK_OK;
+	queued_t* const queued = (queued_t*)malloc(sizeof(queued_t));
+	if (!queued)
+		return RANDOMWALK_FAIL;
+	*queued = (queued_t){ .next = NULL, .message = message };
+	message->references++;
+	*client->tail = queued;
+	client->tail = &queued->next;
+	client->backlog += message->size;
+	return RANDOMWALK_OK;
+}
+
+static void discard_backlog(client_t* const client) {
+	queued_t** current = client->head && client->offset ? &client->head->next : &client->head;
+	while (*current) {
+		queued_t* const discarded = *current;
+		*current = discarded->next;
+		client->backlog -= discarded->message->size;
+		message_release(discarded->message);
+		free(discarded);
+	}
+	client->tail = current;
+	if (client->head && client->offset)
+		client->backlog = client->head->message->size - client->offset;
+}
+
+static randomwalk_result_t flush_client(
+	const frameserver_t* const server,
+	client_t* const client
+) {
+	while (client->head) {
+		const message_t* const message = client->head->message;
+		const ssize_t sent = send(
+			client->fd,
+			message->data + client->offset,
+			message->size - client->offset,
+			MSG_NOSIGNAL | MSG_DONTWAIT
+		);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return RANDOMWALK_FAIL;
+			if (!client->awaiting_writable) {
+				struct epoll_event event = {
+					.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP,
+					.data.ptr = client
+				};
+				if (epoll_ctl(server->epoll, EPOLL_CTL_MOD, client->fd, &event))
+					return RANDOMWALK_FAIL;
+				client->awaiting_writable = true;
+			}
+			return RANDOMWALK_OK;
+		}
+		client->offset += (size_t)sent;
+		client->backlog -= (size_t)sent;
+		if (client->offset == message->size) {
+			queued_t* const sent_queued = client->head;
+			client->head = sent_queued->next;
+			if (!client->head)
+				client->tail = &client->head;
+			client->offset = 0;
+			message_release(sent_queued->message);
+			free(sent_queued);
+		}
+	}
+	if (client->awaiting_writable) {
+		struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = client };
+		if (epoll_ctl(server->epoll, EPOLL_CTL_MOD, client->fd, &event))
+			return RANDOMWALK_FAIL;
+		client->awaiting_writable = false;
+	}
+	return RANDOMWALK_OK;
+}
+
+static void accept_clients(frameserver_t* const server) {
+	while (true) {
+		const int fd = accept4(server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+		client_t* const client = (client_t*)calloc(1, sizeof(client_t));
+		if (!client) {
+			close(fd);
+			continue;
+		}
+		*client = (client_t){
+			.next = server->clients,
+			.fd = fd,
+			.needs_keyframe = true
+		};
+		client->tail = &client->head;
+		struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = client };
+		if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event)) {
+			close(fd);
+			free(client);
+			continue;
+		}
+		server->clients = client;
+	}
+}
+
+static void drop_client(frameserver_t* const server, client_t* const client) {
+	client_t** current = &server->clients;
+	while (*current && *current != client)
+		current = &(*current)->next;
+	if (*current)
+		*current = client->next;
+	epoll_ctl(server->epoll, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	client->offset = 0;
+	discard_backlog(client);
+	free(client);
+}
+
+static void service_events(frameserver_t* const server, const int timeout) {
+	struct epoll_event events[EVENT_BATCH_SIZE];
+	const int ready = epoll_wait(server->epoll, events, EVENT_BATCH_SIZE, timeout);
+	for (int i = 0; i < ready; i++) {
+		client_t* const client = (client_t*)events[i].data.ptr;
+		if (!client) {
+			accept_clients(server);
+			continue;
+		}
+		if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+			drop_client(server, client);
+			continue;
+		}
+		if (events[i].events & EPOLLIN) {
+			// Viewers have nothing to say; discard whatever they send
+			char discarded[256];
+			const ssize_t received = recv(client->fd, discarded, sizeof(discarded), MSG_DONTWAIT);
+			if (!received || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+				drop_client(server, client);
+				continue;
+			}
+		}
+		if (events[i].events & EPOLLOUT && flush_client(server, client) != RANDOMWALK_OK)
+			drop_client(server, client);
+	}
+}
@@ -0,0 +1,59 @@
+/**
+ * @file frameserver.h
+ * @brief Streaming of random walk frames to viewers over a Unix domain socket.
+ * @author Justin Thoreson
+ *
+ * Each frame is encoded once as terminal escape sequences and the encoded bytes
+ * are shared by every connected viewer, so any terminal may view the stream,
+ * e.g. with `socat - UNIX-CONNECT:<path>`. A viewer that falls too far behind
+ * has its backlog discarded and is resynchronized with a keyframe rather than
+ * stalling the simulation.
+ */
+
+#pragma once
+#ifndef FRAMESERVER_H
+#define FRAMESERVER_H
+
+#include "observer.h"
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief A server streaming frames to its connected viewers.
+ */
+typedef struct frameserver_t frameserver_t;
+
+/**
+ * @brief Listen for viewers on a Unix domain socket.
+ * @param[out] server The created server.
+ * @param[in] path The filesystem path to bind the socket to.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @return The result of creating the server.
+ */
+randomwalk_result_t frameserver_create(
+	frameserver_t** server,
+	const char* const path,
+	const uint8_t width,
+	const uint8_t height
+);
+
+/**
+ * @brief Encode a frame and queue it to every viewer; an observer_t callback.
+ *
+ * Pending connections and writable viewers are serviced without blocking.
+ *
+ * @param[in,out] context The frameserver_t to stream with.
+ * @param[in] frame The frame to stream.
+ * @return The result of streaming the frame.
+ */
+randomwalk_result_t frameserver_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Briefly drain the viewers' backlogs, disconnect them and close.
+ * @param[in,out] server The server to destroy.
+ * @return The result of destroying the server.
+ */
+randomwalk_result_t frameserver_destroy(frameserver_t** server);
+
+#endif // FRAMESERVER_H
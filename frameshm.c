@@ -0,0 +1,295 @@
+/**
+ * @file frameshm.c
+ * @brief Publication of random walk frames through POSIX shared memory.
+ * @author Justin Thoreson
+ */
+
+#include "frameshm.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+struct frameshm_t {
+	frameshm_header_t* header;
+	size_t size;
+	char* name;
+};
+
+/**
+ * @brief The interval at which the viewer polls for new frames.
+ */
+const uint32_t VIEW_POLL_NANOS = 10000000;
+
+/**
+ * @brief Round a size up to the alignment of frame buffers.
+ * @param[in] size The size to round.
+ * @return The rounded size.
+ */
+static size_t align_size(const size_t size);
+
+/**
+ * @brief Compute the size of each frame buffer of a segment.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @param[in] particle_capacity The largest number of particles in a frame.
+ * @return The size of each frame buffer, including its header.
+ */
+static size_t compute_buffer_size(
+	const uint8_t width,
+	const uint8_t height,
+	const uint32_t particle_capacity
+);
+
+/**
+ * @brief Locate a frame buffer within a segment.
+ * @param[in] header The header of the segment.
+ * @param[in] index The index of the buffer.
+ * @return The frame buffer.
+ */
+static frameshm_buffer_t* buffer_at(
+	const frameshm_header_t* const header,
+	const uint64_t index
+);
+
+randomwalk_result_t frameshm_create(
+	frameshm_t** shm,
+	const char* const name,
+	const uint8_t width,
+	const uint8_t height,
+	const uint32_t particle_capacity,
+	const bool wrap
+) {
+	if (!shm || *shm || !name || !*name)
+		return RANDOMWALK_FAIL;
+	const size_t buffer_size = compute_buffer_size(width, height, particle_capacity);
+	const size_t size = align_size(sizeof(frameshm_header_t)) +
+		FRAMESHM_BUFFER_COUNT * buffer_size;
+	frameshm_t* const created = (frameshm_t*)calloc(1, sizeof(frameshm_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	created->name = strdup(name);
+	const int fd = created->name ?
+		shm_open(name, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) : -1;
+	if (fd < 0 || ftruncate(fd, (off_t)size)) {
+		if (fd >= 0) {
+			close(fd);
+			shm_unlink(name);
+		}
+		free(created->name);
+		free(created);
+		return RANDOMWALK_FAIL;
+	}
+	void* const mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		shm_unlink(name);
+		free(created->name);
+		free(created);
+		return RANDOMWALK_FAIL;
+	}
+	created->header = (frameshm_header_t*)mapping;
+	created->size = size;
+	*created->header = (frameshm_header_t){
+		.magic = FRAMESHM_MAGIC,
+		.version = FRAMESHM_VERSION,
+		.width = width,
+		.height = height,
+		.wrap = wrap,
+		.particle_capacity = particle_capacity,
+		.buffer_size = buffer_size
+	};
+	atomic_store(&created->header->published, 0);
+	atomic_store(&created->header->closed, 0);
+	*shm = created;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t frameshm_observe(void* context, const frame_t* const frame) {
+	frameshm_t* const shm = (frameshm_t*)context;
+	if (!shm || !frame || !frame->particles || !frame->framebuffer)
+		return RANDOMWALK_FAIL;
+	frameshm_header_t* const header = shm->header;
+	const uint64_t published = atomic_load_explicit(&header->published, memory_order_relaxed);
+	frameshm_buffer_t* const buffer = buffer_at(header, published % FRAMESHM_BUFFER_COUNT);
+	const uint64_t sequence = atomic_load_explicit(&buffer->sequence, memory_order_relaxed);
+	atomic_store_explicit(&buffer->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	const particle_store_t* const particles = frame->particles;
+	const uint32_t count = particles->count < header->particle_capacity ?
+		particles->count : header->particle_capacity;
+	buffer->step = frame->step;
+	buffer->particle_count = count;
+	memcpy((color_t*)frameshm_cells(buffer), frame->framebuffer->cells,
+		(size_t)header->width * header->height * sizeof(color_t));
+	frameshm_particle_t* const published_particles =
+		(frameshm_particle_t*)frameshm_particles(header, buffer);
+	for (uint32_t i = 0; i < count; i++)
+		published_particles[i] = (frameshm_particle_t){
+			.id = particles->id[i],
+			.x = particles->x[i],
+			.y = particles->y[i],
+			.direction = particles->direction[i],
+			.color = particles->color[i]
+		};
+	atomic_store_explicit(&buffer->sequence, sequence + 2, memory_order_release);
+	atomic_store_explicit(&header->published, published + 1, memory_order_release);
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t frameshm_destroy(frameshm_t** shm) {
+	if (!shm || !*shm)
+		return RANDOMWALK_FAIL;
+	frameshm_t* const destroyed = *shm;
+	atomic_store_explicit(&destroyed->header->closed, 1, memory_order_release);
+	munmap(destroyed->header, destroyed->size);
+	shm_unlink(destroyed->name);
+	free(destroyed->name);
+	free(destroyed);
+	*shm = NULL;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t frameshm_attach(
+	frameshm_reader_t* const reader,
+	const char* const name
+) {
+	if (!reader || !name)
+		return RANDOMWALK_FAIL;
+	const int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return RANDOMWALK_FAIL;
+	struct stat status;
+	if (fstat(fd, &status) || (size_t)status.st_size < sizeof(frameshm_header_t)) {
+		close(fd);
+		return RANDOMWALK_FAIL;
+	}
+	const size_t size = (size_t)status.st_size;
+	void* const mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return RANDOMWALK_FAIL;
+	const frameshm_header_t* const header = (const frameshm_header_t*)mapping;
+	if (header->magic != FRAMESHM_MAGIC || header->version != FRAMESHM_VERSION) {
+		munmap(mapping, size);
+		return RANDOMWALK_FAIL;
+	}
+	*reader = (frameshm_reader_t){ .header = header, .size = size };
+	return RANDOMWALK_OK;
+}
+
+bool frameshm_read_begin(
+	const frameshm_reader_t* const reader,
+	const frameshm_buffer_t** buffer,
+	uint64_t* const token
+) {
+	const uint64_t published = atomic_load_explicit(
+		(_Atomic uint64_t*)&reader->header->published,
+		memory_order_acquire
+	);
+	if (!published)
+		return false;
+	*buffer = buffer_at(reader->header, (published - 1) % FRAMESHM_BUFFER_COUNT);
+	*token = atomic_load_explicit(
+		(_Atomic uint64_t*)&(*buffer)->sequence,
+		memory_order_acquire
+	);
+	return !(*token & 1);
+}
+
+bool frameshm_read_validate(
+	const frameshm_buffer_t* const buffer,
+	const uint64_t token
+) {
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(
+		(_Atomic uint64_t*)&buffer->sequence,
+		memory_order_relaxed
+	) == token;
+}
+
+randomwalk_result_t frameshm_detach(frameshm_reader_t* const reader) {
+	if (!reader || !reader->header)
+		return RANDOMWALK_FAIL;
+	munmap((void*)reader->header, reader->size);
+	*reader = (frameshm_reader_t){ 0 };
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t frameshm_view(const char* const name) {
+	frameshm_reader_t reader;
+	randomwalk_result_t result = frameshm_attach(&reader, name);
+	if (result != RANDOMWALK_OK)
+		return result;
+	const frameshm_header_t* const header = reader.header;
+	const size_t cell_count = (size_t)header->width * header->height;
+	color_t* const drawn = (color_t*)calloc(cell_count, sizeof(color_t));
+	color_t* const next = (color_t*)malloc(cell_count * sizeof(color_t));
+	if (!drawn || !next) {
+		free(next);
+		free(drawn);
+		frameshm_detach(&reader);
+		return RANDOMWALK_FAIL;
+	}
+	printf("\x1b[2J");
+	uint64_t seen = 0;
+	while (true) {
+		const uint64_t published = atomic_load_explicit(
+			(_Atomic uint64_t*)&header->published,
+			memory_order_acquire
+		);
+		const frameshm_buffer_t* buffer;
+		uint64_t token;
+		if (published != seen && frameshm_read_begin(&reader, &buffer, &token)) {
+			memcpy(next, frameshm_cells(buffer), cell_count * sizeof(color_t));
+			if (frameshm_read_validate(buffer, token)) {
+				for (size_t i = 0; i < cell_count; i++) {
+					if (!memcmp(&next[i], &drawn[i], sizeof(color_t)))
+						continue;
+					printf("\x1b[%zu;%zuH\x1b[48;2;%d;%d;%dm ",
+						i / header->width + 1, i % header->width + 1,
+						next[i].r, next[i].g, next[i].b);
+					drawn[i] = next[i];
+				}
+				fflush(stdout);
+				seen = published;
+			}
+			continue;
+		}
+		if (published == seen &&
+			atomic_load_explicit((_Atomic uint32_t*)&header->closed, memory_order_acquire))
+			break;
+		struct timespec req = { 0, VIEW_POLL_NANOS };
+		nanosleep(&req, NULL);
+	}
+	printf("\x1b[0m\x1b[%d;1H", header->height + 1);
+	free(next);
+	free(drawn);
+	return frameshm_detach(&reader);
+}
+
+static size_t align_size(const size_t size) {
+	return (size + FRAMESHM_ALIGNMENT - 1) & ~(size_t)(FRAMESHM_ALIGNMENT - 1);
+}
+
+static size_t compute_buffer_size(
+	const uint8_t width,
+	const uint8_t height,
+	const uint32_t particle_capacity
+) {
+	const size_t cells = ((size_t)width * height * sizeof(color_t) + 7) & ~(size_t)7;
+	return align_size(sizeof(frameshm_buffer_t) + cells +
+		(size_t)particle_capacity * sizeof(frameshm_particle_t));
+}
+
+static frameshm_buffer_t* buffer_at(
+	const frameshm_header_t* const header,
+	const uint64_t index
+) {
+	return (frameshm_buffer_t*)((uint8_t*)header +
+		align_size(sizeof(frameshm_header_t)) + index * header->buffer_size);
+}
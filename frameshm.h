@@ -0,0 +1,211 @@
+/**
+ * @file frameshm.h
+ * @brief Publication of random walk frames through POSIX shared memory.
+ * @author Justin Thoreson
+ *
+ * The simulation publishes every frame into one of two buffers of a shared
+ * memory segment, alternating between them. Each buffer is guarded by a
+ * sequence lock: its sequence is odd while the buffer is being written and
+ * even once the write completes. Readers map the segment read-only, read the
+ * most recently published buffer in place and validate that its sequence did
+ * not change while reading, so any number of readers may follow along without
+ * copying frames or ever holding up the simulation.
+ */
+
+#pragma once
+#ifndef FRAMESHM_H
+#define FRAMESHM_H
+
+#include "observer.h"
+#include "particles.h"
+#include "randomwalk.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The magic number opening a frame segment ("RWFB").
+ */
+#define FRAMESHM_MAGIC UINT32_C(0x42465752)
+
+/**
+ * @brief The version of the frame segment layout.
+ */
+#define FRAMESHM_VERSION UINT32_C(1)
+
+/**
+ * @brief The number of buffers frames alternate between.
+ */
+#define FRAMESHM_BUFFER_COUNT 2
+
+/**
+ * @brief The alignment of each buffer within the segment.
+ */
+#define FRAMESHM_ALIGNMENT 64
+
+/**
+ * @brief A particle as published within a frame.
+ */
+typedef struct {
+	uint32_t id;
+	uint8_t x, y;
+	uint8_t direction;
+	color_t color;
+	uint8_t reserved[2];
+} frameshm_particle_t;
+
+/**
+ * @brief The header of a single frame buffer.
+ *
+ * The header is followed by width * height cells of color_t, padded to a
+ * multiple of 8 bytes, and then by particle_capacity frameshm_particle_t.
+ */
+typedef struct {
+	_Atomic uint64_t sequence; // Odd while the buffer is being written
+	uint64_t step;
+	uint32_t particle_count;
+	uint32_t reserved;
+} frameshm_buffer_t;
+
+/**
+ * @brief The header of a frame segment, followed by the frame buffers.
+ */
+typedef struct {
+	uint32_t magic, version;
+	uint8_t width, height;
+	uint8_t wrap;
+	uint8_t reserved;
+	uint32_t particle_capacity;
+	uint64_t buffer_size;       // Bytes per buffer, including its header
+	_Atomic uint64_t published; // Frames published; the latest lives in
+	                            // buffer (published - 1) % FRAMESHM_BUFFER_COUNT
+	_Atomic uint32_t closed;    // Nonzero once the simulation has finished
+} frameshm_header_t;
+
+/**
+ * @brief A simulation publishing frames to a shared memory segment.
+ */
+typedef struct frameshm_t frameshm_t;
+
+/**
+ * @brief A process following the frames of a shared memory segment.
+ */
+typedef struct {
+	const frameshm_header_t* header;
+	size_t size;
+} frameshm_reader_t;
+
+/**
+ * @brief Get the cells of a frame buffer.
+ * @param[in] buffer The frame buffer.
+ * @return The width * height cells of the buffer, stored row by row.
+ */
+static inline const color_t* frameshm_cells(const frameshm_buffer_t* const buffer) {
+	return (const color_t*)(buffer + 1);
+}
+
+/**
+ * @brief Get the particles of a frame buffer.
+ * @param[in] header The header of the segment the buffer belongs to.
+ * @param[in] buffer The frame buffer.
+ * @return The particle_count particles of the buffer.
+ */
+static inline const frameshm_particle_t* frameshm_particles(
+	const frameshm_header_t* const header,
+	const frameshm_buffer_t* const buffer
+) {
+	const size_t cells = ((size_t)header->width * header->height * sizeof(color_t) + 7) & ~(size_t)7;
+	return (const frameshm_particle_t*)((const uint8_t*)(buffer + 1) + cells);
+}
+
+/**
+ * @brief Create and map a shared memory segment to publish frames to.
+ * @param[out] shm The created publisher.
+ * @param[in] name The name of the segment, e.g. "/randomwalk".
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @param[in] particle_capacity The largest number of particles in a frame.
+ * @param[in] wrap Whether particles return to the opposite edge of egress.
+ * @return The result of creating the segment.
+ */
+randomwalk_result_t frameshm_create(
+	frameshm_t** shm,
+	const char* const name,
+	const uint8_t width,
+	const uint8_t height,
+	const uint32_t particle_capacity,
+	const bool wrap
+);
+
+/**
+ * @brief Publish a frame; an observer_t callback.
+ * @param[in,out] context The frameshm_t to publish to.
+ * @param[in] frame The frame to publish.
+ * @return The result of publishing the frame.
+ */
+randomwalk_result_t frameshm_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Mark a segment closed, unmap it and remove its name.
+ *
+ * Readers that already mapped the segment keep their mapping.
+ *
+ * @param[in,out] shm The publisher to destroy.
+ * @return The result of destroying the publisher.
+ */
+randomwalk_result_t frameshm_destroy(frameshm_t** shm);
+
+/**
+ * @brief Map an existing frame segment read-only.
+ * @param[out] reader The attached reader.
+ * @param[in] name The name of the segment.
+ * @return The result of attaching to the segment.
+ */
+randomwalk_result_t frameshm_attach(
+	frameshm_reader_t* const reader,
+	const char* const name
+);
+
+/**
+ * @brief Begin reading the most recently published frame in place.
+ * @param[in] reader The reader.
+ * @param[out] buffer The buffer holding the frame.
+ * @param[out] token The sequence to validate the read against.
+ * @return True if a frame is available, false if none is yet.
+ */
+bool frameshm_read_begin(
+	const frameshm_reader_t* const reader,
+	const frameshm_buffer_t** buffer,
+	uint64_t* const token
+);
+
+/**
+ * @brief Determine whether a frame was left untouched while it was read.
+ * @param[in] buffer The buffer the frame was read from.
+ * @param[in] token The sequence returned when the read began.
+ * @return True if the read was consistent, false if it must be retried.
+ */
+bool frameshm_read_validate(
+	const frameshm_buffer_t* const buffer,
+	const uint64_t token
+);
+
+/**
+ * @brief Unmap a frame segment.
+ * @param[in,out] reader The reader to detach.
+ * @return The result of detaching from the segment.
+ */
+randomwalk_result_t frameshm_detach(frameshm_reader_t* const reader);
+
+/**
+ * @brief Follow a frame segment, drawing its frames to the terminal.
+ *
+ * Returns once the publishing simulation has finished.
+ *
+ * @param[in] name The name of the segment.
+ * @return The result of viewing the segment.
+ */
+randomwalk_result_t frameshm_view(const char* const name);
+
+#endif // FRAMESHM_H
@@ -0,0 +1,194 @@
+/**
+ * @file history.c
+ * @brief A budgeted history of a random walk that any kept step can be restored from.
+ * @author Justin Thoreson
+ */
+
+#include "history.h"
+#include "delta.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * @brief A keyframe and the deltas of the steps following it.
+ *
+ * Segments are structured in a singly-linked-list-like fashion, oldest first.
+ */
+typedef struct segment_t {
+	struct segment_t* next;
+	uint64_t step;             // Step of the keyframe
+	uint32_t length;           // Number of deltas following the keyframe
+	particle_store_t keyframe;
+	size_t size, capacity;     // Bytes of deltas held and allocated
+	uint8_t* deltas;
+} segment_t;
+
+struct history_t {
+	size_t budget, used;
+	uint8_t width, height;
+	bool wrap;
+	segment_t* first;
+	segment_t* last;
+	particle_store_t latest; // Particles as of the newest step
+};
+
+/**
+ * @brief Start a segment at the newest step.
+ * @param[in,out] history The history to append the segment to.
+ * @param[in] step The step of the keyframe.
+ * @param[in] particles The particles of the keyframe.
+ * @return The result of starting the segment.
+ */
+static randomwalk_result_t start_segment(
+	history_t* const history,
+	const uint64_t step,
+	const particle_store_t* const particles
+);
+
+/**
+ * @brief Compute the bytes held by a segment.
+ * @param[in] segment The segment to measure.
+ * @return The bytes held by the segment.
+ */
+static size_t segment_bytes(const segment_t* const segment);
+
+/**
+ * @brief Free a segment.
+ * @param[in,out] segment The segment to destroy.
+ */
+static void destroy_segment(segment_t* const segment);
+
+randomwalk_result_t history_create(
+	history_t** history,
+	const size_t budget,
+	const randomwalk_args_t args
+) {
+	if (!history || *history)
+		return RANDOMWALK_FAIL;
+	history_t* const created = (history_t*)calloc(1, sizeof(history_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	created->budget = budget;
+	created->width = args.width;
+	created->height = args.height;
+	created->wrap = args.wrap;
+	if (particle_store_create(&created->latest, args.particle_count) != RANDOMWALK_OK) {
+		free(created);
+		return RANDOMWALK_FAIL;
+	}
+	*history = created;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t history_observe(void* context, const frame_t* const frame) {
+	history_t* const history = (history_t*)context;
+	if (!history || !frame || !frame->particles)
+		return RANDOMWALK_FAIL;
+	segment_t* const last = history->last;
+	randomwalk_result_t result;
+	if (!last || last->length == HISTORY_KEYFRAME_INTERVAL) {
+		result = start_segment(history, frame->step, frame->particles);
+	} else {
+		// Particles only ever die, so every delta fits the size of the first
+		result = delta_encode(last->deltas + last->size, &history->latest, frame->particles);
+		last->size += delta_size(history->latest.count);
+		last->length++;
+	}
+	if (result != RANDOMWALK_OK)
+		return result;
+	// Evict the oldest segments, always keeping the one being written
+	while (history->used > history->budget && history->first != history->last) {
+		segment_t* const evicted = history->first;
+		history->first = evicted->next;
+		history->used -= segment_bytes(evicted);
+		destroy_segment(evicted);
+	}
+	return particle_store_copy(&history->latest, frame->particles);
+}
+
+randomwalk_result_t history_range(
+	const history_t* const history,
+	uint64_t* const first,
+	uint64_t* const last
+) {
+	if (!history || !history->first || !first || !last)
+		return RANDOMWALK_FAIL;
+	*first = history->first->step;
+	*last = history->last->step + history->last->length;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t history_restore(
+	const history_t* const history,
+	const uint64_t step,
+	particle_store_t* const particles
+) {
+	if (!history || !particles)
+		return RANDOMWALK_FAIL;
+	const segment_t* segment = history->first;
+	while (segment && step > segment->step + segment->length)
+		segment = segment->next;
+	if (!segment || step < segment->step)
+		return RANDOMWALK_FAIL;
+	randomwalk_result_t result = particle_store_copy(particles, &segment->keyframe);
+	const uint8_t* delta = segment->deltas;
+	for (uint64_t i = segment->step; result == RANDOMWALK_OK && i < step; i++) {
+		const size_t size = delta_size(particles->count);
+		result = delta_apply(particles, delta, history->width, history->height, history->wrap);
+		delta += size;
+	}
+	return result;
+}
+
+randomwalk_result_t history_destroy(history_t** history) {
+	if (!history || !*history)
+		return RANDOMWALK_FAIL;
+	history_t* const destroyed = *history;
+	segment_t* current = destroyed->first;
+	while (current) {
+		segment_t* const next = current->next;
+		destroy_segment(current);
+		current = next;
+	}
+	particle_store_destroy(&destroyed->latest);
+	free(destroyed);
+	*history = NULL;
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t start_segment(
+	history_t* const history,
+	const uint64_t step,
+	const particle_store_t* const particles
+) {
+	segment_t* const segment = (segment_t*)calloc(1, sizeof(segment_t));
+	if (!segment)
+		return RANDOMWALK_FAIL;
+	segment->step = step;
+	segment->capacity = HISTORY_KEYFRAME_INTERVAL * delta_size(particles->count);
+	segment->deltas = (uint8_t*)malloc(segment->capacity);
+	if ((segment->capacity && !segment->deltas) ||
+		particle_store_create(&segment->keyframe, particles->count) != RANDOMWALK_OK ||
+		particle_store_copy(&segment->keyframe, particles) != RANDOMWALK_OK) {
+		destroy_segment(segment);
+		return RANDOMWALK_FAIL;
+	}
+	if (history->last)
+		history->last->next = segment;
+	else
+		history->first = segment;
+	history->last = segment;
+	history->used += segment_bytes(segment);
+	return RANDOMWALK_OK;
+}
+
+static size_t segment_bytes(const segment_t* const segment) {
+	const size_t particle_bytes = sizeof(uint32_t) + 3 * sizeof(uint8_t) + sizeof(color_t);
+	return sizeof(segment_t) + segment->keyframe.capacity * particle_bytes + segment->capacity;
+}
+
+static void destroy_segment(segment_t* const segment) {
+	particle_store_destroy(&segment->keyframe);
+	free(segment->deltas);
+	free(segment);
+}
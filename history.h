@@ -0,0 +1,87 @@
+/**
+ * @file history.h
+ * @brief A budgeted history of a random walk that any kept step can be restored from.
+ * @author Justin Thoreson
+ *
+ * The history is a list of segments, each a keyframe of the particles at its
+ * first step followed by the deltas of up to HISTORY_KEYFRAME_INTERVAL steps
+ * after it. A step is restored by applying the deltas of its segment to the
+ * keyframe. Once the memory held exceeds the budget, the oldest segments are
+ * evicted first.
+ */
+
+#pragma once
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "observer.h"
+#include "particles.h"
+#include "randomwalk.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The number of steps between keyframes.
+ */
+#define HISTORY_KEYFRAME_INTERVAL 64
+
+/**
+ * @brief A history of a random walk.
+ */
+typedef struct history_t history_t;
+
+/**
+ * @brief Create a history.
+ * @param[out] history The created history.
+ * @param[in] budget The number of bytes the history may hold.
+ * @param[in] args The random walk arguments.
+ * @return The result of creating the history.
+ */
+randomwalk_result_t history_create(
+	history_t** history,
+	const size_t budget,
+	const randomwalk_args_t args
+);
+
+/**
+ * @brief Add a frame to the history; an observer_t callback.
+ * @param[in,out] context The history_t to add to.
+ * @param[in] frame The frame to add.
+ * @return The result of adding the frame.
+ */
+randomwalk_result_t history_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Get the range of steps that may be restored.
+ * @param[in] history The history to query.
+ * @param[out] first The oldest step kept.
+ * @param[out] last The newest step kept.
+ * @return The result of querying the history; RANDOMWALK_FAIL if it is empty.
+ */
+randomwalk_result_t history_range(
+	const history_t* const history,
+	uint64_t* const first,
+	uint64_t* const last
+);
+
+/**
+ * @brief Restore the particles alive after a step.
+ * @param[in] history The history to restore from.
+ * @param[in] step The step to restore, within history_range().
+ * @param[out] particles The restored particles, with capacity for all particles.
+ * @return The result of restoring the step.
+ */
+randomwalk_result_t history_restore(
+	const history_t* const history,
+	const uint64_t step,
+	particle_store_t* const particles
+);
+
+/**
+ * @brief Free a history.
+ * @param[in,out] history The history to destroy.
+ * @return The result of destroying the history.
+ */
+randomwalk_result_t history_destroy(history_t** history);
+
+#endif // HISTORY_H
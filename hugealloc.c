@@ -0,0 +1,75 @@
+/**
+ * @file hugealloc.c
+ * @brief An allocator backing large arrays with transparent huge pages.
+ * @author Justin Thoreson
+ */
+
+#define _GNU_SOURCE
+#include "hugealloc.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+/**
+ * @brief Whether large allocations are advised to be backed by huge pages.
+ */
+static atomic_bool is_enabled = true;
+
+/**
+ * @brief Round a size up to a whole number of huge pages.
+ * @param[in] size The size to round.
+ * @return The rounded size.
+ */
+static size_t round_size(const size_t size);
+
+void hugealloc_set_enabled(const bool enabled) {
+	atomic_store(&is_enabled, enabled);
+}
+
+void* hugealloc_alloc(const size_t size) {
+	if (size < HUGEALLOC_PAGE_SIZE)
+		return malloc(size);
+	const size_t rounded = round_size(size);
+	// Mapped a huge page longer than needed, then trimmed to a boundary
+	uint8_t* const mapped = (uint8_t*)mmap(
+		NULL,
+		rounded + HUGEALLOC_PAGE_SIZE,
+		PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS,
+		-1,
+		0
+	);
+	if (mapped == MAP_FAILED)
+		return NULL;
+	const uintptr_t offset = (uintptr_t)mapped % HUGEALLOC_PAGE_SIZE;
+	const size_t head = offset ? HUGEALLOC_PAGE_SIZE - offset : 0;
+	uint8_t* const memory = mapped + head;
+	if (head)
+		munmap(mapped, head);
+	munmap(memory + rounded, HUGEALLOC_PAGE_SIZE - head);
+	// Declined advice, as without huge page support, still leaves usable memory
+	madvise(memory, rounded, atomic_load(&is_enabled) ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+	return memory;
+}
+
+void* hugealloc_calloc(const size_t count, const size_t size) {
+	if (size && count > SIZE_MAX / size)
+		return NULL;
+	// Fresh mappings read as zero already
+	return count * size < HUGEALLOC_PAGE_SIZE ?
+		calloc(count, size) : hugealloc_alloc(count * size);
+}
+
+void hugealloc_free(void* const memory, const size_t size) {
+	if (!memory)
+		return;
+	if (size < HUGEALLOC_PAGE_SIZE)
+		free(memory);
+	else
+		munmap(memory, round_size(size));
+}
+
+static size_t round_size(const size_t size) {
+	return (size + HUGEALLOC_PAGE_SIZE - 1) / HUGEALLOC_PAGE_SIZE * HUGEALLOC_PAGE_SIZE;
+}
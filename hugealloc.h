@@ -0,0 +1,58 @@
+/**
+ * @file hugealloc.h
+ * @brief An allocator backing large arrays with transparent huge pages.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef HUGEALLOC_H
+#define HUGEALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The size of a huge page, and the smallest allocation mapped as such.
+ */
+#define HUGEALLOC_PAGE_SIZE (2u << 20)
+
+/**
+ * @brief Choose whether later large allocations are advised to be backed by
+ * huge pages; they are by default.
+ *
+ * Large allocations are mapped the same way either way, so memory may be
+ * freed after the choice changes.
+ *
+ * @param[in] enabled Whether to advise huge pages.
+ */
+void hugealloc_set_enabled(const bool enabled);
+
+/**
+ * @brief Allocate memory, leaving it untouched.
+ *
+ * Allocations of at least HUGEALLOC_PAGE_SIZE bytes are mapped on huge page
+ * boundaries and advised to be backed by huge pages, which the kernel may
+ * decline; smaller ones are made with malloc. Pages are placed once first
+ * touched, so the allocating thread need not be the one to place them.
+ *
+ * @param[in] size The size of the allocation in bytes.
+ * @return The allocation, or NULL if it failed.
+ */
+void* hugealloc_alloc(const size_t size);
+
+/**
+ * @brief Allocate memory set to zero.
+ * @param[in] count The number of elements.
+ * @param[in] size The size of each element in bytes.
+ * @return The allocation, or NULL if it failed.
+ */
+void* hugealloc_calloc(const size_t count, const size_t size);
+
+/**
+ * @brief Free memory allocated by hugealloc_alloc or hugealloc_calloc.
+ * @param[in] memory The allocation to free; may be NULL.
+ * @param[in] size The size the memory was allocated with, in bytes.
+ */
+void hugealloc_free(void* const memory, const size_t size);
+
+#endif // HUGEALLOC_H
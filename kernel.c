@@ -0,0 +1,149 @@
+/**
+ * @file kernel.c
+ * @brief The fused step kernel advancing a particle store by one step.
+ * @author Justin Thoreson
+ */
+
+#include "kernel.h"
+#include "kernelset.h"
+#include <stdio.h>
+
+/**
+ * @brief Advance every particle by one step in a single pass.
+ * @param[in,out] particles The particles to advance; the survivors on return.
+ * @param[out] deaths The particles that left the plane; may be NULL.
+ * @param[in] plane The plane to advance the particles on.
+ * @param[in] draw Whether to draw the particles to the terminal.
+ * @param[in,out] rng The generator to draw from; NULL draws from the buffer,
+ * or else from a counter-based generator of each particle.
+ * @param[in,out] buffer The buffer of random words to read; may be NULL.
+ * @param[in] seed The seed of the counter-based generators.
+ * @param[in] step The step of the counter-based generators.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+static randomwalk_result_t step_particles(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const bool draw,
+	rng_t* const rng,
+	rngbuf_t* const buffer,
+	const uint64_t seed,
+	const uint64_t step
+);
+
+randomwalk_result_t kernel_step(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const bool draw,
+	rng_t* const rng
+) {
+	if (!rng)
+		return RANDOMWALK_FAIL;
+	return step_particles(particles, deaths, plane, draw, rng, NULL, 0, 0);
+}
+
+randomwalk_result_t kernel_step_counter(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const bool draw,
+	const uint64_t seed,
+	const uint64_t step
+) {
+	return step_particles(particles, deaths, plane, draw, NULL, NULL, seed, step);
+}
+
+randomwalk_result_t kernel_step_buffered(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const bool draw,
+	rngbuf_t* const buffer
+) {
+	if (!buffer)
+		return RANDOMWALK_FAIL;
+	return step_particles(particles, deaths, plane, draw, NULL, buffer, 0, 0);
+}
+
+randomwalk_result_t kernel_advance(
+	particle_store_t* const particles,
+	const kernel_plane_t plane,
+	const uint64_t steps,
+	rng_t* const rng,
+	uint64_t* const taken
+) {
+	if (!particles || !taken)
+		return RANDOMWALK_FAIL;
+	randomwalk_result_t result = particles->count ? RANDOMWALK_OK : RANDOMWALK_DONE;
+	for (*taken = 0; result == RANDOMWALK_OK && *taken < steps; (*taken)++)
+		result = kernel_step(particles, NULL, plane, false, rng);
+	return result;
+}
+
+static randomwalk_result_t step_particles(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const bool draw,
+	rng_t* const rng,
+	rngbuf_t* const buffer,
+	const uint64_t seed,
+	const uint64_t step
+) {
+	if (!particles || !plane.width || !plane.height)
+		return RANDOMWALK_FAIL;
+	// Vector kernels step in chunks, which drawing particle by particle precludes
+	const kernelset_t* const kernels = kernelset_active();
+	if (!draw && kernels->isa != KERNELSET_SCALAR)
+		return kernelset_step(kernels, particles, deaths, plane,
+			(kernelset_source_t){ .rng = rng, .buffer = buffer, .seed = seed, .step = step });
+	if (deaths)
+		deaths->count = 0;
+	// Sides that are powers of two wrap by mask, needing no comparisons
+	const bool pow2 = kernel_plane_pow2(plane);
+	const uint8_t view_width = plane.view_width ? plane.view_width : plane.width;
+	const uint8_t view_height = plane.view_height ? plane.view_height : plane.height;
+	uint32_t survivors = 0;
+	for (uint32_t i = 0; i < particles->count; i++) {
+		const uint32_t id = particles->id[i];
+		const color_t color = particles->color[i];
+		uint8_t x = particles->x[i];
+		uint8_t y = particles->y[i];
+		uint8_t direction = particles->direction[i];
+		if (draw && x < view_width && y < view_height)
+			printf("\x1b[%d;%dH\x1b[48;2;%d;%d;%dm ", y + 1, x + 1, color.r, color.g, color.b);
+		if (buffer) {
+			kernel_steer_buffered(plane.prob_dir_change, &direction, buffer);
+		} else {
+			rng_t counter;
+			if (!rng)
+				rng_seed_counter(&counter, seed, id, step);
+			kernel_steer(plane.prob_dir_change, &direction, rng ? rng : &counter);
+		}
+		const bool alive = pow2 ?
+			kernel_walk_pow2(plane, &x, &y, direction) : kernel_walk(plane, &x, &y, direction);
+		if (!alive) {
+			if (deaths && particle_store_push(
+				deaths,
+				id,
+				(coordinate_t){ x, y },
+				(direction_t)direction,
+				color
+			) != RANDOMWALK_OK)
+				return RANDOMWALK_FAIL;
+			continue;
+		}
+		particles->id[survivors] = id;
+		particles->x[survivors] = x;
+		particles->y[survivors] = y;
+		particles->direction[survivors] = direction;
+		particles->color[survivors] = color;
+		survivors++;
+	}
+	if (draw)
+		fflush(stdout);
+	particles->count = survivors;
+	return survivors ? RANDOMWALK_OK : RANDOMWALK_DONE;
+}
@@ -0,0 +1,287 @@
+/**
+ * @file kernel.h
+ * @brief The fused step kernel advancing a particle store by one step.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include "particles.h"
+#include "randomwalk.h"
+#include "rng.h"
+#include "rngbuf.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief The change in x of a move in each direction:  N  NE  E SE  S  SW   W  NW
+ */
+static const int8_t KERNEL_DELTA_X[DIRECTION_COUNT] =  {  0,  1, 1, 1, 0, -1, -1, -1 };
+
+/**
+ * @brief The change in y of a move in each direction.
+ */
+static const int8_t KERNEL_DELTA_Y[DIRECTION_COUNT] =  { -1, -1, 0, 1, 1,  1,  0, -1 };
+
+/**
+ * @brief The most particles in a tile advanced several steps at once.
+ *
+ * A tile of this many particles takes up 20 KiB of the store, so it stays
+ * resident in the L1 or L2 cache while it is stepped repeatedly.
+ */
+#define KERNEL_TILE_PARTICLES 2048
+
+/**
+ * @brief The plane and steering behaviour a kernel advances particles under.
+ */
+typedef struct {
+	uint8_t width, height;
+	uint8_t prob_dir_change;         // Resolved probability; 0 never changes direction
+	bool wrap;
+	uint8_t view_width, view_height; // The area drawn from the origin; 0 draws the whole side
+} kernel_plane_t;
+
+/**
+ * @brief Determine whether particles wrap around a plane whose sides are both
+ * powers of two, where wrapping reduces to masking.
+ * @param[in] plane The plane.
+ * @return True if the plane wraps by mask, false otherwise.
+ */
+static inline bool kernel_plane_pow2(const kernel_plane_t plane) {
+	return plane.wrap && !(plane.width & (plane.width - 1)) && !(plane.height & (plane.height - 1));
+}
+
+/**
+ * @brief Pad a side of a plane up to the next power of two.
+ * @param[in] side The side, at most 128.
+ * @return The smallest power of two no shorter than the side.
+ */
+static inline uint8_t kernel_pad_pow2(const uint8_t side) {
+	uint8_t padded = 1;
+	while (padded < side)
+		padded <<= 1;
+	return padded;
+}
+
+/**
+ * @brief Wrap a new coordinate around a side that is a power of two exactly as
+ * kernel_walk does, without comparing it.
+ *
+ * kernel_walk sends a coordinate of 0, not only -1, to the far edge, so the
+ * mask is also ORed in wherever the coordinate less one is negative.
+ *
+ * @param[in] coord The new coordinate, from -1 to the side.
+ * @param[in] side The side, a power of two.
+ * @return The wrapped coordinate.
+ */
+static inline uint8_t kernel_wrap_pow2(const int16_t coord, const uint8_t side) {
+	const int mask = side - 1;
+	return (uint8_t)((coord & mask) | ((coord - 1) >> 15 & mask));
+}
+
+/**
+ * @brief Turn a particle to any of the other directions, as if the current
+ * one were skipped.
+ * @param[in,out] direction The direction of movement of the particle.
+ * @param[in] other The index of the new direction among the others.
+ */
+static inline void kernel_turn(uint8_t* const direction, const uint8_t other) {
+	*direction = other >= *direction ? other + 1 : other;
+}
+
+/**
+ * @brief Steer a single particle, turning it with the probability of direction
+ * change.
+ * @param[in] prob_dir_change The probability of direction change.
+ * @param[in,out] direction The direction of movement of the particle.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ */
+static inline void kernel_steer(
+	const uint8_t prob_dir_change,
+	uint8_t* const direction,
+	rng_t* const rng
+) {
+	if (rng_uint8(rng, 1, 100) <= prob_dir_change)
+		kernel_turn(direction, rng_uint8(rng, 0, DIRECTION_COUNT - 2));
+}
+
+/**
+ * @brief Walk a single particle one unit in its direction.
+ * @param[in] plane The plane to walk the particle on.
+ * @param[in,out] x The x coordinate of the particle; unchanged if it leaves.
+ * @param[in,out] y The y coordinate of the particle; unchanged if it leaves.
+ * @param[in] direction The direction of movement of the particle.
+ * @return True if the particle remains on the plane, false otherwise.
+ */
+static inline bool kernel_walk(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t direction
+) {
+	const int16_t new_x = *x + KERNEL_DELTA_X[direction];
+	const int16_t new_y = *y + KERNEL_DELTA_Y[direction];
+	if (plane.wrap) {
+		*x = (uint8_t)(new_x > 0 ? new_x == plane.width ? 0 : new_x : plane.width - 1);
+		*y = (uint8_t)(new_y > 0 ? new_y == plane.height ? 0 : new_y : plane.height - 1);
+		return true;
+	}
+	if (new_x < 0 || new_y < 0 || new_x == plane.width || new_y == plane.height)
+		return false;
+	*x = (uint8_t)new_x;
+	*y = (uint8_t)new_y;
+	return true;
+}
+
+/**
+ * @brief Walk a single particle one unit in its direction on a plane that
+ * wraps by mask, as kernel_walk would.
+ * @param[in] plane The plane to walk the particle on; see kernel_plane_pow2.
+ * @param[in,out] x The x coordinate of the particle.
+ * @param[in,out] y The y coordinate of the particle.
+ * @param[in] direction The direction of movement of the particle.
+ * @return True, as particles never leave a wrapping plane.
+ */
+static inline bool kernel_walk_pow2(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t direction
+) {
+	*x = kernel_wrap_pow2(*x + KERNEL_DELTA_X[direction], plane.width);
+	*y = kernel_wrap_pow2(*y + KERNEL_DELTA_Y[direction], plane.height);
+	return true;
+}
+
+/**
+ * @brief Steer and walk a single particle by one step.
+ * @param[in] plane The plane to walk the particle on.
+ * @param[in,out] x The x coordinate of the particle; unchanged if it leaves.
+ * @param[in,out] y The y coordinate of the particle; unchanged if it leaves.
+ * @param[in,out] direction The direction of movement of the particle.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @return True if the particle remains on the plane, false otherwise.
+ */
+static inline bool kernel_move(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	uint8_t* const direction,
+	rng_t* const rng
+) {
+	kernel_steer(plane.prob_dir_change, direction, rng);
+	return kernel_walk(plane, x, y, *direction);
+}
+
+/**
+ * @brief Steer a single particle, reading the words kernel_steer would draw
+ * from a buffer.
+ * @param[in] prob_dir_change The probability of direction change.
+ * @param[in,out] direction The direction of movement of the particle.
+ * @param[in,out] buffer The buffer of random words to read.
+ */
+static inline void kernel_steer_buffered(
+	const uint8_t prob_dir_change,
+	uint8_t* const direction,
+	rngbuf_t* const buffer
+) {
+	if (rng_word_uint8(rngbuf_next(buffer), 1, 100) <= prob_dir_change)
+		kernel_turn(direction, rng_word_uint8(rngbuf_next(buffer), 0, DIRECTION_COUNT - 2));
+}
+
+/**
+ * @brief Advance every particle by one step in a single pass.
+ *
+ * Each particle is drawn (if requested) at its current coordinate, steered,
+ * walked and kept or dropped, survivors being compacted to the front of the
+ * store in order. Random numbers are drawn particle by particle in the same
+ * order as separate steering and walking passes would draw them.
+ *
+ * @param[in,out] particles The particles to advance; the survivors on return.
+ * @param[out] deaths The particles that left the plane, at their last
+ * coordinate and the direction they left in; may be NULL.
+ * @param[in] plane The plane to advance the particles on.
+ * @param[in] draw Whether to draw the particles to the terminal.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+randomwalk_result_t kernel_step(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const bool draw,
+	rng_t* const rng
+);
+
+/**
+ * @brief Advance every particle by one step in a single pass, drawing the
+ * random numbers of each particle from its identifier and the step alone.
+ *
+ * Behaves as kernel_step otherwise. As no state is carried between steps, the
+ * particles at any step may be recomputed from the initial ones (see regen.h).
+ *
+ * @param[in,out] particles The particles to advance; the survivors on return.
+ * @param[out] deaths The particles that left the plane, at their last
+ * coordinate and the direction they left in; may be NULL.
+ * @param[in] plane The plane to advance the particles on.
+ * @param[in] draw Whether to draw the particles to the terminal.
+ * @param[in] seed The seed of the run.
+ * @param[in] step The step taken, counted from 1.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+randomwalk_result_t kernel_step_counter(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const bool draw,
+	const uint64_t seed,
+	const uint64_t step
+);
+
+/**
+ * @brief Advance every particle by one step in a single pass, reading random
+ * words from a buffer filled by a producer thread.
+ *
+ * Behaves as kernel_step otherwise; a buffer producing the sequence of a
+ * generator advances the particles exactly as that generator would.
+ *
+ * @param[in,out] particles The particles to advance; the survivors on return.
+ * @param[out] deaths The particles that left the plane, at their last
+ * coordinate and the direction they left in; may be NULL.
+ * @param[in] plane The plane to advance the particles on.
+ * @param[in] draw Whether to draw the particles to the terminal.
+ * @param[in,out] buffer The buffer of random words to read.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+randomwalk_result_t kernel_step_buffered(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const bool draw,
+	rngbuf_t* const buffer
+);
+
+/**
+ * @brief Advance every particle by up to a number of steps without drawing.
+ *
+ * Stepping a small population several times in a row keeps it in cache, so
+ * tiles of a large population are best advanced one after another this way.
+ *
+ * @param[in,out] particles The particles to advance; the survivors on return.
+ * @param[in] plane The plane to advance the particles on.
+ * @param[in] steps The most steps to advance by.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @param[out] taken The number of steps advanced by.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+randomwalk_result_t kernel_advance(
+	particle_store_t* const particles,
+	const kernel_plane_t plane,
+	const uint64_t steps,
+	rng_t* const rng,
+	uint64_t* const taken
+);
+
+#endif // KERNEL_H
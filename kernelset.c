@@ -0,0 +1,1390 @@
+/**
+ * @file kernelset.c
+ * @brief Sets of kernels built for each instruction set, one of which is
+ * selected at startup by the features of the CPU.
+ * @author Justin Thoreson
+ */
+
+#include "kernelset.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELSET_X86
+#endif
+
+_Static_assert(sizeof(color_t) == 3, "Colors are loaded as packed RGB triples");
+
+/**
+ * @brief The names of the instruction sets, as given to --isa.
+ */
+static const char* const KERNELSET_NAMES[KERNELSET_COUNT] = {
+	"scalar", "sse4", "avx2", "avx512"
+};
+
+/**
+ * @brief The seed of the self-check scenario.
+ */
+static const uint64_t CHECK_SEED = 0x5eed;
+
+/**
+ * @brief The particles of the self-check scenario; no multiple of any width.
+ */
+static const uint32_t CHECK_PARTICLES = 3001;
+
+/**
+ * @brief The most steps of the self-check scenario.
+ */
+static const uint32_t CHECK_STEPS = 48;
+
+/**
+ * @brief The colors encoded by the self-check.
+ */
+#define CHECK_COLORS 301
+
+/**
+ * @brief Steer particles one at a time; every set steers so, as the draws of a
+ * particle depend on those before it.
+ * @param[in,out] direction The directions of the particles.
+ * @param[in] id The identifiers of the particles.
+ * @param[in] count The number of particles.
+ * @param[in] prob_dir_change The probability of direction change.
+ * @param[in,out] source The source of random numbers.
+ */
+static void steer_scalar(
+	uint8_t* const direction,
+	const uint32_t* const id,
+	const uint32_t count,
+	const uint8_t prob_dir_change,
+	const kernelset_source_t* const source
+);
+
+/**
+ * @brief Steer a range of the lanes of interleaved replicates one particle at
+ * a time.
+ * @param[in,out] direction The directions, row by row of lanes.
+ * @param[in] alive Nonzero for each particle to steer.
+ * @param[in] rows The number of rows.
+ * @param[in] lanes The particles in a row.
+ * @param[in] first The first lane of the range.
+ * @param[in] prob_dir_change The probability of direction change.
+ * @param[in,out] rngs The generator of each replicate.
+ */
+static void steer_lane_range(
+	uint8_t* const direction,
+	const uint8_t* const alive,
+	const uint32_t rows,
+	const uint32_t lanes,
+	const uint32_t first,
+	const uint8_t prob_dir_change,
+	rng_t* const rngs
+);
+
+/**
+ * @brief Steer the lanes of interleaved replicates one particle at a time.
+ * @param[in,out] direction The directions, row by row of lanes.
+ * @param[in] alive Nonzero for each particle to steer.
+ * @param[in] rows The number of rows.
+ * @param[in] lanes The particles in a row.
+ * @param[in] prob_dir_change The probability of direction change.
+ * @param[in,out] rngs The generator of each replicate.
+ */
+static void steer_lanes_scalar(
+	uint8_t* const direction,
+	const uint8_t* const alive,
+	const uint32_t rows,
+	const uint32_t lanes,
+	const uint8_t prob_dir_change,
+	rng_t* const rngs
+);
+
+/**
+ * @brief Walk particles one at a time.
+ * @param[in] plane The plane to walk the particles on.
+ * @param[in,out] x The x coordinates; unchanged for particles that leave.
+ * @param[in,out] y The y coordinates; unchanged for particles that leave.
+ * @param[in] direction The directions of the particles.
+ * @param[out] alive 0xFF for each particle remaining on the plane, else 0.
+ * @param[in] count The number of particles.
+ */
+static void walk_scalar(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction,
+	uint8_t* const alive,
+	const uint32_t count
+);
+
+/**
+ * @brief Move a range of particles within a store.
+ * @param[in,out] particles The store to move within.
+ * @param[in] to The index to move the range to.
+ * @param[in] from The first particle of the range.
+ * @param[in] count The number of particles in the range.
+ */
+static void move_range(
+	particle_store_t* const particles,
+	const uint32_t to,
+	const uint32_t from,
+	const uint32_t count
+);
+
+/**
+ * @brief Compact a range of particles, moving whole blocks at once wherever
+ * every particle of a block survived.
+ * @param[in,out] particles The store holding the range.
+ * @param[out] deaths The particles that left the plane; may be NULL.
+ * @param[in] alive Nonzero for each particle of the range remaining.
+ * @param[in] first The first particle of the range.
+ * @param[in] count The number of particles in the range.
+ * @param[in,out] survivors The particles kept before the range; those kept
+ * after it on return.
+ * @param[in] block The particles in a block; 0 compacts one at a time.
+ * @param[in] all_alive Whether every particle of a block survived.
+ * @return The result of recording the deaths.
+ */
+static randomwalk_result_t compact_blocks(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors,
+	const uint32_t block,
+	bool (*all_alive)(const uint8_t* const alive)
+);
+
+/**
+ * @brief Compact particles one at a time.
+ * @param[in,out] particles The store holding the range.
+ * @param[out] deaths The particles that left the plane; may be NULL.
+ * @param[in] alive Nonzero for each particle of the range remaining.
+ * @param[in] first The first particle of the range.
+ * @param[in] count The number of particles in the range.
+ * @param[in,out] survivors The particles kept before the range; those kept
+ * after it on return.
+ * @return The result of recording the deaths.
+ */
+static randomwalk_result_t compact_scalar(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors
+);
+
+/**
+ * @brief Convert colors one at a time.
+ * @param[in] cells The colors to convert.
+ * @param[out] yuv The interleaved Y, Cb and Cr components of each color.
+ * @param[in] count The number of colors.
+ */
+static void encode_scalar(const color_t* const cells, uint8_t* const yuv, const size_t count);
+
+/**
+ * @brief Count visits one at a time; every set counts so, as particles on one
+ * cell would conflict within a vector.
+ * @param[in,out] visits The visits to each cell of the plane, row by row.
+ * @param[in] particles The visiting particles.
+ * @param[in] width The width of the plane.
+ */
+static void accumulate_scalar(
+	uint64_t* const visits,
+	const particle_store_t* const particles,
+	const uint8_t width
+);
+
+#ifdef KERNELSET_X86
+
+/**
+ * @brief Wrap new coordinates around the plane exactly as kernel_walk does.
+ * @param[in] coord The new coordinates, modulo 256.
+ * @param[in] delta The changes that produced them.
+ * @param[in] size The side length of the plane along the axis.
+ * @return The wrapped coordinates.
+ */
+__attribute__((target("sse4.1")))
+static __m128i wrap_sse4(const __m128i coord, const __m128i delta, const __m128i size);
+
+/**
+ * @brief Find the new coordinates that leave the plane.
+ * @param[in] coord The new coordinates, modulo 256.
+ * @param[in] size The side length of the plane along the axis.
+ * @return 0xFF for each coordinate off the plane, else 0.
+ */
+__attribute__((target("sse4.1")))
+static __m128i leaves_sse4(const __m128i coord, const __m128i size);
+
+/**
+ * @brief Wrap new coordinates around a side that is a power of two exactly as
+ * kernel_wrap_pow2 does, selecting the far edge by the sign of the coordinate
+ * less one rather than by comparison.
+ * @param[in] coord The new coordinates, modulo 256.
+ * @param[in] mask The side length of the plane along the axis, less one.
+ * @return The wrapped coordinates.
+ */
+__attribute__((target("sse4.1")))
+static __m128i wrap_pow2_sse4(const __m128i coord, const __m128i mask);
+
+/**
+ * @brief Walk particles 16 at a time with SSE4.1.
+ * @see walk_scalar
+ */
+__attribute__((target("sse4.1")))
+static void walk_sse4(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction,
+	uint8_t* const alive,
+	const uint32_t count
+);
+
+/**
+ * @brief Determine whether all 16 particles of a block survived.
+ * @param[in] alive The flags of the block.
+ * @return True if every particle survived, false otherwise.
+ */
+__attribute__((target("sse4.1")))
+static bool all_alive_sse4(const uint8_t* const alive);
+
+/**
+ * @brief Compact particles in blocks of 16 with SSE4.1.
+ * @see compact_scalar
+ */
+__attribute__((target("sse4.1")))
+static randomwalk_result_t compact_sse4(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors
+);
+
+/**
+ * @brief Load four colors as their red, then green, then blue components.
+ *
+ * Sixteen bytes are read, so two more colors must follow the four.
+ *
+ * @param[in] cells The colors to load.
+ * @return The components, red in bytes 0-3, green in 4-7 and blue in 8-11.
+ */
+__attribute__((target("sse4.1")))
+static __m128i load_rgb_sse4(const color_t* const cells);
+
+/**
+ * @brief Store the components of four colors interleaved.
+ * @param[out] yuv The 12 bytes to store into.
+ * @param[in] y The Y components as 32-bit integers.
+ * @param[in] u The Cb components as 32-bit integers.
+ * @param[in] v The Cr components as 32-bit integers.
+ */
+__attribute__((target("sse4.1")))
+static void store_yuv_sse4(uint8_t* const yuv, const __m128i y, const __m128i u, const __m128i v);
+
+/**
+ * @brief Convert colors four at a time with SSE4.1.
+ * @see encode_scalar
+ */
+__attribute__((target("sse4.1")))
+static void encode_sse4(const color_t* const cells, uint8_t* const yuv, const size_t count);
+
+/**
+ * @brief Wrap new coordinates around the plane exactly as kernel_walk does.
+ * @see wrap_sse4
+ */
+__attribute__((target("avx2")))
+static __m256i wrap_avx2(const __m256i coord, const __m256i delta, const __m256i size);
+
+/**
+ * @brief Find the new coordinates that leave the plane.
+ * @see leaves_sse4
+ */
+__attribute__((target("avx2")))
+static __m256i leaves_avx2(const __m256i coord, const __m256i size);
+
+/**
+ * @brief Wrap new coordinates around a side that is a power of two.
+ * @see wrap_pow2_sse4
+ */
+__attribute__((target("avx2")))
+static __m256i wrap_pow2_avx2(const __m256i coord, const __m256i mask);
+
+/**
+ * @brief Walk particles 32 at a time with AVX2.
+ * @see walk_scalar
+ */
+__attribute__((target("avx2")))
+static void walk_avx2(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction,
+	uint8_t* const alive,
+	const uint32_t count
+);
+
+/**
+ * @brief Determine whether all 32 particles of a block survived.
+ * @param[in] alive The flags of the block.
+ * @return True if every particle survived, false otherwise.
+ */
+__attribute__((target("avx2")))
+static bool all_alive_avx2(const uint8_t* const alive);
+
+/**
+ * @brief Compact particles in blocks of 32 with AVX2.
+ * @see compact_scalar
+ */
+__attribute__((target("avx2")))
+static randomwalk_result_t compact_avx2(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors
+);
+
+/**
+ * @brief Convert colors eight at a time with AVX2.
+ * @see encode_scalar
+ */
+__attribute__((target("avx2")))
+static void encode_avx2(const color_t* const cells, uint8_t* const yuv, const size_t count);
+
+/**
+ * @brief Wrap new coordinates around the plane exactly as kernel_walk does.
+ * @param[in] coord The new coordinates, modulo 256.
+ * @param[in] delta The changes that produced them.
+ * @param[in] size The side length of the plane along the axis.
+ * @return The wrapped coordinates.
+ */
+__attribute__((target("avx512f,avx512bw")))
+static __m512i wrap_avx512(const __m512i coord, const __m512i delta, const __m512i size);
+
+/**
+ * @brief Find the new coordinates that leave the plane.
+ * @param[in] coord The new coordinates, modulo 256.
+ * @param[in] size The side length of the plane along the axis.
+ * @return A bit set for each coordinate off the plane.
+ */
+__attribute__((target("avx512f,avx512bw")))
+static __mmask64 leaves_avx512(const __m512i coord, const __m512i size);
+
+/**
+ * @brief Wrap new coordinates around a side that is a power of two.
+ * @see wrap_pow2_sse4
+ */
+__attribute__((target("avx512f,avx512bw")))
+static __m512i wrap_pow2_avx512(const __m512i coord, const __m512i mask);
+
+/**
+ * @brief Walk particles 64 at a time with AVX-512.
+ * @see walk_scalar
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void walk_avx512(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction,
+	uint8_t* const alive,
+	const uint32_t count
+);
+
+/**
+ * @brief Determine whether all 64 particles of a block survived.
+ * @param[in] alive The flags of the block.
+ * @return True if every particle survived, false otherwise.
+ */
+__attribute__((target("avx512f,avx512bw")))
+static bool all_alive_avx512(const uint8_t* const alive);
+
+/**
+ * @brief Compact particles in blocks of 64 with AVX-512.
+ * @see compact_scalar
+ */
+__attribute__((target("avx512f,avx512bw")))
+static randomwalk_result_t compact_avx512(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors
+);
+
+/**
+ * @brief Convert colors 16 at a time with AVX-512.
+ * @see encode_scalar
+ */
+__attribute__((target("avx512f,avx512bw")))
+static void encode_avx512(const color_t* const cells, uint8_t* const yuv, const size_t count);
+
+/**
+ * @brief Scramble eight generator states at once exactly as rng_mix does.
+ * @param[in] value The states to scramble.
+ * @return The scrambled states.
+ */
+__attribute__((target("avx512f,avx512bw,avx512dq")))
+static __m512i mix_avx512(__m512i value);
+
+/**
+ * @brief Reduce eight 32-bit words modulo a divisor.
+ *
+ * A word is exact in a double, so multiplying by the reciprocal of the divisor
+ * gives a quotient within one of the true one, which the remainder corrects.
+ *
+ * @param[in] word The words, one in each 64-bit lane.
+ * @param[in] divisor The divisor.
+ * @return The remainders.
+ */
+__attribute__((target("avx512f,avx512bw,avx512dq")))
+static __m512i mod_avx512(const __m512i word, const uint32_t divisor);
+
+/**
+ * @brief Steer eight replicates at a time with AVX-512, one generator in each
+ * 64-bit lane.
+ * @see steer_lanes_scalar
+ */
+__attribute__((target("avx512f,avx512bw,avx512dq")))
+static void steer_lanes_avx512(
+	uint8_t* const direction,
+	const uint8_t* const alive,
+	const uint32_t rows,
+	const uint32_t lanes,
+	const uint8_t prob_dir_change,
+	rng_t* const rngs
+);
+
+#endif // KERNELSET_X86
+
+/**
+ * @brief The kernels of each instruction set; those not built are zeroed.
+ */
+static const kernelset_t KERNELSETS[KERNELSET_COUNT] = {
+	[KERNELSET_SCALAR] = {
+		KERNELSET_SCALAR, "scalar",
+		steer_scalar, steer_lanes_scalar, walk_scalar, compact_scalar, encode_scalar,
+		accumulate_scalar
+	},
+#ifdef KERNELSET_X86
+	[KERNELSET_SSE4] = {
+		KERNELSET_SSE4, "sse4",
+		steer_scalar, steer_lanes_scalar, walk_sse4, compact_sse4, encode_sse4,
+		accumulate_scalar
+	},
+	[KERNELSET_AVX2] = {
+		KERNELSET_AVX2, "avx2",
+		steer_scalar, steer_lanes_scalar, walk_avx2, compact_avx2, encode_avx2,
+		accumulate_scalar
+	},
+	[KERNELSET_AVX512] = {
+		KERNELSET_AVX512, "avx512",
+		steer_scalar, steer_lanes_avx512, walk_avx512, compact_avx512, encode_avx512,
+		accumulate_scalar
+	},
+#endif
+};
+
+/**
+ * @brief The selected kernels.
+ */
+static const kernelset_t* active_kernels = &KERNELSETS[KERNELSET_SCALAR];
+
+/**
+ * @brief Determine whether the CPU supports an instruction set.
+ * @param[in] isa The instruction set.
+ * @return True if it is supported, false otherwise.
+ */
+static bool supported(const kernelset_isa_t isa);
+
+/**
+ * @brief Determine whether two stores hold the same particles in order.
+ * @param[in] expected The first store.
+ * @param[in] actual The second store.
+ * @return True if the particles are the same, false otherwise.
+ */
+static bool stores_equal(
+	const particle_store_t* const expected,
+	const particle_store_t* const actual
+);
+
+/**
+ * @brief Step a seeded scenario with a set and the scalar set side by side.
+ * @param[in] kernels The kernels to check.
+ * @param[in] plane The plane of the scenario.
+ * @return RANDOMWALK_OK if every step matched, RANDOMWALK_FAIL otherwise.
+ */
+static randomwalk_result_t check_steps(
+	const kernelset_t* const kernels,
+	const kernel_plane_t plane
+);
+
+/**
+ * @brief Steer seeded interleaved replicates with a set and the scalar set.
+ * @param[in] kernels The kernels to check.
+ * @param[in] lanes The replicates in a row.
+ * @return RANDOMWALK_OK if the directions and generators matched,
+ * RANDOMWALK_FAIL otherwise.
+ */
+static randomwalk_result_t check_lanes(const kernelset_t* const kernels, const uint32_t lanes);
+
+/**
+ * @brief Encode and accumulate seeded data with a set and the scalar set.
+ * @param[in] kernels The kernels to check.
+ * @return RANDOMWALK_OK if the results matched, RANDOMWALK_FAIL otherwise.
+ */
+static randomwalk_result_t check_encode_accumulate(const kernelset_t* const kernels);
+
+/**
+ * @brief Check every kernel of a set against the scalar set.
+ * @param[in] kernels The kernels to check.
+ * @return RANDOMWALK_OK if the set matched, RANDOMWALK_FAIL otherwise.
+ */
+static randomwalk_result_t check_kernels(const kernelset_t* const kernels);
+
+randomwalk_result_t kernelset_parse(const char* const name, kernelset_isa_t* const isa) {
+	if (!name || !isa)
+		return RANDOMWALK_FAIL;
+	for (uint8_t i = 0; i < KERNELSET_COUNT; i++) {
+		if (!strcmp(name, KERNELSET_NAMES[i])) {
+			*isa = (kernelset_isa_t)i;
+			return RANDOMWALK_OK;
+		}
+	}
+	return RANDOMWALK_FAIL;
+}
+
+randomwalk_result_t kernelset_select(const char* const name) {
+	kernelset_isa_t isa = KERNELSET_SCALAR;
+	if (name) {
+		if (kernelset_parse(name, &isa) != RANDOMWALK_OK || !supported(isa))
+			return RANDOMWALK_FAIL;
+		if (isa != KERNELSET_SCALAR && check_kernels(&KERNELSETS[isa]) != RANDOMWALK_OK)
+			return RANDOMWALK_FAIL;
+		active_kernels = &KERNELSETS[isa];
+		return RANDOMWALK_OK;
+	}
+	// A set failing its check falls back to the next narrowest
+	active_kernels = &KERNELSETS[KERNELSET_SCALAR];
+	for (uint8_t i = KERNELSET_COUNT - 1; i > KERNELSET_SCALAR; i--) {
+		if (supported((kernelset_isa_t)i) && check_kernels(&KERNELSETS[i]) == RANDOMWALK_OK) {
+			active_kernels = &KERNELSETS[i];
+			break;
+		}
+	}
+	return RANDOMWALK_OK;
+}
+
+const kernelset_t* kernelset_active(void) {
+	return active_kernels;
+}
+
+randomwalk_result_t kernelset_step(
+	const kernelset_t* const kernels,
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const kernelset_source_t source
+) {
+	if (!kernels || !kernels->walk || !particles || !plane.width || !plane.height)
+		return RANDOMWALK_FAIL;
+	if (deaths)
+		deaths->count = 0;
+	uint8_t alive[KERNELSET_CHUNK_PARTICLES];
+	uint32_t survivors = 0;
+	for (uint32_t first = 0; first < particles->count; first += KERNELSET_CHUNK_PARTICLES) {
+		const uint32_t count = particles->count - first < KERNELSET_CHUNK_PARTICLES ?
+			particles->count - first : KERNELSET_CHUNK_PARTICLES;
+		kernels->steer(particles->direction + first, particles->id + first, count,
+			plane.prob_dir_change, &source);
+		kernels->walk(plane, particles->x + first, particles->y + first,
+			particles->direction + first, alive, count);
+		if (kernels->compact(particles, deaths, alive, first, count, &survivors) != RANDOMWALK_OK)
+			return RANDOMWALK_FAIL;
+	}
+	particles->count = survivors;
+	return survivors ? RANDOMWALK_OK : RANDOMWALK_DONE;
+}
+
+static void steer_scalar(
+	uint8_t* const direction,
+	const uint32_t* const id,
+	const uint32_t count,
+	const uint8_t prob_dir_change,
+	const kernelset_source_t* const source
+) {
+	for (uint32_t i = 0; i < count; i++) {
+		if (source->buffer) {
+			if (rng_word_uint8(rngbuf_next(source->buffer), 1, 100) <= prob_dir_change)
+				kernel_turn(&direction[i],
+					rng_word_uint8(rngbuf_next(source->buffer), 0, DIRECTION_COUNT - 2));
+		} else if (source->rng) {
+			kernel_steer(prob_dir_change, &direction[i], source->rng);
+		} else {
+			rng_t counter;
+			rng_seed_counter(&counter, source->seed, id[i], source->step);
+			kernel_steer(prob_dir_change, &direction[i], &counter);
+		}
+	}
+}
+
+static void steer_lane_range(
+	uint8_t* const direction,
+	const uint8_t* const alive,
+	const uint32_t rows,
+	const uint32_t lanes,
+	const uint32_t first,
+	const uint8_t prob_dir_change,
+	rng_t* const rngs
+) {
+	for (uint32_t row = 0; row < rows; row++)
+		for (uint32_t lane = first; lane < lanes; lane++)
+			if (alive[(size_t)row * lanes + lane])
+				kernel_steer(prob_dir_change, &direction[(size_t)row * lanes + lane], &rngs[lane]);
+}
+
+static void steer_lanes_scalar(
+	uint8_t* const direction,
+	const uint8_t* const alive,
+	const uint32_t rows,
+	const uint32_t lanes,
+	const uint8_t prob_dir_change,
+	rng_t* const rngs
+) {
+	steer_lane_range(direction, alive, rows, lanes, 0, prob_dir_change, rngs);
+}
+
+static void walk_scalar(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction,
+	uint8_t* const alive,
+	const uint32_t count
+) {
+	if (kernel_plane_pow2(plane)) {
+		for (uint32_t i = 0; i < count; i++)
+			alive[i] = kernel_walk_pow2(plane, &x[i], &y[i], direction[i]) ? 0xFF : 0;
+		return;
+	}
+	for (uint32_t i = 0; i < count; i++)
+		alive[i] = kernel_walk(plane, &x[i], &y[i], direction[i]) ? 0xFF : 0;
+}
+
+static void move_range(
+	particle_store_t* const particles,
+	const uint32_t to,
+	const uint32_t from,
+	const uint32_t count
+) {
+	memmove(particles->id + to, particles->id + from, count * sizeof(uint32_t));
+	memmove(particles->x + to, particles->x + from, count);
+	memmove(particles->y + to, particles->y + from, count);
+	memmove(particles->direction + to, particles->direction + from, count);
+	memmove(particles->color + to, particles->color + from, count * sizeof(color_t));
+}
+
+static randomwalk_result_t compact_blocks(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors,
+	const uint32_t block,
+	bool (*all_alive)(const uint8_t* const alive)
+) {
+	uint32_t kept = *survivors;
+	for (uint32_t i = 0; i < count;) {
+		const bool whole_block = block && count - i >= block;
+		if (whole_block && all_alive(alive + i)) {
+			if (kept != first + i)
+				move_range(particles, kept, first + i, block);
+			kept += block;
+			i += block;
+			continue;
+		}
+		for (const uint32_t end = whole_block ? i + block : count; i < end; i++) {
+			const uint32_t index = first + i;
+			if (alive[i]) {
+				if (kept != index)
+					move_range(particles, kept, index, 1);
+				kept++;
+			} else if (deaths && particle_store_push(
+				deaths,
+				particles->id[index],
+				(coordinate_t){ particles->x[index], particles->y[index] },
+				(direction_t)particles->direction[index],
+				particles->color[index]
+			) != RANDOMWALK_OK) {
+				return RANDOMWALK_FAIL;
+			}
+		}
+	}
+	*survivors = kept;
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t compact_scalar(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors
+) {
+	return compact_blocks(particles, deaths, alive, first, count, survivors, 0, NULL);
+}
+
+static void encode_scalar(const color_t* const cells, uint8_t* const yuv, const size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		// Fixed-point coefficients scaled by 2^16
+		const int32_t r = cells[i].r, g = cells[i].g, b = cells[i].b;
+		yuv[i * 3] = (uint8_t)((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+		yuv[i * 3 + 1] = (uint8_t)(((-11059 * r - 21709 * g + 32768 * b + 32768) >> 16) + 128);
+		yuv[i * 3 + 2] = (uint8_t)(((32768 * r - 27439 * g - 5329 * b + 32768) >> 16) + 128);
+	}
+}
+
+static void accumulate_scalar(
+	uint64_t* const visits,
+	const particle_store_t* const particles,
+	const uint8_t width
+) {
+	for (uint32_t i = 0; i < particles->count; i++)
+		visits[particles->y[i] * width + particles->x[i]]++;
+}
+
+#ifdef KERNELSET_X86
+
+__attribute__((target("sse4.1")))
+static __m128i wrap_sse4(const __m128i coord, const __m128i delta, const __m128i size) {
+	// At or below 0, including a particle staying on 0, wraps to the far edge
+	const __m128i ones = _mm_set1_epi8(-1);
+	const __m128i low = _mm_or_si128(
+		_mm_cmpeq_epi8(coord, _mm_setzero_si128()),
+		_mm_and_si128(_mm_cmpeq_epi8(coord, ones), _mm_cmpeq_epi8(delta, ones))
+	);
+	const __m128i high = _mm_andnot_si128(low, _mm_cmpeq_epi8(coord, size));
+	return _mm_blendv_epi8(_mm_andnot_si128(high, coord), _mm_add_epi8(size, ones), low);
+}
+
+__attribute__((target("sse4.1")))
+static __m128i wrap_pow2_sse4(const __m128i coord, const __m128i mask) {
+	// Sides are at most 128, so only -1 and 0 go negative when lowered by one
+	const __m128i lowered = _mm_sub_epi8(coord, _mm_set1_epi8(1));
+	return _mm_blendv_epi8(_mm_and_si128(coord, mask), mask, lowered);
+}
+
+__attribute__((target("sse4.1")))
+static __m128i leaves_sse4(const __m128i coord, const __m128i size) {
+	return _mm_or_si128(
+		_mm_cmpeq_epi8(coord, _mm_set1_epi8(-1)),
+		_mm_cmpeq_epi8(coord, size)
+	);
+}
+
+__attribute__((target("sse4.1")))
+static void walk_sse4(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction,
+	uint8_t* const alive,
+	const uint32_t count
+) {
+	const __m128i delta_x = _mm_setr_epi8(0, 1, 1, 1, 0, -1, -1, -1, 0, 1, 1, 1, 0, -1, -1, -1);
+	const __m128i delta_y = _mm_setr_epi8(-1, -1, 0, 1, 1, 1, 0, -1, -1, -1, 0, 1, 1, 1, 0, -1);
+	const __m128i width = _mm_set1_epi8((char)plane.width);
+	const __m128i height = _mm_set1_epi8((char)plane.height);
+	const __m128i ones = _mm_set1_epi8(-1);
+	const __m128i mask_x = _mm_add_epi8(width, ones), mask_y = _mm_add_epi8(height, ones);
+	const bool pow2 = kernel_plane_pow2(plane);
+	uint32_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		const __m128i d = _mm_loadu_si128((const __m128i*)(direction + i));
+		const __m128i dx = _mm_shuffle_epi8(delta_x, d);
+		const __m128i dy = _mm_shuffle_epi8(delta_y, d);
+		const __m128i old_x = _mm_loadu_si128((const __m128i*)(x + i));
+		const __m128i old_y = _mm_loadu_si128((const __m128i*)(y + i));
+		const __m128i new_x = _mm_add_epi8(old_x, dx);
+		const __m128i new_y = _mm_add_epi8(old_y, dy);
+		if (pow2) {
+			_mm_storeu_si128((__m128i*)(x + i), wrap_pow2_sse4(new_x, mask_x));
+			_mm_storeu_si128((__m128i*)(y + i), wrap_pow2_sse4(new_y, mask_y));
+			_mm_storeu_si128((__m128i*)(alive + i), ones);
+			continue;
+		}
+		if (plane.wrap) {
+			_mm_storeu_si128((__m128i*)(x + i), wrap_sse4(new_x, dx, width));
+			_mm_storeu_si128((__m128i*)(y + i), wrap_sse4(new_y, dy, height));
+			_mm_storeu_si128((__m128i*)(alive + i), ones);
+			continue;
+		}
+		const __m128i kept = _mm_andnot_si128(
+			_mm_or_si128(leaves_sse4(new_x, width), leaves_sse4(new_y, height)),
+			ones
+		);
+		_mm_storeu_si128((__m128i*)(x + i), _mm_blendv_epi8(old_x, new_x, kept));
+		_mm_storeu_si128((__m128i*)(y + i), _mm_blendv_epi8(old_y, new_y, kept));
+		_mm_storeu_si128((__m128i*)(alive + i), kept);
+	}
+	walk_scalar(plane, x + i, y + i, direction + i, alive + i, count - i);
+}
+
+__attribute__((target("sse4.1")))
+static bool all_alive_sse4(const uint8_t* const alive) {
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)alive)) == 0xFFFF;
+}
+
+__attribute__((target("sse4.1")))
+static randomwalk_result_t compact_sse4(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors
+) {
+	return compact_blocks(particles, deaths, alive, first, count, survivors, 16, all_alive_sse4);
+}
+
+__attribute__((target("sse4.1")))
+static __m128i load_rgb_sse4(const color_t* const cells) {
+	const __m128i order = _mm_setr_epi8(0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11, -1, -1, -1, -1);
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)cells), order);
+}
+
+__attribute__((target("sse4.1")))
+static void store_yuv_sse4(uint8_t* const yuv, const __m128i y, const __m128i u, const __m128i v) {
+	// Truncated to a byte as the scalar conversion casts
+	const __m128i byte = _mm_set1_epi32(0xFF);
+	const __m128i order = _mm_setr_epi8(0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1);
+	const __m128i packed = _mm_packus_epi16(
+		_mm_packus_epi32(_mm_and_si128(y, byte), _mm_and_si128(u, byte)),
+		_mm_packus_epi32(_mm_and_si128(v, byte), _mm_setzero_si128())
+	);
+	const __m128i interleaved = _mm_shuffle_epi8(packed, order);
+	const uint32_t last = (uint32_t)_mm_extract_epi32(interleaved, 2);
+	_mm_storel_epi64((__m128i*)yuv, interleaved);
+	memcpy(yuv + 8, &last, sizeof(last));
+}
+
+__attribute__((target("sse4.1")))
+static void encode_sse4(const color_t* const cells, uint8_t* const yuv, const size_t count) {
+	const __m128i half = _mm_set1_epi32(32768), offset = _mm_set1_epi32(128);
+	size_t i = 0;
+	for (; i + 6 <= count; i += 4) {
+		const __m128i rgb = load_rgb_sse4(cells + i);
+		const __m128i r = _mm_cvtepu8_epi32(rgb);
+		const __m128i g = _mm_cvtepu8_epi32(_mm_srli_si128(rgb, 4));
+		const __m128i b = _mm_cvtepu8_epi32(_mm_srli_si128(rgb, 8));
+		const __m128i y = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_add_epi32(
+			_mm_mullo_epi32(r, _mm_set1_epi32(19595)),
+			_mm_mullo_epi32(g, _mm_set1_epi32(38470))),
+			_mm_mullo_epi32(b, _mm_set1_epi32(7471))), half), 16);
+		const __m128i u = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_add_epi32(
+			_mm_mullo_epi32(r, _mm_set1_epi32(-11059)),
+			_mm_mullo_epi32(g, _mm_set1_epi32(-21709))),
+			_mm_mullo_epi32(b, _mm_set1_epi32(32768))), half), 16), offset);
+		const __m128i v = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_add_epi32(
+			_mm_mullo_epi32(r, _mm_set1_epi32(32768)),
+			_mm_mullo_epi32(g, _mm_set1_epi32(-27439))),
+			_mm_mullo_epi32(b, _mm_set1_epi32(-5329))), half), 16), offset);
+		store_yuv_sse4(yuv + i * 3, y, u, v);
+	}
+	encode_scalar(cells + i, yuv + i * 3, count - i);
+}
+
+__attribute__((target("avx2")))
+static __m256i wrap_avx2(const __m256i coord, const __m256i delta, const __m256i size) {
+	const __m256i ones = _mm256_set1_epi8(-1);
+	const __m256i low = _mm256_or_si256(
+		_mm256_cmpeq_epi8(coord, _mm256_setzero_si256()),
+		_mm256_and_si256(_mm256_cmpeq_epi8(coord, ones), _mm256_cmpeq_epi8(delta, ones))
+	);
+	const __m256i high = _mm256_andnot_si256(low, _mm256_cmpeq_epi8(coord, size));
+	return _mm256_blendv_epi8(_mm256_andnot_si256(high, coord), _mm256_add_epi8(size, ones), low);
+}
+
+__attribute__((target("avx2")))
+static __m256i wrap_pow2_avx2(const __m256i coord, const __m256i mask) {
+	const __m256i lowered = _mm256_sub_epi8(coord, _mm256_set1_epi8(1));
+	return _mm256_blendv_epi8(_mm256_and_si256(coord, mask), mask, lowered);
+}
+
+__attribute__((target("avx2")))
+static __m256i leaves_avx2(const __m256i coord, const __m256i size) {
+	return _mm256_or_si256(
+		_mm256_cmpeq_epi8(coord, _mm256_set1_epi8(-1)),
+		_mm256_cmpeq_epi8(coord, size)
+	);
+}
+
+__attribute__((target("avx2")))
+static void walk_avx2(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction,
+	uint8_t* const alive,
+	const uint32_t count
+) {
+	// Shuffles look up within each 128-bit lane, so both lanes hold the table
+	const __m256i delta_x = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8(0, 1, 1, 1, 0, -1, -1, -1, 0, 1, 1, 1, 0, -1, -1, -1));
+	const __m256i delta_y = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8(-1, -1, 0, 1, 1, 1, 0, -1, -1, -1, 0, 1, 1, 1, 0, -1));
+	const __m256i width = _mm256_set1_epi8((char)plane.width);
+	const __m256i height = _mm256_set1_epi8((char)plane.height);
+	const __m256i ones = _mm256_set1_epi8(-1);
+	const __m256i mask_x = _mm256_add_epi8(width, ones), mask_y = _mm256_add_epi8(height, ones);
+	const bool pow2 = kernel_plane_pow2(plane);
+	uint32_t i = 0;
+	for (; i + 32 <= count; i += 32) {
+		const __m256i d = _mm256_loadu_si256((const __m256i*)(direction + i));
+		const __m256i dx = _mm256_shuffle_epi8(delta_x, d);
+		const __m256i dy = _mm256_shuffle_epi8(delta_y, d);
+		const __m256i old_x = _mm256_loadu_si256((const __m256i*)(x + i));
+		const __m256i old_y = _mm256_loadu_si256((const __m256i*)(y + i));
+		const __m256i new_x = _mm256_add_epi8(old_x, dx);
+		const __m256i new_y = _mm256_add_epi8(old_y, dy);
+		if (pow2) {
+			_mm256_storeu_si256((__m256i*)(x + i), wrap_pow2_avx2(new_x, mask_x));
+			_mm256_storeu_si256((__m256i*)(y + i), wrap_pow2_avx2(new_y, mask_y));
+			_mm256_storeu_si256((__m256i*)(alive + i), ones);
+			continue;
+		}
+		if (plane.wrap) {
+			_mm256_storeu_si256((__m256i*)(x + i), wrap_avx2(new_x, dx, width));
+			_mm256_storeu_si256((__m256i*)(y + i), wrap_avx2(new_y, dy, height));
+			_mm256_storeu_si256((__m256i*)(alive + i), ones);
+			continue;
+		}
+		const __m256i kept = _mm256_andnot_si256(
+			_mm256_or_si256(leaves_avx2(new_x, width), leaves_avx2(new_y, height)),
+			ones
+		);
+		_mm256_storeu_si256((__m256i*)(x + i), _mm256_blendv_epi8(old_x, new_x, kept));
+		_mm256_storeu_si256((__m256i*)(y + i), _mm256_blendv_epi8(old_y, new_y, kept));
+		_mm256_storeu_si256((__m256i*)(alive + i), kept);
+	}
+	walk_scalar(plane, x + i, y + i, direction + i, alive + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static bool all_alive_avx2(const uint8_t* const alive) {
+	return _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)alive)) == -1;
+}
+
+__attribute__((target("avx2")))
+static randomwalk_result_t compact_avx2(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors
+) {
+	return compact_blocks(particles, deaths, alive, first, count, survivors, 32, all_alive_avx2);
+}
+
+__attribute__((target("avx2")))
+static void encode_avx2(const color_t* const cells, uint8_t* const yuv, const size_t count) {
+	const __m256i half = _mm256_set1_epi32(32768), offset = _mm256_set1_epi32(128);
+	size_t i = 0;
+	for (; i + 10 <= count; i += 8) {
+		const __m128i first = load_rgb_sse4(cells + i);
+		const __m128i second = load_rgb_sse4(cells + i + 4);
+		// Red then green of all eight colors, and blue
+		const __m128i red_green = _mm_unpacklo_epi32(first, second);
+		const __m128i blue = _mm_unpackhi_epi32(first, second);
+		const __m256i r = _mm256_cvtepu8_epi32(red_green);
+		const __m256i g = _mm256_cvtepu8_epi32(_mm_srli_si128(red_green, 8));
+		const __m256i b = _mm256_cvtepu8_epi32(blue);
+		const __m256i y = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(
+			_mm256_mullo_epi32(r, _mm256_set1_epi32(19595)),
+			_mm256_mullo_epi32(g, _mm256_set1_epi32(38470))),
+			_mm256_mullo_epi32(b, _mm256_set1_epi32(7471))), half), 16);
+		const __m256i u = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(
+			_mm256_mullo_epi32(r, _mm256_set1_epi32(-11059)),
+			_mm256_mullo_epi32(g, _mm256_set1_epi32(-21709))),
+			_mm256_mullo_epi32(b, _mm256_set1_epi32(32768))), half), 16), offset);
+		const __m256i v = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(
+			_mm256_mullo_epi32(r, _mm256_set1_epi32(32768)),
+			_mm256_mullo_epi32(g, _mm256_set1_epi32(-27439))),
+			_mm256_mullo_epi32(b, _mm256_set1_epi32(-5329))), half), 16), offset);
+		store_yuv_sse4(yuv + i * 3, _mm256_castsi256_si128(y),
+			_mm256_castsi256_si128(u), _mm256_castsi256_si128(v));
+		store_yuv_sse4(yuv + i * 3 + 12, _mm256_extracti128_si256(y, 1),
+			_mm256_extracti128_si256(u, 1), _mm256_extracti128_si256(v, 1));
+	}
+	encode_scalar(cells + i, yuv + i * 3, count - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static __m512i wrap_avx512(const __m512i coord, const __m512i delta, const __m512i size) {
+	const __m512i ones = _mm512_set1_epi8(-1);
+	const __mmask64 low = _mm512_cmpeq_epi8_mask(coord, _mm512_setzero_si512()) |
+		(_mm512_cmpeq_epi8_mask(coord, ones) & _mm512_cmpeq_epi8_mask(delta, ones));
+	const __mmask64 high = ~low & _mm512_cmpeq_epi8_mask(coord, size);
+	return _mm512_mask_blend_epi8(
+		low,
+		_mm512_mask_blend_epi8(high, coord, _mm512_setzero_si512()),
+		_mm512_add_epi8(size, ones)
+	);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static __m512i wrap_pow2_avx512(const __m512i coord, const __m512i mask) {
+	const __m512i lowered = _mm512_sub_epi8(coord, _mm512_set1_epi8(1));
+	return _mm512_mask_blend_epi8(_mm512_movepi8_mask(lowered), _mm512_and_si512(coord, mask), mask);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static __mmask64 leaves_avx512(const __m512i coord, const __m512i size) {
+	return _mm512_cmpeq_epi8_mask(coord, _mm512_set1_epi8(-1)) |
+		_mm512_cmpeq_epi8_mask(coord, size);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void walk_avx512(
+	const kernel_plane_t plane,
+	uint8_t* const x,
+	uint8_t* const y,
+	const uint8_t* const direction,
+	uint8_t* const alive,
+	const uint32_t count
+) {
+	const __m512i delta_x = _mm512_broadcast_i32x4(
+		_mm_setr_epi8(0, 1, 1, 1, 0, -1, -1, -1, 0, 1, 1, 1, 0, -1, -1, -1));
+	const __m512i delta_y = _mm512_broadcast_i32x4(
+		_mm_setr_epi8(-1, -1, 0, 1, 1, 1, 0, -1, -1, -1, 0, 1, 1, 1, 0, -1));
+	const __m512i width = _mm512_set1_epi8((char)plane.width);
+	const __m512i height = _mm512_set1_epi8((char)plane.height);
+	const __m512i ones = _mm512_set1_epi8(-1);
+	const __m512i mask_x = _mm512_add_epi8(width, ones), mask_y = _mm512_add_epi8(height, ones);
+	const bool pow2 = kernel_plane_pow2(plane);
+	uint32_t i = 0;
+	for (; i + 64 <= count; i += 64) {
+		const __m512i d = _mm512_loadu_si512(direction + i);
+		const __m512i dx = _mm512_shuffle_epi8(delta_x, d);
+		const __m512i dy = _mm512_shuffle_epi8(delta_y, d);
+		const __m512i old_x = _mm512_loadu_si512(x + i);
+		const __m512i old_y = _mm512_loadu_si512(y + i);
+		const __m512i new_x = _mm512_add_epi8(old_x, dx);
+		const __m512i new_y = _mm512_add_epi8(old_y, dy);
+		if (pow2) {
+			_mm512_storeu_si512(x + i, wrap_pow2_avx512(new_x, mask_x));
+			_mm512_storeu_si512(y + i, wrap_pow2_avx512(new_y, mask_y));
+			_mm512_storeu_si512(alive + i, ones);
+			continue;
+		}
+		if (plane.wrap) {
+			_mm512_storeu_si512(x + i, wrap_avx512(new_x, dx, width));
+			_mm512_storeu_si512(y + i, wrap_avx512(new_y, dy, height));
+			_mm512_storeu_si512(alive + i, ones);
+			continue;
+		}
+		const __mmask64 kept = ~(leaves_avx512(new_x, width) | leaves_avx512(new_y, height));
+		_mm512_storeu_si512(x + i, _mm512_mask_blend_epi8(kept, old_x, new_x));
+		_mm512_storeu_si512(y + i, _mm512_mask_blend_epi8(kept, old_y, new_y));
+		_mm512_storeu_si512(alive + i, _mm512_movm_epi8(kept));
+	}
+	walk_scalar(plane, x + i, y + i, direction + i, alive + i, count - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static bool all_alive_avx512(const uint8_t* const alive) {
+	return _mm512_movepi8_mask(_mm512_loadu_si512(alive)) == UINT64_MAX;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static randomwalk_result_t compact_avx512(
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const uint8_t* const alive,
+	const uint32_t first,
+	const uint32_t count,
+	uint32_t* const survivors
+) {
+	return compact_blocks(particles, deaths, alive, first, count, survivors, 64, all_alive_avx512);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void encode_avx512(const color_t* const cells, uint8_t* const yuv, const size_t count) {
+	const __m512i half = _mm512_set1_epi32(32768), offset = _mm512_set1_epi32(128);
+	size_t i = 0;
+	for (; i + 18 <= count; i += 16) {
+		const __m128i a = load_rgb_sse4(cells + i), b = load_rgb_sse4(cells + i + 4);
+		const __m128i c = load_rgb_sse4(cells + i + 8), d = load_rgb_sse4(cells + i + 12);
+		const __m128i ab_low = _mm_unpacklo_epi32(a, b), cd_low = _mm_unpacklo_epi32(c, d);
+		const __m128i ab_high = _mm_unpackhi_epi32(a, b), cd_high = _mm_unpackhi_epi32(c, d);
+		const __m512i red = _mm512_cvtepu8_epi32(_mm_unpacklo_epi64(ab_low, cd_low));
+		const __m512i green = _mm512_cvtepu8_epi32(_mm_unpackhi_epi64(ab_low, cd_low));
+		const __m512i blue = _mm512_cvtepu8_epi32(_mm_unpacklo_epi64(ab_high, cd_high));
+		const __m512i y = _mm512_srai_epi32(_mm512_add_epi32(_mm512_add_epi32(_mm512_add_epi32(
+			_mm512_mullo_epi32(red, _mm512_set1_epi32(19595)),
+			_mm512_mullo_epi32(green, _mm512_set1_epi32(38470))),
+			_mm512_mullo_epi32(blue, _mm512_set1_epi32(7471))), half), 16);
+		const __m512i u = _mm512_add_epi32(_mm512_srai_epi32(_mm512_add_epi32(_mm512_add_epi32(_mm512_add_epi32(
+			_mm512_mullo_epi32(red, _mm512_set1_epi32(-11059)),
+			_mm512_mullo_epi32(green, _mm512_set1_epi32(-21709))),
+			_mm512_mullo_epi32(blue, _mm512_set1_epi32(32768))), half), 16), offset);
+		const __m512i v = _mm512_add_epi32(_mm512_srai_epi32(_mm512_add_epi32(_mm512_add_epi32(_mm512_add_epi32(
+			_mm512_mullo_epi32(red, _mm512_set1_epi32(32768)),
+			_mm512_mullo_epi32(green, _mm512_set1_epi32(-27439))),
+			_mm512_mullo_epi32(blue, _mm512_set1_epi32(-5329))), half), 16), offset);
+		store_yuv_sse4(yuv + i * 3, _mm512_extracti32x4_epi32(y, 0),
+			_mm512_extracti32x4_epi32(u, 0), _mm512_extracti32x4_epi32(v, 0));
+		store_yuv_sse4(yuv + i * 3 + 12, _mm512_extracti32x4_epi32(y, 1),
+			_mm512_extracti32x4_epi32(u, 1), _mm512_extracti32x4_epi32(v, 1));
+		store_yuv_sse4(yuv + i * 3 + 24, _mm512_extracti32x4_epi32(y, 2),
+			_mm512_extracti32x4_epi32(u, 2), _mm512_extracti32x4_epi32(v, 2));
+		store_yuv_sse4(yuv + i * 3 + 36, _mm512_extracti32x4_epi32(y, 3),
+			_mm512_extracti32x4_epi32(u, 3), _mm512_extracti32x4_epi32(v, 3));
+	}
+	encode_scalar(cells + i, yuv + i * 3, count - i);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512dq")))
+static __m512i mix_avx512(__m512i value) {
+	value = _mm512_mullo_epi64(_mm512_xor_si512(value, _mm512_srli_epi64(value, 30)),
+		_mm512_set1_epi64((long long)UINT64_C(0xBF58476D1CE4E5B9)));
+	value = _mm512_mullo_epi64(_mm512_xor_si512(value, _mm512_srli_epi64(value, 27)),
+		_mm512_set1_epi64((long long)UINT64_C(0x94D049BB133111EB)));
+	return _mm512_xor_si512(value, _mm512_srli_epi64(value, 31));
+}
+
+__attribute__((target("avx512f,avx512bw,avx512dq")))
+static __m512i mod_avx512(const __m512i word, const uint32_t divisor) {
+	const __m512i quotient = _mm512_cvttpd_epi64(
+		_mm512_mul_pd(_mm512_cvtepu64_pd(word), _mm512_set1_pd(1.0 / divisor)));
+	const __m512i size = _mm512_set1_epi64(divisor);
+	const __m512i remainder = _mm512_sub_epi64(word, _mm512_mullo_epi64(quotient, size));
+	// The rounded reciprocal leaves the quotient at most one off either way
+	const __m512i raised = _mm512_mask_add_epi64(remainder,
+		_mm512_cmplt_epi64_mask(remainder, _mm512_setzero_si512()), remainder, size);
+	return _mm512_mask_sub_epi64(raised, _mm512_cmpge_epi64_mask(raised, size), raised, size);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512dq")))
+static void steer_lanes_avx512(
+	uint8_t* const direction,
+	const uint8_t* const alive,
+	const uint32_t rows,
+	const uint32_t lanes,
+	const uint8_t prob_dir_change,
+	rng_t* const rngs
+) {
+	_Static_assert(sizeof(rng_t) == sizeof(uint64_t), "Generators are loaded as 64-bit states");
+	const __m512i gamma = _mm512_set1_epi64((long long)RNG_GOLDEN_GAMMA);
+	const __m512i prob = _mm512_set1_epi64(prob_dir_change), one = _mm512_set1_epi64(1);
+	const uint32_t vector_lanes = lanes / 8 * 8;
+	// Replicates draw independently, so each vector of lanes runs every row
+	for (uint32_t lane = 0; lane < vector_lanes; lane += 8) {
+		__m512i state = _mm512_loadu_si512(&rngs[lane]);
+		for (uint32_t row = 0; row < rows; row++) {
+			const size_t first = (size_t)row * lanes + lane;
+			const __m512i flags = _mm512_cvtepu8_epi64(_mm_loadl_epi64((const __m128i*)(alive + first)));
+			const __mmask8 live = _mm512_test_epi64_mask(flags, flags);
+			if (!live)
+				continue;
+			// A roll of word % 101 + 1 turns if at most the probability
+			state = _mm512_mask_add_epi64(state, live, state, gamma);
+			const __m512i roll = mod_avx512(_mm512_srli_epi64(mix_avx512(state), 32), 101);
+			const __mmask8 turn = _mm512_mask_cmplt_epu64_mask(live, roll, prob);
+			if (!turn)
+				continue;
+			state = _mm512_mask_add_epi64(state, turn, state, gamma);
+			const __m512i other = mod_avx512(_mm512_srli_epi64(mix_avx512(state), 32), DIRECTION_COUNT - 1);
+			const __m512i current = _mm512_cvtepu8_epi64(_mm_loadl_epi64((const __m128i*)(direction + first)));
+			const __m512i turned = _mm512_mask_add_epi64(other,
+				_mm512_cmpge_epu64_mask(other, current), other, one);
+			_mm_storel_epi64((__m128i*)(direction + first),
+				_mm512_cvtepi64_epi8(_mm512_mask_blend_epi64(turn, current, turned)));
+		}
+		_mm512_storeu_si512(&rngs[lane], state);
+	}
+	steer_lane_range(direction, alive, rows, lanes, vector_lanes, prob_dir_change, rngs);
+}
+
+#endif // KERNELSET_X86
+
+static bool supported(const kernelset_isa_t isa) {
+#ifdef KERNELSET_X86
+	__builtin_cpu_init();
+	switch (isa) {
+		case KERNELSET_SSE4:
+			return __builtin_cpu_supports("sse4.1");
+		case KERNELSET_AVX2:
+			return __builtin_cpu_supports("avx2");
+		case KERNELSET_AVX512:
+			return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+				__builtin_cpu_supports("avx512dq");
+		default:
+			return isa == KERNELSET_SCALAR;
+	}
+#else
+	return isa == KERNELSET_SCALAR;
+#endif
+}
+
+static bool stores_equal(
+	const particle_store_t* const expected,
+	const particle_store_t* const actual
+) {
+	const uint32_t count = expected->count;
+	return count == actual->count &&
+		!memcmp(expected->id, actual->id, count * sizeof(uint32_t)) &&
+		!memcmp(expected->x, actual->x, count) &&
+		!memcmp(expected->y, actual->y, count) &&
+		!memcmp(expected->direction, actual->direction, count) &&
+		!memcmp(expected->color, actual->color, count * sizeof(color_t));
+}
+
+static randomwalk_result_t check_steps(
+	const kernelset_t* const kernels,
+	const kernel_plane_t plane
+) {
+	particle_store_t stores[4] = { 0 }; // Expected and actual particles, then deaths
+	randomwalk_result_t result = RANDOMWALK_OK;
+	for (uint8_t i = 0; result == RANDOMWALK_OK && i < 4; i++)
+		result = particle_store_create(&stores[i], CHECK_PARTICLES);
+	rng_t rng;
+	rng_seed(&rng, CHECK_SEED);
+	for (uint32_t i = 0; result == RANDOMWALK_OK && i < CHECK_PARTICLES; i++) {
+		const coordinate_t coord = {
+			rng_uint8(&rng, 0, plane.width - 1),
+			rng_uint8(&rng, 0, plane.height - 1)
+		};
+		const direction_t direction = (direction_t)rng_uint8(&rng, 0, DIRECTION_COUNT - 1);
+		const color_t color = { (uint8_t)i, (uint8_t)(i >> 8), (uint8_t)(i >> 16) };
+		particle_store_push(&stores[0], i, coord, direction, color);
+		result = particle_store_push(&stores[1], i, coord, direction, color);
+	}
+	rng_t expected_rng = rng, actual_rng = rng;
+	for (uint32_t step = 0; result == RANDOMWALK_OK && step < CHECK_STEPS; step++) {
+		const randomwalk_result_t expected = kernelset_step(&KERNELSETS[KERNELSET_SCALAR],
+			&stores[0], &stores[2], plane, (kernelset_source_t){ .rng = &expected_rng });
+		const randomwalk_result_t actual = kernelset_step(kernels,
+			&stores[1], &stores[3], plane, (kernelset_source_t){ .rng = &actual_rng });
+		if (expected != actual || expected == RANDOMWALK_FAIL ||
+			!stores_equal(&stores[0], &stores[1]) || !stores_equal(&stores[2], &stores[3]))
+			result = RANDOMWALK_FAIL;
+		else if (expected == RANDOMWALK_DONE)
+			break;
+	}
+	for (uint8_t i = 0; i < 4; i++)
+		particle_store_destroy(&stores[i]);
+	return result;
+}
+
+static randomwalk_result_t check_lanes(const kernelset_t* const kernels, const uint32_t lanes) {
+	const uint32_t rows = CHECK_PARTICLES / lanes;
+	const size_t count = (size_t)rows * lanes;
+	uint8_t* const expected = (uint8_t*)malloc(count);
+	uint8_t* const actual = (uint8_t*)malloc(count);
+	uint8_t* const alive = (uint8_t*)malloc(count);
+	rng_t* const expected_rngs = (rng_t*)malloc(lanes * sizeof(rng_t));
+	rng_t* const actual_rngs = (rng_t*)malloc(lanes * sizeof(rng_t));
+	randomwalk_result_t result = expected && actual && alive && expected_rngs && actual_rngs ?
+		RANDOMWALK_OK : RANDOMWALK_FAIL;
+	rng_t rng;
+	rng_seed(&rng, CHECK_SEED);
+	for (uint32_t i = 0; result == RANDOMWALK_OK && i < lanes; i++)
+		rng_seed(&expected_rngs[i], rng_derive(CHECK_SEED, i));
+	for (size_t i = 0; result == RANDOMWALK_OK && i < count; i++) {
+		expected[i] = rng_uint8(&rng, 0, DIRECTION_COUNT - 1);
+		// Whole lanes die too, leaving vectors with no particle to steer
+		alive[i] = i % lanes == 3 || !rng_uint8(&rng, 0, 3) ? 0 : 0xFF;
+	}
+	if (result == RANDOMWALK_OK) {
+		memcpy(actual, expected, count);
+		memcpy(actual_rngs, expected_rngs, lanes * sizeof(rng_t));
+	}
+	for (uint32_t step = 0; result == RANDOMWALK_OK && step < CHECK_STEPS; step++) {
+		steer_lanes_scalar(expected, alive, rows, lanes, 60, expected_rngs);
+		kernels->steer_lanes(actual, alive, rows, lanes, 60, actual_rngs);
+		if (memcmp(expected, actual, count) ||
+			memcmp(expected_rngs, actual_rngs, lanes * sizeof(rng_t)))
+			result = RANDOMWALK_FAIL;
+	}
+	free(expected);
+	free(actual);
+	free(alive);
+	free(expected_rngs);
+	free(actual_rngs);
+	return result;
+}
+
+static randomwalk_result_t check_encode_accumulate(const kernelset_t* const kernels) {
+	// The extremes first, where the chroma of pure blue and red overflows a byte
+	color_t cells[CHECK_COLORS] = {
+		{ 0, 0, 0 }, { 255, 255, 255 }, { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 }
+	};
+	rng_t rng;
+	rng_seed(&rng, CHECK_SEED);
+	for (uint32_t i = 5; i < CHECK_COLORS; i++)
+		cells[i] = (color_t){
+			rng_uint8(&rng, 0, UINT8_MAX),
+			rng_uint8(&rng, 0, UINT8_MAX),
+			rng_uint8(&rng, 0, UINT8_MAX)
+		};
+	uint8_t expected[CHECK_COLORS * 3], actual[CHECK_COLORS * 3];
+	encode_scalar(cells, expected, CHECK_COLORS);
+	kernels->encode(cells, actual, CHECK_COLORS);
+	if (memcmp(expected, actual, sizeof(expected)))
+		return RANDOMWALK_FAIL;
+	const uint8_t width = 61, height = 37;
+	particle_store_t particles;
+	if (particle_store_create(&particles, CHECK_PARTICLES) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	for (uint32_t i = 0; i < CHECK_PARTICLES; i++) {
+		const coordinate_t coord = { rng_uint8(&rng, 0, width - 1), rng_uint8(&rng, 0, height - 1) };
+		particle_store_push(&particles, i, coord, DIRECTION_NORTH, cells[0]);
+	}
+	uint64_t* const expected_visits = (uint64_t*)calloc((size_t)width * height, sizeof(uint64_t));
+	uint64_t* const actual_visits = (uint64_t*)calloc((size_t)width * height, sizeof(uint64_t));
+	randomwalk_result_t result = expected_visits && actual_visits ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+	if (result == RANDOMWALK_OK) {
+		accumulate_scalar(expected_visits, &particles, width);
+		kernels->accumulate(actual_visits, &particles, width);
+		if (memcmp(expected_visits, actual_visits, (size_t)width * height * sizeof(uint64_t)))
+			result = RANDOMWALK_FAIL;
+	}
+	free(expected_visits);
+	free(actual_visits);
+	particle_store_destroy(&particles);
+	return result;
+}
+
+static randomwalk_result_t check_kernels(const kernelset_t* const kernels) {
+	// Odd sides exercise the scalar tails, a side of 255 the edge at 0xFF, and
+	// sides that are powers of two the masked wrap
+	const kernel_plane_t planes[] = {
+		{ .width = 61, .height = 37, .prob_dir_change = 50, .wrap = true },
+		{ .width = 61, .height = 37, .prob_dir_change = 50, .wrap = false },
+		{ .width = 255, .height = 3, .prob_dir_change = 20, .wrap = true },
+		{ .width = 3, .height = 255, .prob_dir_change = 20, .wrap = false },
+		{ .width = 128, .height = 2, .prob_dir_change = 50, .wrap = true },
+		{ .width = 1, .height = 64, .prob_dir_change = 70, .wrap = true }
+	};
+	if (!kernels || !kernels->walk)
+		return RANDOMWALK_FAIL;
+	for (size_t i = 0; i < sizeof(planes) / sizeof(planes[0]); i++)
+		if (check_steps(kernels, planes[i]) != RANDOMWALK_OK)
+			return RANDOMWALK_FAIL;
+	// A whole number of vectors, and a tail past the last
+	if (check_lanes(kernels, 16) != RANDOMWALK_OK || check_lanes(kernels, 19) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	return check_encode_accumulate(kernels);
+}
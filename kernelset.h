@@ -0,0 +1,203 @@
+/**
+ * @file kernelset.h
+ * @brief Sets of kernels built for each instruction set, one of which is
+ * selected at startup by the features of the CPU.
+ * @author Justin Thoreson
+ *
+ * Every set computes exactly what the scalar set computes. A set is only
+ * selected once it has matched the scalar set on a small seeded scenario, so a
+ * single binary runs the widest kernels each machine supports.
+ */
+
+#pragma once
+#ifndef KERNELSET_H
+#define KERNELSET_H
+
+#include "kernel.h"
+#include "particles.h"
+#include "randomwalk.h"
+#include "rng.h"
+#include "rngbuf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The instruction sets kernels are built for, narrowest first.
+ */
+typedef enum {
+	KERNELSET_SCALAR = 0,
+	KERNELSET_SSE4,   // SSE4.1
+	KERNELSET_AVX2,
+	KERNELSET_AVX512, // AVX-512F, AVX-512BW and AVX-512DQ
+	KERNELSET_COUNT
+} kernelset_isa_t;
+
+/**
+ * @brief The most particles steered, walked and compacted in one pass.
+ */
+#define KERNELSET_CHUNK_PARTICLES 1024
+
+/**
+ * @brief The source of the random numbers particles are steered by.
+ */
+typedef struct {
+	rng_t* rng;          // A generator drawn from in order; NULL if unused
+	rngbuf_t* buffer;    // A buffer read in order; NULL if unused
+	uint64_t seed, step; // The counter-based generator of each particle otherwise
+} kernelset_source_t;
+
+/**
+ * @brief The kernels of one instruction set.
+ */
+typedef struct {
+	kernelset_isa_t isa;
+	const char* name;
+
+	/**
+	 * @brief Steer particles, drawing from the source in order of particle.
+	 * @param[in,out] direction The directions of the particles.
+	 * @param[in] id The identifiers of the particles.
+	 * @param[in] count The number of particles.
+	 * @param[in] prob_dir_change The probability of direction change.
+	 * @param[in,out] source The source of random numbers.
+	 */
+	void (*steer)(
+		uint8_t* const direction,
+		const uint32_t* const id,
+		const uint32_t count,
+		const uint8_t prob_dir_change,
+		const kernelset_source_t* const source
+	);
+
+	/**
+	 * @brief Steer the particles of interleaved replicates, each lane of a row
+	 * drawing from the generator of its own replicate in order of row.
+	 * @param[in,out] direction The directions, row by row of lanes.
+	 * @param[in] alive Nonzero for each particle to steer; the others draw
+	 * nothing.
+	 * @param[in] rows The number of rows.
+	 * @param[in] lanes The particles in a row, one per replicate.
+	 * @param[in] prob_dir_change The probability of direction change.
+	 * @param[in,out] rngs The generator of each replicate.
+	 */
+	void (*steer_lanes)(
+		uint8_t* const direction,
+		const uint8_t* const alive,
+		const uint32_t rows,
+		const uint32_t lanes,
+		const uint8_t prob_dir_change,
+		rng_t* const rngs
+	);
+
+	/**
+	 * @brief Walk particles one unit in their directions.
+	 * @param[in] plane The plane to walk the particles on.
+	 * @param[in,out] x The x coordinates; unchanged for particles that leave.
+	 * @param[in,out] y The y coordinates; unchanged for particles that leave.
+	 * @param[in] direction The directions of the particles.
+	 * @param[out] alive Nonzero for each particle remaining on the plane.
+	 * @param[in] count The number of particles.
+	 */
+	void (*walk)(
+		const kernel_plane_t plane,
+		uint8_t* const x,
+		uint8_t* const y,
+		const uint8_t* const direction,
+		uint8_t* const alive,
+		const uint32_t count
+	);
+
+	/**
+	 * @brief Move the surviving particles of a range to the front of a store
+	 * in order and record those that left.
+	 * @param[in,out] particles The store holding the range.
+	 * @param[out] deaths The particles that left the plane; may be NULL.
+	 * @param[in] alive Nonzero for each particle of the range remaining.
+	 * @param[in] first The first particle of the range.
+	 * @param[in] count The number of particles in the range.
+	 * @param[in,out] survivors The particles kept before the range; those kept
+	 * after it on return.
+	 * @return The result of recording the deaths.
+	 */
+	randomwalk_result_t (*compact)(
+		particle_store_t* const particles,
+		particle_store_t* const deaths,
+		const uint8_t* const alive,
+		const uint32_t first,
+		const uint32_t count,
+		uint32_t* const survivors
+	);
+
+	/**
+	 * @brief Convert colors to full-range BT.601 luma and chroma.
+	 * @param[in] cells The colors to convert.
+	 * @param[out] yuv The interleaved Y, Cb and Cr components of each color.
+	 * @param[in] count The number of colors.
+	 */
+	void (*encode)(const color_t* const cells, uint8_t* const yuv, const size_t count);
+
+	/**
+	 * @brief Count a visit to the cell of each particle.
+	 * @param[in,out] visits The visits to each cell of the plane, row by row.
+	 * @param[in] particles The visiting particles.
+	 * @param[in] width The width of the plane.
+	 */
+	void (*accumulate)(
+		uint64_t* const visits,
+		const particle_store_t* const particles,
+		const uint8_t width
+	);
+} kernelset_t;
+
+/**
+ * @brief Parse the name of an instruction set.
+ * @param[in] name The name: scalar, sse4, avx2 or avx512.
+ * @param[out] isa The named instruction set.
+ * @return The result of parsing the name.
+ */
+randomwalk_result_t kernelset_parse(const char* const name, kernelset_isa_t* const isa);
+
+/**
+ * @brief Select the kernels used from here on, after checking them against
+ * the scalar kernels.
+ *
+ * Called once at startup, before any kernel runs; until then the scalar
+ * kernels are used.
+ *
+ * @param[in] name The instruction set to select; NULL selects the widest the
+ * CPU supports whose kernels pass the check.
+ * @return The result of selecting the kernels; failing if the named set is
+ * unsupported or fails the check.
+ */
+randomwalk_result_t kernelset_select(const char* const name);
+
+/**
+ * @brief Get the selected kernels.
+ * @return The kernels.
+ */
+const kernelset_t* kernelset_active(void);
+
+/**
+ * @brief Advance every particle by one step, steering, walking and compacting
+ * one chunk of particles at a time.
+ *
+ * Walking draws nothing, so particles are steered in the order a fused pass
+ * steers them and the step is identical to kernel_step.
+ *
+ * @param[in] kernels The kernels to step with.
+ * @param[in,out] particles The particles to advance; the survivors on return.
+ * @param[out] deaths The particles that left the plane, at their last
+ * coordinate and the direction they left in; may be NULL.
+ * @param[in] plane The plane to advance the particles on.
+ * @param[in] source The source of random numbers.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+randomwalk_result_t kernelset_step(
+	const kernelset_t* const kernels,
+	particle_store_t* const particles,
+	particle_store_t* const deaths,
+	const kernel_plane_t plane,
+	const kernelset_source_t source
+);
+
+#endif // KERNELSET_H
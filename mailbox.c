@@ -0,0 +1,59 @@
+/**
+ * @file mailbox.c
+ * @brief Lock-free single-producer single-consumer rings of migrants.
+ * @author Justin Thoreson
+ */
+
+#include "mailbox.h"
+
+size_t mailbox_size(const uint32_t capacity) {
+	return sizeof(mailbox_t) + capacity * sizeof(migrant_t);
+}
+
+void mailbox_init(mailbox_t* const mailbox, const uint32_t capacity) {
+	atomic_init(&mailbox->head, 0);
+	atomic_init(&mailbox->tail, 0);
+	mailbox->mask = capacity - 1;
+}
+
+bool mailbox_push(mailbox_t* const mailbox, const migrant_t* const migrant) {
+	const unsigned tail = atomic_load_explicit(&mailbox->tail, memory_order_relaxed);
+	const unsigned head = atomic_load_explicit(&mailbox->head, memory_order_acquire);
+	if (tail - head > mailbox->mask)
+		return false;
+	mailbox->slots[tail & mailbox->mask] = *migrant;
+	atomic_store_explicit(&mailbox->tail, tail + 1, memory_order_release);
+	return true;
+}
+
+bool mailbox_pop(mailbox_t* const mailbox, migrant_t* const migrant) {
+	const unsigned head = atomic_load_explicit(&mailbox->head, memory_order_relaxed);
+	const unsigned tail = atomic_load_explicit(&mailbox->tail, memory_order_acquire);
+	if (head == tail)
+		return false;
+	*migrant = mailbox->slots[head & mailbox->mask];
+	atomic_store_explicit(&mailbox->head, head + 1, memory_order_release);
+	return true;
+}
+
+bool mailbox_link_send(void* context, const transport_side_t side, const migrant_t* const migrant) {
+	mailbox_link_t* const link = (mailbox_link_t*)context;
+	return mailbox_push(link->outbox[side], migrant);
+}
+
+bool mailbox_link_receive(void* context, migrant_t* const migrant) {
+	mailbox_link_t* const link = (mailbox_link_t*)context;
+	return mailbox_pop(link->inbox[TRANSPORT_NORTH], migrant) ||
+		mailbox_pop(link->inbox[TRANSPORT_SOUTH], migrant);
+}
+
+void mailbox_link_finish_walk(void* context) {
+	mailbox_link_t* const link = (mailbox_link_t*)context;
+	link->walked_target += link->strip_count;
+	atomic_fetch_add(link->walked, 1);
+}
+
+bool mailbox_link_all_walked(void* context) {
+	const mailbox_link_t* const link = (const mailbox_link_t*)context;
+	return atomic_load(link->walked) >= link->walked_target;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file mailbox.h
+ * @brief Lock-free single-producer single-consumer rings of migrants.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "transport.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A ring of migrants written by one strip and read by another.
+ *
+ * Migrants occupy the range [head, tail), both indices growing without bound
+ * and wrapping onto the slots by the mask. Only the producer moves the tail
+ * and only the consumer moves the head. The slots follow the ring inline and
+ * nothing within it is a pointer, so a ring may live in memory shared between
+ * processes.
+ */
+typedef struct {
+	atomic_uint head;
+	atomic_uint tail;
+	uint32_t mask;
+	migrant_t slots[];
+} mailbox_t;
+
+/**
+ * @brief The connection of a strip to the mailboxes of its neighbors.
+ *
+ * Its functions implement every operation of a transport but the total, so
+ * that transports passing migrants through mailboxes need only add one.
+ */
+typedef struct {
+	mailbox_t* inbox[TRANSPORT_SIDE_COUNT];  // Rings written by each neighbor
+	mailbox_t* outbox[TRANSPORT_SIDE_COUNT]; // Rings read by each neighbor
+	atomic_uint_fast64_t* walked; // Strips that finished walking, over all steps
+	uint64_t walked_target;       // Count of walked once this step is done
+	uint32_t strip_count;
+} mailbox_link_t;
+
+/**
+ * @brief The number of migrants each mailbox holds; a power of two.
+ */
+#define MAILBOX_CAPACITY 4096
+
+/**
+ * @brief Compute the size of a mailbox, slots included.
+ * @param[in] capacity The number of slots; a power of two.
+ * @return The size of the mailbox.
+ */
+size_t mailbox_size(const uint32_t capacity);
+
+/**
+ * @brief Initialize an empty mailbox in place.
+ * @param[out] mailbox The mailbox, mailbox_size(capacity) bytes long.
+ * @param[in] capacity The number of slots; a power of two.
+ */
+void mailbox_init(mailbox_t* const mailbox, const uint32_t capacity);
+
+/**
+ * @brief Append a migrant to a mailbox.
+ * @param[in,out] mailbox The mailbox to append to.
+ * @param[in] migrant The migrant to append.
+ * @return True if the migrant was appended, false if the mailbox is full.
+ */
+bool mailbox_push(mailbox_t* const mailbox, const migrant_t* const migrant);
+
+/**
+ * @brief Remove the oldest migrant from a mailbox.
+ * @param[in,out] mailbox The mailbox to remove from.
+ * @param[out] migrant The removed migrant.
+ * @return True if a migrant was removed, false if the mailbox is empty.
+ */
+bool mailbox_pop(mailbox_t* const mailbox, migrant_t* const migrant);
+
+/**
+ * @brief Send a migrant through a mailbox link; a transport send function.
+ * @param[in,out] context The mailbox link.
+ * @param[in] side The neighbor to send to.
+ * @param[in] migrant The migrant to send.
+ * @return True if the migrant was sent, false if the mailbox is full.
+ */
+bool mailbox_link_send(void* context, const transport_side_t side, const migrant_t* const migrant);
+
+/**
+ * @brief Receive a migrant through a mailbox link; a transport receive function.
+ * @param[in,out] context The mailbox link.
+ * @param[out] migrant The received migrant.
+ * @return True if a migrant was received, false if none is waiting.
+ */
+bool mailbox_link_receive(void* context, migrant_t* const migrant);
+
+/**
+ * @brief Announce the end of a walk through a mailbox link; a transport
+ * finish_walk function.
+ * @param[in,out] context The mailbox link.
+ */
+void mailbox_link_finish_walk(void* context);
+
+/**
+ * @brief Determine through a mailbox link whether every strip has finished
+ * walking; a transport all_walked function.
+ * @param[in,out] context The mailbox link.
+ * @return True if every strip has finished walking this step.
+ */
+bool mailbox_link_all_walked(void* context);
+
+#endif // MAILBOX_H
@@ -5,6 +5,16 @@
  */
 
 #include "randomwalk.h"
+#include "args.h"
+#include "engine.h"
+#include "frameshm.h"
+#include "kernelset.h"
+#include "markov.h"
+#include "placement.h"
+#include "recorder.h"
+#include "spawn.h"
+#include "splitting.h"
+#include "sweep.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -18,35 +28,104 @@ static const char* USAGE =
 	"Parameters (R = required | O = optional):\n"
 	"[R] --width=<uint8>           width of the plane\n"
 	"[R] --height=<uint8>          height of the plane\n"
-	"[R] --pcount=<uint8>          initial particle count\n"
+	"[R] --pcount=<uint32>         initial particle count\n"
 	"[O] --prob-dir-change={0-100} probability a particle changes direction\n"
 	"[O] --delay=<uint16>          delay between frames in milliseconds\n"
+	"[O] --headless                run without drawing or frame delays, for runs\n"
+	"                              writing only files such as --trajectory\n"
 	"[O] --wrap                    particles return to opposite edge when\n"
-	"                              leaving the current edge";
+	"                              leaving the current edge\n"
+	"[O] --seed=<uint64>           seed of the random number generator\n"
+	"[O] --max-steps=<uint64>      stop after this many steps\n"
+	"[O] --init=<distribution>     place particles in parallel by uniform,\n"
+	"                              point[:<x>,<y>], gaussian[:<x>,<y>,<sigma>]\n"
+	"                              or line[:{north,east,south,west}]\n"
+	"[O] --counter-rng             draw each step of each particle from the seed,\n"
+	"                              the particle and the step alone\n"
+	"[O] --seek=<uint64>           start a --counter-rng run at this step\n"
+	"[O] --checkpoint=<path>       checkpoint file written by, or sought from, a\n"
+	"                              --counter-rng run\n"
+	"[O] --checkpoint-interval=<uint32> steps between written checkpoints\n"
+	"[O] --rng-buffer              draw random numbers ahead on a producer thread\n"
+	"[O] --pad-pow2                pad a --wrap plane of sides at most 128 to\n"
+	"                              powers of two, drawing only the requested area\n"
+	"[O] --isa=<name>              kernels to run: scalar, sse4, avx2 or avx512\n"
+	"                              (default: the widest the CPU supports)\n"
+	"[O] --diff=<engine>           instead of running, check an engine (store,\n"
+	"                              tile or domain) against the reference linked\n"
+	"                              list engine step by step under --counter-rng\n"
+	"[O] --shm=<name>              publish frames to a shared memory segment\n"
+	"[O] --serve=<path>            stream frames to viewers on a Unix socket\n"
+	"[O] --export-frames=ppm:<dir> write one PPM image per frame into <dir>\n"
+	"    --export-frames=y4m       write a Y4M video to standard output\n"
+	"[O] --scale=<uint8>           side length in pixels of each exported cell\n"
+	"[O] --stream                  write a binary event stream to standard output\n"
+	"[O] --stream-positions=<uint32> steps between streamed particle positions\n"
+	"[O] --record=<uint32>         keep the most recent steps in a flight recorder,\n"
+	"                              dumped on exit, SIGUSR1 or the 'd' key\n"
+	"[O] --record-path=<path>      file to dump recordings to\n"
+	"[O] --history=<uint32>        memory budget in KiB for rewinding; space\n"
+	"                              pauses, arrow keys scrub through past steps\n"
+	"[O] --trajectory=<path>       write every step to a compressed trajectory file\n"
+	"[O] --trajectory-block=<uint32> most steps per trajectory block\n"
+	"[O] --death-log=<path>        log when and where each particle left the plane\n"
+	"[O] --domains=<uint16>        run headlessly on threads each owning a strip\n"
+	"                              of the plane\n"
+	"[O] --shards=<uint16>         run headlessly in forked processes each owning\n"
+	"                              a strip of the plane\n"
+	"[O] --visits=<path>           write the visits to each cell of a --domains\n"
+	"                              or --shards run\n"
+	"[O] --cpus=<list>             pin strips in turn to CPUs such as 0,2,4-7\n"
+	"[O] --numa-report             print the CPU and memory node of each strip";
 
 /**
- * @brief Move a string pointer forward passed a specified prefix.
- * @param[in,out] string The string in which the prefix is skipped.
- * @param[in] prefix The prefix to skip.
- * @return True if skipping succeeded, false otherwise.
+ * @brief Information on the viewer and sweep modes of the random walk program.
  */
-static bool skip_prefix(char** string, const char* const prefix);
+static const char* MODES_USAGE =
+	"Viewer mode:\n"
+	"    --view-shm=<name>         draw the frames published to a segment\n"
+	"    --replay=<path> [--delay=<uint16>] draw a flight recording\n"
+	"Sweep mode (--sweep):\n"
+	"[R] --width, --height, --pcount accept ranges as <min>[:<max>[:<step>]]\n"
+	"[O] --prob-dir-change         also accepts a range\n"
+	"[O] --replicates=<uint16>     runs per configuration\n"
+	"[O] --threads=<uint16>        worker threads (default: all CPUs)\n"
+	"[O] --tile-steps=<uint32>     steps each cache-sized tile of particles\n"
+	"                              advances at once\n"
+	"[O] --ensemble                run up to 64 replicates of a configuration\n"
+	"                              together, one in each vector lane\n"
+	"[O] --format={csv,binary}     format of the result table\n"
+	"[O] --output=<path>           file to write the result table to\n"
+	"Splitting mode (--splitting), estimating the probability of surviving:\n"
+	"[R] --width, --height         plane without wrap\n"
+	"[R] --survival=<uint64>       steps a particle must survive\n"
+	"[R] --pcount=<uint32>         particles started at each level\n"
+	"[O] --levels=<uint16>         levels of equal steps (default: each level ends\n"
+	"                              once half its particles survive)\n"
+	"[O] --prob-dir-change, --seed, --threads as in sweep mode\n"
+	"[O] --replicates=<uint16>     independent estimates (default: 16)\n"
+	"Solver mode (--solve), the exact expected exit of a single particle:\n"
+	"[R] --width, --height         plane without wrap\n"
+	"[O] --prob-dir-change, --threads as in sweep mode\n"
+	"[O] --output=<path>           file to write the expected exit of each cell to";
 
 /**
- * @brief Parse an 8-bit unsigned integer.
- * @param[in] arg The string argument to parse.
- * @param[out] value The parsed integer.
- * @return True if the integer is parsed successfully, false otherwise.
+ * @brief Print information on how to run the random walk program.
  */
-static bool parse_uint8(const char* const arg, uint8_t* const value);
+static void print_usage(void);
 
 /**
- * @brief Parse an 16-bit unsigned integer.
+ * @brief Parse a range of unsigned integers of the form min[:max[:step]].
  * @param[in] arg The string argument to parse.
- * @param[out] value The parsed integer.
- * @return True if the integer is parsed successfully, false otherwise.
+ * @param[out] range The parsed range.
+ * @param[in] upper The largest value the range may contain.
+ * @return True if the range is parsed successfully, false otherwise.
  */
-static bool parse_uint16(const char* const arg, uint16_t* const value);
+static bool parse_range(
+	const char* const arg,
+	sweep_range_t* const range,
+	const uint32_t upper
+);
 
 /**
  * @brief Parse a single command line argument.
@@ -69,65 +148,264 @@ static bool parse_args(
 	char** const argv
 );
 
+/**
+ * @brief Determine whether a flag is present among the command line arguments.
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments to search.
+ * @param[in] flag The flag to search for.
+ * @return True if the flag is present, false otherwise.
+ */
+static bool has_flag(const int argc, char** const argv, const char* const flag);
+
+/**
+ * @brief Parse a single command line argument of sweep mode.
+ * @param[out] args The parsed sweep argument.
+ * @param[in] arg The argument to parse.
+ * @return True if parsing succeeded, false otherwise.
+ */
+static bool parse_sweep_arg(sweep_args_t* const args, char* arg);
+
+/**
+ * @brief Parse command line arguments of sweep mode.
+ * @param[out] args The parsed sweep arguments.
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments to parse.
+ * @return True if the arguments are parsed successfully, false otherwise.
+ */
+static bool parse_sweep_args(
+	sweep_args_t* const args,
+	const int argc,
+	char** const argv
+);
+
+/**
+ * @brief Parse command line arguments of splitting mode.
+ * @param[out] args The parsed splitting arguments.
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments to parse.
+ * @return True if the arguments are parsed successfully, false otherwise.
+ */
+static bool parse_splitting_args(
+	splitting_args_t* const args,
+	const int argc,
+	char** const argv
+);
+
+/**
+ * @brief Parse command line arguments of solver mode.
+ * @param[out] args The parsed solver arguments.
+ * @param[in] argc The number of command line arguments.
+ * @param[in] argv The command line arguments to parse.
+ * @return True if the arguments are parsed successfully, false otherwise.
+ */
+static bool parse_markov_args(
+	markov_args_t* const args,
+	const int argc,
+	char** const argv
+);
+
 /**
  * @brief Print the result of the random walk program.
+ * @param[in,out] stream The stream to print to.
  * @param[in] result The random walk result to print.
  */
-static void print_randomwalk_result(const randomwalk_result_t result);
+static void print_randomwalk_result(
+	FILE* const stream,
+	const randomwalk_result_t result
+);
 
 int main(int argc, char** argv) {
+	char* view_name = argc == 2 ? argv[1] : NULL;
+	if (view_name && args_skip_prefix(&view_name, "--view-shm=")) {
+		print_randomwalk_result(stdout, frameshm_view(view_name));
+		return 0;
+	}
+	char* replay_path = argc == 2 || argc == 3 ? argv[1] : NULL;
+	if (replay_path && args_skip_prefix(&replay_path, "--replay=")) {
+		uint16_t delay_ms = 0;
+		char* delay = argc == 3 ? argv[2] : NULL;
+		if (delay && (!args_skip_prefix(&delay, "--delay=") || !args_parse_uint16(delay, &delay_ms))) {
+			print_usage();
+			return 1;
+		}
+		print_randomwalk_result(stdout, recorder_replay(replay_path, delay_ms));
+		return 0;
+	}
+	if (has_flag(argc, argv, "--sweep")) {
+		sweep_args_t args = { 0 };
+		if (!parse_sweep_args(&args, argc, argv)) {
+			print_usage();
+			return 1;
+		}
+		kernelset_select(NULL);
+		// Keep standard output clean when the table is written to it
+		print_randomwalk_result(args.output ? stdout : stderr, sweep(args));
+		return 0;
+	}
+	if (has_flag(argc, argv, "--splitting")) {
+		splitting_args_t args = { .replicates = 16 };
+		if (!parse_splitting_args(&args, argc, argv)) {
+			print_usage();
+			return 1;
+		}
+		print_randomwalk_result(stderr, splitting(args));
+		return 0;
+	}
+	if (has_flag(argc, argv, "--solve")) {
+		markov_args_t args = { 0 };
+		if (!parse_markov_args(&args, argc, argv)) {
+			print_usage();
+			return 1;
+		}
+		print_randomwalk_result(stderr, markov_solve(args));
+		return 0;
+	}
 	randomwalk_args_t args = { 0 };
 	if (!parse_args(&args, argc, argv)) {
-		puts(USAGE);
+		print_usage();
 		return 1;
 	}
-	print_randomwalk_result(randomwalk(args));
+	if (kernelset_select(args.isa) != RANDOMWALK_OK) {
+		printf("Kernels unsupported by this CPU or failing their self-check: %s\n", args.isa);
+		return 1;
+	}
+	// Keep standard output clean when a video is written to it
+	const bool streaming = args.export_format == RANDOMWALK_EXPORT_Y4M || args.stream;
+	print_randomwalk_result(streaming ? stderr : stdout, randomwalk(args));
 	return 0;
 }
 
-static bool skip_prefix(char** string, const char* const prefix) {
-	const size_t prefix_size = strlen(prefix);
-	if (strncmp(*string, prefix, prefix_size))
-		return false;
-	*string += prefix_size;
-	return true;
-}
-
-static bool parse_uint8(const char* const arg, uint8_t* const value) {
-	if (!arg || !value)
-		return false;
-	int64_t temp;
-	if (!sscanf(arg, "%ld", &temp))
-		return false;
-	if (temp < 0 || temp > UINT8_MAX)
-		return false;
-	*value = (uint8_t)temp;
-	return true;
+static void print_usage(void) {
+	puts(USAGE);
+	puts(MODES_USAGE);
 }
 
-static bool parse_uint16(const char* const arg, uint16_t* const value) {
-	if (!arg || !value)
+static bool parse_range(
+	const char* const arg,
+	sweep_range_t* const range,
+	const uint32_t upper
+) {
+	if (!arg || !range)
 		return false;
-	int64_t temp;
-	if (!sscanf(arg, "%ld", &temp))
+	int64_t min, max, step = 1;
+	const int parsed = sscanf(arg, "%ld:%ld:%ld", &min, &max, &step);
+	if (parsed < 1)
 		return false;
-	if (temp < 0 || temp > UINT16_MAX)
+	if (parsed == 1)
+		max = min;
+	if (min < 0 || max < min || max > upper || step < 1 || step > upper)
 		return false;
-	*value = (uint16_t)temp;
+	*range = (sweep_range_t){
+		.min = (uint32_t)min,
+		.max = (uint32_t)max,
+		.step = (uint32_t)step
+	};
 	return true;
 }
 
 static bool parse_arg(randomwalk_args_t* const args, char* arg) {
-	if (!args->width && skip_prefix(&arg, "--width="))
-		return parse_uint8(arg, &args->width);
-	if (!args->height && skip_prefix(&arg, "--height="))
-		return parse_uint8(arg, &args->height);
-	if (!args->particle_count && skip_prefix(&arg, "--pcount="))
-		return parse_uint8(arg, &args->particle_count);
-	if (!args->prob_dir_change && skip_prefix(&arg, "--prob-dir-change="))
-		return parse_uint8(arg, &args->prob_dir_change);
-	if (!args->delay_ms && skip_prefix(&arg, "--delay="))
-		return parse_uint16(arg, &args->delay_ms);
+	if (!args->width && args_skip_prefix(&arg, "--width="))
+		return args_parse_uint8(arg, &args->width);
+	if (!args->height && args_skip_prefix(&arg, "--height="))
+		return args_parse_uint8(arg, &args->height);
+	if (!args->particle_count && args_skip_prefix(&arg, "--pcount="))
+		return args_parse_uint32(arg, &args->particle_count);
+	if (!args->prob_dir_change && args_skip_prefix(&arg, "--prob-dir-change="))
+		return args_parse_uint8(arg, &args->prob_dir_change);
+	if (!args->delay_ms && args_skip_prefix(&arg, "--delay="))
+		return args_parse_uint16(arg, &args->delay_ms);
+	if (!args->seed && args_skip_prefix(&arg, "--seed="))
+		return args_parse_uint64(arg, &args->seed);
+	if (!args->max_steps && args_skip_prefix(&arg, "--max-steps="))
+		return args_parse_uint64(arg, &args->max_steps);
+	if (!args->init && args_skip_prefix(&arg, "--init=")) {
+		args->init = arg;
+		return *arg;
+	}
+	if (!args->isa && args_skip_prefix(&arg, "--isa=")) {
+		kernelset_isa_t isa;
+		args->isa = arg;
+		return kernelset_parse(arg, &isa) == RANDOMWALK_OK;
+	}
+	if (!args->diff_engine && args_skip_prefix(&arg, "--diff=")) {
+		args->diff_engine = arg;
+		return engine_find(arg) != NULL;
+	}
+	if (!args->seek_step && args_skip_prefix(&arg, "--seek="))
+		return args_parse_uint64(arg, &args->seek_step);
+	if (!args->checkpoint_path && args_skip_prefix(&arg, "--checkpoint=")) {
+		args->checkpoint_path = arg;
+		return *arg;
+	}
+	if (!args->checkpoint_interval && args_skip_prefix(&arg, "--checkpoint-interval="))
+		return args_parse_uint32(arg, &args->checkpoint_interval) && args->checkpoint_interval;
+	if (!args->shm_name && args_skip_prefix(&arg, "--shm=")) {
+		args->shm_name = arg;
+		return *arg == '/' && arg[1];
+	}
+	if (!args->serve_path && args_skip_prefix(&arg, "--serve=")) {
+		args->serve_path = arg;
+		return *arg;
+	}
+	if (!args->export_format && args_skip_prefix(&arg, "--export-frames=")) {
+		if (!strcmp(arg, "y4m")) {
+			args->export_format = RANDOMWALK_EXPORT_Y4M;
+			return true;
+		}
+		if (!args_skip_prefix(&arg, "ppm:"))
+			return false;
+		args->export_format = RANDOMWALK_EXPORT_PPM;
+		args->export_path = arg;
+		return *arg;
+	}
+	if (!args->export_scale && args_skip_prefix(&arg, "--scale="))
+		return args_parse_uint8(arg, &args->export_scale);
+	if (!args->stream_positions && args_skip_prefix(&arg, "--stream-positions="))
+		return args_parse_uint32(arg, &args->stream_positions);
+	if (!args->record_steps && args_skip_prefix(&arg, "--record="))
+		return args_parse_uint32(arg, &args->record_steps) && args->record_steps;
+	if (!args->record_path && args_skip_prefix(&arg, "--record-path=")) {
+		args->record_path = arg;
+		return *arg;
+	}
+	if (!args->history_kib && args_skip_prefix(&arg, "--history="))
+		return args_parse_uint32(arg, &args->history_kib);
+	if (!args->trajectory_path && args_skip_prefix(&arg, "--trajectory=")) {
+		args->trajectory_path = arg;
+		return *arg;
+	}
+	if (!args->trajectory_block && args_skip_prefix(&arg, "--trajectory-block="))
+		return args_parse_uint32(arg, &args->trajectory_block);
+	if (!args->death_log_path && args_skip_prefix(&arg, "--death-log=")) {
+		args->death_log_path = arg;
+		return *arg;
+	}
+	if (!args->domains && args_skip_prefix(&arg, "--domains="))
+		return args_parse_uint16(arg, &args->domains) && args->domains;
+	if (!args->shards && args_skip_prefix(&arg, "--shards="))
+		return args_parse_uint16(arg, &args->shards) && args->shards;
+	if (!args->cpus && args_skip_prefix(&arg, "--cpus=")) {
+		placement_cpus_t cpus;
+		args->cpus = arg;
+		return placement_parse_cpus(arg, &cpus) == RANDOMWALK_OK &&
+			placement_free_cpus(&cpus) == RANDOMWALK_OK;
+	}
+	if (!args->numa_report && !strcmp(arg, "--numa-report"))
+		args->numa_report = true;
+	if (!args->visits_path && args_skip_prefix(&arg, "--visits=")) {
+		args->visits_path = arg;
+		return *arg;
+	}
+	if (!args->counter_rng && !strcmp(arg, "--counter-rng"))
+		args->counter_rng = true;
+	if (!args->rng_buffer && !strcmp(arg, "--rng-buffer"))
+		args->rng_buffer = true;
+	if (!args->pad_pow2 && !strcmp(arg, "--pad-pow2"))
+		args->pad_pow2 = true;
+	if (!args->headless && !strcmp(arg, "--headless"))
+		args->headless = true;
+	if (!args->stream && !strcmp(arg, "--stream"))
+		args->stream = true;
 	if (!args->wrap && !strcmp(arg, "--wrap"))
 		args->wrap = true;
 	return true;
@@ -149,32 +427,238 @@ static bool parse_args(
 			return false;
 		}
 	}
+	spawn_distribution_t distribution;
+	// The plane must be known to place a distribution on it
+	if (args->init && args->width && args->height && spawn_parse(args->init, args->width, args->height, &distribution) != RANDOMWALK_OK) {
+		printf("Failed to parse: --init=%s\n", args->init);
+		return false;
+	}
+	if (args->stream && args->export_format == RANDOMWALK_EXPORT_Y4M) {
+		puts("Only one of --stream and --export-frames=y4m may use standard output");
+		return false;
+	}
+	const bool observed = args->shm_name || args->serve_path || args->export_format ||
+		args->stream || args->record_steps || args->trajectory_path || args->death_log_path;
+	if (args->domains && args->shards) {
+		puts("Only one of --domains and --shards may split the plane");
+		return false;
+	}
+	if ((args->domains || args->shards) && observed) {
+		puts("--domains and --shards run headlessly and write nothing but --visits");
+		return false;
+	}
+	if ((args->visits_path || args->cpus || args->numa_report) && !args->domains && !args->shards) {
+		puts("--visits, --cpus and --numa-report require --domains or --shards");
+		return false;
+	}
+	if ((args->seek_step || args->checkpoint_path || args->checkpoint_interval) && !args->counter_rng) {
+		puts("--seek, --checkpoint and --checkpoint-interval require --counter-rng");
+		return false;
+	}
+	if (args->counter_rng && (!args->seed || (args->domains && !args->diff_engine) || args->shards)) {
+		puts("--counter-rng requires --seed, which replays depend on, and a single engine");
+		return false;
+	}
+	if (args->diff_engine && (!args->counter_rng || observed || args->seek_step ||
+		args->checkpoint_path || args->visits_path || args->cpus || args->numa_report)) {
+		puts("--diff requires --counter-rng and runs from step 0 writing only its report");
+		return false;
+	}
+	if (args->diff_engine && args->wrap && !args->max_steps) {
+		puts("--diff with --wrap requires --max-steps, as particles never leave the plane");
+		return false;
+	}
+	if (args->rng_buffer && (args->counter_rng || args->domains || args->shards)) {
+		puts("--rng-buffer replaces the generator of a single engine, not --counter-rng");
+		return false;
+	}
+	if (args->pad_pow2 && (!args->wrap || args->width > 128 || args->height > 128 ||
+		args->counter_rng || args->domains || args->shards)) {
+		puts("--pad-pow2 pads a --wrap plane of sides at most 128 run by a single engine");
+		return false;
+	}
+	if (args->checkpoint_interval && (!args->checkpoint_path || args->seek_step)) {
+		puts("--checkpoint-interval writes to --checkpoint, which --seek only reads");
+		return false;
+	}
+	return true;
+}
+
+static bool has_flag(const int argc, char** const argv, const char* const flag) {
+	for (int i = 1; i < argc; i++)
+		if (!strcmp(argv[i], flag))
+			return true;
+	return false;
+}
+
+static bool parse_sweep_arg(sweep_args_t* const args, char* arg) {
+	if (!args->width.min && args_skip_prefix(&arg, "--width="))
+		return parse_range(arg, &args->width, UINT8_MAX);
+	if (!args->height.min && args_skip_prefix(&arg, "--height="))
+		return parse_range(arg, &args->height, UINT8_MAX);
+	if (!args->particle_count.min && args_skip_prefix(&arg, "--pcount="))
+		return parse_range(arg, &args->particle_count, UINT32_MAX);
+	if (!args->prob_dir_change.max && args_skip_prefix(&arg, "--prob-dir-change="))
+		return parse_range(arg, &args->prob_dir_change, 100);
+	if (!args->seed && args_skip_prefix(&arg, "--seed="))
+		return args_parse_uint64(arg, &args->seed);
+	if (!args->max_steps && args_skip_prefix(&arg, "--max-steps="))
+		return args_parse_uint64(arg, &args->max_steps);
+	if (!args->replicates && args_skip_prefix(&arg, "--replicates="))
+		return args_parse_uint16(arg, &args->replicates);
+	if (!args->threads && args_skip_prefix(&arg, "--threads="))
+		return args_parse_uint16(arg, &args->threads);
+	if (!args->tile_steps && args_skip_prefix(&arg, "--tile-steps="))
+		return args_parse_uint32(arg, &args->tile_steps);
+	if (!args->output && args_skip_prefix(&arg, "--output=")) {
+		args->output = arg;
+		return *arg;
+	}
+	if (args_skip_prefix(&arg, "--format=")) {
+		if (!strcmp(arg, "csv"))
+			args->format = SWEEP_FORMAT_CSV;
+		else if (!strcmp(arg, "binary"))
+			args->format = SWEEP_FORMAT_BINARY;
+		else
+			return false;
+		return true;
+	}
+	if (!args->wrap && !strcmp(arg, "--wrap"))
+		args->wrap = true;
+	if (!args->ensemble && !strcmp(arg, "--ensemble"))
+		args->ensemble = true;
+	return true;
+}
+
+static bool parse_sweep_args(
+	sweep_args_t* const args,
+	const int argc,
+	char** const argv
+) {
+	for (int i = 1; i < argc; i++) {
+		char* const arg = argv[i];
+		if (!parse_sweep_arg(args, arg)) {
+			printf("Failed to parse: %s\n", arg);
+			return false;
+		}
+	}
+	if (!args->width.min || !args->height.min || !args->particle_count.min) {
+		puts("Sweep requires --width, --height and --pcount");
+		return false;
+	}
+	if (!args->prob_dir_change.max)
+		args->prob_dir_change = (sweep_range_t){ 0, 0, 1 };
+	if (args->wrap && !args->max_steps) {
+		puts("Sweeping with --wrap requires --max-steps");
+		return false;
+	}
+	if (args->ensemble && args->tile_steps) {
+		puts("--ensemble advances every particle together, not in --tile-steps");
+		return false;
+	}
+	return true;
+}
+
+static bool parse_splitting_args(
+	splitting_args_t* const args,
+	const int argc,
+	char** const argv
+) {
+	for (int i = 1; i < argc; i++) {
+		char* arg = argv[i];
+		bool parsed = true;
+		if (!args->width && args_skip_prefix(&arg, "--width="))
+			parsed = args_parse_uint8(arg, &args->width);
+		else if (!args->height && args_skip_prefix(&arg, "--height="))
+			parsed = args_parse_uint8(arg, &args->height);
+		else if (!args->particle_count && args_skip_prefix(&arg, "--pcount="))
+			parsed = args_parse_uint32(arg, &args->particle_count);
+		else if (!args->prob_dir_change && args_skip_prefix(&arg, "--prob-dir-change="))
+			parsed = args_parse_uint8(arg, &args->prob_dir_change) && args->prob_dir_change <= 100;
+		else if (!args->survival && args_skip_prefix(&arg, "--survival="))
+			parsed = args_parse_uint64(arg, &args->survival);
+		else if (!args->levels && args_skip_prefix(&arg, "--levels="))
+			parsed = args_parse_uint16(arg, &args->levels);
+		else if (args_skip_prefix(&arg, "--replicates="))
+			parsed = args_parse_uint16(arg, &args->replicates);
+		else if (!args->threads && args_skip_prefix(&arg, "--threads="))
+			parsed = args_parse_uint16(arg, &args->threads);
+		else if (!args->seed && args_skip_prefix(&arg, "--seed="))
+			parsed = args_parse_uint64(arg, &args->seed);
+		if (!parsed) {
+			printf("Failed to parse: %s\n", argv[i]);
+			return false;
+		}
+	}
+	if (!args->width || !args->height || !args->particle_count || !args->survival) {
+		puts("Splitting requires --width, --height, --pcount and --survival");
+		return false;
+	}
+	if (args->particle_count < 2 || args->levels > args->survival || args->replicates < 2) {
+		puts("Splitting needs --pcount and --replicates of at least 2, and --levels up to --survival");
+		return false;
+	}
 	return true;
 }
 
-static void print_randomwalk_result(const randomwalk_result_t result) {
+static bool parse_markov_args(
+	markov_args_t* const args,
+	const int argc,
+	char** const argv
+) {
+	for (int i = 1; i < argc; i++) {
+		char* arg = argv[i];
+		bool parsed = true;
+		if (!args->width && args_skip_prefix(&arg, "--width="))
+			parsed = args_parse_uint8(arg, &args->width);
+		else if (!args->height && args_skip_prefix(&arg, "--height="))
+			parsed = args_parse_uint8(arg, &args->height);
+		else if (!args->prob_dir_change && args_skip_prefix(&arg, "--prob-dir-change="))
+			parsed = args_parse_uint8(arg, &args->prob_dir_change) && args->prob_dir_change <= 100;
+		else if (!args->threads && args_skip_prefix(&arg, "--threads="))
+			parsed = args_parse_uint16(arg, &args->threads);
+		else if (!args->output && args_skip_prefix(&arg, "--output=")) {
+			args->output = arg;
+			parsed = *arg;
+		}
+		if (!parsed) {
+			printf("Failed to parse: %s\n", argv[i]);
+			return false;
+		}
+	}
+	if (!args->width || !args->height) {
+		puts("Solving requires --width and --height");
+		return false;
+	}
+	return true;
+}
+
+static void print_randomwalk_result(
+	FILE* const stream,
+	const randomwalk_result_t result
+) {
 	switch(result) {
 		case RANDOMWALK_OK:
-			printf("RANDOMWALK_OK (%d)\n", RANDOMWALK_OK);
+			fprintf(stream, "RANDOMWALK_OK (%d)\n", RANDOMWALK_OK);
 			break;
 		case RANDOMWALK_DONE:
-			printf("RANDOMWALK_DONE (%d)\n", RANDOMWALK_DONE);
+			fprintf(stream, "RANDOMWALK_DONE (%d)\n", RANDOMWALK_DONE);
 			break;
 		case RANDOMWALK_BADDIM:
-			printf("RANDOMWALK_BADDIM (%d)\n", RANDOMWALK_BADDIM);
+			fprintf(stream, "RANDOMWALK_BADDIM (%d)\n", RANDOMWALK_BADDIM);
 			break;
 		case RANDOMWALK_BADCOUNT:
-			printf("RANDOMWALK_BADCOUNT (%d)\n", RANDOMWALK_BADCOUNT);
+			fprintf(stream, "RANDOMWALK_BADCOUNT (%d)\n", RANDOMWALK_BADCOUNT);
 			break;
 		case RANDOMWALK_BADPROB:
-			printf("RANDOMWALK_BADPROB (%d)\n", RANDOMWALK_BADPROB);
+			fprintf(stream, "RANDOMWALK_BADPROB (%d)\n", RANDOMWALK_BADPROB);
 			break;
 		case RANDOMWALK_FAIL:
-			printf("RANDOMWALK_FAIL (%d)\n", RANDOMWALK_FAIL);
+			fprintf(stream, "RANDOMWALK_FAIL (%d)\n", RANDOMWALK_FAIL);
 			break;
 		case RANDOMWALK_UNKNOWN:
 		default:
-			printf("RANDOMWALK_UNKNOWN (%d)\n", RANDOMWALK_UNKNOWN);
+			fprintf(stream, "RANDOMWALK_UNKNOWN (%d)\n", RANDOMWALK_UNKNOWN);
 	};
 }
 
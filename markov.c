@@ -0,0 +1,235 @@
+/**
+ * @file markov.c
+ * @brief Exact expected exit times and exit edge probabilities of a particle,
+ * solved from the absorbing Markov chain of its cell and direction.
+ * @author Justin Thoreson
+ */
+
+#include "markov.h"
+#include "deathlog.h"
+#include "kernel.h"
+#include "threadpool.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief The quantities solved for each state: the expected steps, then the
+ * probability of leaving through each edge.
+ */
+#define MARKOV_QUANTITIES (1 + DEATHLOG_EDGE_COUNT)
+
+/**
+ * @brief The largest change of a sweep, relative to the expected steps or in
+ * probability, at which the solution is taken to have converged.
+ */
+static const double TOLERANCE = 1e-12;
+
+/**
+ * @brief The most sweeps taken before giving up on converging.
+ */
+static const uint32_t MAX_SWEEPS = 10000000;
+
+/**
+ * @brief The names of the edges of the plane, as a death log names them.
+ */
+static const char* const EDGE_NAMES[DEATHLOG_EDGE_COUNT] = { "north", "south", "west", "east" };
+
+/**
+ * @brief The system solved and the unknowns of each state.
+ *
+ * States are stored cell by cell, row by row, with the quantities of each of
+ * the eight directions of a cell side by side.
+ */
+typedef struct {
+	uint8_t width, height;
+	double turn; // The probability of turning to each of the other directions
+	double keep; // The probability of keeping the direction
+	double* values;
+} chain_t;
+
+/**
+ * @brief A band of rows of one color, swept by a thread pool task.
+ */
+typedef struct {
+	chain_t* chain;
+	uint8_t color;      // The parity of x in bit 0 and of y in bit 1
+	uint8_t first, end; // The rows of the band
+	double change;      // The largest change of the sweep
+} band_t;
+
+/**
+ * @brief Sweep the cells of a band; a thread pool task.
+ * @param[in,out] arg The band to sweep.
+ */
+static void sweep_band(void* arg);
+
+/**
+ * @brief Update the quantities of every direction of a cell from those of
+ * the states it moves to.
+ * @param[in,out] chain The chain.
+ * @param[in] x The x coordinate of the cell.
+ * @param[in] y The y coordinate of the cell.
+ * @return The largest change of a quantity.
+ */
+static double update_cell(chain_t* const chain, const uint8_t x, const uint8_t y);
+
+/**
+ * @brief Write the quantities of each cell, averaged over directions.
+ * @param[in] chain The solved chain.
+ * @param[in] path The file to write to.
+ * @return The result of writing the file.
+ */
+static randomwalk_result_t write_cells(const chain_t* const chain, const char* const path);
+
+randomwalk_result_t markov_solve(const markov_args_t args) {
+	if (!args.width || !args.height)
+		return RANDOMWALK_BADDIM;
+	if (args.prob_dir_change > 100)
+		return RANDOMWALK_BADPROB;
+	const uint8_t prob = args.prob_dir_change ? args.prob_dir_change : DEFAULT_PROB_DIR_CHANGE;
+	const size_t states = (size_t)args.width * args.height * DIRECTION_COUNT;
+	chain_t chain = {
+		.width = args.width,
+		.height = args.height,
+		.turn = prob / 101.0 / (DIRECTION_COUNT - 1),
+		.keep = 1 - prob / 101.0,
+		.values = (double*)calloc(states * MARKOV_QUANTITIES, sizeof(double))
+	};
+	if (!chain.values)
+		return RANDOMWALK_FAIL;
+	threadpool_t* pool = NULL;
+	randomwalk_result_t result = threadpool_create(&pool, args.threads);
+	// Cells of one color never move to one another, so a color is swept in
+	// parallel and every thread count takes the same sweeps to the same values
+	const uint8_t band_count = result == RANDOMWALK_OK ?
+		(uint8_t)(threadpool_size(pool) < args.height ? threadpool_size(pool) : args.height) : 0;
+	band_t bands[4][UINT8_MAX];
+	for (uint8_t color = 0; color < 4; color++)
+		for (uint8_t band = 0; band < band_count; band++)
+			bands[color][band] = (band_t){
+				.chain = &chain,
+				.color = color,
+				.first = (uint8_t)(args.height * band / band_count),
+				.end = (uint8_t)(args.height * (band + 1) / band_count)
+			};
+	uint32_t sweeps = 0;
+	double change = INFINITY;
+	while (result == RANDOMWALK_OK && change > TOLERANCE && sweeps < MAX_SWEEPS) {
+		change = 0;
+		for (uint8_t color = 0; result == RANDOMWALK_OK && color < 4; color++) {
+			for (uint8_t band = 0; result == RANDOMWALK_OK && band < band_count; band++)
+				result = threadpool_submit(pool, sweep_band, &bands[color][band]);
+			if (result == RANDOMWALK_OK)
+				result = threadpool_wait(pool);
+			for (uint8_t band = 0; band < band_count; band++)
+				if (bands[color][band].change > change)
+					change = bands[color][band].change;
+		}
+		sweeps++;
+	}
+	if (pool)
+		threadpool_destroy(&pool);
+	if (result == RANDOMWALK_OK && change > TOLERANCE)
+		result = RANDOMWALK_FAIL;
+	// Runs place particles in any cell heading in any direction alike
+	double mean[MARKOV_QUANTITIES] = { 0 };
+	for (size_t state = 0; result == RANDOMWALK_OK && state < states; state++)
+		for (uint8_t quantity = 0; quantity < MARKOV_QUANTITIES; quantity++)
+			mean[quantity] += chain.values[state * MARKOV_QUANTITIES + quantity] / states;
+	if (result == RANDOMWALK_OK) {
+		printf("mean_steps");
+		for (uint8_t edge = 0; edge < DEATHLOG_EDGE_COUNT; edge++)
+			printf(",%s", EDGE_NAMES[edge]);
+		printf(",sweeps,change\n%.9f", mean[0]);
+		for (uint8_t edge = 0; edge < DEATHLOG_EDGE_COUNT; edge++)
+			printf(",%.9f", mean[1 + edge]);
+		printf(",%u,%.3e\n", sweeps, change);
+	}
+	if (result == RANDOMWALK_OK && args.output)
+		result = write_cells(&chain, args.output);
+	free(chain.values);
+	return result;
+}
+
+static void sweep_band(void* arg) {
+	band_t* const band = (band_t*)arg;
+	const uint8_t first_x = band->color & 1, parity_y = band->color >> 1;
+	band->change = 0;
+	for (uint16_t y = band->first; y < band->end; y++) {
+		if ((y & 1) != parity_y)
+			continue;
+		for (uint16_t x = first_x; x < band->chain->width; x += 2) {
+			const double change = update_cell(band->chain, (uint8_t)x, (uint8_t)y);
+			if (change > band->change)
+				band->change = change;
+		}
+	}
+}
+
+static double update_cell(chain_t* const chain, const uint8_t x, const uint8_t y) {
+	// The quantities reached by moving in each direction, left or not
+	double reached[DIRECTION_COUNT][MARKOV_QUANTITIES] = { 0 };
+	double total[MARKOV_QUANTITIES] = { 0 };
+	for (uint8_t direction = 0; direction < DIRECTION_COUNT; direction++) {
+		const int16_t new_x = x + KERNEL_DELTA_X[direction];
+		const int16_t new_y = y + KERNEL_DELTA_Y[direction];
+		if (new_y < 0)
+			reached[direction][1 + DEATHLOG_EDGE_NORTH] = 1;
+		else if (new_y == chain->height)
+			reached[direction][1 + DEATHLOG_EDGE_SOUTH] = 1;
+		else if (new_x < 0)
+			reached[direction][1 + DEATHLOG_EDGE_WEST] = 1;
+		else if (new_x == chain->width)
+			reached[direction][1 + DEATHLOG_EDGE_EAST] = 1;
+		else {
+			const size_t state = ((size_t)new_y * chain->width + new_x) * DIRECTION_COUNT + direction;
+			for (uint8_t quantity = 0; quantity < MARKOV_QUANTITIES; quantity++)
+				reached[direction][quantity] = chain->values[state * MARKOV_QUANTITIES + quantity];
+		}
+		for (uint8_t quantity = 0; quantity < MARKOV_QUANTITIES; quantity++)
+			total[quantity] += reached[direction][quantity];
+	}
+	// Every direction turns to each other alike, so only the one kept differs
+	double change = 0;
+	double* const values = chain->values + ((size_t)y * chain->width + x) * DIRECTION_COUNT * MARKOV_QUANTITIES;
+	for (uint8_t direction = 0; direction < DIRECTION_COUNT; direction++) {
+		for (uint8_t quantity = 0; quantity < MARKOV_QUANTITIES; quantity++) {
+			double* const value = &values[direction * MARKOV_QUANTITIES + quantity];
+			const double updated = (quantity ? 0 : 1) + chain->turn * total[quantity] +
+				(chain->keep - chain->turn) * reached[direction][quantity];
+			// Expected steps run into the hundreds, so they converge relatively
+			const double difference = fabs(updated - *value) / (updated > 1 ? updated : 1);
+			if (difference > change)
+				change = difference;
+			*value = updated;
+		}
+	}
+	return change;
+}
+
+static randomwalk_result_t write_cells(const chain_t* const chain, const char* const path) {
+	FILE* const file = fopen(path, "w");
+	if (!file)
+		return RANDOMWALK_FAIL;
+	fprintf(file, "x,y,mean_steps");
+	for (uint8_t edge = 0; edge < DEATHLOG_EDGE_COUNT; edge++)
+		fprintf(file, ",%s", EDGE_NAMES[edge]);
+	fputc('\n', file);
+	for (uint16_t y = 0; y < chain->height; y++) {
+		for (uint16_t x = 0; x < chain->width; x++) {
+			const double* const values =
+				chain->values + ((size_t)y * chain->width + x) * DIRECTION_COUNT * MARKOV_QUANTITIES;
+			fprintf(file, "%u,%u", x, y);
+			for (uint8_t quantity = 0; quantity < MARKOV_QUANTITIES; quantity++) {
+				double mean = 0;
+				for (uint8_t direction = 0; direction < DIRECTION_COUNT; direction++)
+					mean += values[direction * MARKOV_QUANTITIES + quantity] / DIRECTION_COUNT;
+				fprintf(file, ",%.9f", mean);
+			}
+			fputc('\n', file);
+		}
+	}
+	return fclose(file) ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file markov.h
+ * @brief Exact expected exit times and exit edge probabilities of a particle,
+ * solved from the absorbing Markov chain of its cell and direction.
+ * @author Justin Thoreson
+ *
+ * Each step a particle keeps its direction or, with the probability of
+ * direction change, turns to one of the other seven alike, and then moves a
+ * cell, leaving a plane without wrap through an edge. The expected steps to
+ * leave from each (cell, direction) state, and the probability of leaving
+ * through each edge, satisfy a sparse linear system over the width x height x 8
+ * states, solved here by Gauss-Seidel sweeps.
+ *
+ * The walk draws its turns as a roll from 1 to 101 against the probability,
+ * so a probability p turns with probability p / 101, as solved here. A
+ * particle leaving through a corner is counted against the north or south
+ * edge, as in a death log.
+ */
+
+#pragma once
+#ifndef MARKOV_H
+#define MARKOV_H
+
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief Arguments to be given to the solver.
+ */
+typedef struct {
+	uint8_t width, height;
+	uint8_t prob_dir_change; // 0 uses the default probability
+	uint16_t threads;        // 0 uses every online CPU
+	const char* output;      // The expected exit of each cell; NULL writes none
+} markov_args_t;
+
+/**
+ * @brief Solve for the expected steps and exit edge probabilities of a
+ * particle placed as a run places them, and write them, with the sweeps taken
+ * and the largest change of the last, as CSV to standard output.
+ *
+ * With an output path, the same is also written for each cell, averaged over
+ * the directions a particle may start in.
+ *
+ * @param[in] args A structure of arguments to configure the solver with.
+ * @return An enum denoting the random walk result code.
+ */
+randomwalk_result_t markov_solve(const markov_args_t args);
+
+#endif // MARKOV_H
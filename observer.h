@@ -0,0 +1,44 @@
+/**
+ * @file observer.h
+ * @brief Hooks through which consumers observe each step of a random walk.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef OBSERVER_H
+#define OBSERVER_H
+
+#include "framebuffer.h"
+#include "particles.h"
+#include "randomwalk.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief A snapshot of the random walk after a step.
+ *
+ * The snapshot of step 0 holds the initial particles and no deaths.
+ */
+typedef struct {
+	uint64_t step;
+	uint8_t width, height;
+	bool wrap;
+	const particle_store_t* particles; // Particles alive after the step
+	const particle_store_t* deaths;    // Particles that died during the step,
+	                                   // at their last coordinate and the
+	                                   // direction they left the plane in
+	const framebuffer_t* framebuffer;  // Trails painted up to the step
+} frame_t;
+
+/**
+ * @brief A consumer of random walk frames.
+ *
+ * Observers are chained in a singly-linked list and notified in order.
+ */
+typedef struct observer_t {
+	randomwalk_result_t (*observe)(void* context, const frame_t* const frame);
+	void* context;
+	struct observer_t* next;
+} observer_t;
+
+#endif // OBSERVER_H
@@ -0,0 +1,78 @@
+/**
+ * @file particles.c
+ * @brief Particle types and a structure-of-arrays particle store.
+ * @author Justin Thoreson
+ */
+
+#include "particles.h"
+#include "hugealloc.h"
+#include <string.h>
+
+randomwalk_result_t particle_store_create(
+	particle_store_t* const store,
+	const uint32_t capacity
+) {
+	if (!store)
+		return RANDOMWALK_FAIL;
+	*store = (particle_store_t){
+		.count = 0,
+		.capacity = capacity,
+		.id = (uint32_t*)hugealloc_alloc((size_t)capacity * sizeof(uint32_t)),
+		.x = (uint8_t*)hugealloc_alloc(capacity),
+		.y = (uint8_t*)hugealloc_alloc(capacity),
+		.direction = (uint8_t*)hugealloc_alloc(capacity),
+		.color = (color_t*)hugealloc_alloc((size_t)capacity * sizeof(color_t))
+	};
+	if (capacity && (!store->id || !store->x || !store->y ||
+		!store->direction || !store->color)) {
+		particle_store_destroy(store);
+		return RANDOMWALK_FAIL;
+	}
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t particle_store_push(
+	particle_store_t* const store,
+	const uint32_t id,
+	const coordinate_t coord,
+	const direction_t direction,
+	const color_t color
+) {
+	if (!store || store->count == store->capacity)
+		return RANDOMWALK_FAIL;
+	const uint32_t i = store->count++;
+	store->id[i] = id;
+	store->x[i] = coord.x;
+	store->y[i] = coord.y;
+	store->direction[i] = (uint8_t)direction;
+	store->color[i] = color;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t particle_store_copy(
+	particle_store_t* const destination,
+	const particle_store_t* const source
+) {
+	if (!destination || !source || source->count > destination->capacity)
+		return RANDOMWALK_FAIL;
+	const uint32_t count = destination->count = source->count;
+	memcpy(destination->id, source->id, count * sizeof(uint32_t));
+	memcpy(destination->x, source->x, count);
+	memcpy(destination->y, source->y, count);
+	memcpy(destination->direction, source->direction, count);
+	memcpy(destination->color, source->color, count * sizeof(color_t));
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t particle_store_destroy(particle_store_t* const store) {
+	if (!store)
+		return RANDOMWALK_FAIL;
+	const size_t capacity = store->capacity;
+	hugealloc_free(store->id, capacity * sizeof(uint32_t));
+	hugealloc_free(store->x, capacity);
+	hugealloc_free(store->y, capacity);
+	hugealloc_free(store->direction, capacity);
+	hugealloc_free(store->color, capacity * sizeof(color_t));
+	*store = (particle_store_t){ 0 };
+	return RANDOMWALK_OK;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file particles.h
+ * @brief Particle types and a structure-of-arrays particle store.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief A coordinate within a plane (2-dimensional).
+ */
+typedef struct {
+	uint8_t x, y;
+} coordinate_t;
+
+/**
+ * @brief A 24-bit (RGB) color.
+ */
+typedef struct {
+	uint8_t r, g, b;
+} color_t;
+
+/**
+ * @brief Enumeration denoting cardinal directions.
+ */
+typedef enum {
+	DIRECTION_NORTH = 0,
+	DIRECTION_NORTHEAST,
+	DIRECTION_EAST,
+	DIRECTION_SOUTHEAST,
+	DIRECTION_SOUTH,
+	DIRECTION_SOUTHWEST,
+	DIRECTION_WEST,
+	DIRECTION_NORTHWEST,
+	DIRECTION_COUNT, // special enumeration to track the number of enumerators
+} direction_t;
+
+/**
+ * @brief A population of particles laid out as one array per attribute.
+ *
+ * The i-th particle of the store is made up of the i-th element of each array.
+ */
+typedef struct {
+	uint32_t count, capacity;
+	uint32_t* id;
+	uint8_t* x;
+	uint8_t* y;
+	uint8_t* direction;
+	color_t* color;
+} particle_store_t;
+
+/**
+ * @brief Allocate the arrays of a particle store.
+ * @param[out] store The store to allocate.
+ * @param[in] capacity The maximum number of particles the store may hold.
+ * @return The result of allocating the store.
+ */
+randomwalk_result_t particle_store_create(
+	particle_store_t* const store,
+	const uint32_t capacity
+);
+
+/**
+ * @brief Append a particle to a particle store.
+ * @param[in,out] store The store to append to.
+ * @param[in] id The identifier of the particle.
+ * @param[in] coord The coordinate of the particle.
+ * @param[in] direction The direction of movement of the particle.
+ * @param[in] color The color of the particle.
+ * @return The result of appending the particle.
+ */
+randomwalk_result_t particle_store_push(
+	particle_store_t* const store,
+	const uint32_t id,
+	const coordinate_t coord,
+	const direction_t direction,
+	const color_t color
+);
+
+/**
+ * @brief Copy every particle of one particle store into another.
+ * @param[out] destination The store to copy into.
+ * @param[in] source The store to copy from.
+ * @return The result of copying the particles.
+ */
+randomwalk_result_t particle_store_copy(
+	particle_store_t* const destination,
+	const particle_store_t* const source
+);
+
+/**
+ * @brief Free the arrays of a particle store.
+ * @param[in,out] store The store to free.
+ * @return The result of freeing the store.
+ */
+randomwalk_result_t particle_store_destroy(particle_store_t* const store);
+
+#endif // PARTICLES_H
@@ -0,0 +1,182 @@
+/**
+ * @file placement.c
+ * @brief Pinning of threads to CPUs and inspection of the NUMA node memory is
+ * placed on.
+ * @author Justin Thoreson
+ */
+
+#define _GNU_SOURCE
+#include "placement.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief The most pages inspected by a single system call.
+ */
+#define PLACEMENT_BATCH_PAGES 1024
+
+/**
+ * @brief Append a CPU to a list of CPUs.
+ * @param[in,out] cpus The list to append to.
+ * @param[in,out] capacity The capacity of the list.
+ * @param[in] cpu The CPU to append.
+ * @return The result of appending the CPU.
+ */
+static randomwalk_result_t append_cpu(
+	placement_cpus_t* const cpus,
+	uint32_t* const capacity,
+	const uint16_t cpu
+);
+
+randomwalk_result_t placement_parse_cpus(const char* const list, placement_cpus_t* const cpus) {
+	if (!list || !cpus)
+		return RANDOMWALK_FAIL;
+	*cpus = (placement_cpus_t){ 0 };
+	uint32_t capacity = 0;
+	const char* cursor = list;
+	randomwalk_result_t result = RANDOMWALK_OK;
+	while (result == RANDOMWALK_OK) {
+		char* end;
+		const long first = strtol(cursor, &end, 10);
+		long last = first;
+		if (end == cursor || first < 0 || first >= CPU_SETSIZE) {
+			result = RANDOMWALK_FAIL;
+			break;
+		}
+		if (*end == '-') {
+			cursor = end + 1;
+			last = strtol(cursor, &end, 10);
+			if (end == cursor || last < first || last >= CPU_SETSIZE) {
+				result = RANDOMWALK_FAIL;
+				break;
+			}
+		}
+		for (long cpu = first; result == RANDOMWALK_OK && cpu <= last; cpu++)
+			result = append_cpu(cpus, &capacity, (uint16_t)cpu);
+		if (!*end)
+			break;
+		if (*end != ',')
+			result = RANDOMWALK_FAIL;
+		cursor = end + 1;
+	}
+	if (result != RANDOMWALK_OK)
+		placement_free_cpus(cpus);
+	return result;
+}
+
+randomwalk_result_t placement_free_cpus(placement_cpus_t* const cpus) {
+	if (!cpus)
+		return RANDOMWALK_FAIL;
+	free(cpus->cpus);
+	*cpus = (placement_cpus_t){ 0 };
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t placement_pin(const uint16_t cpu) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) ?
+		RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
+
+uint32_t placement_node_count(void) {
+	FILE* const file = fopen("/sys/devices/system/node/online", "r");
+	if (!file)
+		return 1;
+	// The list reads like "0-1" or "0,2"; its last number is the highest node
+	uint32_t highest = 0;
+	unsigned node;
+	while (fscanf(file, "%u", &node) == 1) {
+		highest = node > highest ? node : highest;
+		if (fgetc(file) == EOF)
+			break;
+	}
+	fclose(file);
+	return highest + 1;
+}
+
+int32_t placement_cpu_node(const int32_t cpu) {
+	if (cpu < 0)
+		return -1;
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	DIR* const directory = opendir(path);
+	if (!directory)
+		return -1;
+	int32_t node = -1;
+	for (struct dirent* entry; node < 0 && (entry = readdir(directory));)
+		if (sscanf(entry->d_name, "node%d", &node) != 1)
+			node = -1;
+	closedir(directory);
+	return node;
+}
+
+randomwalk_result_t placement_count_pages(
+	const void* const address,
+	const size_t size,
+	uint64_t* const pages,
+	const uint32_t node_count
+) {
+	if (!pages || (!address && size))
+		return RANDOMWALK_FAIL;
+	const uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t page = (uintptr_t)address / page_size * page_size;
+	const uintptr_t end = (uintptr_t)address + size;
+	void* batch[PLACEMENT_BATCH_PAGES];
+	int status[PLACEMENT_BATCH_PAGES];
+	while (page < end) {
+		unsigned long count = 0;
+		for (; count < PLACEMENT_BATCH_PAGES && page < end; count++, page += page_size)
+			batch[count] = (void*)page;
+		// Without target nodes, move_pages only reports where each page is
+		if (syscall(SYS_move_pages, 0, count, batch, NULL, status, 0))
+			return RANDOMWALK_FAIL;
+		for (unsigned long i = 0; i < count; i++)
+			if (status[i] >= 0 && (uint32_t)status[i] < node_count)
+				pages[status[i]]++;
+	}
+	return RANDOMWALK_OK;
+}
+
+void placement_print_header(FILE* const stream, const uint32_t node_count) {
+	fputs("strip,pinned_cpu,cpu,cpu_node", stream);
+	for (uint32_t node = 0; node < node_count; node++)
+		fprintf(stream, ",pages_node%u", node);
+	fputc('\n', stream);
+}
+
+void placement_print_strip(
+	FILE* const stream,
+	const uint32_t strip,
+	const int32_t pinned,
+	const int32_t cpu,
+	const uint64_t* const pages,
+	const uint32_t node_count
+) {
+	fprintf(stream, "%u,%d,%d,%d", strip, pinned, cpu, placement_cpu_node(cpu));
+	for (uint32_t node = 0; node < node_count; node++)
+		fprintf(stream, ",%lu", pages[node]);
+	fputc('\n', stream);
+}
+
+static randomwalk_result_t append_cpu(
+	placement_cpus_t* const cpus,
+	uint32_t* const capacity,
+	const uint16_t cpu
+) {
+	if (cpus->count == *capacity) {
+		const uint32_t grown = *capacity ? *capacity * 2 : 8;
+		uint16_t* const resized = (uint16_t*)realloc(cpus->cpus, grown * sizeof(uint16_t));
+		if (!resized)
+			return RANDOMWALK_FAIL;
+		cpus->cpus = resized;
+		*capacity = grown;
+	}
+	cpus->cpus[cpus->count++] = cpu;
+	return RANDOMWALK_OK;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file placement.h
+ * @brief Pinning of threads to CPUs and inspection of the NUMA node memory is
+ * placed on.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include "randomwalk.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief A list of CPUs to pin threads to, in order.
+ */
+typedef struct {
+	uint16_t* cpus;
+	uint32_t count;
+} placement_cpus_t;
+
+/**
+ * @brief Parse a list of CPUs such as "0,2,4-7".
+ * @param[in] list The comma-separated CPUs and inclusive CPU ranges.
+ * @param[out] cpus The parsed CPUs.
+ * @return The result of parsing the list.
+ */
+randomwalk_result_t placement_parse_cpus(const char* const list, placement_cpus_t* const cpus);
+
+/**
+ * @brief Free a list of CPUs.
+ * @param[in,out] cpus The list to free.
+ * @return The result of freeing the list.
+ */
+randomwalk_result_t placement_free_cpus(placement_cpus_t* const cpus);
+
+/**
+ * @brief Pin the calling thread to a single CPU.
+ * @param[in] cpu The CPU to pin to.
+ * @return The result of pinning the thread.
+ */
+randomwalk_result_t placement_pin(const uint16_t cpu);
+
+/**
+ * @brief Determine the number of NUMA nodes of the host.
+ * @return One past the highest online node, at least 1.
+ */
+uint32_t placement_node_count(void);
+
+/**
+ * @brief Determine the NUMA node a CPU belongs to.
+ * @param[in] cpu The CPU.
+ * @return The node of the CPU, or -1 if it is unknown.
+ */
+int32_t placement_cpu_node(const int32_t cpu);
+
+/**
+ * @brief Count the resident pages of a memory range on each NUMA node.
+ *
+ * Pages not yet touched, and so backed by no node, are not counted.
+ *
+ * @param[in] address The start of the range.
+ * @param[in] size The size of the range in bytes.
+ * @param[in,out] pages The pages on each node, added to.
+ * @param[in] node_count The number of nodes counted.
+ * @return The result of inspecting the range.
+ */
+randomwalk_result_t placement_count_pages(
+	const void* const address,
+	const size_t size,
+	uint64_t* const pages,
+	const uint32_t node_count
+);
+
+/**
+ * @brief Print the header of a placement report.
+ * @param[in,out] stream The stream to print to.
+ * @param[in] node_count The number of nodes of the report.
+ */
+void placement_print_header(FILE* const stream, const uint32_t node_count);
+
+/**
+ * @brief Print the placement of one strip of the plane.
+ * @param[in,out] stream The stream to print to.
+ * @param[in] strip The index of the strip.
+ * @param[in] pinned The CPU the strip was pinned to, or -1 if unpinned.
+ * @param[in] cpu The CPU the strip last ran on.
+ * @param[in] pages The resident pages of the strip on each node.
+ * @param[in] node_count The number of nodes of the report.
+ */
+void placement_print_strip(
+	FILE* const stream,
+	const uint32_t strip,
+	const int32_t pinned,
+	const int32_t cpu,
+	const uint64_t* const pages,
+	const uint32_t node_count
+);
+
+#endif // PLACEMENT_H
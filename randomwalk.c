@@ -5,72 +5,106 @@
  */
 
 #include "randomwalk.h"
+#include "checkpoint.h"
+#include "deathlog.h"
+#include "domain.h"
+#include "engine.h"
+#include "eventstream.h"
+#include "framebuffer.h"
+#include "frameexport.h"
+#include "frameserver.h"
+#include "frameshm.h"
+#include "history.h"
+#include "kernel.h"
+#include "observer.h"
+#include "particles.h"
+#include "recorder.h"
+#include "refengine.h"
+#include "regen.h"
+#include "shard.h"
+#include "spawn.h"
+#include "rng.h"
+#include "rngbuf.h"
+#include "terminal.h"
+#include "trajectory.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 /**
- * @brief A coordinate within a plane (2-dimensional).
+ * @brief The consumers attached to a run and the state they share.
  */
 typedef struct {
-	uint8_t x, y;
-} coordinate_t;
+	observer_t* observer;          // The first attached observer, if any
+	particle_store_t deaths;       // Snapshot of the particles that just died
+	framebuffer_t framebuffer;     // Trails painted so far
+	frameshm_t* shm;
+	observer_t shm_observer;
+	frameserver_t* server;
+	observer_t server_observer;
+	frameexport_t* exporter;
+	observer_t export_observer;
+	eventstream_t* stream;
+	observer_t stream_observer;
+	recorder_t* recorder;
+	observer_t recorder_observer;
+	history_t* history;
+	observer_t history_observer;
+	trajectory_writer_t* trajectory;
+	observer_t trajectory_observer;
+	deathlog_t* death_log;
+	observer_t death_log_observer;
+	checkpoint_writer_t* checkpoint;
+	observer_t checkpoint_observer;
+} observers_t;
 
 /**
- * @brief A 24-bit (RGB) color.
+ * @brief The default probability of particle direction change.
  */
-typedef struct {
-	uint8_t r, g, b;
-} color_t;
+const uint8_t DEFAULT_PROB_DIR_CHANGE = 50;
 
 /**
- * @brief Enumeration denoting cardinal directions.
+ * @brief The default frame delay in milliseconds.
  */
-typedef enum {
-	DIRECTION_NORTH = 0,
-	DIRECTION_NORTHEAST,
-	DIRECTION_EAST,
-	DIRECTION_SOUTHEAST,
-	DIRECTION_SOUTH,
-	DIRECTION_SOUTHWEST,
-	DIRECTION_WEST,
-	DIRECTION_NORTHWEST,
-	DIRECTION_COUNT, // special enumeration to track the number of enumerators
-} direction_t;
+const uint8_t DEFAULT_DELAY_MILLIS = 25;
 
 /**
- * @brief A particle that takes a random walk.
- *
- * Particles are structure in a singly-linked-list-like fashion.
+ * @brief The number of milliseconds per second.
  */
-typedef struct particle_t {
-	struct particle_t* next;
-	bool is_alive;
-	direction_t direction;
-	color_t color;
-	coordinate_t coord;
-} particle_t;
+const uint16_t MILLIS_PER_SECOND = 1000;
 
 /**
- * @brief The default probability of particle direction change.
+ * @brief The number of nanoseconds per millisecond.
  */
-const uint8_t DEFAULT_PROB_DIR_CHANGE = 50;
+const uint32_t NANOS_PER_MILLI = 1000000;
 
 /**
- * @brief The default frame delay in milliseconds.
+ * @brief The default file the flight recorder dumps to.
  */
-const uint8_t DEFAULT_DELAY_MILLIS = 25;
+const char* const DEFAULT_RECORD_PATH = "randomwalk.rec";
 
 /**
- * @brief The number of milliseconds per second.
+ * @brief The key requesting a flight recorder dump.
  */
-const uint16_t MILLIS_PER_SECOND = 1000;
+const int DUMP_KEY = 'd';
 
 /**
- * @brief The number of nanoseconds per millisecond.
+ * @brief The key pausing and resuming the random walk.
  */
-const uint32_t NANOS_PER_MILLI = 1000000;
+const int PAUSE_KEY = ' ';
+
+/**
+ * @brief The default memory budget of interactive rewinding in kibibytes.
+ */
+const uint32_t DEFAULT_HISTORY_KIB = 16384;
+
+/**
+ * @brief The number of steps the up and down keys scrub by.
+ */
+const uint64_t SCRUB_JUMP = 10;
 
 /**
  * @brief Validate random walk arguments.
@@ -85,136 +119,183 @@ static randomwalk_result_t validate_args(const randomwalk_args_t args);
 static void clear_screen();
 
 /**
- * @brief Generate a random unsigned 8-bit integer value.
- * @param[in] min The minimum possible value to generate.
- * @param[in] max The maximum possible value to generate.
- * @return A generated uint8_t value.
+ * @brief Seed a pseudorandom number generator from the random walk arguments.
+ *
+ * If no seed is specified, seed from the current time.
+ *
+ * @param[out] rng The generator to seed.
+ * @param[in] seed The specified seed.
  */
-static uint8_t gen_uint8(const uint8_t min,	const uint8_t max);
+static void seed_rng(rng_t* const rng, const uint64_t seed);
 
 /**
  * @brief Generate a random coordinate.
  * @param[out] coord A generated coordinate.
  * @param[in] width The width of the plane.
  * @param[in] height The height of the plane.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
  * @return The result of the coordinate generation.
  */
 static randomwalk_result_t gen_coord(
 	coordinate_t* const coord,
 	const uint8_t width,
-	const uint8_t height
+	const uint8_t height,
+	rng_t* const rng
 );
 
 /**
  * @brief Generate a random 24-bit (RGB) color.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
  * @return A generated color.
  */
-static color_t gen_color();
+static color_t gen_color(rng_t* const rng);
 
 /**
  * @brief Generate a random cardinal direction.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
  * @return A generated direction.
  */
-static direction_t gen_direction();
+static direction_t gen_direction(rng_t* const rng);
 
 /**
- * @brief Generate a random cardinal direction except one that is specified.
- * @param[out] direction A generated direction.
- * @param[in] exclude The direction to exclude from random generation.
- * @return The result of generating a direction.
+ * @brief Initialize all particles.
+ *
+ * Without an initial distribution, particles are placed uniformly one at a
+ * time from the generator of the run. With one, they are placed in parallel
+ * from generators derived from a single draw of it. Counter-based runs are
+ * instead regenerated as of the step sought, from the seed alone.
+ *
+ * @param[out] particles The created particles.
+ * @param[in] args The random walk arguments.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @return The result of the initialization.
  */
-static randomwalk_result_t gen_direction_except(
-	direction_t* direction,
-	const direction_t exclude
+static randomwalk_result_t init_particles(
+	particle_store_t* const particles,
+	const randomwalk_args_t args,
+	rng_t* const rng
 );
 
 /**
- * @brief Initialize all particles.
- * @param[out] particle The first created particle; subsequent particles follow.
- * @param[in] particle_count The number of particles to create.
- * @param[in] width The width of the plane.
- * @param[in] height The height of the plane.
- * @return The result of the initialization.
+ * @brief Draw a snapshot of particles.
+ * @param[in] particles The particles to draw.
+ * @param[in] width The width of the area drawn from the origin.
+ * @param[in] height The height of the area drawn from the origin.
+ * @return The result of drawing the particles.
  */
-static randomwalk_result_t init_particles(
-	particle_t** particle,
-	const uint8_t particle_count,
+static randomwalk_result_t draw_snapshot(
+	const particle_store_t* const particles,
 	const uint8_t width,
 	const uint8_t height
 );
 
 /**
- * @brief Walk all particles forward in their respective directions of movement.
- * @param[in,out] particle The first particle to walk.
- * @param[in] width The width of the plane
- * @param[in] height The height of the plane
- * @param[in] wrap Whether to return particles to the opposite edge of egress.
- * @return The result of the particles taking a walk.
+ * @brief Attach the consumers requested by the random walk arguments.
+ * @param[out] observers The attached consumers.
+ * @param[in] args The random walk arguments.
+ * @param[in] interactive Whether the run is drawn and may be rewound.
+ * @return The result of attaching the consumers.
  */
-static randomwalk_result_t walk_particles(
-	particle_t* const particle,
-	const uint8_t width,
-	const uint8_t height,
-	const bool wrap
+static randomwalk_result_t attach_observers(
+	observers_t* const observers,
+	const randomwalk_args_t args,
+	const bool interactive
 );
 
 /**
- * @brief Steer all particles in a new random direction.
- *
- * Particles change direction probabilistically.
- *
- * @param[in,out] particle The first particle to steer.
- * @param[in] prob_dir_change The probability of a particle changing direction.
- * @return The result of steering the particles.
+ * @brief Notify every attached consumer of the state after a step.
+ * @param[in,out] observers The attached consumers.
+ * @param[in] particles The particles alive after the step.
+ * @param[in] step The number of steps taken so far.
+ * @param[in] args The random walk arguments.
+ * @return The result of notifying the consumers.
  */
-static randomwalk_result_t steer_particles(
-	particle_t* const particle,
-	const uint8_t prob_dir_change
+static randomwalk_result_t notify_observers(
+	observers_t* const observers,
+	const particle_store_t* const particles,
+	const uint64_t step,
+	const randomwalk_args_t args
 );
 
 /**
- * @brief Draw all particles.
- * @param[in] particle The first particle to draw.
- * @return The result of drawing the particles.
+ * @brief Detach and free every attached consumer.
+ * @param[in,out] observers The attached consumers.
+ * @return The result of detaching the consumers.
  */
-static randomwalk_result_t draw_particles(particle_t* const particle);
+static randomwalk_result_t detach_observers(observers_t* const observers);
 
 /**
- * @brief Validate the live status of all particles
+ * @brief Let the user scrub through the history of a paused random walk.
  *
- * If any particle has died, it is deallocated from memory, never to return.
+ * Returns once the user resumes or the program is asked to stop.
  *
- * @param[in,out] particle The first particle to validate.
- * @return The result of validating the particles.
+ * @param[in] history The history to scrub through.
+ * @param[in] args The random walk arguments.
+ * @return The result of scrubbing.
  */
-static randomwalk_result_t validate_particles(particle_t** particle);
+static randomwalk_result_t scrub_history(
+	const history_t* const history,
+	const randomwalk_args_t args
+);
 
 /**
- * @brief Conduct a single step/frame of the random walk program.
+ * @brief Run the random walk until all particles die or the step limit is hit.
  *
- * Computing a particle consists of drawing, steering, walking, and validating.
+ * A counter-based run starts from the step sought, if any.
  *
- * @param[in,out] particle The first particle to compute.
- * @param[in] width The width of the plane.
- * @param[in] height The height of the plane.
- * @param[in] prob_dir_change The probability of a particle changing direction.
- * @param[in] wrap Whether to return particles to the opposite edge of egress.
- * @return The result of computing all particles.
+ * @param[in] args The validated random walk arguments.
+ * @param[in] headless Whether to skip drawing and frame delays.
+ * @param[out] stats Statistics gathered from the run; may be NULL.
+ * @return The result of the run.
  */
-static randomwalk_result_t compute_particles(
-	particle_t** particle,
-	const uint8_t width,
-	const uint8_t height,
-	const uint8_t prob_dir_change,
-	const bool wrap
+static randomwalk_result_t run_particles(
+	randomwalk_args_t args,
+	const bool headless,
+	randomwalk_stats_t* const stats
 );
 
 /**
- * @brief Destroy all particles.
- * @param[in,out] particle The first particle to destroy.
- * @return The result of destroying the particles.
+ * @brief Check an engine against the reference engine on a counter-based run,
+ * reporting to standard output.
+ * @param[in] args The validated random walk arguments.
+ * @return The result of the check; RANDOMWALK_FAIL if the engines diverge.
  */
-static randomwalk_result_t destroy_particles(particle_t** particle);
+static randomwalk_result_t run_diff(randomwalk_args_t args);
+
+/**
+ * @brief Run the random walk headlessly with the plane split between threads
+ * or processes.
+ * @param[in] args The validated random walk arguments.
+ * @param[out] stats Statistics gathered from the run; may be NULL.
+ * @return The result of the run.
+ */
+static randomwalk_result_t run_domains(
+	randomwalk_args_t args,
+	randomwalk_stats_t* const stats
+);
+
+/**
+ * @brief Run the random walk headlessly one tile of particles at a time.
+ *
+ * Each tile is advanced several steps before the next, with a pseudorandom
+ * number generator of its own so that the outcome does not depend on how
+ * many steps it is advanced at once.
+ *
+ * @param[in,out] particles The particles to advance; the survivors on return.
+ * @param[in] plane The plane to advance the particles on.
+ * @param[in] args The validated random walk arguments.
+ * @param[in,out] rng The pseudorandom number generator to derive tile
+ * generators from.
+ * @param[out] steps The number of steps simulated.
+ * @return The result of the run.
+ */
+static randomwalk_result_t run_tiles(
+	particle_store_t* const particles,
+	const kernel_plane_t plane,
+	const randomwalk_args_t args,
+	rng_t* const rng,
+	uint64_t* const steps
+);
 
 /**
  * @brief Temporarily halt execution for a provided number of milliseconds.
@@ -229,19 +310,33 @@ randomwalk_result_t randomwalk(randomwalk_args_t args) {
 	randomwalk_result_t result = validate_args(args);
 	if (result != RANDOMWALK_OK)
 		return result;
-	srand(time(NULL));
-	particle_t* particle = NULL;
-	result = init_particles(&particle, args.particle_count, args.width, args.height);
+	if (args.diff_engine)
+		return run_diff(args);
+	if (args.domains || args.shards)
+		return run_domains(args, NULL);
+	// Exported frames are rendered as fast as they are simulated
+	const bool headless = args.headless || args.export_format != RANDOMWALK_EXPORT_NONE || args.stream;
+	if (headless)
+		return run_particles(args, headless, NULL);
 	clear_screen();
-	while (result == RANDOMWALK_OK) {
-		result = compute_particles(&particle, args.width, args.height, args.prob_dir_change, args.wrap);
-		millisleep(args.delay_ms);
-	}
-	if (result != RANDOMWALK_DONE)
-		result = destroy_particles(&particle);
+	terminal_begin_input();
+	result = run_particles(args, headless, NULL);
+	terminal_end_input();
 	return result;
 }
 
+randomwalk_result_t randomwalk_simulate(
+	randomwalk_args_t args,
+	randomwalk_stats_t* const stats
+) {
+	randomwalk_result_t result = validate_args(args);
+	if (result != RANDOMWALK_OK)
+		return result;
+	if (args.domains || args.shards)
+		return run_domains(args, stats);
+	return run_particles(args, true, stats);
+}
+
 static randomwalk_result_t validate_args(const randomwalk_args_t args) {
 	if (!args.width || !args.height)
 		return RANDOMWALK_BADDIM;
@@ -256,200 +351,498 @@ static void clear_screen() {
 	printf("\x1b[2J");
 }
 
-static uint8_t gen_uint8(const uint8_t min,	const uint8_t max) {
-	return (uint8_t)(rand() % (max + 1) + min);
+static void seed_rng(rng_t* const rng, const uint64_t seed) {
+	rng_seed(rng, seed ? seed : (uint64_t)time(NULL));
 }
 
 static randomwalk_result_t gen_coord(
 	coordinate_t* const coord,
 	const uint8_t width,
-	const uint8_t height
+	const uint8_t height,
+	rng_t* const rng
 ) {
 	if (!coord || !width || !height)
 		return RANDOMWALK_FAIL;
 	*coord = (coordinate_t){
-		.x = gen_uint8(0, width - 1),
-		.y = gen_uint8(0, height - 1)
+		.x = rng_uint8(rng, 0, width - 1),
+		.y = rng_uint8(rng, 0, height - 1)
 	};
 	return RANDOMWALK_OK;
 }
 
-static color_t gen_color() {
+static color_t gen_color(rng_t* const rng) {
 	return (color_t){
-		.r = gen_uint8(0, UINT8_MAX),
-		.g = gen_uint8(0, UINT8_MAX),
-		.b = gen_uint8(0, UINT8_MAX)
+		.r = rng_uint8(rng, 0, UINT8_MAX),
+		.g = rng_uint8(rng, 0, UINT8_MAX),
+		.b = rng_uint8(rng, 0, UINT8_MAX)
 	};
 }
 
-static direction_t gen_direction() {
-	return (direction_t)gen_uint8(0, DIRECTION_COUNT - 1);
+static direction_t gen_direction(rng_t* const rng) {
+	return (direction_t)rng_uint8(rng, 0, DIRECTION_COUNT - 1);
 }
 
-static randomwalk_result_t gen_direction_except(
-	direction_t* direction,
-	const direction_t exclude
+static randomwalk_result_t init_particles(
+	particle_store_t* const particles,
+	const randomwalk_args_t args,
+	rng_t* const rng
 ) {
-	if (exclude >= DIRECTION_COUNT)
-		return RANDOMWALK_FAIL;
-	direction_t directions[DIRECTION_COUNT - 1];
-	direction_t current = (direction_t)(0);
-	uint8_t i = 0;
-	while (i < DIRECTION_COUNT - 1 && current < DIRECTION_COUNT) {
-		if (current != exclude)
-			directions[i++] = (direction_t)current;
-		current++;
+	randomwalk_result_t result = particle_store_create(particles, args.particle_count);
+	if (result == RANDOMWALK_OK && args.counter_rng) {
+		result = regen_particles(particles, args, args.seek_step);
+		return result == RANDOMWALK_OK && !particles->count ? RANDOMWALK_DONE : result;
 	}
-	*direction = directions[gen_uint8(0, DIRECTION_COUNT - 2)];
-	return RANDOMWALK_OK;
+	if (result == RANDOMWALK_OK && args.init) {
+		spawn_distribution_t distribution;
+		result = spawn_parse(args.init, args.width, args.height, &distribution);
+		// Drawn rather than taken from the state, which tiles derive from
+		const uint64_t high = rng_next(rng);
+		const uint64_t seed = high << 32 | rng_next(rng);
+		if (result == RANDOMWALK_OK)
+			result = spawn_particles(particles, distribution, args.width, args.height, seed);
+		return result;
+	}
+	for (uint32_t i = 0; result == RANDOMWALK_OK && i < args.particle_count; i++) {
+		coordinate_t coord;
+		result = gen_coord(&coord, args.width, args.height, rng);
+		if (result != RANDOMWALK_OK)
+			return result;
+		const color_t color = gen_color(rng);
+		result = particle_store_push(particles, i, coord, gen_direction(rng), color);
+	}
+	return result;
 }
 
-static randomwalk_result_t init_particles(
-	particle_t** particle,
-	const uint8_t particle_count,
+static randomwalk_result_t draw_snapshot(
+	const particle_store_t* const particles,
 	const uint8_t width,
 	const uint8_t height
 ) {
-	if (!particle || *particle)
+	if (!particles)
 		return RANDOMWALK_FAIL;
-	particle_t** current = particle;
-	for (uint8_t i = 0; i < particle_count; i++) {
-		*current = (particle_t*)malloc(sizeof(particle_t));
-		randomwalk_result_t result = gen_coord(&(*current)->coord, width, height);
-		if (result != RANDOMWALK_OK)
-			return result;
-		(*current)->color = gen_color();
-		(*current)->direction = gen_direction();
-		(*current)->is_alive = true;
-		(*current)->next = NULL;
-		current = &(*current)->next;
+	for (uint32_t i = 0; i < particles->count; i++) {
+		if (particles->x[i] >= width || particles->y[i] >= height)
+			continue;
+		const color_t color = particles->color[i];
+		const uint8_t row = particles->y[i] + 1;
+		const uint8_t col = particles->x[i] + 1;
+		printf("\x1b[%d;%dH\x1b[48;2;%d;%d;%dm ", row, col, color.r, color.g, color.b);
 	}
+	fflush(stdout);
 	return RANDOMWALK_OK;
 }
 
-static randomwalk_result_t walk_particles(
-	particle_t* const particle,
-	const uint8_t width,
-	const uint8_t height,
-	const bool wrap
+static randomwalk_result_t run_particles(
+	randomwalk_args_t args,
+	const bool headless,
+	randomwalk_stats_t* const stats
 ) {
-	if (!particle || !width || !height)
-		return RANDOMWALK_FAIL;
-	// Shift coordinate by current direction:  N  NE  E SE  S  SW   W  NW
-	const int8_t delta_x[DIRECTION_COUNT] = {  0,  1, 1, 1, 0, -1, -1, -1 };
-	const int8_t delta_y[DIRECTION_COUNT] = { -1, -1, 0, 1, 1,  1,  0, -1 };
-	particle_t* current = particle;
-	while (current) {
-		const int16_t new_x = current->coord.x + delta_x[current->direction];
-		const int16_t new_y = current->coord.y + delta_y[current->direction];
-		if (wrap) {
-			current->coord.x = (uint8_t)(new_x > 0 ? new_x == width ? 0 : new_x : width - 1);
-			current->coord.y = (uint8_t)(new_y > 0 ? new_y == height ? 0 : new_y : height - 1);
-		} else if (new_x < 0 || new_y < 0 || new_x == width || new_y == height) {
-			current->is_alive = false;
-		} else {
-			current->coord.x = (uint8_t)new_x;
-			current->coord.y = (uint8_t)new_y;
+	// Checkpoints record the probability the run was regenerated with
+	if (args.counter_rng && !args.prob_dir_change)
+		args.prob_dir_change = DEFAULT_PROB_DIR_CHANGE;
+	// Particles start in and are drawn from the requested area alone, but roam
+	// and are observed on the whole padded plane
+	const randomwalk_args_t requested = args;
+	if (args.pad_pow2) {
+		args.width = kernel_pad_pow2(args.width);
+		args.height = kernel_pad_pow2(args.height);
+	}
+	rng_t rng;
+	seed_rng(&rng, args.seed);
+	observers_t observers;
+	randomwalk_result_t result = attach_observers(&observers, args, !headless);
+	particle_store_t particles = { 0 };
+	if (result == RANDOMWALK_OK)
+		result = init_particles(&particles, requested, &rng);
+	uint64_t step = args.counter_rng ? args.seek_step : 0;
+	if (result == RANDOMWALK_OK && observers.observer)
+		result = notify_observers(&observers, &particles, step, args);
+	const kernel_plane_t plane = {
+		.width = args.width,
+		.height = args.height,
+		.prob_dir_change = args.prob_dir_change ? args.prob_dir_change : DEFAULT_PROB_DIR_CHANGE,
+		.wrap = args.wrap,
+		.view_width = requested.width,
+		.view_height = requested.height
+	};
+	// Nothing observes individual steps, so the particles may be tiled in time
+	if (result == RANDOMWALK_OK && headless && !observers.observer && args.tile_steps &&
+		!args.counter_rng && !args.rng_buffer)
+		result = run_tiles(&particles, plane, args, &rng, &step);
+	// The producer continues the sequence of the generator from here on
+	rngbuf_t buffer = { 0 };
+	if (result == RANDOMWALK_OK && args.rng_buffer)
+		result = rngbuf_create(&buffer, rng);
+	while (result == RANDOMWALK_OK && (!args.max_steps || step < args.max_steps)) {
+		particle_store_t* const deaths = observers.observer ? &observers.deaths : NULL;
+		if (args.counter_rng)
+			result = kernel_step_counter(&particles, deaths, plane, !headless, args.seed, step + 1);
+		else if (args.rng_buffer)
+			result = kernel_step_buffered(&particles, deaths, plane, !headless, &buffer);
+		else
+			result = kernel_step(&particles, deaths, plane, !headless, &rng);
+		step++;
+		if (result != RANDOMWALK_OK && result != RANDOMWALK_DONE)
+			break;
+		if (observers.observer) {
+			const randomwalk_result_t notified = notify_observers(&observers, &particles, step, args);
+			if (notified != RANDOMWALK_OK)
+				result = notified;
+		}
+		if (headless)
+			continue;
+		millisleep(args.delay_ms);
+		for (int key; result == RANDOMWALK_OK && (key = terminal_read_key()) != TERMINAL_NO_KEY;) {
+			if (key == DUMP_KEY)
+				recorder_request_dump();
+			else if (key == PAUSE_KEY)
+				result = scrub_history(observers.history, requested);
 		}
-		current = current->next;
+		if (terminal_interrupted())
+			break;
 	}
-	return RANDOMWALK_OK;
+	if (buffer.words)
+		rngbuf_destroy(&buffer);
+	const randomwalk_result_t detached = detach_observers(&observers);
+	if (detached != RANDOMWALK_OK && (result == RANDOMWALK_OK || result == RANDOMWALK_DONE))
+		result = detached;
+	if (stats)
+		*stats = (randomwalk_stats_t){ .steps = step, .survivors = particles.count };
+	const randomwalk_result_t destroyed = particle_store_destroy(&particles);
+	return result == RANDOMWALK_OK ? destroyed : result;
+}
+
+static randomwalk_result_t run_diff(randomwalk_args_t args) {
+	if (!args.prob_dir_change)
+		args.prob_dir_change = DEFAULT_PROB_DIR_CHANGE;
+	bool diverged;
+	const randomwalk_result_t result =
+		engine_diff(refengine_get(), engine_find(args.diff_engine), args, stdout, &diverged);
+	return result == RANDOMWALK_OK && diverged ? RANDOMWALK_FAIL : result;
+}
+
+static randomwalk_result_t run_domains(
+	randomwalk_args_t args,
+	randomwalk_stats_t* const stats
+) {
+	if (!args.seed)
+		args.seed = (uint64_t)time(NULL);
+	if (!args.prob_dir_change)
+		args.prob_dir_change = DEFAULT_PROB_DIR_CHANGE;
+	return args.shards ? shard_run(args, stats) : domain_run(args, stats);
 }
 
-static randomwalk_result_t steer_particles(
-	particle_t* const particle,
-	const uint8_t prob_dir_change
+static randomwalk_result_t run_tiles(
+	particle_store_t* const particles,
+	const kernel_plane_t plane,
+	const randomwalk_args_t args,
+	rng_t* const rng,
+	uint64_t* const steps
 ) {
-	if (!particle)
+	const uint32_t tile_count = (particles->count + KERNEL_TILE_PARTICLES - 1) / KERNEL_TILE_PARTICLES;
+	particle_store_t* const tiles = (particle_store_t*)malloc(tile_count * sizeof(particle_store_t));
+	rng_t* const rngs = (rng_t*)malloc(tile_count * sizeof(rng_t));
+	if (!tiles || !rngs) {
+		free(tiles);
+		free(rngs);
 		return RANDOMWALK_FAIL;
-	particle_t* current = particle;
-	while (current) {
-		bool change_dir = gen_uint8(1, 100) <=
-			(prob_dir_change ? prob_dir_change : DEFAULT_PROB_DIR_CHANGE);
-		if (change_dir) {
-			randomwalk_result_t result =
-				gen_direction_except(&current->direction, current->direction);
-			if (result != RANDOMWALK_OK)
-				return result;
+	}
+	// Tiles are windows onto the store, each compacted in place
+	for (uint32_t t = 0; t < tile_count; t++) {
+		const uint32_t first = t * KERNEL_TILE_PARTICLES;
+		const uint32_t count = particles->count - first < KERNEL_TILE_PARTICLES ?
+			particles->count - first : KERNEL_TILE_PARTICLES;
+		tiles[t] = (particle_store_t){
+			.count = count,
+			.capacity = count,
+			.id = particles->id + first,
+			.x = particles->x + first,
+			.y = particles->y + first,
+			.direction = particles->direction + first,
+			.color = particles->color + first
+		};
+		rng_seed(&rngs[t], rng_derive(rng->state, t));
+	}
+	randomwalk_result_t result = RANDOMWALK_OK;
+	uint64_t step = 0, last_death = 0;
+	bool alive = tile_count;
+	while (result == RANDOMWALK_OK && alive && (!args.max_steps || step < args.max_steps)) {
+		const uint64_t block = args.max_steps && args.max_steps - step < args.tile_steps ?
+			args.max_steps - step : args.tile_steps;
+		alive = false;
+		for (uint32_t t = 0; result == RANDOMWALK_OK && t < tile_count; t++) {
+			if (!tiles[t].count)
+				continue;
+			uint64_t taken;
+			const randomwalk_result_t advanced =
+				kernel_advance(&tiles[t], plane, block, &rngs[t], &taken);
+			if (advanced == RANDOMWALK_DONE && step + taken > last_death)
+				last_death = step + taken;
+			else if (advanced == RANDOMWALK_OK)
+				alive = true;
+			else if (advanced != RANDOMWALK_DONE)
+				result = advanced;
 		}
-		current = current->next;
+		step += block;
 	}
-	return RANDOMWALK_OK;
+	// Gather the survivors of every tile back to the front of the store
+	uint32_t survivors = 0;
+	for (uint32_t t = 0; t < tile_count; t++) {
+		const particle_store_t tile = tiles[t];
+		memmove(particles->id + survivors, tile.id, tile.count * sizeof(uint32_t));
+		memmove(particles->x + survivors, tile.x, tile.count);
+		memmove(particles->y + survivors, tile.y, tile.count);
+		memmove(particles->direction + survivors, tile.direction, tile.count);
+		memmove(particles->color + survivors, tile.color, tile.count * sizeof(color_t));
+		survivors += tile.count;
+	}
+	particles->count = survivors;
+	*steps = alive ? step : last_death;
+	free(tiles);
+	free(rngs);
+	if (result != RANDOMWALK_OK)
+		return result;
+	return survivors ? RANDOMWALK_OK : RANDOMWALK_DONE;
 }
 
-static randomwalk_result_t draw_particles(particle_t* const particle) {
-	if (!particle)
-		return RANDOMWALK_FAIL;
-	particle_t* current = particle;
-	while (current) {
-		const uint8_t red = current->color.r;
-		const uint8_t green = current->color.g;
-		const uint8_t blue = current->color.b;
-		const uint8_t row = current->coord.y + 1;
-		const uint8_t col = current->coord.x + 1;
-		printf("\x1b[%d;%dH\x1b[48;2;%d;%d;%dm ", row, col, red, green, blue);
-		current = current->next;
+static randomwalk_result_t scrub_history(
+	const history_t* const history,
+	const randomwalk_args_t args
+) {
+	uint64_t first, last;
+	randomwalk_result_t result = history_range(history, &first, &last);
+	particle_store_t particles = { 0 };
+	if (result == RANDOMWALK_OK)
+		result = particle_store_create(&particles, args.particle_count);
+	uint64_t step = last;
+	bool moved = true, resumed = false;
+	while (result == RANDOMWALK_OK && !resumed && !terminal_interrupted()) {
+		if (moved) {
+			result = history_restore(history, step, &particles);
+			if (result != RANDOMWALK_OK)
+				break;
+			clear_screen();
+			draw_snapshot(&particles, args.width, args.height);
+			printf("\x1b[0m\x1b[%d;1Hstep %lu of %lu-%lu (paused)", args.height + 1, step, first, last);
+			fflush(stdout);
+			moved = false;
+		}
+		millisleep(args.delay_ms);
+		for (int key; (key = terminal_read_key()) != TERMINAL_NO_KEY;) {
+			const uint64_t previous = step;
+			if (key == TERMINAL_KEY_LEFT && step > first)
+				step--;
+			else if (key == TERMINAL_KEY_RIGHT && step < last)
+				step++;
+			else if (key == TERMINAL_KEY_DOWN)
+				step = step - first > SCRUB_JUMP ? step - SCRUB_JUMP : first;
+			else if (key == TERMINAL_KEY_UP)
+				step = last - step > SCRUB_JUMP ? step + SCRUB_JUMP : last;
+			else if (key == DUMP_KEY)
+				recorder_request_dump();
+			else if (key == PAUSE_KEY)
+				resumed = true;
+			moved = moved || step != previous;
+		}
 	}
-	fflush(stdout);
-	return RANDOMWALK_OK;
+	// Trails of the live run are drawn afresh from here on
+	clear_screen();
+	particle_store_destroy(&particles);
+	return result;
 }
 
-static randomwalk_result_t validate_particles(particle_t** particle) {
-	if (!*particle)
-		return RANDOMWALK_FAIL;
-	particle_t* current = *particle;
-	// Deallocate from head of singly-linked-list
-	while (current && !current->is_alive) {
-		*particle = current->next;
-		current->next = NULL;
-		free(current);
-		current = *particle;
+static randomwalk_result_t attach_observers(
+	observers_t* const observers,
+	const randomwalk_args_t args,
+	const bool interactive
+) {
+	*observers = (observers_t){ 0 };
+	observer_t** tail = &observers->observer;
+	if (args.shm_name) {
+		randomwalk_result_t result = frameshm_create(
+			&observers->shm,
+			args.shm_name,
+			args.width,
+			args.height,
+			args.particle_count,
+			args.wrap
+		);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->shm_observer = (observer_t){ frameshm_observe, observers->shm, NULL };
+		*tail = &observers->shm_observer;
+		tail = &observers->shm_observer.next;
 	}
-	// Deallocate head-trailing segments of singly-linked-list
-	while (current && current->next) {
-		if (!current->next->is_alive) {
-			particle_t* next = current->next;
-			current->next = next->next;
-			next->next = NULL;
-			free(next);
-		} else {
-			current = current->next;
-		}
+	if (args.serve_path) {
+		randomwalk_result_t result = frameserver_create(
+			&observers->server,
+			args.serve_path,
+			args.width,
+			args.height
+		);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->server_observer =
+			(observer_t){ frameserver_observe, observers->server, NULL };
+		*tail = &observers->server_observer;
+		tail = &observers->server_observer.next;
+	}
+	if (args.export_format != RANDOMWALK_EXPORT_NONE) {
+		randomwalk_result_t result = frameexport_create(
+			&observers->exporter,
+			args.export_format,
+			args.export_path,
+			args.width,
+			args.height,
+			args.export_scale,
+			args.delay_ms
+		);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->export_observer =
+			(observer_t){ frameexport_observe, observers->exporter, NULL };
+		*tail = &observers->export_observer;
+		tail = &observers->export_observer.next;
+	}
+	if (args.stream) {
+		randomwalk_result_t result = eventstream_create(
+			&observers->stream,
+			STDOUT_FILENO,
+			args,
+			args.stream_positions
+		);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->stream_observer =
+			(observer_t){ eventstream_observe, observers->stream, NULL };
+		*tail = &observers->stream_observer;
+		tail = &observers->stream_observer.next;
+	}
+	if (args.record_steps) {
+		randomwalk_result_t result = recorder_create(
+			&observers->recorder,
+			args.record_steps,
+			args.record_path ? args.record_path : DEFAULT_RECORD_PATH,
+			args
+		);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->recorder_observer =
+			(observer_t){ recorder_observe, observers->recorder, NULL };
+		*tail = &observers->recorder_observer;
+		tail = &observers->recorder_observer.next;
+	}
+	if (args.trajectory_path) {
+		randomwalk_result_t result = trajectory_writer_create(
+			&observers->trajectory,
+			args.trajectory_path,
+			args.trajectory_block,
+			args
+		);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->trajectory_observer =
+			(observer_t){ trajectory_writer_observe, observers->trajectory, NULL };
+		*tail = &observers->trajectory_observer;
+		tail = &observers->trajectory_observer.next;
+	}
+	if (args.death_log_path) {
+		randomwalk_result_t result =
+			deathlog_create(&observers->death_log, args.death_log_path, args);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->death_log_observer =
+			(observer_t){ deathlog_observe, observers->death_log, NULL };
+		*tail = &observers->death_log_observer;
+		tail = &observers->death_log_observer.next;
+	}
+	if (args.checkpoint_interval) {
+		randomwalk_result_t result = checkpoint_writer_create(
+			&observers->checkpoint,
+			args.checkpoint_path,
+			args.checkpoint_interval,
+			args
+		);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->checkpoint_observer =
+			(observer_t){ checkpoint_writer_observe, observers->checkpoint, NULL };
+		*tail = &observers->checkpoint_observer;
+		tail = &observers->checkpoint_observer.next;
 	}
-	return *particle ? RANDOMWALK_OK : RANDOMWALK_DONE;
+	if (interactive) {
+		const uint32_t kib = args.history_kib ? args.history_kib : DEFAULT_HISTORY_KIB;
+		randomwalk_result_t result =
+			history_create(&observers->history, (size_t)kib * 1024, args);
+		if (result != RANDOMWALK_OK)
+			return result;
+		observers->history_observer =
+			(observer_t){ history_observe, observers->history, NULL };
+		*tail = &observers->history_observer;
+		tail = &observers->history_observer.next;
+	}
+	if (!observers->observer)
+		return RANDOMWALK_OK;
+	randomwalk_result_t result = particle_store_create(&observers->deaths, args.particle_count);
+	if (result == RANDOMWALK_OK)
+		result = framebuffer_create(&observers->framebuffer, args.width, args.height);
+	return result;
 }
 
-static randomwalk_result_t compute_particles(
-	particle_t** particle,
-	const uint8_t width,
-	const uint8_t height,
-	const uint8_t prob_dir_change,
-	const bool wrap
+static randomwalk_result_t notify_observers(
+	observers_t* const observers,
+	const particle_store_t* const particles,
+	const uint64_t step,
+	const randomwalk_args_t args
 ) {
-	randomwalk_result_t result = draw_particles(*particle);
-	if (result != RANDOMWALK_OK)
-		return result;
-	result = steer_particles(*particle, prob_dir_change);
-	if (result != RANDOMWALK_OK)
-		return result;
-	result = walk_particles(*particle, width, height, wrap);
+	// Particles are drawn before they move, so the deaths of this step were
+	// painted at their last coordinate in the previous one
+	randomwalk_result_t result = framebuffer_paint(&observers->framebuffer, particles);
 	if (result != RANDOMWALK_OK)
 		return result;
-	return validate_particles(particle);
-}
-
-static randomwalk_result_t destroy_particles(particle_t** particle) {
-	if (!particle)
-		return RANDOMWALK_FAIL;
-	particle_t* current = *particle;
-	while (current) {
-		*particle = current->next;
-		free(current);
-		current = *particle;
+	const frame_t frame = {
+		.step = step,
+		.width = args.width,
+		.height = args.height,
+		.wrap = args.wrap,
+		.particles = particles,
+		.deaths = &observers->deaths,
+		.framebuffer = &observers->framebuffer
+	};
+	for (observer_t* current = observers->observer; current; current = current->next) {
+		result = current->observe(current->context, &frame);
+		if (result != RANDOMWALK_OK)
+			return result;
 	}
 	return RANDOMWALK_OK;
 }
 
+static randomwalk_result_t detach_observers(observers_t* const observers) {
+	randomwalk_result_t result = RANDOMWALK_OK;
+	if (observers->shm)
+		result = frameshm_destroy(&observers->shm);
+	if (observers->server && frameserver_destroy(&observers->server) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	if (observers->exporter && frameexport_destroy(&observers->exporter) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	if (observers->stream && eventstream_destroy(&observers->stream) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	if (observers->recorder && recorder_destroy(&observers->recorder) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	if (observers->trajectory && trajectory_writer_destroy(&observers->trajectory) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	if (observers->death_log && deathlog_destroy(&observers->death_log) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	if (observers->checkpoint && checkpoint_writer_destroy(&observers->checkpoint) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	if (observers->history && history_destroy(&observers->history) != RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	particle_store_destroy(&observers->deaths);
+	framebuffer_destroy(&observers->framebuffer);
+	*observers = (observers_t){ 0 };
+	return result;
+}
+
 static void millisleep(const uint16_t delay) {
 	const uint8_t seconds = (delay ? delay : DEFAULT_DELAY_MILLIS) /
 		MILLIS_PER_SECOND;
@@ -11,17 +11,71 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/**
+ * @brief Formats frames may be exported in instead of drawing them.
+ */
+typedef enum {
+	RANDOMWALK_EXPORT_NONE = 0, // Draw frames to the terminal
+	RANDOMWALK_EXPORT_PPM,      // Write one PPM image per frame into a directory
+	RANDOMWALK_EXPORT_Y4M       // Write a Y4M video stream to standard output
+} randomwalk_export_t;
+
 /**
  * @brief Arguments to be given to the random walk program.
  */
 typedef struct {
 	uint8_t width, height;
-	uint8_t particle_count;
+	uint32_t particle_count;
 	uint8_t prob_dir_change;
 	uint16_t delay_ms;
+	bool headless;      // Skip drawing and frame delays, as exports and streams do
 	bool wrap;
+	uint64_t seed;      // 0 seeds from the current time
+	uint64_t max_steps; // 0 runs until all particles die
+	const char* init;   // Initial distribution of particles placed in parallel,
+	                    // such as "gaussian:32,16,4"; NULL places them in turn
+	bool counter_rng;   // Draw each step of each particle from (seed, id, step)
+	uint64_t seek_step; // Step a counter-based run is regenerated at and resumed from
+	bool rng_buffer;    // Read random words from a buffer filled by a producer thread
+	bool pad_pow2;      // Pad a wrapping plane to powers of two, drawing only the requested area
+	const char* isa;    // Instruction set of the kernels; NULL selects by the CPU
+	const char* diff_engine; // Engine checked against the reference engine instead of running
+	const char* checkpoint_path;  // File checkpoints are written to or sought from
+	uint32_t checkpoint_interval; // Steps between written checkpoints
+	const char* shm_name;   // Shared memory segment to publish frames to
+	const char* serve_path; // Unix domain socket to stream frames on
+	randomwalk_export_t export_format;
+	const char* export_path; // Directory to write exported images into
+	uint8_t export_scale;    // Side length in pixels of each exported cell
+	bool stream;               // Write a binary event stream to standard output
+	uint32_t stream_positions; // Steps between streamed position batches
+	uint32_t record_steps;   // Most recent steps kept by the flight recorder
+	const char* record_path; // File the flight recorder dumps to
+	uint32_t history_kib;    // Memory budget of interactive rewinding
+	const char* trajectory_path; // File to write every step to
+	uint32_t trajectory_block;   // Most steps per trajectory block
+	const char* death_log_path;  // File to log each death to
+	uint32_t tile_steps; // Steps each tile of particles advances at once headlessly
+	uint16_t domains;        // Threads each owning a strip of the plane; 0 runs one engine
+	uint16_t shards;         // Processes each owning a strip of the plane; 0 runs one engine
+	const char* visits_path; // File to write per-cell visit counts of a strip run to
+	const char* cpus;        // CPUs to pin strips to in turn, such as "0,2,4-7"
+	bool numa_report;        // Print the CPU and memory placement of each strip
 } randomwalk_args_t;
 
+/**
+ * @brief Statistics gathered from a single random walk run.
+ */
+typedef struct {
+	uint64_t steps;     // Number of steps simulated
+	uint32_t survivors; // Number of particles alive after the final step
+} randomwalk_stats_t;
+
+/**
+ * @brief The probability of direction change of runs given none.
+ */
+extern const uint8_t DEFAULT_PROB_DIR_CHANGE;
+
 /**
  * @brief Result codes returned by the random walk program.
  */
@@ -42,4 +96,15 @@ typedef enum {
  */
 randomwalk_result_t randomwalk(randomwalk_args_t args);
 
+/**
+ * @brief Execute Random Walk headlessly, without drawing or frame delays.
+ * @param[in] args A structure of arguments to configure random walk with.
+ * @param[out] stats Statistics gathered from the run.
+ * @return An enum denoting the random walk result code.
+ */
+randomwalk_result_t randomwalk_simulate(
+	randomwalk_args_t args,
+	randomwalk_stats_t* const stats
+);
+
 #endif // RANDOMWALK_H
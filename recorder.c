@@ -0,0 +1,331 @@
+/**
+ * @file recorder.c
+ * @brief A flight recorder keeping the most recent steps of a random walk.
+ * @author Justin Thoreson
+ */
+
+#include "recorder.h"
+#include "delta.h"
+#include "particles.h"
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct recorder_t {
+	uint32_t capacity; // Number of deltas dumped
+	char* path;
+	uint8_t width, height;
+	bool wrap;
+	bool started;
+	uint64_t keyframe_step;
+	particle_store_t keyframes[2]; // Particles as of the oldest held step, and
+	                               // as of capacity steps after it
+	uint8_t oldest;                // The keyframe of the oldest held step
+	uint8_t* deltas;               // Ring of 2 * capacity deltas of slot_size bytes
+	uint32_t* counts;              // Particles alive before each delta
+	size_t slot_size;
+	uint32_t head, length;
+};
+
+/**
+ * @brief The magic bytes opening a recording file.
+ */
+static const char RECORDING_MAGIC[8] = { 'R', 'W', 'R', 'E', 'C', '0', '0', '1' };
+
+/**
+ * @brief The bytes of a particle in a recording file.
+ */
+#define RECORD_PARTICLE_SIZE 10
+
+/**
+ * @brief The most particles gathered before writing them to a recording file.
+ */
+#define RECORD_BLOCK_PARTICLES 4096
+
+/**
+ * @brief Whether a dump was requested by signal or key press.
+ */
+static volatile sig_atomic_t dump_requested = 0;
+
+/**
+ * @brief Request a dump from a signal handler.
+ * @param[in] signal The caught signal.
+ */
+static void handle_dump_signal(int signal);
+
+/**
+ * @brief Write an unsigned integer in little-endian byte order.
+ * @param[in,out] file The file to write to.
+ * @param[in] value The value to write.
+ * @param[in] size The number of bytes to write.
+ * @return True if the value was written, false otherwise.
+ */
+static bool write_le(FILE* const file, uint64_t value, const size_t size);
+
+/**
+ * @brief Read an unsigned integer in little-endian byte order.
+ * @param[in,out] file The file to read from.
+ * @param[out] value The value read.
+ * @param[in] size The number of bytes to read.
+ * @return True if the value was read, false otherwise.
+ */
+static bool read_le(FILE* const file, uint64_t* const value, const size_t size);
+
+/**
+ * @brief Draw particles to the terminal.
+ * @param[in] particles The particles to draw.
+ */
+static void draw(const particle_store_t* const particles);
+
+randomwalk_result_t recorder_create(
+	recorder_t** recorder,
+	const uint32_t capacity,
+	const char* const path,
+	const randomwalk_args_t args
+) {
+	if (!recorder || *recorder || !capacity || !path)
+		return RANDOMWALK_FAIL;
+	recorder_t* const created = (recorder_t*)calloc(1, sizeof(recorder_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	*recorder = created;
+	created->capacity = capacity;
+	created->width = args.width;
+	created->height = args.height;
+	created->wrap = args.wrap;
+	created->slot_size = delta_size(args.particle_count);
+	created->path = strdup(path);
+	created->deltas = (uint8_t*)malloc((size_t)capacity * 2 * created->slot_size);
+	created->counts = (uint32_t*)malloc((size_t)capacity * 2 * sizeof(uint32_t));
+	if (!created->path || !created->deltas || !created->counts ||
+		particle_store_create(&created->keyframes[0], args.particle_count) != RANDOMWALK_OK ||
+		particle_store_create(&created->keyframes[1], args.particle_count) != RANDOMWALK_OK) {
+		recorder_destroy(recorder);
+		return RANDOMWALK_FAIL;
+	}
+	struct sigaction action = { .sa_handler = handle_dump_signal };
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGUSR1, &action, NULL);
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t recorder_observe(void* context, const frame_t* const frame) {
+	recorder_t* const recorder = (recorder_t*)context;
+	if (!recorder || !frame || !frame->particles || !frame->deaths)
+		return RANDOMWALK_FAIL;
+	randomwalk_result_t result = RANDOMWALK_OK;
+	if (!recorder->started) {
+		recorder->started = true;
+		recorder->keyframe_step = frame->step;
+		result = particle_store_copy(&recorder->keyframes[recorder->oldest], frame->particles);
+	} else {
+		// The particles before the step are the survivors and the deaths, so
+		// the step is encoded without keeping a copy of them
+		const uint32_t ring = recorder->capacity * 2;
+		const uint32_t slot = (recorder->head + recorder->length) % ring;
+		recorder->counts[slot] = frame->particles->count + frame->deaths->count;
+		result = delta_encode_step(
+			recorder->deltas + slot * recorder->slot_size,
+			frame->particles,
+			frame->deaths
+		);
+		if (++recorder->length == ring) {
+			// The newer keyframe covers the older half of the ring, so it is dropped
+			recorder->oldest ^= 1;
+			recorder->keyframe_step += recorder->capacity;
+			recorder->head = (recorder->head + recorder->capacity) % ring;
+			recorder->length = recorder->capacity;
+		}
+		// Taken once every capacity steps rather than folding a delta each step
+		if (result == RANDOMWALK_OK && recorder->length == recorder->capacity)
+			result = particle_store_copy(&recorder->keyframes[recorder->oldest ^ 1], frame->particles);
+	}
+	if (result == RANDOMWALK_OK && dump_requested) {
+		dump_requested = 0;
+		result = recorder_dump(recorder);
+	}
+	return result;
+}
+
+void recorder_request_dump() {
+	dump_requested = 1;
+}
+
+randomwalk_result_t recorder_dump(const recorder_t* const recorder) {
+	if (!recorder || !recorder->started)
+		return RANDOMWALK_FAIL;
+	// Write beside the recording and rename, so a dump is never seen half-written
+	const size_t path_size = strlen(recorder->path) + sizeof(".tmp");
+	char temporary[path_size];
+	snprintf(temporary, path_size, "%s.tmp", recorder->path);
+	// Deltas held beyond the capacity are folded into a copy of the keyframe
+	const uint32_t ring = recorder->capacity * 2;
+	const uint32_t skipped = recorder->length > recorder->capacity ?
+		recorder->length - recorder->capacity : 0;
+	const particle_store_t* const oldest = &recorder->keyframes[recorder->oldest];
+	particle_store_t folded = { 0 };
+	if (skipped && (particle_store_create(&folded, oldest->capacity) != RANDOMWALK_OK ||
+		particle_store_copy(&folded, oldest) != RANDOMWALK_OK)) {
+		particle_store_destroy(&folded);
+		return RANDOMWALK_FAIL;
+	}
+	for (uint32_t i = 0; i < skipped; i++)
+		delta_apply(
+			&folded,
+			recorder->deltas + (recorder->head + i) % ring * recorder->slot_size,
+			recorder->width,
+			recorder->height,
+			recorder->wrap
+		);
+	const particle_store_t* const keyframe = skipped ? &folded : oldest;
+	FILE* const file = fopen(temporary, "wb");
+	bool written = file && fwrite(RECORDING_MAGIC, sizeof(RECORDING_MAGIC), 1, file) == 1 &&
+		write_le(file, recorder->width, 1) &&
+		write_le(file, recorder->height, 1) &&
+		write_le(file, recorder->wrap, 1) &&
+		write_le(file, 0, 1) &&
+		write_le(file, recorder->keyframe_step + skipped, 8) &&
+		write_le(file, keyframe->count, 4);
+	// Particles are gathered into records a block at a time rather than
+	// written field by field
+	uint8_t records[RECORD_BLOCK_PARTICLES * RECORD_PARTICLE_SIZE];
+	for (uint32_t first = 0; written && first < keyframe->count; first += RECORD_BLOCK_PARTICLES) {
+		const uint32_t count = keyframe->count - first < RECORD_BLOCK_PARTICLES ?
+			keyframe->count - first : RECORD_BLOCK_PARTICLES;
+		for (uint32_t i = 0; i < count; i++) {
+			uint8_t* const record = records + i * RECORD_PARTICLE_SIZE;
+			const uint32_t id = keyframe->id[first + i];
+			for (uint8_t byte = 0; byte < 4; byte++)
+				record[byte] = (uint8_t)(id >> byte * 8);
+			record[4] = keyframe->x[first + i];
+			record[5] = keyframe->y[first + i];
+			record[6] = keyframe->direction[first + i];
+			record[7] = keyframe->color[first + i].r;
+			record[8] = keyframe->color[first + i].g;
+			record[9] = keyframe->color[first + i].b;
+		}
+		written = fwrite(records, RECORD_PARTICLE_SIZE, count, file) == count;
+	}
+	written = written && write_le(file, recorder->length - skipped, 4);
+	for (uint32_t i = skipped; written && i < recorder->length; i++) {
+		const uint32_t slot = (recorder->head + i) % ring;
+		const size_t size = delta_size(recorder->counts[slot]);
+		written = !size ||
+			fwrite(recorder->deltas + slot * recorder->slot_size, size, 1, file) == 1;
+	}
+	if (folded.capacity)
+		particle_store_destroy(&folded);
+	if (!file || fclose(file) || !written || rename(temporary, recorder->path)) {
+		remove(temporary);
+		return RANDOMWALK_FAIL;
+	}
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t recorder_destroy(recorder_t** recorder) {
+	if (!recorder || !*recorder)
+		return RANDOMWALK_FAIL;
+	recorder_t* const destroyed = *recorder;
+	const randomwalk_result_t result = destroyed->started ?
+		recorder_dump(destroyed) : RANDOMWALK_OK;
+	signal(SIGUSR1, SIG_DFL);
+	particle_store_destroy(&destroyed->keyframes[0]);
+	particle_store_destroy(&destroyed->keyframes[1]);
+	free(destroyed->counts);
+	free(destroyed->deltas);
+	free(destroyed->path);
+	free(destroyed);
+	*recorder = NULL;
+	return result;
+}
+
+randomwalk_result_t recorder_replay(const char* const path, const uint16_t delay_ms) {
+	FILE* const file = path ? fopen(path, "rb") : NULL;
+	if (!file)
+		return RANDOMWALK_FAIL;
+	char magic[sizeof(RECORDING_MAGIC)];
+	uint64_t width, height, wrap, reserved, step, count;
+	if (fread(magic, sizeof(magic), 1, file) != 1 ||
+		memcmp(magic, RECORDING_MAGIC, sizeof(magic)) ||
+		!read_le(file, &width, 1) || !read_le(file, &height, 1) ||
+		!read_le(file, &wrap, 1) || !read_le(file, &reserved, 1) ||
+		!read_le(file, &step, 8) || !read_le(file, &count, 4) || !width || !height) {
+		fclose(file);
+		return RANDOMWALK_FAIL;
+	}
+	particle_store_t particles;
+	uint8_t* const delta = (uint8_t*)malloc(delta_size((uint32_t)count) + 1);
+	if (!delta || particle_store_create(&particles, (uint32_t)count) != RANDOMWALK_OK) {
+		free(delta);
+		fclose(file);
+		return RANDOMWALK_FAIL;
+	}
+	bool read = true;
+	for (uint64_t i = 0; read && i < count; i++) {
+		uint64_t id, x, y, direction, r, g, b;
+		read = read_le(file, &id, 4) && read_le(file, &x, 1) && read_le(file, &y, 1) &&
+			read_le(file, &direction, 1) && read_le(file, &r, 1) &&
+			read_le(file, &g, 1) && read_le(file, &b, 1) && x < width && y < height &&
+			particle_store_push(
+				&particles,
+				(uint32_t)id,
+				(coordinate_t){ (uint8_t)x, (uint8_t)y },
+				(direction_t)direction,
+				(color_t){ (uint8_t)r, (uint8_t)g, (uint8_t)b }
+			) == RANDOMWALK_OK;
+	}
+	uint64_t delta_count = 0;
+	read = read && read_le(file, &delta_count, 4);
+	printf("\x1b[2J");
+	draw(&particles);
+	const struct timespec pause = {
+		(delay_ms ? delay_ms : 25) / 1000,
+		(delay_ms ? delay_ms : 25) % 1000 * 1000000L
+	};
+	for (uint64_t i = 0; read && i < delta_count; i++) {
+		const size_t size = delta_size(particles.count);
+		read = (!size || fread(delta, size, 1, file) == 1) &&
+			delta_apply(&particles, delta, (uint8_t)width, (uint8_t)height, wrap) == RANDOMWALK_OK;
+		nanosleep(&pause, NULL);
+		draw(&particles);
+	}
+	printf("\x1b[0m\x1b[%u;1H", (unsigned)height + 1);
+	particle_store_destroy(&particles);
+	free(delta);
+	fclose(file);
+	return read ? RANDOMWALK_DONE : RANDOMWALK_FAIL;
+}
+
+static void handle_dump_signal(int signal) {
+	(void)signal;
+	dump_requested = 1;
+}
+
+static bool write_le(FILE* const file, uint64_t value, const size_t size) {
+	uint8_t bytes[8];
+	for (size_t i = 0; i < size; i++, value >>= 8)
+		bytes[i] = (uint8_t)value;
+	return fwrite(bytes, size, 1, file) == 1;
+}
+
+static bool read_le(FILE* const file, uint64_t* const value, const size_t size) {
+	uint8_t bytes[8];
+	if (fread(bytes, size, 1, file) != 1)
+		return false;
+	*value = 0;
+	for (size_t i = size; i > 0; i--)
+		*value = *value << 8 | bytes[i - 1];
+	return true;
+}
+
+static void draw(const particle_store_t* const particles) {
+	for (uint32_t i = 0; i < particles->count; i++) {
+		const color_t color = particles->color[i];
+		printf("\x1b[%d;%dH\x1b[48;2;%d;%d;%dm ",
+			particles->y[i] + 1, particles->x[i] + 1, color.r, color.g, color.b);
+	}
+	fflush(stdout);
+}
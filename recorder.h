@@ -0,0 +1,88 @@
+/**
+ * @file recorder.h
+ * @brief A flight recorder keeping the most recent steps of a random walk.
+ * @author Justin Thoreson
+ *
+ * The recorder keeps a keyframe taken once every retained number of steps and
+ * a ring buffer of up to twice that many deltas since, so its memory is
+ * bounded by the number of steps retained. Each delta is encoded from the
+ * survivors and deaths of its step, and the deltas older than those retained
+ * are folded into the keyframe only when dumping.
+ *
+ * A recording file holds, in little-endian order: the magic "RWREC001", uint8
+ * width, uint8 height, uint8 wrap, uint8 reserved, uint64 step of the keyframe,
+ * uint32 particle count, that many particles (uint32 id, uint8 x, uint8 y,
+ * uint8 direction, uint8 red, uint8 green, uint8 blue), uint32 delta count and
+ * the deltas of each following step, each sized by the particles alive before it.
+ */
+
+#pragma once
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "observer.h"
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief A flight recorder.
+ */
+typedef struct recorder_t recorder_t;
+
+/**
+ * @brief Create a flight recorder.
+ *
+ * A dump may afterwards be requested by sending SIGUSR1 to the process.
+ *
+ * @param[out] recorder The created recorder.
+ * @param[in] capacity The number of most recent steps to retain.
+ * @param[in] path The file to dump recordings to.
+ * @param[in] args The random walk arguments.
+ * @return The result of creating the recorder.
+ */
+randomwalk_result_t recorder_create(
+	recorder_t** recorder,
+	const uint32_t capacity,
+	const char* const path,
+	const randomwalk_args_t args
+);
+
+/**
+ * @brief Record a frame; an observer_t callback.
+ *
+ * Dumps the recording afterwards if a dump was requested.
+ *
+ * @param[in,out] context The recorder_t to record with.
+ * @param[in] frame The frame to record.
+ * @return The result of recording the frame.
+ */
+randomwalk_result_t recorder_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Request a dump once the current step has been recorded.
+ */
+void recorder_request_dump();
+
+/**
+ * @brief Write the retained steps to the recording file.
+ * @param[in] recorder The recorder to dump.
+ * @return The result of dumping the recording.
+ */
+randomwalk_result_t recorder_dump(const recorder_t* const recorder);
+
+/**
+ * @brief Dump the recording a final time and free the recorder.
+ * @param[in,out] recorder The recorder to destroy.
+ * @return The result of destroying the recorder.
+ */
+randomwalk_result_t recorder_destroy(recorder_t** recorder);
+
+/**
+ * @brief Draw a recording to the terminal, step by step.
+ * @param[in] path The recording file to replay.
+ * @param[in] delay_ms The delay between frames in milliseconds.
+ * @return The result of replaying the recording.
+ */
+randomwalk_result_t recorder_replay(const char* const path, const uint16_t delay_ms);
+
+#endif // RECORDER_H
@@ -0,0 +1,320 @@
+/**
+ * @file refengine.c
+ * @brief The reference engine: the linked list of particles the random walk
+ * was first written with, drawing from counter-based generators.
+ * @author Justin Thoreson
+ */
+
+#include "refengine.h"
+#include "rng.h"
+#include "spawn.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * @brief A particle that takes a random walk.
+ *
+ * Particles are structure in a singly-linked-list-like fashion.
+ */
+typedef struct particle_t {
+	struct particle_t* next;
+	bool is_alive;
+	uint32_t id;
+	direction_t direction;
+	color_t color;
+	coordinate_t coord;
+} particle_t;
+
+/**
+ * @brief The state of a reference engine.
+ */
+typedef struct {
+	particle_t* particle; // The first particle
+	uint8_t width, height;
+	uint8_t prob_dir_change;
+	bool wrap;
+	uint64_t seed;
+} refengine_t;
+
+/**
+ * @brief Generate a random cardinal direction except one that is specified.
+ * @param[out] direction A generated direction.
+ * @param[in] exclude The direction to exclude from random generation.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @return The result of generating a direction.
+ */
+static randomwalk_result_t gen_direction_except(
+	direction_t* direction,
+	const direction_t exclude,
+	rng_t* const rng
+);
+
+/**
+ * @brief Walk all particles forward in their respective directions of movement.
+ * @param[in,out] particle The first particle to walk.
+ * @param[in] width The width of the plane
+ * @param[in] height The height of the plane
+ * @param[in] wrap Whether to return particles to the opposite edge of egress.
+ * @return The result of the particles taking a walk.
+ */
+static randomwalk_result_t walk_particles(
+	particle_t* const particle,
+	const uint8_t width,
+	const uint8_t height,
+	const bool wrap
+);
+
+/**
+ * @brief Steer all particles in a new random direction.
+ *
+ * Particles change direction probabilistically.
+ *
+ * @param[in,out] particle The first particle to steer.
+ * @param[in] prob_dir_change The probability of a particle changing direction.
+ * @param[in] seed The seed of the run.
+ * @param[in] step The step taken.
+ * @return The result of steering the particles.
+ */
+static randomwalk_result_t steer_particles(
+	particle_t* const particle,
+	const uint8_t prob_dir_change,
+	const uint64_t seed,
+	const uint64_t step
+);
+
+/**
+ * @brief Validate the live status of all particles
+ *
+ * If any particle has died, it is deallocated from memory, never to return.
+ *
+ * @param[in,out] particle The first particle to validate.
+ * @return The result of validating the particles.
+ */
+static randomwalk_result_t validate_particles(particle_t** particle);
+
+/**
+ * @brief Destroy all particles.
+ * @param[in,out] particle The first particle to destroy.
+ * @return The result of destroying the particles.
+ */
+static randomwalk_result_t destroy_particles(particle_t** particle);
+
+/**
+ * @brief Place the particles of a run in a list; an engine init function.
+ * @param[out] engine The state of the created engine.
+ * @param[in] args The random walk arguments.
+ * @return The result of placing the particles.
+ */
+static randomwalk_result_t init_engine(void** engine, const randomwalk_args_t args);
+
+/**
+ * @brief Conduct a single step of the random walk; an engine step function.
+ * @param[in,out] engine The engine to advance.
+ * @param[in] step The step taken.
+ * @return RANDOMWALK_OK while particles remain, RANDOMWALK_DONE once none do.
+ */
+static randomwalk_result_t compute_particles(void* engine, const uint64_t step);
+
+/**
+ * @brief Copy the particles of the list in order; an engine observe function.
+ * @param[in] engine The engine to observe.
+ * @param[out] particles The store to copy into.
+ * @return The result of copying the particles.
+ */
+static randomwalk_result_t observe_engine(void* engine, particle_store_t* const particles);
+
+/**
+ * @brief Free the list and the engine; an engine destroy function.
+ * @param[in,out] engine The state of the engine to destroy.
+ * @return The result of destroying the engine.
+ */
+static randomwalk_result_t destroy_engine(void** engine);
+
+/**
+ * @brief The operations of the reference engine.
+ */
+static const engine_t REFENGINE = {
+	.name = "reference",
+	.init = init_engine,
+	.step = compute_particles,
+	.observe = observe_engine,
+	.destroy = destroy_engine
+};
+
+const engine_t* refengine_get(void) {
+	return &REFENGINE;
+}
+
+static randomwalk_result_t gen_direction_except(
+	direction_t* direction,
+	const direction_t exclude,
+	rng_t* const rng
+) {
+	if (exclude >= DIRECTION_COUNT)
+		return RANDOMWALK_FAIL;
+	direction_t directions[DIRECTION_COUNT - 1];
+	direction_t current = (direction_t)(0);
+	uint8_t i = 0;
+	while (i < DIRECTION_COUNT - 1 && current < DIRECTION_COUNT) {
+		if (current != exclude)
+			directions[i++] = (direction_t)current;
+		current++;
+	}
+	*direction = directions[rng_uint8(rng, 0, DIRECTION_COUNT - 2)];
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t walk_particles(
+	particle_t* const particle,
+	const uint8_t width,
+	const uint8_t height,
+	const bool wrap
+) {
+	if (!particle || !width || !height)
+		return RANDOMWALK_FAIL;
+	// Shift coordinate by current direction:  N  NE  E SE  S  SW   W  NW
+	const int8_t delta_x[DIRECTION_COUNT] = {  0,  1, 1, 1, 0, -1, -1, -1 };
+	const int8_t delta_y[DIRECTION_COUNT] = { -1, -1, 0, 1, 1,  1,  0, -1 };
+	particle_t* current = particle;
+	while (current) {
+		const int16_t new_x = current->coord.x + delta_x[current->direction];
+		const int16_t new_y = current->coord.y + delta_y[current->direction];
+		if (wrap) {
+			current->coord.x = (uint8_t)(new_x > 0 ? new_x == width ? 0 : new_x : width - 1);
+			current->coord.y = (uint8_t)(new_y > 0 ? new_y == height ? 0 : new_y : height - 1);
+		} else if (new_x < 0 || new_y < 0 || new_x == width || new_y == height) {
+			current->is_alive = false;
+		} else {
+			current->coord.x = (uint8_t)new_x;
+			current->coord.y = (uint8_t)new_y;
+		}
+		current = current->next;
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t steer_particles(
+	particle_t* const particle,
+	const uint8_t prob_dir_change,
+	const uint64_t seed,
+	const uint64_t step
+) {
+	if (!particle)
+		return RANDOMWALK_FAIL;
+	particle_t* current = particle;
+	while (current) {
+		rng_t rng;
+		rng_seed_counter(&rng, seed, current->id, step);
+		bool change_dir = rng_uint8(&rng, 1, 100) <= prob_dir_change;
+		if (change_dir) {
+			randomwalk_result_t result =
+				gen_direction_except(&current->direction, current->direction, &rng);
+			if (result != RANDOMWALK_OK)
+				return result;
+		}
+		current = current->next;
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t validate_particles(particle_t** particle) {
+	if (!*particle)
+		return RANDOMWALK_FAIL;
+	particle_t** current = particle;
+	while (*current) {
+		if ((*current)->is_alive) {
+			current = &(*current)->next;
+			continue;
+		}
+		particle_t* const dead = *current;
+		*current = dead->next;
+		free(dead);
+	}
+	return *particle ? RANDOMWALK_OK : RANDOMWALK_DONE;
+}
+
+static randomwalk_result_t destroy_particles(particle_t** particle) {
+	if (!particle)
+		return RANDOMWALK_FAIL;
+	while (*particle) {
+		particle_t* const next = (*particle)->next;
+		free(*particle);
+		*particle = next;
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t init_engine(void** engine, const randomwalk_args_t args) {
+	if (!engine || *engine)
+		return RANDOMWALK_FAIL;
+	spawn_distribution_t distribution;
+	if (spawn_parse(args.init, args.width, args.height, &distribution) != RANDOMWALK_OK)
+		return RANDOMWALK_FAIL;
+	refengine_t* const created = (refengine_t*)calloc(1, sizeof(refengine_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	*created = (refengine_t){
+		.width = args.width,
+		.height = args.height,
+		.prob_dir_change = args.prob_dir_change,
+		.wrap = args.wrap,
+		.seed = args.seed
+	};
+	*engine = created;
+	// Each particle is placed from its own generator, as strips place them
+	particle_t** current = &created->particle;
+	for (uint32_t i = 0; i < args.particle_count; i++) {
+		*current = (particle_t*)malloc(sizeof(particle_t));
+		if (!*current) {
+			destroy_engine(engine);
+			return RANDOMWALK_FAIL;
+		}
+		rng_t rng;
+		rng_seed(&rng, rng_derive(args.seed, i));
+		spawn_particle(&distribution, args.width, args.height, &rng,
+			&(*current)->coord, &(*current)->color, &(*current)->direction);
+		(*current)->id = i;
+		(*current)->is_alive = true;
+		(*current)->next = NULL;
+		current = &(*current)->next;
+	}
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t compute_particles(void* engine, const uint64_t step) {
+	refengine_t* const state = (refengine_t*)engine;
+	if (!state)
+		return RANDOMWALK_FAIL;
+	if (!state->particle)
+		return RANDOMWALK_DONE;
+	randomwalk_result_t result = steer_particles(state->particle, state->prob_dir_change,
+		state->seed, step);
+	if (result != RANDOMWALK_OK)
+		return result;
+	result = walk_particles(state->particle, state->width, state->height, state->wrap);
+	if (result != RANDOMWALK_OK)
+		return result;
+	return validate_particles(&state->particle);
+}
+
+static randomwalk_result_t observe_engine(void* engine, particle_store_t* const particles) {
+	const refengine_t* const state = (const refengine_t*)engine;
+	if (!state || !particles)
+		return RANDOMWALK_FAIL;
+	particles->count = 0;
+	for (const particle_t* current = state->particle; current; current = current->next)
+		if (particle_store_push(particles, current->id, current->coord, current->direction,
+			current->color) != RANDOMWALK_OK)
+			return RANDOMWALK_FAIL;
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t destroy_engine(void** engine) {
+	if (!engine || !*engine)
+		return RANDOMWALK_FAIL;
+	refengine_t* const state = (refengine_t*)*engine;
+	const randomwalk_result_t result = destroy_particles(&state->particle);
+	free(state);
+	*engine = NULL;
+	return result;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file refengine.h
+ * @brief The reference engine: the linked list of particles the random walk
+ * was first written with, drawing from counter-based generators.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef REFENGINE_H
+#define REFENGINE_H
+
+#include "engine.h"
+
+/**
+ * @brief Get the reference engine.
+ *
+ * Each step draws, steers, walks and validates every particle in separate
+ * passes over a singly linked list, exactly as compute_particles did, the
+ * draws of each particle coming from the seed, its identifier and the step.
+ *
+ * @return The engine.
+ */
+const engine_t* refengine_get(void);
+
+#endif // REFENGINE_H
@@ -0,0 +1,157 @@
+/**
+ * @file regen.c
+ * @brief Regeneration of the particles of a counter-based run at any step from
+ * the seed alone.
+ * @author Justin Thoreson
+ */
+
+#include "regen.h"
+#include "checkpoint.h"
+#include "kernel.h"
+#include "rng.h"
+#include "spawn.h"
+#include "threadpool.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The regeneration of one block of particles.
+ */
+typedef struct {
+	particle_store_t window; // The block within the store, compacted in place
+	const spawn_distribution_t* distribution;
+	kernel_plane_t plane;
+	uint64_t seed;
+	uint64_t from, to; // Steps walked between
+	bool place;        // Whether the particles are yet to be placed
+	uint32_t first;    // Identifier of the first particle placed
+} job_t;
+
+/**
+ * @brief Place, if need be, and walk one block of particles; a thread pool
+ * task.
+ * @param[in,out] arg The job of the block.
+ */
+static void regen_block(void* arg);
+
+randomwalk_result_t regen_particles(
+	particle_store_t* const particles,
+	const randomwalk_args_t args,
+	const uint64_t step
+) {
+	if (!particles || particles->count)
+		return RANDOMWALK_FAIL;
+	spawn_distribution_t distribution;
+	randomwalk_result_t result = spawn_parse(args.init, args.width, args.height, &distribution);
+	uint64_t from = 0;
+	bool loaded = false;
+	// A run writing checkpoints starts afresh
+	if (result == RANDOMWALK_OK && args.checkpoint_path && !args.checkpoint_interval)
+		result = checkpoint_load(args.checkpoint_path, args, step, particles, &from, &loaded);
+	if (result != RANDOMWALK_OK)
+		return result;
+	if (!loaded)
+		particles->count = particles->capacity;
+	const uint32_t block_count =
+		(uint32_t)(((uint64_t)particles->count + REGEN_BLOCK_PARTICLES - 1) / REGEN_BLOCK_PARTICLES);
+	job_t* const jobs = (job_t*)malloc(block_count * sizeof(job_t));
+	if (block_count && !jobs) {
+		particles->count = 0;
+		return RANDOMWALK_FAIL;
+	}
+	for (uint32_t b = 0; b < block_count; b++) {
+		const uint32_t first = b * REGEN_BLOCK_PARTICLES;
+		const uint32_t count = particles->count - first < REGEN_BLOCK_PARTICLES ?
+			particles->count - first : REGEN_BLOCK_PARTICLES;
+		jobs[b] = (job_t){
+			.window = {
+				.count = count,
+				.capacity = count,
+				.id = particles->id + first,
+				.x = particles->x + first,
+				.y = particles->y + first,
+				.direction = particles->direction + first,
+				.color = particles->color + first
+			},
+			.distribution = &distribution,
+			.plane = {
+				.width = args.width,
+				.height = args.height,
+				.prob_dir_change = args.prob_dir_change,
+				.wrap = args.wrap
+			},
+			.seed = args.seed,
+			.from = from,
+			.to = step,
+			.place = !loaded,
+			.first = first
+		};
+	}
+	threadpool_t* pool = NULL;
+	// A pool worker, such as a sweep job, walks its own blocks
+	if (block_count > 1 && threadpool_worker_index() < 0)
+		result = threadpool_create(&pool, 0);
+	if (result == RANDOMWALK_OK && pool) {
+		for (uint32_t b = 0; result == RANDOMWALK_OK && b < block_count; b++)
+			result = threadpool_submit(pool, regen_block, &jobs[b]);
+		const randomwalk_result_t waited = threadpool_wait(pool);
+		result = result == RANDOMWALK_OK ? waited : result;
+		threadpool_destroy(&pool);
+	} else if (result == RANDOMWALK_OK) {
+		for (uint32_t b = 0; b < block_count; b++)
+			regen_block(&jobs[b]);
+	}
+	// Gather the survivors of every block back to the front of the store
+	uint32_t survivors = 0;
+	for (uint32_t b = 0; result == RANDOMWALK_OK && b < block_count; b++) {
+		const particle_store_t window = jobs[b].window;
+		memmove(particles->id + survivors, window.id, window.count * sizeof(uint32_t));
+		memmove(particles->x + survivors, window.x, window.count);
+		memmove(particles->y + survivors, window.y, window.count);
+		memmove(particles->direction + survivors, window.direction, window.count);
+		memmove(particles->color + survivors, window.color, window.count * sizeof(color_t));
+		survivors += window.count;
+	}
+	particles->count = survivors;
+	free(jobs);
+	return result;
+}
+
+static void regen_block(void* arg) {
+	job_t* const job = (job_t*)arg;
+	particle_store_t* const window = &job->window;
+	uint32_t survivors = 0;
+	for (uint32_t i = 0; i < window->count; i++) {
+		// Identifiers of placed particles follow their index in the store
+		const uint32_t id = job->place ? job->first + i : window->id[i];
+		if (job->place) {
+			rng_t rng;
+			rng_seed(&rng, rng_derive(job->seed, id));
+			coordinate_t coord;
+			direction_t direction;
+			spawn_particle(job->distribution, job->plane.width, job->plane.height, &rng,
+				&coord, &window->color[i], &direction);
+			window->x[i] = coord.x;
+			window->y[i] = coord.y;
+			window->direction[i] = (uint8_t)direction;
+		}
+		// Each particle is walked through every step before the next one
+		uint8_t x = window->x[i], y = window->y[i], direction = window->direction[i];
+		bool alive = true;
+		for (uint64_t step = job->from + 1; alive && step <= job->to; step++) {
+			rng_t rng;
+			rng_seed_counter(&rng, job->seed, id, step);
+			alive = kernel_move(job->plane, &x, &y, &direction, &rng);
+		}
+		if (!alive)
+			continue;
+		window->id[survivors] = id;
+		window->x[survivors] = x;
+		window->y[survivors] = y;
+		window->direction[survivors] = direction;
+		window->color[survivors] = window->color[i];
+		survivors++;
+	}
+	window->count = survivors;
+}
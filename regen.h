@@ -0,0 +1,45 @@
+/**
+ * @file regen.h
+ * @brief Regeneration of the particles of a counter-based run at any step from
+ * the seed alone.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef REGEN_H
+#define REGEN_H
+
+#include "particles.h"
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief The most particles regenerated by one task.
+ */
+#define REGEN_BLOCK_PARTICLES 65536
+
+/**
+ * @brief Fill a particle store with the particles of a counter-based run as
+ * of a step.
+ *
+ * Each particle is placed from a generator derived from the seed and its
+ * identifier, as strips place them, then walked from the last checkpoint of
+ * args.checkpoint_path at or before the step, if any, or from its placement;
+ * checkpoints are not sought while args.checkpoint_interval writes them.
+ * Particles never interact, so blocks of REGEN_BLOCK_PARTICLES particles are
+ * walked on a thread pool of every online CPU, unless called from a pool
+ * worker, in which case they are walked in turn.
+ *
+ * @param[in,out] particles The empty store to fill.
+ * @param[in] args The random walk arguments, with the probability of direction
+ * change resolved.
+ * @param[in] step The step to regenerate.
+ * @return The result of regenerating the particles.
+ */
+randomwalk_result_t regen_particles(
+	particle_store_t* const particles,
+	const randomwalk_args_t args,
+	const uint64_t step
+);
+
+#endif // REGEN_H
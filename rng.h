@@ -0,0 +1,112 @@
+/**
+ * @file rng.h
+ * @brief Pseudorandom number generation for the random walk program.
+ * @author Justin Thoreson
+ *
+ * Each generator carries its own state so that independent simulations may
+ * run concurrently and reproducibly from a seed.
+ */
+
+#pragma once
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/**
+ * @brief The state of a SplitMix64 pseudorandom number generator.
+ */
+typedef struct {
+	uint64_t state;
+} rng_t;
+
+/**
+ * @brief The increment applied to the generator state per draw.
+ */
+#define RNG_GOLDEN_GAMMA UINT64_C(0x9E3779B97F4A7C15)
+
+/**
+ * @brief Scramble a 64-bit value into a statistically independent one.
+ * @param[in] value The value to scramble.
+ * @return The scrambled value.
+ */
+static inline uint64_t rng_mix(uint64_t value) {
+	value = (value ^ (value >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	value = (value ^ (value >> 27)) * UINT64_C(0x94D049BB133111EB);
+	return value ^ (value >> 31);
+}
+
+/**
+ * @brief Seed a pseudorandom number generator.
+ * @param[out] rng The generator to seed.
+ * @param[in] seed The seed to start the generator from.
+ */
+static inline void rng_seed(rng_t* const rng, const uint64_t seed) {
+	rng->state = seed;
+}
+
+/**
+ * @brief Derive a seed for an independent stream from a base seed.
+ * @param[in] seed The base seed.
+ * @param[in] stream The index of the stream to derive.
+ * @return The derived seed.
+ */
+static inline uint64_t rng_derive(const uint64_t seed, const uint64_t stream) {
+	return rng_mix(seed ^ rng_mix((stream + 1) * RNG_GOLDEN_GAMMA));
+}
+
+/**
+ * @brief Seed a generator whose draws are a pure function of a seed, a
+ * particle and a step, so that any step of any particle may be redrawn.
+ * @param[out] rng The generator to seed.
+ * @param[in] seed The seed of the run.
+ * @param[in] id The identifier of the particle.
+ * @param[in] step The step the particle takes.
+ */
+static inline void rng_seed_counter(
+	rng_t* const rng,
+	const uint64_t seed,
+	const uint32_t id,
+	const uint64_t step
+) {
+	rng->state = rng_derive(rng_derive(seed, id), step);
+}
+
+/**
+ * @brief Draw the next 32-bit value from a pseudorandom number generator.
+ * @param[in,out] rng The generator to draw from.
+ * @return A uniformly distributed 32-bit value.
+ */
+static inline uint32_t rng_next(rng_t* const rng) {
+	rng->state += RNG_GOLDEN_GAMMA;
+	return (uint32_t)(rng_mix(rng->state) >> 32);
+}
+
+/**
+ * @brief Map a drawn 32-bit value onto an unsigned 8-bit integer.
+ *
+ * The value is offset from 0 to max by min, so values above max - min occur
+ * whenever min is nonzero; random walks are defined by this distribution.
+ *
+ * @param[in] word The drawn value.
+ * @param[in] min The offset of the mapped value.
+ * @param[in] max The largest value mapped to before offsetting.
+ * @return The mapped value.
+ */
+static inline uint8_t rng_word_uint8(const uint32_t word, const uint8_t min, const uint8_t max) {
+	return (uint8_t)(word % (max + 1) + min);
+}
+
+/**
+ * @brief Draw an unsigned 8-bit integer from a pseudorandom number generator,
+ * mapped as by rng_word_uint8.
+ * @param[in,out] rng The generator to draw from.
+ * @param[in] min The offset of the drawn value.
+ * @param[in] max The largest value drawn before offsetting.
+ * @return The drawn value.
+ */
+static inline uint8_t rng_uint8(rng_t* const rng, const uint8_t min, const uint8_t max) {
+	return rng_word_uint8(rng_next(rng), min, max);
+}
+
+#endif // RNG_H
@@ -0,0 +1,94 @@
+/**
+ * @file rngbuf.c
+ * @brief A ring of random words filled ahead of the step kernel by a
+ * background producer thread.
+ * @author Justin Thoreson
+ */
+
+#include "rngbuf.h"
+#include <stdlib.h>
+
+/**
+ * @brief Fill blocks as the consumer releases them until stopped; the body of
+ * the producer thread.
+ * @param[in,out] arg The buffer to fill.
+ * @return NULL.
+ */
+static void* produce(void* arg);
+
+randomwalk_result_t rngbuf_create(rngbuf_t* const buffer, const rng_t rng) {
+	if (!buffer)
+		return RANDOMWALK_FAIL;
+	*buffer = (rngbuf_t){ .rng = rng };
+	buffer->words = (uint32_t*)malloc(
+		(size_t)RNGBUF_BLOCK_COUNT * RNGBUF_BLOCK_WORDS * sizeof(uint32_t));
+	if (!buffer->words)
+		return RANDOMWALK_FAIL;
+	if (pthread_mutex_init(&buffer->lock, NULL)) {
+		free(buffer->words);
+		return RANDOMWALK_FAIL;
+	}
+	if (pthread_cond_init(&buffer->changed, NULL)) {
+		pthread_mutex_destroy(&buffer->lock);
+		free(buffer->words);
+		return RANDOMWALK_FAIL;
+	}
+	if (pthread_create(&buffer->producer, NULL, produce, buffer)) {
+		pthread_cond_destroy(&buffer->changed);
+		pthread_mutex_destroy(&buffer->lock);
+		free(buffer->words);
+		return RANDOMWALK_FAIL;
+	}
+	return RANDOMWALK_OK;
+}
+
+void rngbuf_refill(rngbuf_t* const buffer) {
+	pthread_mutex_lock(&buffer->lock);
+	if (buffer->reading) {
+		buffer->consumed++;
+		pthread_cond_broadcast(&buffer->changed);
+	}
+	while (buffer->filled == buffer->consumed)
+		pthread_cond_wait(&buffer->changed, &buffer->lock);
+	buffer->reading = true;
+	buffer->cursor = buffer->words + buffer->consumed % RNGBUF_BLOCK_COUNT * RNGBUF_BLOCK_WORDS;
+	buffer->end = buffer->cursor + RNGBUF_BLOCK_WORDS;
+	pthread_mutex_unlock(&buffer->lock);
+}
+
+randomwalk_result_t rngbuf_destroy(rngbuf_t* const buffer) {
+	if (!buffer || !buffer->words)
+		return RANDOMWALK_FAIL;
+	pthread_mutex_lock(&buffer->lock);
+	buffer->stopping = true;
+	pthread_cond_broadcast(&buffer->changed);
+	pthread_mutex_unlock(&buffer->lock);
+	pthread_join(buffer->producer, NULL);
+	pthread_cond_destroy(&buffer->changed);
+	pthread_mutex_destroy(&buffer->lock);
+	free(buffer->words);
+	*buffer = (rngbuf_t){ 0 };
+	return RANDOMWALK_OK;
+}
+
+static void* produce(void* arg) {
+	rngbuf_t* const buffer = (rngbuf_t*)arg;
+	pthread_mutex_lock(&buffer->lock);
+	for (;;) {
+		while (!buffer->stopping && buffer->filled - buffer->consumed == RNGBUF_BLOCK_COUNT)
+			pthread_cond_wait(&buffer->changed, &buffer->lock);
+		if (buffer->stopping)
+			break;
+		// The block is neither ready nor read, so it is filled unlocked
+		uint32_t* const block =
+			buffer->words + buffer->filled % RNGBUF_BLOCK_COUNT * RNGBUF_BLOCK_WORDS;
+		pthread_mutex_unlock(&buffer->lock);
+		for (uint32_t i = 0; i < RNGBUF_BLOCK_WORDS; i++)
+			block[i] = rng_next(&buffer->rng);
+		pthread_mutex_lock(&buffer->lock);
+		buffer->filled++;
+		pthread_cond_broadcast(&buffer->changed);
+	}
+	pthread_mutex_unlock(&buffer->lock);
+	return NULL;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file rngbuf.h
+ * @brief A ring of random words filled ahead of the step kernel by a
+ * background producer thread.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef RNGBUF_H
+#define RNGBUF_H
+
+#include "randomwalk.h"
+#include "rng.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief The number of words in each block of the ring.
+ */
+#define RNGBUF_BLOCK_WORDS 16384
+
+/**
+ * @brief The number of blocks in the ring.
+ */
+#define RNGBUF_BLOCK_COUNT 8
+
+/**
+ * @brief A ring of blocks of random words.
+ *
+ * The producer draws every word from a copy of a generator, so the consumer
+ * reads exactly the sequence the generator itself would have produced. Blocks
+ * [consumed, filled) are ready to read, both counts growing without bound and
+ * wrapping onto the blocks; the producer fills block filled while fewer than
+ * all blocks are ready. The consumer reads the block consumed through its
+ * cursor and releases it only once the cursor reaches its end.
+ */
+typedef struct {
+	const uint32_t* cursor; // The next word of the block being read
+	const uint32_t* end;    // The end of the block being read
+	uint32_t* words;
+	uint64_t filled, consumed;
+	bool reading, stopping;
+	rng_t rng; // Owned by the producer
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	pthread_t producer;
+} rngbuf_t;
+
+/**
+ * @brief Start a producer drawing from a copy of a generator.
+ * @param[out] buffer The buffer to create.
+ * @param[in] rng The generator whose sequence is produced.
+ * @return The result of creating the buffer.
+ */
+randomwalk_result_t rngbuf_create(rngbuf_t* const buffer, const rng_t rng);
+
+/**
+ * @brief Release the block being read and wait for the next one.
+ * @param[in,out] buffer The buffer to read.
+ */
+void rngbuf_refill(rngbuf_t* const buffer);
+
+/**
+ * @brief Read the next random word, as rng_next would draw it.
+ * @param[in,out] buffer The buffer to read.
+ * @return The word.
+ */
+static inline uint32_t rngbuf_next(rngbuf_t* const buffer) {
+	if (buffer->cursor == buffer->end)
+		rngbuf_refill(buffer);
+	return *buffer->cursor++;
+}
+
+/**
+ * @brief Stop the producer and free the buffer.
+ * @param[in,out] buffer The buffer to destroy.
+ * @return The result of destroying the buffer.
+ */
+randomwalk_result_t rngbuf_destroy(rngbuf_t* const buffer);
+
+#endif // RNGBUF_H
@@ -0,0 +1,293 @@
+/**
+ * @file shard.c
+ * @brief A spatially decomposed engine running each strip of the plane in a
+ * forked worker process, emulating a run split across machines.
+ * @author Justin Thoreson
+ */
+
+#include "shard.h"
+#include "domain.h"
+#include "mailbox.h"
+#include "placement.h"
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief The head of the memory shared by the coordinator and its workers.
+ *
+ * The mailboxes of every worker, north then south inbox, follow the header.
+ * The visits to each cell of the plane follow the mailboxes, then the
+ * placement of each worker: the CPU it last ran on and its pages per node.
+ */
+typedef struct {
+	atomic_uint_fast64_t walked;   // Workers that finished walking, over all steps
+	atomic_uint_fast64_t reported; // Workers that reported their count, over all steps
+	atomic_uint_fast64_t released; // Steps the coordinator released the workers from
+	uint32_t total;                // Particles alive in every strip, per the coordinator
+	uint32_t alive[];              // Particles alive in each strip
+} shard_header_t;
+
+/**
+ * @brief The connection of a worker to the others and the coordinator.
+ */
+typedef struct {
+	mailbox_link_t link; // First, so the link functions accept the context
+	shard_header_t* header;
+	uint32_t index;
+	uint64_t step; // Counts reported so far
+} shard_link_t;
+
+/**
+ * @brief Round a size up to the size of a cache line.
+ * @param[in] size The size to round.
+ * @return The rounded size.
+ */
+static size_t align_size(const size_t size);
+
+/**
+ * @brief Locate an inbox of a worker within the shared memory.
+ * @param[in] header The head of the shared memory.
+ * @param[in] worker_count The number of workers.
+ * @param[in] index The index of the worker.
+ * @param[in] side The neighbor the inbox is written by.
+ * @return The inbox.
+ */
+static mailbox_t* inbox_at(
+	shard_header_t* const header,
+	const uint32_t worker_count,
+	const uint32_t index,
+	const transport_side_t side
+);
+
+/**
+ * @brief Report the particles alive in a worker to the coordinator and await
+ * the total; a transport total function.
+ * @param[in,out] context The link of the calling worker.
+ * @param[in] alive The particles alive in the strip of the worker.
+ * @return The particles alive in every strip.
+ */
+static uint32_t total_shards(void* context, const uint32_t alive);
+
+/**
+ * @brief Total the counts reported by the workers each step until every
+ * particle dies or the step limit is hit.
+ *
+ * While waiting for the counts, workers that exit are reaped, as the others
+ * would otherwise wait on them forever.
+ *
+ * @param[in,out] header The head of the shared memory.
+ * @param[in,out] workers The process of each worker; those reaped are set to 0.
+ * @param[in] worker_count The number of workers.
+ * @param[in] max_steps The step limit; 0 runs until every particle dies.
+ * @param[out] stats Statistics gathered from the run.
+ * @return The result of the run; RANDOMWALK_FAIL if a worker exits early.
+ */
+static randomwalk_result_t coordinate(
+	shard_header_t* const header,
+	pid_t* const workers,
+	const uint32_t worker_count,
+	const uint64_t max_steps,
+	randomwalk_stats_t* const stats
+);
+
+randomwalk_result_t shard_run(
+	const randomwalk_args_t args,
+	randomwalk_stats_t* const stats
+) {
+	const uint32_t worker_count = domain_strip_count(args.shards, args.height);
+	const size_t header_size =
+		align_size(sizeof(shard_header_t) + worker_count * sizeof(uint32_t));
+	const size_t mailbox_bytes = align_size(mailbox_size(MAILBOX_CAPACITY));
+	const size_t visits_size = align_size((size_t)args.width * args.height * sizeof(uint64_t));
+	const uint32_t node_count = placement_node_count();
+	const size_t pages_size = align_size(worker_count * node_count * sizeof(uint64_t));
+	const size_t size = header_size + 2 * worker_count * mailbox_bytes +
+		visits_size + pages_size + 2 * worker_count * sizeof(int32_t);
+	shard_header_t* const header = (shard_header_t*)mmap(
+		NULL,
+		size,
+		PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS,
+		-1,
+		0
+	);
+	if (header == MAP_FAILED)
+		return RANDOMWALK_FAIL;
+	uint64_t* const visits = (uint64_t*)((uint8_t*)header + header_size +
+		2 * worker_count * mailbox_bytes);
+	uint64_t* const pages = (uint64_t*)((uint8_t*)visits + visits_size);
+	int32_t* const ran_on = (int32_t*)((uint8_t*)pages + pages_size);
+	int32_t* const pinned = ran_on + worker_count;
+	atomic_init(&header->walked, 0);
+	atomic_init(&header->reported, 0);
+	atomic_init(&header->released, 0);
+	randomwalk_result_t result = RANDOMWALK_OK;
+	for (uint32_t i = 0; result == RANDOMWALK_OK && i < worker_count; i++) {
+		mailbox_init(inbox_at(header, worker_count, i, TRANSPORT_NORTH), MAILBOX_CAPACITY);
+		mailbox_init(inbox_at(header, worker_count, i, TRANSPORT_SOUTH), MAILBOX_CAPACITY);
+	}
+	// Strips are allocated before forking, so workers cannot fail once started
+	domain_strip_t* const strips = (domain_strip_t*)calloc(worker_count, sizeof(domain_strip_t));
+	shard_link_t* const links = (shard_link_t*)calloc(worker_count, sizeof(shard_link_t));
+	pid_t* const workers = (pid_t*)calloc(worker_count, sizeof(pid_t));
+	placement_cpus_t cpus = { 0 };
+	if (!strips || !links || !workers)
+		result = RANDOMWALK_FAIL;
+	if (result == RANDOMWALK_OK && args.cpus)
+		result = placement_parse_cpus(args.cpus, &cpus);
+	for (uint32_t i = 0; result == RANDOMWALK_OK && i < worker_count; i++) {
+		const uint32_t north = (i + worker_count - 1) % worker_count;
+		const uint32_t south = (i + 1) % worker_count;
+		links[i] = (shard_link_t){
+			.link = {
+				.inbox = {
+					inbox_at(header, worker_count, i, TRANSPORT_NORTH),
+					inbox_at(header, worker_count, i, TRANSPORT_SOUTH)
+				},
+				.outbox = {
+					inbox_at(header, worker_count, north, TRANSPORT_SOUTH),
+					inbox_at(header, worker_count, south, TRANSPORT_NORTH)
+				},
+				.walked = &header->walked,
+				.strip_count = worker_count
+			},
+			.header = header,
+			.index = i
+		};
+		const transport_t transport = {
+			.send = mailbox_link_send,
+			.receive = mailbox_link_receive,
+			.finish_walk = mailbox_link_finish_walk,
+			.all_walked = mailbox_link_all_walked,
+			.total = total_shards,
+			.context = &links[i]
+		};
+		result = domain_strip_create(&strips[i], args, i, worker_count, visits, transport);
+		if (result != RANDOMWALK_OK)
+			break;
+		if (cpus.count)
+			strips[i].cpu = cpus.cpus[i % cpus.count];
+		if (args.numa_report) {
+			strips[i].pinned = &pinned[i];
+			strips[i].ran_on = &ran_on[i];
+			strips[i].pages = &pages[i * node_count];
+			strips[i].node_count = node_count;
+		}
+	}
+	// Output buffered so far would otherwise be written by every worker too
+	fflush(stdout);
+	fflush(stderr);
+	uint32_t started = 0;
+	while (result == RANDOMWALK_OK && started < worker_count) {
+		const pid_t pid = fork();
+		if (pid < 0) {
+			result = RANDOMWALK_FAIL;
+		} else if (!pid) {
+			domain_strip_run(&strips[started], NULL);
+			_exit(EXIT_SUCCESS);
+		} else {
+			workers[started++] = pid;
+		}
+	}
+	randomwalk_stats_t run_stats = { 0 };
+	if (result == RANDOMWALK_OK)
+		result = coordinate(header, workers, worker_count, args.max_steps, &run_stats);
+	// Workers wait on each other, so a partial start or an early exit can never finish
+	if (result != RANDOMWALK_OK)
+		for (uint32_t i = 0; i < started; i++)
+			if (workers[i])
+				kill(workers[i], SIGKILL);
+	for (uint32_t i = 0; i < started; i++) {
+		int status;
+		if (workers[i] && (waitpid(workers[i], &status, 0) < 0 || !WIFEXITED(status) ||
+			WEXITSTATUS(status)))
+			result = RANDOMWALK_FAIL;
+	}
+	if (result == RANDOMWALK_OK && args.visits_path)
+		result = domain_write_visits(args.visits_path, visits, args.width, args.height);
+	if (result == RANDOMWALK_OK && args.numa_report) {
+		placement_print_header(stdout, node_count);
+		for (uint32_t i = 0; i < worker_count; i++)
+			placement_print_strip(stdout, i, pinned[i], ran_on[i], &pages[i * node_count], node_count);
+	}
+	if (result == RANDOMWALK_OK && stats)
+		*stats = run_stats;
+	for (uint32_t i = 0; strips && i < worker_count; i++)
+		domain_strip_destroy(&strips[i]);
+	free(strips);
+	free(links);
+	free(workers);
+	placement_free_cpus(&cpus);
+	munmap(header, size);
+	if (result != RANDOMWALK_OK)
+		return result;
+	return run_stats.survivors ? RANDOMWALK_OK : RANDOMWALK_DONE;
+}
+
+static size_t align_size(const size_t size) {
+	const size_t alignment = 64;
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+static mailbox_t* inbox_at(
+	shard_header_t* const header,
+	const uint32_t worker_count,
+	const uint32_t index,
+	const transport_side_t side
+) {
+	const size_t header_size =
+		align_size(sizeof(shard_header_t) + worker_count * sizeof(uint32_t));
+	const size_t mailbox_bytes = align_size(mailbox_size(MAILBOX_CAPACITY));
+	return (mailbox_t*)((uint8_t*)header + header_size +
+		(2 * index + side) * mailbox_bytes);
+}
+
+static uint32_t total_shards(void* context, const uint32_t alive) {
+	shard_link_t* const link = (shard_link_t*)context;
+	shard_header_t* const header = link->header;
+	header->alive[link->index] = alive;
+	atomic_fetch_add(&header->reported, 1);
+	// The coordinator totals the counts once every worker reported, then releases them
+	link->step++;
+	while (atomic_load(&header->released) < link->step)
+		sched_yield();
+	return header->total;
+}
+
+static randomwalk_result_t coordinate(
+	shard_header_t* const header,
+	pid_t* const workers,
+	const uint32_t worker_count,
+	const uint64_t max_steps,
+	randomwalk_stats_t* const stats
+) {
+	for (uint64_t step = 0;; step++) {
+		const uint64_t reported = (step + 1) * worker_count;
+		while (atomic_load(&header->reported) < reported) {
+			// No worker exits before it is released from its last step
+			for (uint32_t i = 0; i < worker_count; i++) {
+				if (waitpid(workers[i], NULL, WNOHANG) == workers[i]) {
+					fprintf(stderr, "Shard worker %u exited early at step %lu\n", i, step);
+					workers[i] = 0;
+					return RANDOMWALK_FAIL;
+				}
+			}
+			sched_yield();
+		}
+		uint32_t total = 0;
+		for (uint32_t i = 0; i < worker_count; i++)
+			total += header->alive[i];
+		header->total = total;
+		atomic_store(&header->released, step + 1);
+		// Workers reach the same verdict from the same total and step
+		if (!total || (max_steps && step == max_steps)) {
+			*stats = (randomwalk_stats_t){ .steps = step, .survivors = total };
+			return RANDOMWALK_OK;
+		}
+	}
+}
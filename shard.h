@@ -0,0 +1,39 @@
+/**
+ * @file shard.h
+ * @brief A spatially decomposed engine running each strip of the plane in a
+ * forked worker process, emulating a run split across machines.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "randomwalk.h"
+
+/**
+ * @brief Run the random walk headlessly over strips of the plane in worker
+ * processes.
+ *
+ * The plane is cut into args.shards horizontal strips, each run by a forked
+ * worker process. Particles crossing into a neighboring strip are handed off
+ * through rings in memory shared between the workers. After every step the
+ * workers report their live particle counts to the calling process, which acts
+ * as coordinator: it totals the counts, detects when every particle has died
+ * or the step limit is hit, and releases the workers to take the next step or
+ * to exit. The workers reach each other only through the transport declared
+ * in transport.h, so a socket or MPI transport could replace shared memory.
+ *
+ * Outcomes match those of domain_run with as many strips.
+ *
+ * @param[in] args The validated random walk arguments, with the seed and the
+ * probability of direction change resolved.
+ * @param[out] stats Statistics gathered from the run; may be NULL.
+ * @return The result of the run.
+ */
+randomwalk_result_t shard_run(
+	const randomwalk_args_t args,
+	randomwalk_stats_t* const stats
+);
+
+#endif // SHARD_H
@@ -0,0 +1,208 @@
+/**
+ * @file spawn.c
+ * @brief Initial placement of particles by one of several distributions,
+ * filled into a particle store in parallel.
+ * @author Justin Thoreson
+ */
+
+#include "spawn.h"
+#include "threadpool.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The placement of one block of particles.
+ */
+typedef struct {
+	particle_store_t* particles;
+	const spawn_distribution_t* distribution;
+	uint8_t width, height;
+	uint64_t seed;
+	uint32_t block;
+} job_t;
+
+/**
+ * @brief Draw a uniform real number within (0, 1].
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @return The drawn number.
+ */
+static double draw_unit(rng_t* const rng);
+
+/**
+ * @brief Place one block of particles; a thread pool task.
+ * @param[in,out] arg The job of the block.
+ */
+static void place_block(void* arg);
+
+randomwalk_result_t spawn_parse(
+	const char* const spec,
+	const uint8_t width,
+	const uint8_t height,
+	spawn_distribution_t* const distribution
+) {
+	if (!distribution || !width || !height)
+		return RANDOMWALK_FAIL;
+	const uint8_t shorter = width < height ? width : height;
+	*distribution = (spawn_distribution_t){
+		.kind = SPAWN_UNIFORM,
+		.x = width / 2,
+		.y = height / 2,
+		.sigma = shorter >= 8 ? shorter / 8.0 : 1.0,
+		.edge = DIRECTION_NORTH
+	};
+	if (!spec || !strcmp(spec, "uniform"))
+		return RANDOMWALK_OK;
+	unsigned x = distribution->x, y = distribution->y;
+	char edge[8];
+	int end = 0;
+	if (!strcmp(spec, "point")) {
+		distribution->kind = SPAWN_POINT;
+	} else if (sscanf(spec, "point:%u,%u%n", &x, &y, &end) == 2 && !spec[end]) {
+		distribution->kind = SPAWN_POINT;
+	} else if (!strcmp(spec, "gaussian")) {
+		distribution->kind = SPAWN_GAUSSIAN;
+	} else if (sscanf(spec, "gaussian:%u,%u,%lf%n", &x, &y, &distribution->sigma, &end) == 3 &&
+		!spec[end]) {
+		distribution->kind = SPAWN_GAUSSIAN;
+	} else if (!strcmp(spec, "line")) {
+		distribution->kind = SPAWN_LINE;
+	} else if (sscanf(spec, "line:%7[a-z]%n", edge, &end) == 1 && !spec[end]) {
+		distribution->kind = SPAWN_LINE;
+		if (!strcmp(edge, "north"))
+			distribution->edge = DIRECTION_NORTH;
+		else if (!strcmp(edge, "east"))
+			distribution->edge = DIRECTION_EAST;
+		else if (!strcmp(edge, "south"))
+			distribution->edge = DIRECTION_SOUTH;
+		else if (!strcmp(edge, "west"))
+			distribution->edge = DIRECTION_WEST;
+		else
+			return RANDOMWALK_FAIL;
+	} else {
+		return RANDOMWALK_FAIL;
+	}
+	// Wider Gaussians land on the plane so rarely that placing would not end
+	const double widest = 4.0 * (width > height ? width : height);
+	if (x >= width || y >= height || !(distribution->sigma > 0) ||
+		!isfinite(distribution->sigma) || distribution->sigma > widest)
+		return RANDOMWALK_FAIL;
+	distribution->x = (uint8_t)x;
+	distribution->y = (uint8_t)y;
+	return RANDOMWALK_OK;
+}
+
+coordinate_t spawn_coordinate(
+	const spawn_distribution_t* const distribution,
+	const uint8_t width,
+	const uint8_t height,
+	rng_t* const rng
+) {
+	switch (distribution->kind) {
+		case SPAWN_POINT:
+			return (coordinate_t){ distribution->x, distribution->y };
+		case SPAWN_GAUSSIAN:
+			for (;;) {
+				// Box-Muller transform of two uniform draws
+				const double radius = distribution->sigma * sqrt(-2.0 * log(draw_unit(rng)));
+				const double angle = 2.0 * M_PI * draw_unit(rng);
+				const long x = lround(distribution->x + radius * cos(angle));
+				const long y = lround(distribution->y + radius * sin(angle));
+				if (x >= 0 && x < width && y >= 0 && y < height)
+					return (coordinate_t){ (uint8_t)x, (uint8_t)y };
+			}
+		case SPAWN_LINE:
+			if (distribution->edge == DIRECTION_NORTH || distribution->edge == DIRECTION_SOUTH) {
+				const uint8_t x = rng_uint8(rng, 0, width - 1);
+				return (coordinate_t){ x, distribution->edge == DIRECTION_NORTH ? 0 : height - 1 };
+			} else {
+				const uint8_t y = rng_uint8(rng, 0, height - 1);
+				return (coordinate_t){ distribution->edge == DIRECTION_WEST ? 0 : width - 1, y };
+			}
+		case SPAWN_UNIFORM:
+		default: {
+			const uint8_t x = rng_uint8(rng, 0, width - 1);
+			const uint8_t y = rng_uint8(rng, 0, height - 1);
+			return (coordinate_t){ x, y };
+		}
+	}
+}
+
+void spawn_particle(
+	const spawn_distribution_t* const distribution,
+	const uint8_t width,
+	const uint8_t height,
+	rng_t* const rng,
+	coordinate_t* const coord,
+	color_t* const color,
+	direction_t* const direction
+) {
+	*coord = spawn_coordinate(distribution, width, height, rng);
+	color->r = rng_uint8(rng, 0, UINT8_MAX);
+	color->g = rng_uint8(rng, 0, UINT8_MAX);
+	color->b = rng_uint8(rng, 0, UINT8_MAX);
+	*direction = (direction_t)rng_uint8(rng, 0, DIRECTION_COUNT - 1);
+}
+
+randomwalk_result_t spawn_particles(
+	particle_store_t* const particles,
+	const spawn_distribution_t distribution,
+	const uint8_t width,
+	const uint8_t height,
+	const uint64_t seed
+) {
+	if (!particles || particles->count || !width || !height)
+		return RANDOMWALK_FAIL;
+	const uint32_t block_count =
+		(uint32_t)(((uint64_t)particles->capacity + SPAWN_BLOCK_PARTICLES - 1) / SPAWN_BLOCK_PARTICLES);
+	job_t* const jobs = (job_t*)malloc(block_count * sizeof(job_t));
+	if (block_count && !jobs)
+		return RANDOMWALK_FAIL;
+	for (uint32_t b = 0; b < block_count; b++)
+		jobs[b] = (job_t){ particles, &distribution, width, height, seed, b };
+	randomwalk_result_t result = RANDOMWALK_OK;
+	threadpool_t* pool = NULL;
+	// A pool worker, such as a sweep job, places its own blocks
+	if (block_count > 1 && threadpool_worker_index() < 0)
+		result = threadpool_create(&pool, 0);
+	if (result == RANDOMWALK_OK && pool) {
+		for (uint32_t b = 0; result == RANDOMWALK_OK && b < block_count; b++)
+			result = threadpool_submit(pool, place_block, &jobs[b]);
+		const randomwalk_result_t waited = threadpool_wait(pool);
+		result = result == RANDOMWALK_OK ? waited : result;
+		threadpool_destroy(&pool);
+	} else if (result == RANDOMWALK_OK) {
+		for (uint32_t b = 0; b < block_count; b++)
+			place_block(&jobs[b]);
+	}
+	free(jobs);
+	if (result == RANDOMWALK_OK)
+		particles->count = particles->capacity;
+	return result;
+}
+
+static double draw_unit(rng_t* const rng) {
+	return (rng_next(rng) + 1.0) / 4294967296.0;
+}
+
+static void place_block(void* arg) {
+	const job_t* const job = (const job_t*)arg;
+	particle_store_t* const particles = job->particles;
+	const uint32_t first = job->block * SPAWN_BLOCK_PARTICLES;
+	const uint32_t end = particles->capacity - first < SPAWN_BLOCK_PARTICLES ?
+		particles->capacity : first + SPAWN_BLOCK_PARTICLES;
+	rng_t rng;
+	rng_seed(&rng, rng_derive(job->seed, job->block));
+	for (uint32_t i = first; i < end; i++) {
+		coordinate_t coord;
+		direction_t direction;
+		spawn_particle(job->distribution, job->width, job->height, &rng,
+			&coord, &particles->color[i], &direction);
+		particles->id[i] = i;
+		particles->x[i] = coord.x;
+		particles->y[i] = coord.y;
+		particles->direction[i] = (uint8_t)direction;
+	}
+}
@@ -0,0 +1,126 @@
+/**
+ * @file spawn.h
+ * @brief Initial placement of particles by one of several distributions,
+ * filled into a particle store in parallel.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include "particles.h"
+#include "randomwalk.h"
+#include "rng.h"
+#include <stdint.h>
+
+/**
+ * @brief The most particles placed from one generator by one task.
+ */
+#define SPAWN_BLOCK_PARTICLES 65536
+
+/**
+ * @brief Distributions particles may initially be placed by.
+ */
+typedef enum {
+	SPAWN_UNIFORM = 0, // Anywhere on the plane
+	SPAWN_POINT,       // All on a single cell
+	SPAWN_GAUSSIAN,    // Normally about a cell, redrawn until on the plane
+	SPAWN_LINE         // Anywhere along one edge of the plane
+} spawn_kind_t;
+
+/**
+ * @brief A distribution of initial particle coordinates.
+ */
+typedef struct {
+	spawn_kind_t kind;
+	uint8_t x, y;     // Cell of a point, or center of a Gaussian
+	double sigma;     // Standard deviation in cells of a Gaussian
+	direction_t edge; // North, east, south or west edge of a line
+} spawn_distribution_t;
+
+/**
+ * @brief Parse a distribution such as "uniform", "point:10,20",
+ * "gaussian:32,16,4.5" or "line:west".
+ *
+ * Points and Gaussians are centered on the plane and lines lie along the north
+ * edge unless given otherwise; a Gaussian spreads an eighth of the shorter
+ * side by default, and at most four times the longer side.
+ *
+ * @param[in] spec The distribution to parse; NULL is uniform.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @param[out] distribution The parsed distribution.
+ * @return The result of parsing the distribution.
+ */
+randomwalk_result_t spawn_parse(
+	const char* const spec,
+	const uint8_t width,
+	const uint8_t height,
+	spawn_distribution_t* const distribution
+);
+
+/**
+ * @brief Draw the coordinate of a particle.
+ *
+ * A uniform coordinate draws x then y exactly as the original placement did.
+ *
+ * @param[in] distribution The distribution to draw from.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @return The drawn coordinate.
+ */
+coordinate_t spawn_coordinate(
+	const spawn_distribution_t* const distribution,
+	const uint8_t width,
+	const uint8_t height,
+	rng_t* const rng
+);
+
+/**
+ * @brief Draw the coordinate, then the color and then the direction of a
+ * particle.
+ * @param[in] distribution The distribution to draw the coordinate from.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @param[out] coord The drawn coordinate.
+ * @param[out] color The drawn color.
+ * @param[out] direction The drawn direction.
+ */
+void spawn_particle(
+	const spawn_distribution_t* const distribution,
+	const uint8_t width,
+	const uint8_t height,
+	rng_t* const rng,
+	coordinate_t* const coord,
+	color_t* const color,
+	direction_t* const direction
+);
+
+/**
+ * @brief Fill a particle store to capacity.
+ *
+ * Each block of SPAWN_BLOCK_PARTICLES particles is placed by a task of its
+ * own from a generator derived from the seed and the block, so the placement
+ * does not depend on the number of threads. Blocks are placed on a thread
+ * pool of every online CPU, unless called from a pool worker, in which case
+ * they are placed in turn.
+ *
+ * @param[in,out] particles The empty store to fill.
+ * @param[in] distribution The distribution to place the particles by.
+ * @param[in] width The width of the plane.
+ * @param[in] height The height of the plane.
+ * @param[in] seed The seed to derive the generator of each block from.
+ * @return The result of filling the store.
+ */
+randomwalk_result_t spawn_particles(
+	particle_store_t* const particles,
+	const spawn_distribution_t distribution,
+	const uint8_t width,
+	const uint8_t height,
+	const uint64_t seed
+);
+
+#endif // SPAWN_H
@@ -0,0 +1,295 @@
+/**
+ * @file splitting.c
+ * @brief Multilevel splitting estimates of the probability that a particle
+ * survives a long time on a plane without wrap.
+ * @author Justin Thoreson
+ */
+
+#include "splitting.h"
+#include "kernel.h"
+#include "rng.h"
+#include "threadpool.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief The standard normal quantile of a two-sided 95% confidence interval.
+ */
+static const double Z_95 = 1.959964;
+
+/**
+ * @brief The particles of a level, moved between a pair of buffers as the
+ * survivors of one level are cloned into the next.
+ */
+typedef struct {
+	uint8_t* x;
+	uint8_t* y;
+	uint8_t* direction;
+	uint32_t count;
+} population_t;
+
+/**
+ * @brief An independent splitting estimate and its outcome.
+ */
+typedef struct {
+	const splitting_args_t* args;
+	uint64_t seed;
+	double probability;      // The product of the conditional probabilities
+	double lifetime;         // The mean steps survived, capped at the survival
+	double levels;           // The levels passed through
+	uint64_t particle_steps; // The steps taken by every particle of every level
+	randomwalk_result_t result;
+} replicate_t;
+
+/**
+ * @brief Run a replicate; a thread pool task.
+ * @param[in,out] arg The replicate to run.
+ */
+static void run_replicate(void* arg);
+
+/**
+ * @brief Estimate the probability of surviving from a single series of levels.
+ * @param[in,out] replicate The replicate to run, its outcome set on return.
+ * @param[in,out] buffers The populations the levels alternate between, each
+ * with room for the particles of a level.
+ * @param[out] order Room for the index of each particle of a level.
+ */
+static void estimate(
+	replicate_t* const replicate,
+	population_t* const buffers,
+	uint32_t* const order
+);
+
+/**
+ * @brief Advance the particles of a population by one step, dropping those
+ * that leave the plane.
+ * @param[in,out] population The particles to advance.
+ * @param[in] plane The plane to walk the particles on.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ */
+static void advance(
+	population_t* const population,
+	const kernel_plane_t plane,
+	rng_t* const rng
+);
+
+/**
+ * @brief Clone the survivors of a level into the particles of the next, each
+ * as often as the others and the remainder to distinct survivors at random.
+ * @param[in] survivors The survivors, at least one.
+ * @param[out] next The particles of the next level.
+ * @param[in] count The particles of the next level.
+ * @param[out] order Room for the index of each particle of a level.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ */
+static void clone(
+	const population_t* const survivors,
+	population_t* const next,
+	const uint32_t count,
+	uint32_t* const order,
+	rng_t* const rng
+);
+
+/**
+ * @brief Draw an index uniformly below a bound.
+ * @param[in,out] rng The pseudorandom number generator to draw from.
+ * @param[in] bound The number of indices.
+ * @return The index.
+ */
+static uint32_t draw_index(rng_t* const rng, const uint32_t bound);
+
+randomwalk_result_t splitting(const splitting_args_t args) {
+	if (!args.width || !args.height)
+		return RANDOMWALK_BADDIM;
+	if (args.particle_count < 2)
+		return RANDOMWALK_BADCOUNT;
+	if (args.prob_dir_change > 100)
+		return RANDOMWALK_BADPROB;
+	if (!args.survival || args.levels > args.survival)
+		return RANDOMWALK_FAIL;
+	const uint16_t replicate_count = args.replicates ? args.replicates : 1;
+	replicate_t* const replicates = (replicate_t*)calloc(replicate_count, sizeof(replicate_t));
+	if (!replicates)
+		return RANDOMWALK_FAIL;
+	const uint64_t seed = args.seed ? args.seed : (uint64_t)time(NULL);
+	for (uint16_t i = 0; i < replicate_count; i++) {
+		const uint64_t replicate_seed = rng_derive(seed, i);
+		replicates[i] = (replicate_t){
+			.args = &args,
+			.seed = replicate_seed ? replicate_seed : 1,
+			.result = RANDOMWALK_UNKNOWN
+		};
+	}
+	threadpool_t* pool = NULL;
+	randomwalk_result_t result = threadpool_create(&pool, args.threads);
+	for (uint16_t i = 0; result == RANDOMWALK_OK && i < replicate_count; i++)
+		result = threadpool_submit(pool, run_replicate, &replicates[i]);
+	if (pool)
+		threadpool_destroy(&pool);
+	double sum = 0, sum_squares = 0, lifetime = 0, levels = 0;
+	uint64_t particle_steps = 0;
+	for (uint16_t i = 0; result == RANDOMWALK_OK && i < replicate_count; i++) {
+		if (replicates[i].result != RANDOMWALK_OK) {
+			result = replicates[i].result;
+			break;
+		}
+		sum += replicates[i].probability;
+		sum_squares += replicates[i].probability * replicates[i].probability;
+		lifetime += replicates[i].lifetime / replicate_count;
+		levels += replicates[i].levels / replicate_count;
+		particle_steps += replicates[i].particle_steps;
+	}
+	free(replicates);
+	if (result != RANDOMWALK_OK)
+		return result;
+	const double probability = sum / replicate_count;
+	const double variance = replicate_count > 1 ?
+		(sum_squares - sum * probability) / (replicate_count - 1) : 0;
+	const double std_error = variance > 0 ? sqrt(variance / replicate_count) : 0;
+	const double low = probability - Z_95 * std_error;
+	// Brute force needs (1 - p) / (p e^2) particles to reach a relative error e
+	const double relative_error = probability > 0 ? std_error / probability : 0;
+	const double brute_force = relative_error > 0 ?
+		(1 - probability) / (probability * relative_error * relative_error) * lifetime : INFINITY;
+	puts("probability,std_error,ci95_low,ci95_high,levels,particle_steps,brute_force_particle_steps");
+	printf(
+		"%.6e,%.6e,%.6e,%.6e,%.1f,%lu,%.6e\n",
+		probability,
+		std_error,
+		low > 0 ? low : 0,
+		probability + Z_95 * std_error,
+		levels,
+		particle_steps,
+		brute_force
+	);
+	return RANDOMWALK_OK;
+}
+
+static void run_replicate(void* arg) {
+	replicate_t* const replicate = (replicate_t*)arg;
+	const uint32_t count = replicate->args->particle_count;
+	uint8_t* const memory = (uint8_t*)malloc((size_t)count * 6);
+	uint32_t* const order = (uint32_t*)malloc((size_t)count * sizeof(uint32_t));
+	if (!memory || !order) {
+		free(order);
+		free(memory);
+		replicate->result = RANDOMWALK_FAIL;
+		return;
+	}
+	population_t buffers[2];
+	for (uint8_t i = 0; i < 2; i++)
+		buffers[i] = (population_t){
+			.x = memory + (size_t)count * 3 * i,
+			.y = memory + (size_t)count * (3 * i + 1),
+			.direction = memory + (size_t)count * (3 * i + 2)
+		};
+	estimate(replicate, buffers, order);
+	free(order);
+	free(memory);
+	replicate->result = RANDOMWALK_OK;
+}
+
+static void estimate(
+	replicate_t* const replicate,
+	population_t* const buffers,
+	uint32_t* const order
+) {
+	const splitting_args_t* const args = replicate->args;
+	const uint32_t count = args->particle_count;
+	const kernel_plane_t plane = {
+		.width = args->width,
+		.height = args->height,
+		.prob_dir_change = args->prob_dir_change ? args->prob_dir_change : DEFAULT_PROB_DIR_CHANGE
+	};
+	rng_t rng;
+	rng_seed(&rng, replicate->seed);
+	population_t* population = &buffers[0];
+	for (uint32_t i = 0; i < count; i++) {
+		population->x[i] = rng_uint8(&rng, 0, args->width - 1);
+		population->y[i] = rng_uint8(&rng, 0, args->height - 1);
+		population->direction[i] = rng_uint8(&rng, 0, DIRECTION_COUNT - 1);
+	}
+	population->count = count;
+	// The probability of reaching the start of the current level
+	double weight = 1;
+	uint64_t step = 0;
+	for (uint16_t level = 1; step < args->survival; level++) {
+		const uint64_t end = args->levels ? args->survival * level / args->levels : args->survival;
+		while (step < end) {
+			// Summing the survival function over each step gives the mean lifetime
+			replicate->lifetime += weight * population->count / count;
+			replicate->particle_steps += population->count;
+			advance(population, plane, &rng);
+			step++;
+			if (!args->levels && population->count <= count / 2)
+				break;
+		}
+		weight *= (double)population->count / count;
+		replicate->levels++;
+		if (!population->count)
+			break;
+		if (step < args->survival) {
+			population_t* const next = population == &buffers[0] ? &buffers[1] : &buffers[0];
+			clone(population, next, count, order, &rng);
+			population = next;
+		}
+	}
+	replicate->probability = weight;
+}
+
+static void advance(
+	population_t* const population,
+	const kernel_plane_t plane,
+	rng_t* const rng
+) {
+	uint32_t survivors = 0;
+	for (uint32_t i = 0; i < population->count; i++) {
+		uint8_t x = population->x[i], y = population->y[i], direction = population->direction[i];
+		if (!kernel_move(plane, &x, &y, &direction, rng))
+			continue;
+		population->x[survivors] = x;
+		population->y[survivors] = y;
+		population->direction[survivors] = direction;
+		survivors++;
+	}
+	population->count = survivors;
+}
+
+static void clone(
+	const population_t* const survivors,
+	population_t* const next,
+	const uint32_t count,
+	uint32_t* const order,
+	rng_t* const rng
+) {
+	const uint32_t copies = count / survivors->count;
+	uint32_t remainder = count - copies * survivors->count;
+	for (uint32_t i = 0; i < survivors->count; i++)
+		order[i] = i;
+	// A partial shuffle picks the survivors copied once more
+	for (uint32_t i = 0; i < remainder; i++) {
+		const uint32_t j = i + draw_index(rng, survivors->count - i);
+		const uint32_t swapped = order[i];
+		order[i] = order[j];
+		order[j] = swapped;
+	}
+	next->count = 0;
+	for (uint32_t i = 0; i < survivors->count; i++) {
+		const uint32_t source = order[i];
+		const uint32_t clones = copies + (remainder ? 1 : 0);
+		if (remainder)
+			remainder--;
+		for (uint32_t j = 0; j < clones; j++) {
+			next->x[next->count] = survivors->x[source];
+			next->y[next->count] = survivors->y[source];
+			next->direction[next->count] = survivors->direction[source];
+			next->count++;
+		}
+	}
+}
+
+static uint32_t draw_index(rng_t* const rng, const uint32_t bound) {
+	return (uint32_t)(((uint64_t)rng_next(rng) * bound) >> 32);
+}
@@ -0,0 +1,51 @@
+/**
+ * @file splitting.h
+ * @brief Multilevel splitting estimates of the probability that a particle
+ * survives a long time on a plane without wrap.
+ * @author Justin Thoreson
+ *
+ * Survival is split into levels of time. Each level starts a fixed number of
+ * particles from the survivors of the level before, cloned evenly, and the
+ * fraction reaching the end of the level estimates the probability of
+ * surviving it given survival so far. The product of these fractions is an
+ * unbiased estimate of surviving every level, since a particle's future
+ * depends on its cell and direction alone.
+ */
+
+#pragma once
+#ifndef SPLITTING_H
+#define SPLITTING_H
+
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief Arguments to be given to a splitting estimate.
+ */
+typedef struct {
+	uint8_t width, height;
+	uint8_t prob_dir_change; // 0 uses the default probability
+	uint64_t survival;       // Steps a particle must survive
+	uint32_t particle_count; // Particles started at each level
+	uint16_t levels;         // Levels of equal steps; 0 ends each level once half survive
+	uint16_t replicates;     // Independent estimates averaged; 0 runs one
+	uint16_t threads;        // 0 uses every online CPU
+	uint64_t seed;           // 0 seeds from the current time
+} splitting_args_t;
+
+/**
+ * @brief Estimate the probability of surviving, writing the estimate, its 95%
+ * confidence interval, the mean levels per replicate and the particle-steps
+ * spent against those brute force would need for the same relative error, as
+ * CSV to standard output.
+ *
+ * Levels of equal steps yield an unbiased estimate; levels ending once half
+ * the particles survive adapt to the plane, at a bias vanishing as the
+ * particles per level grow.
+ *
+ * @param[in] args A structure of arguments to configure the estimate with.
+ * @return An enum denoting the random walk result code.
+ */
+randomwalk_result_t splitting(const splitting_args_t args);
+
+#endif // SPLITTING_H
@@ -0,0 +1,464 @@
+/**
+ * @file sweep.c
+ * @brief Headless parameter sweeps of the random walk across all cores.
+ * @author Justin Thoreson
+ */
+
+#include "sweep.h"
+#include "ensemble.h"
+#include "rng.h"
+#include "threadpool.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief A single configuration of the swept parameters.
+ */
+typedef struct {
+	uint8_t width, height;
+	uint32_t particle_count;
+	uint8_t prob_dir_change;
+} config_t;
+
+/**
+ * @brief A single (configuration, replicate) pair scheduled on the pool.
+ */
+typedef struct {
+	const sweep_args_t* args;
+	const config_t* config;
+	uint64_t seed;
+	uint64_t cost;
+	uint32_t lanes; // Replicates run by the job from itself on; 0 if run by another
+	randomwalk_stats_t stats;
+	randomwalk_result_t result;
+} job_t;
+
+/**
+ * @brief The aggregated outcome of every replicate of one configuration.
+ */
+typedef struct {
+	config_t config;
+	uint32_t replicates;
+	uint32_t censored; // Replicates cut off by the step limit
+	uint64_t min_steps, max_steps;
+	double mean_steps, stddev_steps;
+	double mean_survivors;
+} row_t;
+
+/**
+ * @brief The magic bytes opening a binary sweep table.
+ */
+static const char BINARY_MAGIC[8] = { 'R', 'W', 'S', 'W', 'E', 'E', 'P', '1' };
+
+/**
+ * @brief The size of a single record within a binary sweep table.
+ */
+#define BINARY_ROW_SIZE 72
+
+/**
+ * @brief Validate a sweep range against the bounds of its parameter.
+ * @param[in] range The range to validate.
+ * @param[in] lower The smallest value the parameter may take.
+ * @param[in] upper The largest value the parameter may take.
+ * @return True if the range is valid, false otherwise.
+ */
+static bool validate_range(
+	const sweep_range_t range,
+	const uint32_t lower,
+	const uint32_t upper
+);
+
+/**
+ * @brief Count the values visited by a sweep range.
+ * @param[in] range The range to count.
+ * @return The number of values in the range.
+ */
+static uint32_t range_size(const sweep_range_t range);
+
+/**
+ * @brief Get the value at a position within a sweep range.
+ * @param[in] range The range to index.
+ * @param[in] index The position within the range.
+ * @return The value at the given position.
+ */
+static uint32_t range_value(const sweep_range_t range, const uint32_t index);
+
+/**
+ * @brief Validate sweep arguments.
+ * @param[in] args The specified sweep arguments.
+ * @return The result of validating the sweep arguments.
+ */
+static randomwalk_result_t validate_sweep_args(const sweep_args_t args);
+
+/**
+ * @brief Enumerate every configuration of the swept parameters.
+ * @param[in] args The sweep arguments.
+ * @param[out] configs The enumerated configurations.
+ * @param[out] config_count The number of configurations.
+ * @return The result of enumerating the configurations.
+ */
+static randomwalk_result_t enumerate_configs(
+	const sweep_args_t args,
+	config_t** configs,
+	size_t* const config_count
+);
+
+/**
+ * @brief Estimate the relative cost of running a configuration once.
+ * @param[in] args The sweep arguments.
+ * @param[in] config The configuration to estimate.
+ * @return A cost proportional to the expected particle-steps of a run.
+ */
+static uint64_t estimate_cost(const sweep_args_t* const args, const config_t* const config);
+
+/**
+ * @brief Order jobs by ascending cost.
+ * @param[in] a The first job.
+ * @param[in] b The second job.
+ * @return The comparison of both jobs' costs.
+ */
+static int compare_jobs(const void* a, const void* b);
+
+/**
+ * @brief Run a single replicate of a configuration headlessly, or an ensemble
+ * of it and the replicates following it.
+ * @param[in,out] arg The job_t to run.
+ */
+static void run_job(void* arg);
+
+/**
+ * @brief Aggregate the replicates of a configuration into a result row.
+ * @param[out] row The aggregated row.
+ * @param[in] config The configuration the replicates belong to.
+ * @param[in] jobs The replicates of the configuration.
+ * @param[in] replicates The number of replicates.
+ */
+static void aggregate(
+	row_t* const row,
+	const config_t* const config,
+	const job_t* const* const jobs,
+	const uint32_t replicates
+);
+
+/**
+ * @brief Write the header of a result table.
+ * @param[in,out] stream The stream to write to.
+ * @param[in] format The format of the table.
+ * @param[in] row_count The number of rows that follow.
+ * @return The result of writing the header.
+ */
+static randomwalk_result_t write_header(
+	FILE* const stream,
+	const sweep_format_t format,
+	const uint32_t row_count
+);
+
+/**
+ * @brief Write a single row of a result table.
+ * @param[in,out] stream The stream to write to.
+ * @param[in] format The format of the table.
+ * @param[in] row The row to write.
+ * @param[in] wrap Whether particles wrapped around the plane.
+ * @return The result of writing the row.
+ */
+static randomwalk_result_t write_row(
+	FILE* const stream,
+	const sweep_format_t format,
+	const row_t* const row,
+	const bool wrap
+);
+
+/**
+ * @brief Serialize an unsigned integer in little-endian byte order.
+ * @param[out] buffer The buffer to serialize into.
+ * @param[in] value The value to serialize.
+ * @param[in] size The number of bytes to serialize.
+ * @return The position within the buffer following the value.
+ */
+static uint8_t* put_le(uint8_t* buffer, uint64_t value, const size_t size);
+
+randomwalk_result_t sweep(const sweep_args_t args) {
+	randomwalk_result_t result = validate_sweep_args(args);
+	if (result != RANDOMWALK_OK)
+		return result;
+	config_t* configs = NULL;
+	size_t config_count = 0;
+	result = enumerate_configs(args, &configs, &config_count);
+	if (result != RANDOMWALK_OK)
+		return result;
+	const uint32_t replicates = args.replicates ? args.replicates : 1;
+	const size_t job_count = config_count * replicates;
+	job_t* const jobs = (job_t*)calloc(job_count, sizeof(job_t));
+	job_t** const order = (job_t**)malloc(job_count * sizeof(job_t*));
+	if (!jobs || !order) {
+		free(order);
+		free(jobs);
+		free(configs);
+		return RANDOMWALK_FAIL;
+	}
+	const uint64_t seed = args.seed ? args.seed : (uint64_t)time(NULL);
+	size_t order_count = 0;
+	for (size_t i = 0; i < job_count; i++) {
+		const config_t* const config = &configs[i / replicates];
+		const uint64_t job_seed = rng_derive(seed, i);
+		// The first replicate of each ensemble runs those following it
+		const uint32_t replicate = (uint32_t)(i % replicates);
+		const uint32_t lanes = !args.ensemble ? 1 : replicate % ENSEMBLE_MAX_LANES ? 0 :
+			replicates - replicate < ENSEMBLE_MAX_LANES ? replicates - replicate : ENSEMBLE_MAX_LANES;
+		jobs[i] = (job_t){
+			.args = &args,
+			.config = config,
+			.seed = job_seed ? job_seed : 1,
+			.cost = estimate_cost(&args, config) * lanes,
+			.lanes = lanes,
+			.result = RANDOMWALK_UNKNOWN
+		};
+		if (lanes)
+			order[order_count++] = &jobs[i];
+	}
+	// Cheapest jobs are dealt first so that each worker pops its costliest
+	// jobs first and thieves mop up the cheap ones at the end of the sweep
+	qsort(order, order_count, sizeof(job_t*), compare_jobs);
+	threadpool_t* pool = NULL;
+	result = threadpool_create(&pool, args.threads);
+	for (size_t i = 0; result == RANDOMWALK_OK && i < order_count; i++)
+		result = threadpool_submit(pool, run_job, order[i]);
+	if (pool)
+		threadpool_destroy(&pool);
+	for (size_t i = 0; result == RANDOMWALK_OK && i < job_count; i++)
+		if (jobs[i].result != RANDOMWALK_OK && jobs[i].result != RANDOMWALK_DONE)
+			result = jobs[i].result;
+	FILE* const stream = args.output ? fopen(args.output, "wb") : stdout;
+	if (result == RANDOMWALK_OK && !stream)
+		result = RANDOMWALK_FAIL;
+	if (result == RANDOMWALK_OK)
+		result = write_header(stream, args.format, (uint32_t)config_count);
+	for (size_t i = 0; result == RANDOMWALK_OK && i < config_count; i++) {
+		const job_t* replicate_jobs[replicates];
+		for (uint32_t j = 0; j < replicates; j++)
+			replicate_jobs[j] = &jobs[i * replicates + j];
+		row_t row;
+		aggregate(&row, &configs[i], replicate_jobs, replicates);
+		result = write_row(stream, args.format, &row, args.wrap);
+	}
+	if (stream && stream != stdout && fclose(stream) && result == RANDOMWALK_OK)
+		result = RANDOMWALK_FAIL;
+	else if (stream == stdout)
+		fflush(stdout);
+	free(order);
+	free(jobs);
+	free(configs);
+	return result;
+}
+
+static bool validate_range(
+	const sweep_range_t range,
+	const uint32_t lower,
+	const uint32_t upper
+) {
+	return range.min >= lower && range.max <= upper && range.min <= range.max;
+}
+
+static uint32_t range_size(const sweep_range_t range) {
+	return (range.max - range.min) / (range.step ? range.step : 1) + 1;
+}
+
+static uint32_t range_value(const sweep_range_t range, const uint32_t index) {
+	return range.min + index * (range.step ? range.step : 1);
+}
+
+static randomwalk_result_t validate_sweep_args(const sweep_args_t args) {
+	if (!validate_range(args.width, 1, UINT8_MAX) ||
+		!validate_range(args.height, 1, UINT8_MAX))
+		return RANDOMWALK_BADDIM;
+	if (!validate_range(args.particle_count, 1, UINT32_MAX))
+		return RANDOMWALK_BADCOUNT;
+	if (!validate_range(args.prob_dir_change, 0, 100))
+		return RANDOMWALK_BADPROB;
+	// Wrapping particles never die, so every run needs a step limit
+	if (args.wrap && !args.max_steps)
+		return RANDOMWALK_FAIL;
+	// Tiles draw from generators derived per tile, which no ensemble reproduces
+	if (args.ensemble && args.tile_steps)
+		return RANDOMWALK_FAIL;
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t enumerate_configs(
+	const sweep_args_t args,
+	config_t** configs,
+	size_t* const config_count
+) {
+	const uint32_t widths = range_size(args.width);
+	const uint32_t heights = range_size(args.height);
+	const uint32_t counts = range_size(args.particle_count);
+	const uint32_t probs = range_size(args.prob_dir_change);
+	*config_count = (size_t)widths * heights * counts * probs;
+	*configs = (config_t*)malloc(*config_count * sizeof(config_t));
+	if (!*configs)
+		return RANDOMWALK_FAIL;
+	config_t* current = *configs;
+	for (uint32_t w = 0; w < widths; w++)
+		for (uint32_t h = 0; h < heights; h++)
+			for (uint32_t c = 0; c < counts; c++)
+				for (uint32_t p = 0; p < probs; p++) {
+					// A run takes 0 as the default, so rows record the probability run at
+					const uint8_t prob = (uint8_t)range_value(args.prob_dir_change, p);
+					*current++ = (config_t){
+						.width = (uint8_t)range_value(args.width, w),
+						.height = (uint8_t)range_value(args.height, h),
+						.particle_count = range_value(args.particle_count, c),
+						.prob_dir_change = prob ? prob : DEFAULT_PROB_DIR_CHANGE
+					};
+				}
+	return RANDOMWALK_OK;
+}
+
+static uint64_t estimate_cost(const sweep_args_t* const args, const config_t* const config) {
+	// Absent wrapping, lifetimes grow with the area a particle must cross
+	const uint64_t lifetime = args->wrap ? args->max_steps :
+		(uint64_t)config->width * config->height;
+	const uint64_t capped = args->max_steps && lifetime > args->max_steps ?
+		args->max_steps : lifetime;
+	return capped * config->particle_count;
+}
+
+static int compare_jobs(const void* a, const void* b) {
+	const job_t* const job_a = *(const job_t* const*)a;
+	const job_t* const job_b = *(const job_t* const*)b;
+	return (job_a->cost > job_b->cost) - (job_a->cost < job_b->cost);
+}
+
+static void run_job(void* arg) {
+	job_t* const job = (job_t*)arg;
+	const randomwalk_args_t args = {
+		.width = job->config->width,
+		.height = job->config->height,
+		.particle_count = job->config->particle_count,
+		.prob_dir_change = job->config->prob_dir_change,
+		.wrap = job->args->wrap,
+		.seed = job->seed,
+		.max_steps = job->args->max_steps,
+		.tile_steps = job->args->tile_steps
+	};
+	if (job->lanes <= 1) {
+		job->result = randomwalk_simulate(args, &job->stats);
+		return;
+	}
+	uint64_t seeds[ENSEMBLE_MAX_LANES];
+	randomwalk_stats_t stats[ENSEMBLE_MAX_LANES];
+	for (uint32_t i = 0; i < job->lanes; i++)
+		seeds[i] = job[i].seed;
+	const randomwalk_result_t result = ensemble_simulate(args, seeds, job->lanes, stats);
+	for (uint32_t i = 0; i < job->lanes; i++) {
+		job[i].stats = stats[i];
+		job[i].result = result != RANDOMWALK_OK ? result :
+			stats[i].survivors ? RANDOMWALK_OK : RANDOMWALK_DONE;
+	}
+}
+
+static void aggregate(
+	row_t* const row,
+	const config_t* const config,
+	const job_t* const* const jobs,
+	const uint32_t replicates
+) {
+	*row = (row_t){
+		.config = *config,
+		.replicates = replicates,
+		.min_steps = UINT64_MAX
+	};
+	double sum = 0, sum_squares = 0, survivors = 0;
+	for (uint32_t i = 0; i < replicates; i++) {
+		const randomwalk_stats_t stats = jobs[i]->stats;
+		if (stats.survivors)
+			row->censored++;
+		if (stats.steps < row->min_steps)
+			row->min_steps = stats.steps;
+		if (stats.steps > row->max_steps)
+			row->max_steps = stats.steps;
+		sum += (double)stats.steps;
+		sum_squares += (double)stats.steps * (double)stats.steps;
+		survivors += stats.survivors;
+	}
+	row->mean_steps = sum / replicates;
+	const double variance = sum_squares / replicates - row->mean_steps * row->mean_steps;
+	row->stddev_steps = variance > 0 ? sqrt(variance) : 0;
+	row->mean_survivors = survivors / replicates;
+}
+
+static randomwalk_result_t write_header(
+	FILE* const stream,
+	const sweep_format_t format,
+	const uint32_t row_count
+) {
+	if (format == SWEEP_FORMAT_CSV) {
+		const int written = fprintf(stream,
+			"width,height,pcount,prob_dir_change,wrap,replicates,censored,"
+			"min_steps,max_steps,mean_steps,stddev_steps,mean_survivors\n");
+		return written < 0 ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+	}
+	uint8_t header[sizeof(BINARY_MAGIC) + 8];
+	uint8_t* cursor = header;
+	for (size_t i = 0; i < sizeof(BINARY_MAGIC); i++)
+		*cursor++ = (uint8_t)BINARY_MAGIC[i];
+	cursor = put_le(cursor, row_count, 4);
+	put_le(cursor, BINARY_ROW_SIZE, 4);
+	return fwrite(header, sizeof(header), 1, stream) == 1 ?
+		RANDOMWALK_OK : RANDOMWALK_FAIL;
+}
+
+static randomwalk_result_t write_row(
+	FILE* const stream,
+	const sweep_format_t format,
+	const row_t* const row,
+	const bool wrap
+) {
+	if (format == SWEEP_FORMAT_CSV) {
+		const int written = fprintf(stream,
+			"%u,%u,%u,%u,%d,%u,%u,%lu,%lu,%.3f,%.3f,%.3f\n",
+			row->config.width,
+			row->config.height,
+			row->config.particle_count,
+			row->config.prob_dir_change,
+			wrap,
+			row->replicates,
+			row->censored,
+			row->min_steps,
+			row->max_steps,
+			row->mean_steps,
+			row->stddev_steps,
+			row->mean_survivors
+		);
+		return written < 0 ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+	}
+	union { double real; uint64_t bits; } mean, stddev, survivors;
+	mean.real = row->mean_steps;
+	stddev.real = row->stddev_steps;
+	survivors.real = row->mean_survivors;
+	uint8_t record[BINARY_ROW_SIZE];
+	uint8_t* cursor = record;
+	cursor = put_le(cursor, row->config.width, 4);
+	cursor = put_le(cursor, row->config.height, 4);
+	cursor = put_le(cursor, row->config.particle_count, 4);
+	cursor = put_le(cursor, row->config.prob_dir_change, 4);
+	cursor = put_le(cursor, wrap, 4);
+	cursor = put_le(cursor, row->replicates, 4);
+	cursor = put_le(cursor, row->censored, 4);
+	cursor = put_le(cursor, 0, 4); // Reserved
+	cursor = put_le(cursor, row->min_steps, 8);
+	cursor = put_le(cursor, row->max_steps, 8);
+	cursor = put_le(cursor, mean.bits, 8);
+	cursor = put_le(cursor, stddev.bits, 8);
+	put_le(cursor, survivors.bits, 8);
+	return fwrite(record, sizeof(record), 1, stream) == 1 ?
+		RANDOMWALK_OK : RANDOMWALK_FAIL;
+}
+
+static uint8_t* put_le(uint8_t* buffer, uint64_t value, const size_t size) {
+	for (size_t i = 0; i < size; i++, value >>= 8)
+		*buffer++ = (uint8_t)value;
+	return buffer;
+}
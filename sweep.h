@@ -0,0 +1,58 @@
+/**
+ * @file sweep.h
+ * @brief Headless parameter sweeps of the random walk across all cores.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "randomwalk.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief An inclusive range of parameter values visited in fixed increments.
+ */
+typedef struct {
+	uint32_t min, max, step;
+} sweep_range_t;
+
+/**
+ * @brief Formats a sweep may tabulate its results in.
+ */
+typedef enum {
+	SWEEP_FORMAT_CSV = 0, // One comma-separated row per configuration
+	SWEEP_FORMAT_BINARY   // Fixed-size little-endian records behind a header
+} sweep_format_t;
+
+/**
+ * @brief Arguments to be given to a parameter sweep.
+ */
+typedef struct {
+	sweep_range_t width, height;
+	sweep_range_t particle_count;
+	sweep_range_t prob_dir_change;
+	bool wrap;
+	uint64_t seed;       // 0 seeds from the current time
+	uint64_t max_steps;  // 0 runs each replicate until all particles die
+	uint16_t replicates; // 0 runs a single replicate per configuration
+	uint16_t threads;    // 0 uses every online CPU
+	uint32_t tile_steps; // 0 advances every particle of a replicate together
+	bool ensemble;       // Run the replicates of a configuration in vector lanes
+	sweep_format_t format;
+	const char* output;  // NULL writes to standard output
+} sweep_args_t;
+
+/**
+ * @brief Run every (configuration, replicate) pair of a parameter sweep.
+ *
+ * Each configuration of the swept parameters yields one result row.
+ *
+ * @param[in] args A structure of arguments to configure the sweep with.
+ * @return An enum denoting the random walk result code.
+ */
+randomwalk_result_t sweep(const sweep_args_t args);
+
+#endif // SWEEP_H
@@ -0,0 +1,74 @@
+/**
+ * @file terminal.c
+ * @brief Keyboard input from the controlling terminal while drawing.
+ * @author Justin Thoreson
+ */
+
+#include "terminal.h"
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+/**
+ * @brief Whether the terminal settings have been replaced.
+ */
+static bool is_raw = false;
+
+/**
+ * @brief The terminal settings to restore.
+ */
+static struct termios original;
+
+/**
+ * @brief Whether an interrupt or termination request was caught.
+ */
+static volatile sig_atomic_t interrupted = 0;
+
+/**
+ * @brief Record that the program was asked to stop.
+ * @param[in] signal The caught signal.
+ */
+static void handle_interrupt(int signal);
+
+void terminal_begin_input() {
+	struct sigaction action = { .sa_handler = handle_interrupt };
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	if (is_raw || !isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &original))
+		return;
+	struct termios raw = original;
+	raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	is_raw = !tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+}
+
+int terminal_read_key() {
+	unsigned char key;
+	if (!is_raw || read(STDIN_FILENO, &key, 1) != 1)
+		return TERMINAL_NO_KEY;
+	// Arrow keys arrive as the escape sequences ESC [ A through ESC [ D
+	unsigned char sequence[2];
+	if (key != '\x1b' || read(STDIN_FILENO, sequence, 2) != 2 || sequence[0] != '[' ||
+		sequence[1] < 'A' || sequence[1] > 'D')
+		return key;
+	return TERMINAL_KEY_UP + sequence[1] - 'A';
+}
+
+bool terminal_interrupted() {
+	return interrupted;
+}
+
+void terminal_end_input() {
+	if (is_raw)
+		tcsetattr(STDIN_FILENO, TCSANOW, &original);
+	is_raw = false;
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+}
+
+static void handle_interrupt(int signal) {
+	(void)signal;
+	interrupted = 1;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file terminal.h
+ * @brief Keyboard input from the controlling terminal while drawing.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include <stdbool.h>
+
+/**
+ * @brief The value returned when no key has been pressed.
+ */
+#define TERMINAL_NO_KEY (-1)
+
+/**
+ * @brief The values returned for arrow keys, beyond those of any single byte.
+ */
+#define TERMINAL_KEY_UP    0x100
+#define TERMINAL_KEY_DOWN  0x101
+#define TERMINAL_KEY_RIGHT 0x102
+#define TERMINAL_KEY_LEFT  0x103
+
+/**
+ * @brief Read keys without waiting for a newline or echoing them.
+ *
+ * Interrupts and termination requests are caught so that the terminal is
+ * restored before the program exits. Does nothing if standard input is not a
+ * terminal.
+ */
+void terminal_begin_input();
+
+/**
+ * @brief Read a pressed key without blocking.
+ * @return The key pressed, one of TERMINAL_KEY_* for an arrow key, or
+ * TERMINAL_NO_KEY if none was.
+ */
+int terminal_read_key();
+
+/**
+ * @brief Determine whether an interrupt or termination request was caught.
+ * @return True if the program was asked to stop, false otherwise.
+ */
+bool terminal_interrupted();
+
+/**
+ * @brief Restore the terminal settings in effect before terminal_begin_input().
+ */
+void terminal_end_input();
+
+#endif // TERMINAL_H
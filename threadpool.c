@@ -0,0 +1,301 @@
+/**
+ * @file threadpool.c
+ * @brief A work-stealing thread pool for running independent tasks.
+ * @author Justin Thoreson
+ */
+
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @brief A task paired with the argument it was submitted with.
+ */
+typedef struct {
+	threadpool_task_fn function;
+	void* arg;
+} task_t;
+
+/**
+ * @brief A double-ended queue of tasks owned by a single worker.
+ *
+ * Tasks occupy the range [head, tail). The owner pushes and pops at the tail;
+ * thieves steal from the head.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	task_t* tasks;
+	size_t head, tail, capacity;
+} deque_t;
+
+/**
+ * @brief A worker thread and the deque it owns.
+ */
+typedef struct {
+	pthread_t thread;
+	deque_t deque;
+	threadpool_t* pool;
+	uint16_t index;
+} worker_t;
+
+struct threadpool_t {
+	worker_t* workers;
+	uint16_t worker_count;
+	atomic_uint submit_cursor;
+	atomic_long queued;  // Tasks sitting in deques
+	atomic_long pending; // Tasks queued or running
+	atomic_bool stopping;
+	pthread_mutex_t lock;
+	pthread_cond_t work_available;
+	pthread_cond_t all_done;
+};
+
+/**
+ * @brief The initial capacity of each worker deque.
+ */
+const size_t DEQUE_INITIAL_CAPACITY = 64;
+
+/**
+ * @brief The pool owning the calling thread, if it is a worker.
+ */
+static _Thread_local threadpool_t* current_pool = NULL;
+
+/**
+ * @brief The index of the calling thread within its pool, if it is a worker.
+ */
+static _Thread_local int32_t current_index = -1;
+
+/**
+ * @brief Push a task onto the tail of a deque.
+ * @param[in,out] deque The deque to push onto.
+ * @param[in] task The task to push.
+ * @return The result of pushing the task.
+ */
+static randomwalk_result_t deque_push(deque_t* const deque, const task_t task);
+
+/**
+ * @brief Pop a task from the tail of a deque.
+ * @param[in,out] deque The deque to pop from.
+ * @param[out] task The popped task.
+ * @return True if a task was popped, false if the deque was empty.
+ */
+static bool deque_pop(deque_t* const deque, task_t* const task);
+
+/**
+ * @brief Steal a task from the head of a deque.
+ * @param[in,out] deque The deque to steal from.
+ * @param[out] task The stolen task.
+ * @return True if a task was stolen, false if the deque was empty.
+ */
+static bool deque_steal(deque_t* const deque, task_t* const task);
+
+/**
+ * @brief Take a task from a worker's own deque, or steal one from another.
+ * @param[in,out] worker The worker looking for work.
+ * @param[out] task The task taken.
+ * @return True if a task was taken, false if every deque was empty.
+ */
+static bool take_task(worker_t* const worker, task_t* const task);
+
+/**
+ * @brief The main loop of a worker thread.
+ * @param[in,out] arg The worker_t the thread runs as.
+ * @return Always NULL.
+ */
+static void* work(void* arg);
+
+randomwalk_result_t threadpool_create(
+	threadpool_t** pool,
+	const uint16_t thread_count
+) {
+	if (!pool || *pool)
+		return RANDOMWALK_FAIL;
+	threadpool_t* const created = (threadpool_t*)calloc(1, sizeof(threadpool_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	const long online = sysconf(_SC_NPROCESSORS_ONLN);
+	created->worker_count = thread_count ? thread_count :
+		(uint16_t)(online > 0 && online <= UINT16_MAX ? online : 1);
+	created->workers = (worker_t*)calloc(created->worker_count, sizeof(worker_t));
+	if (!created->workers) {
+		free(created);
+		return RANDOMWALK_FAIL;
+	}
+	atomic_init(&created->submit_cursor, 0);
+	atomic_init(&created->queued, 0);
+	atomic_init(&created->pending, 0);
+	atomic_init(&created->stopping, false);
+	pthread_mutex_init(&created->lock, NULL);
+	pthread_cond_init(&created->work_available, NULL);
+	pthread_cond_init(&created->all_done, NULL);
+	for (uint16_t i = 0; i < created->worker_count; i++) {
+		worker_t* const worker = &created->workers[i];
+		pthread_mutex_init(&worker->deque.lock, NULL);
+		worker->pool = created;
+		worker->index = i;
+	}
+	*pool = created;
+	for (uint16_t i = 0; i < created->worker_count; i++) {
+		if (pthread_create(&created->workers[i].thread, NULL, work, &created->workers[i])) {
+			created->worker_count = i;
+			threadpool_destroy(pool);
+			return RANDOMWALK_FAIL;
+		}
+	}
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t threadpool_submit(
+	threadpool_t* const pool,
+	const threadpool_task_fn task,
+	void* const arg
+) {
+	if (!pool || !task)
+		return RANDOMWALK_FAIL;
+	const uint16_t index = current_pool == pool ? (uint16_t)current_index :
+		(uint16_t)(atomic_fetch_add(&pool->submit_cursor, 1) % pool->worker_count);
+	atomic_fetch_add(&pool->pending, 1);
+	randomwalk_result_t result =
+		deque_push(&pool->workers[index].deque, (task_t){ task, arg });
+	if (result != RANDOMWALK_OK) {
+		atomic_fetch_sub(&pool->pending, 1);
+		return result;
+	}
+	atomic_fetch_add(&pool->queued, 1);
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_signal(&pool->work_available);
+	pthread_mutex_unlock(&pool->lock);
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t threadpool_wait(threadpool_t* const pool) {
+	if (!pool || current_pool == pool)
+		return RANDOMWALK_FAIL;
+	pthread_mutex_lock(&pool->lock);
+	while (atomic_load(&pool->pending) > 0)
+		pthread_cond_wait(&pool->all_done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+	return RANDOMWALK_OK;
+}
+
+uint16_t threadpool_size(const threadpool_t* const pool) {
+	return pool ? pool->worker_count : 0;
+}
+
+int32_t threadpool_worker_index() {
+	return current_index;
+}
+
+randomwalk_result_t threadpool_destroy(threadpool_t** pool) {
+	if (!pool || !*pool)
+		return RANDOMWALK_FAIL;
+	threadpool_t* const destroyed = *pool;
+	threadpool_wait(destroyed);
+	pthread_mutex_lock(&destroyed->lock);
+	atomic_store(&destroyed->stopping, true);
+	pthread_cond_broadcast(&destroyed->work_available);
+	pthread_mutex_unlock(&destroyed->lock);
+	for (uint16_t i = 0; i < destroyed->worker_count; i++)
+		pthread_join(destroyed->workers[i].thread, NULL);
+	for (uint16_t i = 0; i < destroyed->worker_count; i++) {
+		pthread_mutex_destroy(&destroyed->workers[i].deque.lock);
+		free(destroyed->workers[i].deque.tasks);
+	}
+	pthread_cond_destroy(&destroyed->all_done);
+	pthread_cond_destroy(&destroyed->work_available);
+	pthread_mutex_destroy(&destroyed->lock);
+	free(destroyed->workers);
+	free(destroyed);
+	*pool = NULL;
+	return RANDOMWALK_OK;
+}
+
+static randomwalk_result_t deque_push(deque_t* const deque, const task_t task) {
+	pthread_mutex_lock(&deque->lock);
+	if (deque->tail == deque->capacity) {
+		// Slide live tasks to the front before growing
+		const size_t count = deque->tail - deque->head;
+		if (deque->head >= deque->capacity / 2 && deque->head) {
+			for (size_t i = 0; i < count; i++)
+				deque->tasks[i] = deque->tasks[deque->head + i];
+		} else {
+			const size_t capacity = deque->capacity ?
+				deque->capacity * 2 : DEQUE_INITIAL_CAPACITY;
+			task_t* const tasks = (task_t*)malloc(capacity * sizeof(task_t));
+			if (!tasks) {
+				pthread_mutex_unlock(&deque->lock);
+				return RANDOMWALK_FAIL;
+			}
+			for (size_t i = 0; i < count; i++)
+				tasks[i] = deque->tasks[deque->head + i];
+			free(deque->tasks);
+			deque->tasks = tasks;
+			deque->capacity = capacity;
+		}
+		deque->head = 0;
+		deque->tail = count;
+	}
+	deque->tasks[deque->tail++] = task;
+	pthread_mutex_unlock(&deque->lock);
+	return RANDOMWALK_OK;
+}
+
+static bool deque_pop(deque_t* const deque, task_t* const task) {
+	pthread_mutex_lock(&deque->lock);
+	const bool popped = deque->tail > deque->head;
+	if (popped)
+		*task = deque->tasks[--deque->tail];
+	pthread_mutex_unlock(&deque->lock);
+	return popped;
+}
+
+static bool deque_steal(deque_t* const deque, task_t* const task) {
+	pthread_mutex_lock(&deque->lock);
+	const bool stolen = deque->tail > deque->head;
+	if (stolen)
+		*task = deque->tasks[deque->head++];
+	pthread_mutex_unlock(&deque->lock);
+	return stolen;
+}
+
+static bool take_task(worker_t* const worker, task_t* const task) {
+	threadpool_t* const pool = worker->pool;
+	bool taken = deque_pop(&worker->deque, task);
+	for (uint16_t i = 1; !taken && i < pool->worker_count; i++) {
+		const uint16_t victim = (worker->index + i) % pool->worker_count;
+		taken = deque_steal(&pool->workers[victim].deque, task);
+	}
+	if (taken)
+		atomic_fetch_sub(&pool->queued, 1);
+	return taken;
+}
+
+static void* work(void* arg) {
+	worker_t* const worker = (worker_t*)arg;
+	threadpool_t* const pool = worker->pool;
+	current_pool = pool;
+	current_index = worker->index;
+	while (true) {
+		task_t task;
+		if (take_task(worker, &task)) {
+			task.function(task.arg);
+			if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+				pthread_mutex_lock(&pool->lock);
+				pthread_cond_broadcast(&pool->all_done);
+				pthread_mutex_unlock(&pool->lock);
+			}
+			continue;
+		}
+		pthread_mutex_lock(&pool->lock);
+		while (atomic_load(&pool->queued) <= 0 && !atomic_load(&pool->stopping))
+			pthread_cond_wait(&pool->work_available, &pool->lock);
+		const bool stop = atomic_load(&pool->stopping) && atomic_load(&pool->queued) <= 0;
+		pthread_mutex_unlock(&pool->lock);
+		if (stop)
+			break;
+	}
+	return NULL;
+}
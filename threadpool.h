@@ -0,0 +1,86 @@
+/**
+ * @file threadpool.h
+ * @brief A work-stealing thread pool for running independent tasks.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "randomwalk.h"
+#include <stdint.h>
+
+/**
+ * @brief A task to be executed by the thread pool.
+ * @param[in,out] arg The argument the task was submitted with.
+ */
+typedef void (*threadpool_task_fn)(void* arg);
+
+/**
+ * @brief A pool of worker threads, each owning a deque of tasks.
+ *
+ * Workers pop tasks from the bottom of their own deque and, when it runs dry,
+ * steal from the top of the deques of other workers.
+ */
+typedef struct threadpool_t threadpool_t;
+
+/**
+ * @brief Create a thread pool.
+ * @param[out] pool The created thread pool.
+ * @param[in] thread_count The number of workers; 0 uses every online CPU.
+ * @return The result of creating the thread pool.
+ */
+randomwalk_result_t threadpool_create(
+	threadpool_t** pool,
+	const uint16_t thread_count
+);
+
+/**
+ * @brief Submit a task to the thread pool.
+ *
+ * Tasks submitted from a worker are pushed onto that worker's own deque;
+ * tasks submitted from elsewhere are dealt to the workers round-robin.
+ *
+ * @param[in,out] pool The thread pool to submit to.
+ * @param[in] task The task to execute.
+ * @param[in] arg The argument to execute the task with.
+ * @return The result of submitting the task.
+ */
+randomwalk_result_t threadpool_submit(
+	threadpool_t* const pool,
+	const threadpool_task_fn task,
+	void* const arg
+);
+
+/**
+ * @brief Block until every submitted task has finished.
+ *
+ * Must not be called from a worker of the same pool.
+ *
+ * @param[in,out] pool The thread pool to wait on.
+ * @return The result of waiting on the thread pool.
+ */
+randomwalk_result_t threadpool_wait(threadpool_t* const pool);
+
+/**
+ * @brief Get the number of workers in the thread pool.
+ * @param[in] pool The thread pool.
+ * @return The number of workers.
+ */
+uint16_t threadpool_size(const threadpool_t* const pool);
+
+/**
+ * @brief Get the index of the worker executing the calling task.
+ * @return The worker index, or -1 if not called from a pool worker.
+ */
+int32_t threadpool_worker_index();
+
+/**
+ * @brief Finish outstanding tasks, join all workers and free the pool.
+ * @param[in,out] pool The thread pool to destroy.
+ * @return The result of destroying the thread pool.
+ */
+randomwalk_result_t threadpool_destroy(threadpool_t** pool);
+
+#endif // THREADPOOL_H
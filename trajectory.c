@@ -0,0 +1,435 @@
+/**
+ * @file trajectory.c
+ * @brief Compressed trajectory files with block-level random access.
+ * @author Justin Thoreson
+ */
+
+#include "trajectory.h"
+#include "delta.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct trajectory_writer_t {
+	FILE* file;
+	uint8_t width, height;
+	bool wrap, failed;
+	uint32_t block_steps;
+	particle_store_t latest;   // Particles as of the newest step
+	uint8_t* block;            // Block being gathered
+	size_t size, capacity;
+	trajectory_block_t* index; // Entries of the blocks written
+	uint64_t blocks, index_capacity;
+};
+
+struct trajectory_t {
+	uint8_t* data;
+	size_t size;
+	trajectory_info_t info;
+	const uint8_t* index;
+};
+
+/**
+ * @brief The magic bytes opening a trajectory file.
+ */
+static const char TRAJECTORY_MAGIC[8] = { 'R', 'W', 'T', 'R', 'A', 'J', '0', '1' };
+
+/**
+ * @brief The size of the file header.
+ */
+static const size_t HEADER_SIZE = 28;
+
+/**
+ * @brief The offset of the index offset within the file header.
+ */
+static const long INDEX_OFFSET_FIELD = 20;
+
+/**
+ * @brief The size of the header of a block.
+ */
+static const size_t BLOCK_HEADER_SIZE = 16;
+
+/**
+ * @brief The size of a serialized keyframe particle.
+ */
+static const size_t PARTICLE_SIZE = 10;
+
+/**
+ * @brief The size of an entry of the block index.
+ */
+static const size_t INDEX_ENTRY_SIZE = 28;
+
+/**
+ * @brief Store an unsigned integer in little-endian byte order.
+ * @param[out] bytes The bytes to store into.
+ * @param[in] value The value to store.
+ * @param[in] size The number of bytes to store.
+ * @return The bytes following those stored.
+ */
+static uint8_t* store_le(uint8_t* bytes, uint64_t value, const size_t size);
+
+/**
+ * @brief Load an unsigned integer in little-endian byte order.
+ * @param[in] bytes The bytes to load from.
+ * @param[in] size The number of bytes to load.
+ * @return The loaded value.
+ */
+static uint64_t load_le(const uint8_t* const bytes, const size_t size);
+
+/**
+ * @brief Start gathering a block with a keyframe.
+ * @param[in,out] writer The writer to gather with.
+ * @param[in] step The step of the keyframe.
+ * @param[in] particles The particles of the keyframe.
+ */
+static void start_block(
+	trajectory_writer_t* const writer,
+	const uint64_t step,
+	const particle_store_t* const particles
+);
+
+/**
+ * @brief Write the gathered block and add it to the index.
+ * @param[in,out] writer The writer to flush.
+ */
+static void flush_block(trajectory_writer_t* const writer);
+
+randomwalk_result_t trajectory_writer_create(
+	trajectory_writer_t** writer,
+	const char* const path,
+	const uint32_t block_steps,
+	const randomwalk_args_t args
+) {
+	if (!writer || *writer || !path)
+		return RANDOMWALK_FAIL;
+	trajectory_writer_t* const created =
+		(trajectory_writer_t*)calloc(1, sizeof(trajectory_writer_t));
+	if (!created)
+		return RANDOMWALK_FAIL;
+	*writer = created;
+	created->width = args.width;
+	created->height = args.height;
+	created->wrap = args.wrap;
+	created->block_steps = block_steps ? block_steps : TRAJECTORY_DEFAULT_BLOCK_STEPS;
+	// Particles only ever die, so a block never outgrows its first keyframe
+	created->capacity = BLOCK_HEADER_SIZE + args.particle_count * PARTICLE_SIZE +
+		created->block_steps * delta_size(args.particle_count);
+	created->block = (uint8_t*)malloc(created->capacity);
+	created->file = fopen(path, "wb");
+	if (!created->block || !created->file ||
+		particle_store_create(&created->latest, args.particle_count) != RANDOMWALK_OK) {
+		created->failed = true;
+		trajectory_writer_destroy(writer);
+		return RANDOMWALK_FAIL;
+	}
+	uint8_t header[HEADER_SIZE];
+	memcpy(header, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC));
+	uint8_t* field = header + sizeof(TRAJECTORY_MAGIC);
+	field = store_le(field, args.width, 1);
+	field = store_le(field, args.height, 1);
+	field = store_le(field, args.wrap, 1);
+	field = store_le(field, 0, 1);
+	field = store_le(field, args.particle_count, 4);
+	field = store_le(field, created->block_steps, 4);
+	store_le(field, 0, 8); // Patched once the index is written
+	created->failed = fwrite(header, sizeof(header), 1, created->file) != 1;
+	return created->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
+
+randomwalk_result_t trajectory_writer_observe(void* context, const frame_t* const frame) {
+	trajectory_writer_t* const writer = (trajectory_writer_t*)context;
+	if (!writer || !frame || !frame->particles)
+		return RANDOMWALK_FAIL;
+	if (writer->size && load_le(writer->block + 8, 4) + 1 == writer->block_steps)
+		flush_block(writer);
+	if (!writer->size) {
+		start_block(writer, frame->step, frame->particles);
+	} else {
+		uint8_t* const delta = writer->block + writer->size;
+		if (delta_encode(delta, &writer->latest, frame->particles) != RANDOMWALK_OK)
+			writer->failed = true;
+		writer->size += delta_size(writer->latest.count);
+		store_le(writer->block + 8, load_le(writer->block + 8, 4) + 1, 4);
+	}
+	if (particle_store_copy(&writer->latest, frame->particles) != RANDOMWALK_OK)
+		writer->failed = true;
+	return writer->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+}
+
+randomwalk_result_t trajectory_writer_destroy(trajectory_writer_t** writer) {
+	if (!writer || !*writer)
+		return RANDOMWALK_FAIL;
+	trajectory_writer_t* const destroyed = *writer;
+	if (destroyed->file && !destroyed->failed) {
+		if (destroyed->size)
+			flush_block(destroyed);
+		const long index_offset = ftell(destroyed->file);
+		uint8_t entry[INDEX_ENTRY_SIZE];
+		store_le(entry, destroyed->blocks, 8);
+		destroyed->failed = index_offset < 0 || fwrite(entry, 8, 1, destroyed->file) != 1;
+		for (uint64_t i = 0; !destroyed->failed && i < destroyed->blocks; i++) {
+			const trajectory_block_t* const block = &destroyed->index[i];
+			uint8_t* field = store_le(entry, block->first_step, 8);
+			field = store_le(field, block->deltas, 4);
+			field = store_le(field, block->offset, 8);
+			store_le(field, block->size, 8);
+			destroyed->failed = fwrite(entry, sizeof(entry), 1, destroyed->file) != 1;
+		}
+		store_le(entry, (uint64_t)index_offset, 8);
+		destroyed->failed = destroyed->failed ||
+			fseek(destroyed->file, INDEX_OFFSET_FIELD, SEEK_SET) ||
+			fwrite(entry, 8, 1, destroyed->file) != 1;
+	}
+	if (destroyed->file && fclose(destroyed->file))
+		destroyed->failed = true;
+	const randomwalk_result_t result = destroyed->failed ? RANDOMWALK_FAIL : RANDOMWALK_OK;
+	particle_store_destroy(&destroyed->latest);
+	free(destroyed->index);
+	free(destroyed->block);
+	free(destroyed);
+	*writer = NULL;
+	return result;
+}
+
+randomwalk_result_t trajectory_open(trajectory_t** trajectory, const char* const path) {
+	if (!trajectory || *trajectory || !path)
+		return RANDOMWALK_FAIL;
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return RANDOMWALK_FAIL;
+	struct stat status;
+	uint8_t* data = MAP_FAILED;
+	if (!fstat(fd, &status) && (size_t)status.st_size >= HEADER_SIZE + 8)
+		data = (uint8_t*)mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return RANDOMWALK_FAIL;
+	const size_t size = (size_t)status.st_size;
+	const uint64_t index_offset = load_le(data + INDEX_OFFSET_FIELD, 8);
+	const uint64_t blocks = index_offset <= size - 8 ? load_le(data + index_offset, 8) : 0;
+	if (memcmp(data, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC)) || !blocks ||
+		index_offset < HEADER_SIZE || blocks > (size - index_offset - 8) / INDEX_ENTRY_SIZE) {
+		munmap(data, size);
+		return RANDOMWALK_FAIL;
+	}
+	trajectory_t* const opened = (trajectory_t*)calloc(1, sizeof(trajectory_t));
+	if (!opened) {
+		munmap(data, size);
+		return RANDOMWALK_FAIL;
+	}
+	opened->data = data;
+	opened->size = size;
+	opened->index = data + index_offset + 8;
+	const uint8_t* const last = opened->index + (blocks - 1) * INDEX_ENTRY_SIZE;
+	opened->info = (trajectory_info_t){
+		.width = data[8],
+		.height = data[9],
+		.wrap = data[10],
+		.particle_count = (uint32_t)load_le(data + 12, 4),
+		.block_steps = (uint32_t)load_le(data + 16, 4),
+		.block_count = blocks,
+		.first_step = load_le(opened->index, 8),
+		.last_step = load_le(last, 8) + load_le(last + 8, 4)
+	};
+	// Decoded steps are visited in order, so let the kernel read ahead
+	madvise(data, size, MADV_SEQUENTIAL);
+	*trajectory = opened;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t trajectory_info(
+	const trajectory_t* const trajectory,
+	trajectory_info_t* const info
+) {
+	if (!trajectory || !info)
+		return RANDOMWALK_FAIL;
+	*info = trajectory->info;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t trajectory_block(
+	const trajectory_t* const trajectory,
+	const uint64_t index,
+	trajectory_block_t* const block
+) {
+	if (!trajectory || !block || index >= trajectory->info.block_count)
+		return RANDOMWALK_FAIL;
+	const uint8_t* const entry = trajectory->index + index * INDEX_ENTRY_SIZE;
+	*block = (trajectory_block_t){
+		.first_step = load_le(entry, 8),
+		.deltas = (uint32_t)load_le(entry + 8, 4),
+		.offset = load_le(entry + 12, 8),
+		.size = load_le(entry + 20, 8)
+	};
+	const bool in_file = block->offset >= HEADER_SIZE && block->offset <= trajectory->size &&
+		block->size >= BLOCK_HEADER_SIZE && block->size <= trajectory->size - block->offset;
+	return in_file ? RANDOMWALK_OK : RANDOMWALK_FAIL;
+}
+
+randomwalk_result_t trajectory_find_block(
+	const trajectory_t* const trajectory,
+	const uint64_t step,
+	uint64_t* const index
+) {
+	if (!trajectory || !index || step < trajectory->info.first_step ||
+		step > trajectory->info.last_step)
+		return RANDOMWALK_FAIL;
+	// Find the last block starting at or before the step
+	uint64_t low = 0, high = trajectory->info.block_count;
+	while (high - low > 1) {
+		const uint64_t middle = low + (high - low) / 2;
+		if (load_le(trajectory->index + middle * INDEX_ENTRY_SIZE, 8) <= step)
+			low = middle;
+		else
+			high = middle;
+	}
+	*index = low;
+	return RANDOMWALK_OK;
+}
+
+randomwalk_result_t trajectory_decode_block(
+	const trajectory_t* const trajectory,
+	const uint64_t index,
+	const uint64_t first,
+	const uint64_t last,
+	trajectory_visit_t visit,
+	void* context
+) {
+	trajectory_block_t block;
+	randomwalk_result_t result = trajectory_block(trajectory, index, &block);
+	if (result != RANDOMWALK_OK || !visit)
+		return RANDOMWALK_FAIL;
+	const uint8_t* bytes = trajectory->data + block.offset;
+	const uint8_t* const end = bytes + block.size;
+	const uint32_t count = (uint32_t)load_le(bytes + 12, 4);
+	if (count > (block.size - BLOCK_HEADER_SIZE) / PARTICLE_SIZE)
+		return RANDOMWALK_FAIL;
+	particle_store_t particles;
+	result = particle_store_create(&particles, count);
+	if (result != RANDOMWALK_OK)
+		return result;
+	bytes += BLOCK_HEADER_SIZE;
+	const trajectory_info_t* const info = &trajectory->info;
+	for (uint32_t i = 0; i < count; i++, bytes += PARTICLE_SIZE) {
+		// Readers index the plane by these, so a damaged keyframe is rejected
+		if (bytes[4] >= info->width || bytes[5] >= info->height || bytes[6] >= DIRECTION_COUNT) {
+			particle_store_destroy(&particles);
+			return RANDOMWALK_FAIL;
+		}
+		particle_store_push(
+			&particles,
+			(uint32_t)load_le(bytes, 4),
+			(coordinate_t){ bytes[4], bytes[5] },
+			(direction_t)bytes[6],
+			(color_t){ bytes[7], bytes[8], bytes[9] }
+		);
+	}
+	const uint64_t stop = last < block.first_step + block.deltas ?
+		last : block.first_step + block.deltas;
+	for (uint64_t step = block.first_step; result == RANDOMWALK_OK && step <= stop; step++) {
+		if (step > block.first_step) {
+			const size_t size = delta_size(particles.count);
+			if (size > (size_t)(end - bytes)) {
+				result = RANDOMWALK_FAIL;
+				break;
+			}
+			result = delta_apply(&particles, bytes, info->width, info->height, info->wrap);
+			bytes += size;
+			if (result != RANDOMWALK_OK)
+				break;
+		}
+		if (step >= first)
+			result = visit(context, step, &particles);
+	}
+	particle_store_destroy(&particles);
+	return result;
+}
+
+randomwalk_result_t trajectory_read(
+	const trajectory_t* const trajectory,
+	const uint64_t first,
+	const uint64_t last,
+	trajectory_visit_t visit,
+	void* context
+) {
+	uint64_t index;
+	randomwalk_result_t result = trajectory_find_block(trajectory, first, &index);
+	while (result == RANDOMWALK_OK && index < trajectory->info.block_count &&
+		load_le(trajectory->index + index * INDEX_ENTRY_SIZE, 8) <= last)
+		result = trajectory_decode_block(trajectory, index++, first, last, visit, context);
+	return result;
+}
+
+randomwalk_result_t trajectory_close(trajectory_t** trajectory) {
+	if (!trajectory || !*trajectory)
+		return RANDOMWALK_FAIL;
+	munmap((*trajectory)->data, (*trajectory)->size);
+	free(*trajectory);
+	*trajectory = NULL;
+	return RANDOMWALK_OK;
+}
+
+static uint8_t* store_le(uint8_t* bytes, uint64_t value, const size_t size) {
+	for (size_t i = 0; i < size; i++, value >>= 8)
+		*bytes++ = (uint8_t)value;
+	return bytes;
+}
+
+static uint64_t load_le(const uint8_t* const bytes, const size_t size) {
+	uint64_t value = 0;
+	for (size_t i = size; i > 0; i--)
+		value = value << 8 | bytes[i - 1];
+	return value;
+}
+
+static void start_block(
+	trajectory_writer_t* const writer,
+	const uint64_t step,
+	const particle_store_t* const particles
+) {
+	uint8_t* bytes = store_le(writer->block, step, 8);
+	bytes = store_le(bytes, 0, 4);
+	bytes = store_le(bytes, particles->count, 4);
+	for (uint32_t i = 0; i < particles->count; i++) {
+		bytes = store_le(bytes, particles->id[i], 4);
+		*bytes++ = particles->x[i];
+		*bytes++ = particles->y[i];
+		*bytes++ = particles->direction[i];
+		*bytes++ = particles->color[i].r;
+		*bytes++ = particles->color[i].g;
+		*bytes++ = particles->color[i].b;
+	}
+	writer->size = (size_t)(bytes - writer->block);
+}
+
+static void flush_block(trajectory_writer_t* const writer) {
+	if (writer->blocks == writer->index_capacity) {
+		const uint64_t capacity = writer->index_capacity ? writer->index_capacity * 2 : 64;
+		trajectory_block_t* const index = (trajectory_block_t*)realloc(
+			writer->index,
+			capacity * sizeof(trajectory_block_t)
+		);
+		if (!index) {
+			writer->failed = true;
+			return;
+		}
+		writer->index = index;
+		writer->index_capacity = capacity;
+	}
+	const long offset = ftell(writer->file);
+	if (offset < 0 || fwrite(writer->block, writer->size, 1, writer->file) != 1) {
+		writer->failed = true;
+		return;
+	}
+	writer->index[writer->blocks++] = (trajectory_block_t){
+		.first_step = load_le(writer->block, 8),
+		.deltas = (uint32_t)load_le(writer->block + 8, 4),
+		.offset = (uint64_t)offset,
+		.size = writer->size
+	};
+	writer->size = 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * @file trajectory.h
+ * @brief Compressed trajectory files with block-level random access.
+ * @author Justin Thoreson
+ *
+ * A trajectory file holds every step of a random walk, chunked into blocks of
+ * consecutive steps. Each block opens with a keyframe of the particles at its
+ * first step, followed by the delta of each later step (see delta.h), so a
+ * block decodes on its own. An index of the blocks at the end of the file lets
+ * readers seek to any step and decode disjoint step ranges in parallel.
+ *
+ * All integers are little-endian. The file begins with a header:
+ *
+ * | Bytes | Field                                        |
+ * |-------|----------------------------------------------|
+ * | 8     | magic "RWTRAJ01"                             |
+ * | 1     | width                                        |
+ * | 1     | height                                       |
+ * | 1     | wrap                                         |
+ * | 1     | reserved                                     |
+ * | 4     | initial particle count                       |
+ * | 4     | most steps per block, keyframe included      |
+ * | 8     | offset of the index                          |
+ *
+ * Each block holds uint64 first step, uint32 number of deltas, uint32 particle
+ * count, that many particles (uint32 id, uint8 x, uint8 y, uint8 direction,
+ * uint8 red, uint8 green, uint8 blue) and the deltas, each sized by the
+ * particles alive before it. The index holds uint64 block count, then per
+ * block uint64 first step, uint32 number of deltas, uint64 offset and uint64
+ * size.
+ */
+
+#pragma once
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "observer.h"
+#include "particles.h"
+#include "randomwalk.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The default number of steps per block.
+ */
+#define TRAJECTORY_DEFAULT_BLOCK_STEPS 256
+
+/**
+ * @brief A writer of a trajectory file.
+ */
+typedef struct trajectory_writer_t trajectory_writer_t;
+
+/**
+ * @brief A memory-mapped trajectory file being read.
+ */
+typedef struct trajectory_t trajectory_t;
+
+/**
+ * @brief A description of a trajectory file.
+ */
+typedef struct {
+	uint8_t width, height;
+	bool wrap;
+	uint32_t particle_count; // Particles alive at the first step
+	uint32_t block_steps;    // Most steps in a block
+	uint64_t block_count;
+	uint64_t first_step, last_step;
+} trajectory_info_t;
+
+/**
+ * @brief An entry of the block index.
+ */
+typedef struct {
+	uint64_t first_step;
+	uint32_t deltas; // Steps following the first step
+	uint64_t offset, size;
+} trajectory_block_t;
+
+/**
+ * @brief A consumer of decoded steps.
+ * @param[in,out] context The context of the consumer.
+ * @param[in] step The decoded step.
+ * @param[in] particles The particles alive after the step, whose direction is
+ * the one they last moved in.
+ * @return The result of consuming the step; anything but RANDOMWALK_OK stops
+ * decoding.
+ */
+typedef randomwalk_result_t (*trajectory_visit_t)(
+	void* context,
+	const uint64_t step,
+	const particle_store_t* const particles
+);
+
+/**
+ * @brief Create a trajectory file to write steps to.
+ * @param[out] writer The created writer.
+ * @param[in] path The file to write.
+ * @param[in] block_steps The most steps per block; 0 for the default.
+ * @param[in] args The random walk arguments.
+ * @return The result of creating the writer.
+ */
+randomwalk_result_t trajectory_writer_create(
+	trajectory_writer_t** writer,
+	const char* const path,
+	const uint32_t block_steps,
+	const randomwalk_args_t args
+);
+
+/**
+ * @brief Write a frame to a trajectory file; an observer_t callback.
+ * @param[in,out] context The trajectory_writer_t to write with.
+ * @param[in] frame The frame to write.
+ * @return The result of writing the frame.
+ */
+randomwalk_result_t trajectory_writer_observe(void* context, const frame_t* const frame);
+
+/**
+ * @brief Write the last block and the index, then close the file.
+ * @param[in,out] writer The writer to destroy.
+ * @return The result of finishing the file.
+ */
+randomwalk_result_t trajectory_writer_destroy(trajectory_writer_t** writer);
+
+/**
+ * @brief Map a trajectory file for reading.
+ * @param[out] trajectory The opened trajectory.
+ * @param[in] path The file to read.
+ * @return The result of opening the file.
+ */
+randomwalk_result_t trajectory_open(trajectory_t** trajectory, const char* const path);
+
+/**
+ * @brief Describe a trajectory file.
+ * @param[in] trajectory The trajectory to describe.
+ * @param[out] info The description.
+ * @return The result of describing the trajectory.
+ */
+randomwalk_result_t trajectory_info(
+	const trajectory_t* const trajectory,
+	trajectory_info_t* const info
+);
+
+/**
+ * @brief Get an entry of the block index.
+ * @param[in] trajectory The trajectory to query.
+ * @param[in] index The index of the block.
+ * @param[out] block The entry of the block.
+ * @return The result of reading the entry.
+ */
+randomwalk_result_t trajectory_block(
+	const trajectory_t* const trajectory,
+	const uint64_t index,
+	trajectory_block_t* const block
+);
+
+/**
+ * @brief Find the block holding a step.
+ * @param[in] trajectory The trajectory to search.
+ * @param[in] step The step to find.
+ * @param[out] index The index of the block holding the step.
+ * @return The result of the search; RANDOMWALK_FAIL if no block holds the step.
+ */
+randomwalk_result_t trajectory_find_block(
+	const trajectory_t* const trajectory,
+	const uint64_t step,
+	uint64_t* const index
+);
+
+/**
+ * @brief Decode the steps of one block within a range.
+ *
+ * Blocks are decoded independently, so distinct blocks may be decoded by
+ * distinct threads at once.
+ *
+ * @param[in] trajectory The trajectory to decode.
+ * @param[in] index The index of the block.
+ * @param[in] first The first step to visit.
+ * @param[in] last The last step to visit.
+ * @param[in] visit The consumer of each decoded step.
+ * @param[in,out] context The context of the consumer.
+ * @return The result of decoding the block.
+ */
+randomwalk_result_t trajectory_decode_block(
+	const trajectory_t* const trajectory,
+	const uint64_t index,
+	const uint64_t first,
+	const uint64_t last,
+	trajectory_visit_t visit,
+	void* context
+);
+
+/**
+ * @brief Decode every step within a range, in order.
+ * @param[in] trajectory The trajectory to decode.
+ * @param[in] first The first step to visit.
+ * @param[in] last The last step to visit.
+ * @param[in] visit The consumer of each decoded step.
+ * @param[in,out] context The context of the consumer.
+ * @return The result of decoding the range.
+ */
+randomwalk_result_t trajectory_read(
+	const trajectory_t* const trajectory,
+	const uint64_t first,
+	const uint64_t last,
+	trajectory_visit_t visit,
+	void* context
+);
+
+/**
+ * @brief Unmap a trajectory file.
+ * @param[in,out] trajectory The trajectory to close.
+ * @return The result of closing the trajectory.
+ */
+randomwalk_result_t trajectory_close(trajectory_t** trajectory);
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,58 @@
+/**
+ * @file transport.h
+ * @brief The exchange layer connecting a strip of the plane to the others.
+ * @author Justin Thoreson
+ */
+
+#pragma once
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "particles.h"
+#include "rng.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief A particle handed off from one strip to another.
+ */
+typedef struct {
+	uint32_t id;
+	uint8_t x, y, direction;
+	color_t color;
+	rng_t rng;
+} migrant_t;
+
+/**
+ * @brief The neighbors of a strip.
+ */
+typedef enum {
+	TRANSPORT_NORTH = 0,
+	TRANSPORT_SOUTH,
+	TRANSPORT_SIDE_COUNT, // special enumeration to track the number of enumerators
+} transport_side_t;
+
+/**
+ * @brief The exchange layer through which a strip reaches the other strips.
+ *
+ * Each step, a strip sends the particles leaving it to its neighbors, finishes
+ * walking, and receives until every strip has finished walking. Between steps,
+ * the particles alive in every strip are totalled. Strips may be threads,
+ * processes or machines; only the transport knows which.
+ */
+typedef struct {
+	// Hand a migrant to a neighbor; false if that would block, in which case
+	// the strip receives before retrying
+	bool (*send)(void* context, const transport_side_t side, const migrant_t* const migrant);
+	// Take a migrant sent to the strip; false if none is waiting
+	bool (*receive)(void* context, migrant_t* const migrant);
+	// Announce that the strip sends nothing more this step
+	void (*finish_walk)(void* context);
+	// Whether every strip has finished walking this step
+	bool (*all_walked)(void* context);
+	// Total the particles alive in every strip after a step
+	uint32_t (*total)(void* context, const uint32_t alive);
+	void* context;
+} transport_t;
+
+#endif // TRANSPORT_H